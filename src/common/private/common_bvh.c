@@ -0,0 +1,476 @@
+// SPDX-License-Identifier: LGPL-3.0-or-later
+// Copyright © 2020-2023 OldTimes Software, Mark E Sowden <hogsy@oldtimes-software.com>
+
+#include <plcore/pl_console.h>
+
+#include "common.h"
+#include "common_bvh.h"
+
+static void ExpandBounds( CommonBVHBounds *out, const CommonBVHBounds *bounds )
+{
+	out->mins.x = ( bounds->mins.x < out->mins.x ) ? bounds->mins.x : out->mins.x;
+	out->mins.y = ( bounds->mins.y < out->mins.y ) ? bounds->mins.y : out->mins.y;
+	out->mins.z = ( bounds->mins.z < out->mins.z ) ? bounds->mins.z : out->mins.z;
+	out->maxs.x = ( bounds->maxs.x > out->maxs.x ) ? bounds->maxs.x : out->maxs.x;
+	out->maxs.y = ( bounds->maxs.y > out->maxs.y ) ? bounds->maxs.y : out->maxs.y;
+	out->maxs.z = ( bounds->maxs.z > out->maxs.z ) ? bounds->maxs.z : out->maxs.z;
+}
+
+/****************************************
+ * BUILD
+ ****************************************/
+
+typedef struct BuildContext
+{
+	CommonBVH *bvh;
+	float ( *centroids )[ 3 ];
+} BuildContext;
+
+/**
+ * Partially sorts the items so the nth lands where it would if they were
+ * fully sorted along the given axis, with everything before it no greater
+ * and everything after it no less.
+ */
+static void SelectNth( const BuildContext *ctx, uint32_t *items, int numItems, int nth, unsigned int axis )
+{
+	int lo = 0;
+	int hi = numItems - 1;
+	while ( lo < hi )
+	{
+		float pivot = ctx->centroids[ items[ ( lo + hi ) / 2 ] ][ axis ];
+		int   i     = lo;
+		int   j     = hi;
+		while ( i <= j )
+		{
+			while ( ctx->centroids[ items[ i ] ][ axis ] < pivot )
+				i++;
+			while ( ctx->centroids[ items[ j ] ][ axis ] > pivot )
+				j--;
+			if ( i <= j )
+			{
+				uint32_t tmp = items[ i ];
+				items[ i++ ] = items[ j ];
+				items[ j-- ] = tmp;
+			}
+		}
+
+		if ( nth <= j )
+			hi = j;
+		else if ( nth >= i )
+			lo = i;
+		else
+			break;
+	}
+}
+
+static uint32_t BuildNode( BuildContext *ctx, const CommonBVHBounds *bounds, unsigned int first, unsigned int numItems )
+{
+	CommonBVH     *bvh       = ctx->bvh;
+	uint32_t       nodeIndex = bvh->numNodes++;
+	CommonBVHNode *node      = &bvh->nodes[ nodeIndex ];
+
+	node->bounds = bounds[ bvh->items[ first ] ];
+
+	float centroidMins[ 3 ], centroidMaxs[ 3 ];
+	for ( unsigned int i = 0; i < 3; ++i )
+		centroidMins[ i ] = centroidMaxs[ i ] = ctx->centroids[ bvh->items[ first ] ][ i ];
+
+	for ( unsigned int i = first + 1; i < first + numItems; ++i )
+	{
+		ExpandBounds( &node->bounds, &bounds[ bvh->items[ i ] ] );
+		for ( unsigned int j = 0; j < 3; ++j )
+		{
+			float c           = ctx->centroids[ bvh->items[ i ] ][ j ];
+			centroidMins[ j ] = ( c < centroidMins[ j ] ) ? c : centroidMins[ j ];
+			centroidMaxs[ j ] = ( c > centroidMaxs[ j ] ) ? c : centroidMaxs[ j ];
+		}
+	}
+
+	/* split along whichever axis the centres are most spread out on */
+	unsigned int axis = 0;
+	for ( unsigned int i = 1; i < 3; ++i )
+	{
+		if ( centroidMaxs[ i ] - centroidMins[ i ] > centroidMaxs[ axis ] - centroidMins[ axis ] )
+			axis = i;
+	}
+
+	/* nothing left to separate them by, so it's a leaf */
+	if ( numItems <= CMN_BVH_MAX_LEAF_ITEMS || centroidMaxs[ axis ] <= centroidMins[ axis ] )
+	{
+		node->offset   = first;
+		node->numItems = numItems;
+		return nodeIndex;
+	}
+
+	/* splitting down the median keeps the tree balanced, which
+	 * in turn keeps it well within CMN_BVH_MAX_DEPTH */
+	unsigned int numLeft = numItems / 2;
+	SelectNth( ctx, &bvh->items[ first ], ( int ) numItems, ( int ) numLeft, axis );
+
+	BuildNode( ctx, bounds, first, numLeft );
+	uint32_t right = BuildNode( ctx, bounds, first + numLeft, numItems - numLeft );
+
+	/* nodes were allocated up front, so this is still valid */
+	node->offset   = right;
+	node->numItems = 0;
+
+	return nodeIndex;
+}
+
+/**
+ * Builds a tree over the given boxes. Any existing tree is destroyed.
+ */
+bool Common_BVH_Build( CommonBVH *bvh, const CommonBVHBounds *bounds, unsigned int numBounds )
+{
+	Common_BVH_Destroy( bvh );
+	if ( numBounds == 0 )
+		return true;
+
+	bvh->nodes      = PlMAllocA( sizeof( CommonBVHNode ) * ( numBounds * 2 - 1 ) );
+	bvh->items      = PlMAllocA( sizeof( uint32_t ) * numBounds );
+	bvh->itemBounds = PlMAllocA( sizeof( CommonBVHBounds ) * numBounds );
+	if ( bvh->nodes == NULL || bvh->items == NULL || bvh->itemBounds == NULL )
+	{
+		Warning( "Failed to allocate bvh for %u items!\n", numBounds );
+		Common_BVH_Destroy( bvh );
+		return false;
+	}
+
+	BuildContext ctx;
+	ctx.bvh       = bvh;
+	ctx.centroids = PlMAllocA( sizeof( float[ 3 ] ) * numBounds );
+	for ( unsigned int i = 0; i < numBounds; ++i )
+	{
+		/* no need to halve these, since they're only ever compared */
+		ctx.centroids[ i ][ 0 ] = bounds[ i ].mins.x + bounds[ i ].maxs.x;
+		ctx.centroids[ i ][ 1 ] = bounds[ i ].mins.y + bounds[ i ].maxs.y;
+		ctx.centroids[ i ][ 2 ] = bounds[ i ].mins.z + bounds[ i ].maxs.z;
+		bvh->items[ i ]         = i;
+	}
+
+	bvh->numItems = numBounds;
+	BuildNode( &ctx, bounds, 0, numBounds );
+
+	PL_DELETE( ctx.centroids );
+
+	for ( unsigned int i = 0; i < numBounds; ++i )
+		bvh->itemBounds[ i ] = bounds[ bvh->items[ i ] ];
+
+	return true;
+}
+
+/**
+ * Checks the tree's layout is something we can safely walk; every node
+ * reachable exactly once, children after their parent and every item
+ * belonging to exactly one leaf.
+ */
+static bool ValidateTree( const CommonBVH *bvh, unsigned int numBounds )
+{
+	bool     status  = false;
+	uint8_t *visited = PlCAllocA( bvh->numNodes + numBounds * 2, sizeof( uint8_t ) );
+	uint8_t *slots   = visited + bvh->numNodes;
+	uint8_t *seen    = slots + numBounds;
+
+	uint32_t     stack[ CMN_BVH_MAX_DEPTH ];
+	unsigned int stackSize = 0;
+	unsigned int depth[ CMN_BVH_MAX_DEPTH ];
+	uint32_t     nodeIndex = 0;
+	unsigned int curDepth  = 0;
+	for ( ;; )
+	{
+		if ( visited[ nodeIndex ] )
+			goto end;
+
+		visited[ nodeIndex ] = 1;
+
+		const CommonBVHNode *node = &bvh->nodes[ nodeIndex ];
+		if ( node->numItems == 0 )
+		{
+			if ( nodeIndex + 1 >= bvh->numNodes || node->offset <= nodeIndex + 1 || node->offset >= bvh->numNodes )
+				goto end;
+
+			if ( curDepth + 1 >= CMN_BVH_MAX_DEPTH )
+				goto end;
+
+			depth[ stackSize ]   = curDepth + 1;
+			stack[ stackSize++ ] = node->offset;
+			nodeIndex++;
+			curDepth++;
+			continue;
+		}
+
+		if ( node->offset >= numBounds || node->numItems > numBounds - node->offset )
+			goto end;
+
+		for ( unsigned int i = node->offset; i < node->offset + node->numItems; ++i )
+		{
+			if ( slots[ i ] || bvh->items[ i ] >= numBounds || seen[ bvh->items[ i ] ] )
+				goto end;
+
+			slots[ i ]              = 1;
+			seen[ bvh->items[ i ] ] = 1;
+		}
+
+		if ( stackSize == 0 )
+			break;
+
+		nodeIndex = stack[ --stackSize ];
+		curDepth  = depth[ stackSize ];
+	}
+
+	status = true;
+	for ( unsigned int i = 0; i < bvh->numNodes; ++i )
+	{
+		if ( !visited[ i ] )
+			status = false;
+	}
+	for ( unsigned int i = 0; i < numBounds; ++i )
+	{
+		if ( !slots[ i ] )
+			status = false;
+	}
+
+end:
+	PL_DELETE( visited );
+	return status;
+}
+
+/**
+ * Sets up the tree from a previously built layout, i.e. one that's been
+ * stored alongside the data it was built for. Node bounds aren't stored,
+ * and instead get recalculated from the given boxes.
+ *
+ * Nodes are given as pairs of offset and number of items, per CommonBVHNode.
+ */
+bool Common_BVH_Load( CommonBVH *bvh, const uint32_t *nodes, unsigned int numNodes, const uint32_t *items, const CommonBVHBounds *bounds, unsigned int numBounds )
+{
+	Common_BVH_Destroy( bvh );
+	if ( numNodes == 0 || numBounds == 0 || numNodes > numBounds * 2 - 1 )
+	{
+		Warning( "Invalid number of nodes for bvh (%u nodes, %u items)!\n", numNodes, numBounds );
+		return false;
+	}
+
+	bvh->nodes      = PlMAllocA( sizeof( CommonBVHNode ) * numNodes );
+	bvh->items      = PlMAllocA( sizeof( uint32_t ) * numBounds );
+	bvh->itemBounds = PlMAllocA( sizeof( CommonBVHBounds ) * numBounds );
+	bvh->numNodes   = numNodes;
+	bvh->numItems   = numBounds;
+
+	for ( unsigned int i = 0; i < numNodes; ++i )
+	{
+		bvh->nodes[ i ].offset   = nodes[ i * 2 ];
+		bvh->nodes[ i ].numItems = nodes[ i * 2 + 1 ];
+	}
+	memcpy( bvh->items, items, sizeof( uint32_t ) * numBounds );
+
+	if ( !ValidateTree( bvh, numBounds ) )
+	{
+		Warning( "Invalid bvh layout!\n" );
+		Common_BVH_Destroy( bvh );
+		return false;
+	}
+
+	for ( unsigned int i = 0; i < numBounds; ++i )
+		bvh->itemBounds[ i ] = bounds[ bvh->items[ i ] ];
+
+	Common_BVH_Refit( bvh );
+
+	return true;
+}
+
+/**
+ * Recalculates the bounds of every node from the item bounds,
+ * for when items have moved but not enough to warrant a rebuild.
+ */
+void Common_BVH_Refit( CommonBVH *bvh )
+{
+	/* children always come after their parent, so going
+	 * backwards means they're done before we get to it */
+	for ( unsigned int i = bvh->numNodes; i-- > 0; )
+	{
+		CommonBVHNode *node = &bvh->nodes[ i ];
+		if ( node->numItems == 0 )
+		{
+			node->bounds = bvh->nodes[ i + 1 ].bounds;
+			ExpandBounds( &node->bounds, &bvh->nodes[ node->offset ].bounds );
+			continue;
+		}
+
+		node->bounds = bvh->itemBounds[ node->offset ];
+		for ( unsigned int j = 1; j < node->numItems; ++j )
+			ExpandBounds( &node->bounds, &bvh->itemBounds[ node->offset + j ] );
+	}
+}
+
+void Common_BVH_Destroy( CommonBVH *bvh )
+{
+	PL_DELETE( bvh->nodes );
+	PL_DELETE( bvh->items );
+	PL_DELETE( bvh->itemBounds );
+	PL_ZERO( bvh, sizeof( CommonBVH ) );
+}
+
+/****************************************
+ * QUERIES
+ ****************************************/
+
+bool Common_BVH_TestBounds( const CommonBVHBounds *a, const CommonBVHBounds *b )
+{
+	return !( a->maxs.x < b->mins.x || a->mins.x > b->maxs.x ||
+	          a->maxs.y < b->mins.y || a->mins.y > b->maxs.y ||
+	          a->maxs.z < b->mins.z || a->mins.z > b->maxs.z );
+}
+
+bool Common_BVH_TestSphere( const CommonBVHBounds *bounds, const PLVector3 *origin, float radius )
+{
+	const float o[ 3 ]    = { origin->x, origin->y, origin->z };
+	const float mins[ 3 ] = { bounds->mins.x, bounds->mins.y, bounds->mins.z };
+	const float maxs[ 3 ] = { bounds->maxs.x, bounds->maxs.y, bounds->maxs.z };
+
+	/* squared distance from the centre to the nearest point in the box */
+	float d = 0.0f;
+	for ( unsigned int i = 0; i < 3; ++i )
+	{
+		float e = 0.0f;
+		if ( o[ i ] < mins[ i ] )
+			e = mins[ i ] - o[ i ];
+		else if ( o[ i ] > maxs[ i ] )
+			e = o[ i ] - maxs[ i ];
+
+		d += e * e;
+	}
+
+	return d <= radius * radius;
+}
+
+/**
+ * Checks whether the segment starting at origin, going distance
+ * along direction, passes through the box.
+ */
+bool Common_BVH_TestRay( const CommonBVHBounds *bounds, const PLVector3 *origin, const PLVector3 *direction, float distance )
+{
+	const float o[ 3 ]    = { origin->x, origin->y, origin->z };
+	const float d[ 3 ]    = { direction->x, direction->y, direction->z };
+	const float mins[ 3 ] = { bounds->mins.x, bounds->mins.y, bounds->mins.z };
+	const float maxs[ 3 ] = { bounds->maxs.x, bounds->maxs.y, bounds->maxs.z };
+
+	float tMin = 0.0f;
+	float tMax = distance;
+	for ( unsigned int i = 0; i < 3; ++i )
+	{
+		/* parallel with this slab, so we're either in it or we're not */
+		if ( d[ i ] == 0.0f )
+		{
+			if ( o[ i ] < mins[ i ] || o[ i ] > maxs[ i ] )
+				return false;
+
+			continue;
+		}
+
+		float t0 = ( mins[ i ] - o[ i ] ) / d[ i ];
+		float t1 = ( maxs[ i ] - o[ i ] ) / d[ i ];
+		if ( t0 > t1 )
+		{
+			float tmp = t0;
+			t0        = t1;
+			t1        = tmp;
+		}
+
+		tMin = ( t0 > tMin ) ? t0 : tMin;
+		tMax = ( t1 < tMax ) ? t1 : tMax;
+		if ( tMin > tMax )
+			return false;
+	}
+
+	return true;
+}
+
+unsigned int Common_BVH_Query( const CommonBVH *bvh, CommonBVHTestFunction test, void *user, uint32_t *items, unsigned int maxItems )
+{
+	if ( bvh->numNodes == 0 )
+		return 0;
+
+	uint32_t     stack[ CMN_BVH_MAX_DEPTH ];
+	unsigned int stackSize = 0;
+	unsigned int numFound  = 0;
+	uint32_t     nodeIndex = 0;
+	for ( ;; )
+	{
+		const CommonBVHNode *node = &bvh->nodes[ nodeIndex ];
+		if ( test( &node->bounds, user ) )
+		{
+			if ( node->numItems == 0 )
+			{
+				stack[ stackSize++ ] = node->offset;
+				nodeIndex++;
+				continue;
+			}
+
+			for ( unsigned int i = node->offset; i < node->offset + node->numItems; ++i )
+			{
+				if ( !test( &bvh->itemBounds[ i ], user ) )
+					continue;
+
+				if ( numFound == maxItems )
+					return numFound;
+
+				items[ numFound++ ] = bvh->items[ i ];
+			}
+		}
+
+		if ( stackSize == 0 )
+			break;
+
+		nodeIndex = stack[ --stackSize ];
+	}
+
+	return numFound;
+}
+
+static bool QueryBoundsTest( const CommonBVHBounds *bounds, void *user )
+{
+	return Common_BVH_TestBounds( bounds, user );
+}
+
+unsigned int Common_BVH_QueryBounds( const CommonBVH *bvh, const CommonBVHBounds *bounds, uint32_t *items, unsigned int maxItems )
+{
+	return Common_BVH_Query( bvh, QueryBoundsTest, ( void * ) bounds, items, maxItems );
+}
+
+typedef struct SphereQuery
+{
+	PLVector3 origin;
+	float     radius;
+} SphereQuery;
+
+static bool QuerySphereTest( const CommonBVHBounds *bounds, void *user )
+{
+	const SphereQuery *query = user;
+	return Common_BVH_TestSphere( bounds, &query->origin, query->radius );
+}
+
+unsigned int Common_BVH_QuerySphere( const CommonBVH *bvh, const PLVector3 *origin, float radius, uint32_t *items, unsigned int maxItems )
+{
+	SphereQuery query = { *origin, radius };
+	return Common_BVH_Query( bvh, QuerySphereTest, &query, items, maxItems );
+}
+
+typedef struct RayQuery
+{
+	PLVector3 origin;
+	PLVector3 direction;
+	float     distance;
+} RayQuery;
+
+static bool QueryRayTest( const CommonBVHBounds *bounds, void *user )
+{
+	const RayQuery *query = user;
+	return Common_BVH_TestRay( bounds, &query->origin, &query->direction, query->distance );
+}
+
+unsigned int Common_BVH_QueryRay( const CommonBVH *bvh, const PLVector3 *origin, const PLVector3 *direction, float distance, uint32_t *items, unsigned int maxItems )
+{
+	RayQuery query = { *origin, *direction, distance };
+	return Common_BVH_Query( bvh, QueryRayTest, &query, items, maxItems );
+}
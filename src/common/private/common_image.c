@@ -0,0 +1,570 @@
+// SPDX-License-Identifier: LGPL-3.0-or-later
+// Copyright © 2020-2023 OldTimes Software, Mark E Sowden <hogsy@oldtimes-software.com>
+
+#include <plcore/pl_filesystem.h>
+#include <plcore/pl_image.h>
+
+#include "common.h"
+#include "common_format_gfx.h"
+
+/////////////////////////////////////////////////////////////////
+// READ
+
+#define GFX_LEGACY_IDENTIFIER "GFX0"
+
+static unsigned int GetLevelDimension( unsigned int size, unsigned int level )
+{
+	size >>= level;
+	return ( size > 0 ) ? size : 1;
+}
+
+static size_t GetPixelOffsetSize( uint32_t pixelSize )
+{
+	if ( pixelSize < UINT8_MAX )
+		return sizeof( uint8_t );
+	else if ( pixelSize < UINT16_MAX )
+		return sizeof( uint16_t );
+
+	return sizeof( uint32_t );
+}
+
+/**
+ * Everything after the header is pulled in with a single read, and then
+ * decoded straight out of memory, rather than going through the file
+ * API for every byte.
+ */
+typedef struct ImageReader
+{
+	const uint8_t *pos;
+	const uint8_t *end;
+	const char    *path;
+} ImageReader;
+
+static bool ReadBytes( ImageReader *reader, void *dest, size_t size )
+{
+	if ( ( size_t ) ( reader->end - reader->pos ) < size )
+		return false;
+
+	memcpy( dest, reader->pos, size );
+	reader->pos += size;
+	return true;
+}
+
+static bool ReadUInt8( ImageReader *reader, uint8_t *dest )
+{
+	if ( reader->pos >= reader->end )
+		return false;
+
+	*dest = *reader->pos++;
+	return true;
+}
+
+static bool ReadUInt16( ImageReader *reader, uint16_t *dest )
+{
+	if ( reader->end - reader->pos < 2 )
+		return false;
+
+	*dest = ( uint16_t ) ( reader->pos[ 0 ] | ( reader->pos[ 1 ] << 8 ) );
+	reader->pos += 2;
+	return true;
+}
+
+static bool ReadColour( ImageReader *reader, uint8_t flags, uint8_t *colour )
+{
+	if ( ( flags & PGFX_CHANNEL_RED ) && !ReadUInt8( reader, &colour[ 0 ] ) ) return false;
+	if ( ( flags & PGFX_CHANNEL_GREEN ) && !ReadUInt8( reader, &colour[ 1 ] ) ) return false;
+	if ( ( flags & PGFX_CHANNEL_BLUE ) && !ReadUInt8( reader, &colour[ 2 ] ) ) return false;
+	if ( ( flags & PGFX_CHANNEL_ALPHA ) && !ReadUInt8( reader, &colour[ 3 ] ) ) return false;
+	return true;
+}
+
+/* expands a block's colour out to each of its pixels, returns false on a bad offset */
+#define EXPAND_BLOCK( OFFSET_TYPE, NUM_CHANNELS )                                     \
+	{                                                                                 \
+		for ( unsigned int j = 0; j < numBlockPixels; ++j )                           \
+		{                                                                             \
+			OFFSET_TYPE po;                                                           \
+			memcpy( &po, offsets + j * sizeof( OFFSET_TYPE ), sizeof( OFFSET_TYPE ) ); \
+			if ( po >= pixelSize )                                                    \
+				return false;                                                         \
+			memcpy( &dest[ ( size_t ) po * NUM_CHANNELS ], colour, NUM_CHANNELS );    \
+		}                                                                             \
+		return true;                                                                  \
+	}
+
+static bool ExpandBlock( uint8_t *dest, uint32_t pixelSize, unsigned int numChannels, const uint8_t *colour,
+                         const uint8_t *offsets, size_t offsetSize, uint16_t numBlockPixels )
+{
+	/* specialised for each combination, so the inner loop
+	 * boils down to a load, compare and fixed-size store */
+	if ( numChannels == 4 )
+	{
+		if ( offsetSize == sizeof( uint8_t ) ) EXPAND_BLOCK( uint8_t, 4 )
+		else if ( offsetSize == sizeof( uint16_t ) ) EXPAND_BLOCK( uint16_t, 4 )
+		else EXPAND_BLOCK( uint32_t, 4 )
+	}
+
+	if ( offsetSize == sizeof( uint8_t ) ) EXPAND_BLOCK( uint8_t, 3 )
+	else if ( offsetSize == sizeof( uint16_t ) ) EXPAND_BLOCK( uint16_t, 3 )
+	else EXPAND_BLOCK( uint32_t, 3 )
+}
+
+/**
+ * Reads in the blocks for a cluster image, writing each
+ * block's colour out to every pixel it covers.
+ */
+static bool ReadClusterBlocks( ImageReader *reader, uint8_t *dest, uint32_t pixelSize, unsigned int numChannels, uint16_t numBlocks )
+{
+	size_t offsetSize = GetPixelOffsetSize( pixelSize );
+	for ( unsigned int i = 0; i < numBlocks; ++i )
+	{
+		/* fetch the number of channels and then create our colour store */
+		uint8_t  blockFlags;
+		uint8_t  colour[ 4 ] = { 0, 0, 0, 255 };
+		uint16_t numBlockPixels;
+		if ( !ReadUInt8( reader, &blockFlags ) || !ReadColour( reader, blockFlags, colour ) || !ReadUInt16( reader, &numBlockPixels ) )
+		{
+			Warning( "Failed to read in block %u header in \"%s\"!\n", i, reader->path );
+			return false;
+		}
+
+		/* the offsets are used in place */
+		size_t offsetsLength = offsetSize * numBlockPixels;
+		if ( ( size_t ) ( reader->end - reader->pos ) < offsetsLength )
+		{
+			Warning( "Failed to read pixel offsets in block %u, in \"%s\"!\n", i, reader->path );
+			return false;
+		}
+
+		if ( !ExpandBlock( dest, pixelSize, numChannels, colour, reader->pos, offsetSize, numBlockPixels ) )
+		{
+			Warning( "Invalid pixel offset in block %u, in \"%s\"!\n", i, reader->path );
+			return false;
+		}
+
+		reader->pos += offsetsLength;
+	}
+
+	return true;
+}
+
+static bool ReadClusterPlainData( ImageReader *reader, uint8_t *dest, uint32_t pixelSize, unsigned int numChannels, uint8_t flags )
+{
+	/* if the stored layout matches ours, it can just be copied over */
+	uint8_t allChannels = PGFX_CHANNEL_RED | PGFX_CHANNEL_GREEN | PGFX_CHANNEL_BLUE;
+	if ( numChannels == 4 )
+		allChannels |= PGFX_CHANNEL_ALPHA;
+
+	if ( flags == allChannels )
+		return ReadBytes( reader, dest, ( size_t ) pixelSize * numChannels );
+
+	unsigned int numStoredChannels = 0;
+	for ( unsigned int i = 0; i < 4; ++i )
+	{
+		if ( flags & ( 1 << i ) )
+			numStoredChannels++;
+	}
+
+	if ( ( size_t ) ( reader->end - reader->pos ) < ( size_t ) pixelSize * numStoredChannels )
+		return false;
+
+	uint8_t *pixelPos = dest;
+	for ( unsigned int i = 0; i < pixelSize; ++i )
+	{
+		ReadColour( reader, flags, pixelPos );
+		pixelPos += numChannels;
+	}
+
+	return true;
+}
+
+static bool ReadClusterLevel( ImageReader *reader, uint8_t *dest, unsigned int width, unsigned int height, unsigned int numChannels )
+{
+	uint8_t  flags;
+	uint16_t numBlocks;
+	if ( !ReadUInt8( reader, &flags ) || !ReadUInt16( reader, &numBlocks ) )
+	{
+		Warning( "Failed to read level header for \"%s\"!\n", reader->path );
+		return false;
+	}
+
+	/* any channels that aren't provided default to opaque black */
+	uint32_t pixelSize = width * height;
+	if ( numChannels > 3 )
+	{
+		static const uint8_t black[ 4 ] = { 0, 0, 0, 255 };
+		for ( uint32_t i = 0; i < pixelSize; ++i )
+			memcpy( &dest[ i * 4 ], black, 4 );
+	}
+	else
+		memset( dest, 0, ( size_t ) pixelSize * numChannels );
+
+	if ( numBlocks == 0 )
+		return ReadClusterPlainData( reader, dest, pixelSize, numChannels, flags );
+
+	return ReadClusterBlocks( reader, dest, pixelSize, numChannels, numBlocks );
+}
+
+/* the original decoder, which goes through the file API for every
+ * byte; only used when benchmarking against the one above */
+
+static bool useReferenceDecoder = false;
+
+static bool ReadClusterBlocksReference( PLFile *file, uint8_t *dest, uint32_t pixelSize, unsigned int numChannels, uint16_t numBlocks )
+{
+	const char *path = PlGetFilePath( file );
+
+	bool status;
+	for ( unsigned int i = 0; i < numBlocks; ++i )
+	{
+		uint8_t blockFlags = PlReadInt8( file, &status );
+		if ( !status )
+		{
+			Warning( "Failed to read in block %u header in \"%s\"!\nPL: %s\n", i, path, PlGetError() );
+			return false;
+		}
+
+		uint8_t colour[ 4 ] = { 0, 0, 0, 255 };
+		if ( blockFlags & PGFX_CHANNEL_RED ) { colour[ 0 ] = PlReadInt8( file, &status ); }
+		if ( blockFlags & PGFX_CHANNEL_GREEN ) { colour[ 1 ] = PlReadInt8( file, &status ); }
+		if ( blockFlags & PGFX_CHANNEL_BLUE ) { colour[ 2 ] = PlReadInt8( file, &status ); }
+		if ( blockFlags & PGFX_CHANNEL_ALPHA ) { colour[ 3 ] = PlReadInt8( file, &status ); }
+
+		uint16_t numBlockPixels = PlReadInt16( file, false, &status );
+
+		size_t offsetSize   = GetPixelOffsetSize( pixelSize );
+		void  *pixelOffsets = PlCAlloc( numBlockPixels, offsetSize, true );
+		if ( PlReadFile( file, pixelOffsets, offsetSize, numBlockPixels ) != numBlockPixels )
+		{
+			Warning( "Failed to read pixel offsets in block %u, in \"%s\"!\nPL: %s\n", i, path, PlGetError() );
+			PlFree( pixelOffsets );
+			return false;
+		}
+
+		for ( unsigned int j = 0; j < numBlockPixels; ++j )
+		{
+			size_t po;
+			switch ( offsetSize )
+			{
+				case sizeof( uint8_t ):
+					po = ( ( uint8_t * ) ( pixelOffsets ) )[ j ];
+					break;
+				case sizeof( uint16_t ):
+					po = ( ( uint16_t * ) ( pixelOffsets ) )[ j ];
+					break;
+				default:
+					po = ( ( uint32_t * ) ( pixelOffsets ) )[ j ];
+					break;
+			}
+
+			if ( po >= pixelSize )
+			{
+				Warning( "Invalid pixel offset %u in block %u, in \"%s\"!\n", j, i, path );
+				PlFree( pixelOffsets );
+				return false;
+			}
+
+			memcpy( &dest[ po * numChannels ], colour, numChannels );
+		}
+
+		PlFree( pixelOffsets );
+	}
+
+	return true;
+}
+
+static bool ReadClusterPlainDataReference( PLFile *file, uint8_t *dest, uint32_t pixelSize, unsigned int numChannels, uint8_t flags )
+{
+	bool     status   = true;
+	uint8_t *pixelPos = dest;
+	for ( unsigned int i = 0; i < pixelSize; ++i )
+	{
+		if ( flags & PGFX_CHANNEL_RED ) { pixelPos[ 0 ] = PlReadInt8( file, &status ); }
+		if ( flags & PGFX_CHANNEL_GREEN ) { pixelPos[ 1 ] = PlReadInt8( file, &status ); }
+		if ( flags & PGFX_CHANNEL_BLUE ) { pixelPos[ 2 ] = PlReadInt8( file, &status ); }
+		if ( flags & PGFX_CHANNEL_ALPHA ) { pixelPos[ 3 ] = PlReadInt8( file, &status ); }
+		pixelPos += numChannels;
+	}
+
+	return status;
+}
+
+static bool ReadClusterLevelReference( PLFile *file, uint8_t *dest, unsigned int width, unsigned int height, unsigned int numChannels )
+{
+	bool     status;
+	uint8_t  flags     = PlReadInt8( file, &status );
+	uint16_t numBlocks = PlReadInt16( file, false, &status );
+	if ( !status )
+	{
+		Warning( "Failed to read level header for \"%s\"!\n", PlGetFilePath( file ) );
+		return false;
+	}
+
+	uint32_t pixelSize = width * height;
+	for ( uint32_t i = 0; i < pixelSize; ++i )
+	{
+		memset( &dest[ i * numChannels ], 0, 3 );
+		if ( numChannels > 3 )
+			dest[ i * numChannels + 3 ] = 255;
+	}
+
+	if ( numBlocks == 0 )
+		return ReadClusterPlainDataReference( file, dest, pixelSize, numChannels, flags );
+
+	return ReadClusterBlocksReference( file, dest, pixelSize, numChannels, numBlocks );
+}
+
+/**
+ * Pulls in the rest of the file from the current position.
+ * Returned buffer should be freed by the caller.
+ */
+static uint8_t *ReadRemainingData( PLFile *file, ImageReader *reader )
+{
+	PLFileOffset offset = PlGetFileOffset( file );
+	size_t       size   = PlGetFileSize( file );
+	if ( offset < 0 || ( size_t ) offset > size )
+		return NULL;
+
+	size -= ( size_t ) offset;
+
+	uint8_t *buffer = PlMAllocA( size > 0 ? size : 1 );
+	if ( PlReadFile( file, buffer, sizeof( uint8_t ), size ) != size )
+	{
+		PlFree( buffer );
+		return NULL;
+	}
+
+	reader->pos  = buffer;
+	reader->end  = buffer + size;
+	reader->path = PlGetFilePath( file );
+
+	return buffer;
+}
+
+/**
+ * Allocates the buffers for every level beyond the first,
+ * which is already provided by PlCreateImage.
+ */
+static void SetupImageLevels( PLImage *image, unsigned int numLevels )
+{
+	image->data = PlReAllocA( image->data, sizeof( uint8_t * ) * numLevels );
+	for ( unsigned int i = 1; i < numLevels; ++i )
+	{
+		size_t size      = PlGetImageSize( image->format, GetLevelDimension( image->width, i ), GetLevelDimension( image->height, i ) );
+		image->data[ i ] = PlCAllocA( size, sizeof( uint8_t ) );
+	}
+	image->levels = numLevels;
+}
+
+static PLImage *ParseLegacyImage( PLFile *file )
+{
+	ImageReader reader;
+	uint8_t    *buffer = ReadRemainingData( file, &reader );
+	if ( buffer == NULL )
+	{
+		Warning( "Failed to read in data for \"%s\"!\nPL: %s\n", PlGetFilePath( file ), PlGetError() );
+		return NULL;
+	}
+
+	uint8_t  flags;
+	uint16_t width, height, numBlocks;
+	if ( !ReadUInt8( &reader, &flags ) || !ReadUInt16( &reader, &width ) || !ReadUInt16( &reader, &height ) || !ReadUInt16( &reader, &numBlocks ) )
+	{
+		Warning( "Failed to read header for \"%s\"!\n", reader.path );
+		PlFree( buffer );
+		return NULL;
+	}
+
+	bool     hasAlpha = ( flags & PGFX_CHANNEL_ALPHA );
+	PLImage *image    = PlCreateImage( NULL, width, height, 0,
+	                                   hasAlpha ? PL_COLOURFORMAT_RGBA : PL_COLOURFORMAT_RGB,
+	                                   hasAlpha ? PL_IMAGEFORMAT_RGBA8 : PL_IMAGEFORMAT_RGB8 );
+	if ( image == NULL )
+	{
+		Warning( "Failed to create image handle!\nPL: %s\n", PlGetError() );
+		PlFree( buffer );
+		return NULL;
+	}
+
+	unsigned int numChannels = hasAlpha ? 4 : 3;
+	uint32_t     pixelSize   = width * height;
+
+	bool status;
+	if ( numBlocks == 0 )
+		status = ReadClusterPlainData( &reader, image->data[ 0 ], pixelSize, numChannels, flags );
+	else
+		status = ReadClusterBlocks( &reader, image->data[ 0 ], pixelSize, numChannels, numBlocks );
+
+	PlFree( buffer );
+
+	if ( !status )
+	{
+		Warning( "Failed to read image data for \"%s\"!\n", reader.path );
+		PlDestroyImage( image );
+		return NULL;
+	}
+
+	return image;
+}
+
+static PLImage *ParsePackedImage( PLFile *file )
+{
+	const char *path = PlGetFilePath( file );
+
+	uint8_t     header[ 6 ];
+	ImageReader reader = { header, header + sizeof( header ), path };
+	if ( PlReadFile( file, header, sizeof( uint8_t ), sizeof( header ) ) != sizeof( header ) )
+	{
+		Warning( "Failed to read header for \"%s\"!\nPL: %s\n", path, PlGetError() );
+		return NULL;
+	}
+
+	uint8_t  format, numLevels;
+	uint16_t width, height;
+	ReadUInt8( &reader, &format );
+	ReadUInt8( &reader, &numLevels );
+	ReadUInt16( &reader, &width );
+	ReadUInt16( &reader, &height );
+
+	if ( numLevels == 0 || numLevels > GFX_MAX_LEVELS )
+	{
+		Warning( "Invalid number of levels for \"%s\" (%u)!\n", path, numLevels );
+		return NULL;
+	}
+
+	/* compressed levels are read straight into place, whereas cluster
+	 * levels are decoded from the rest of the file in memory */
+	bool     isReference = ( format == PGFX_FORMAT_CLUSTER && useReferenceDecoder );
+	uint8_t *buffer      = NULL;
+	if ( format == PGFX_FORMAT_CLUSTER && !isReference && ( buffer = ReadRemainingData( file, &reader ) ) == NULL )
+	{
+		Warning( "Failed to read in data for \"%s\"!\nPL: %s\n", path, PlGetError() );
+		return NULL;
+	}
+
+	PLImageFormat  imageFormat;
+	PLColourFormat colourFormat = PL_COLOURFORMAT_RGBA;
+	switch ( format )
+	{
+		case PGFX_FORMAT_CLUSTER:
+		{
+			/* peek at the channels for the first level, so we know what we're creating */
+			uint8_t flags = 0;
+			if ( isReference )
+			{
+				bool         status;
+				PLFileOffset offset = PlGetFileOffset( file );
+				flags               = PlReadInt8( file, &status );
+				PlFileSeek( file, offset, PL_SEEK_SET );
+			}
+			else if ( reader.pos < reader.end )
+				flags = *reader.pos;
+
+			if ( flags & PGFX_CHANNEL_ALPHA )
+				imageFormat = PL_IMAGEFORMAT_RGBA8;
+			else
+			{
+				imageFormat  = PL_IMAGEFORMAT_RGB8;
+				colourFormat = PL_COLOURFORMAT_RGB;
+			}
+			break;
+		}
+		case PGFX_FORMAT_DXT1:
+			imageFormat  = PL_IMAGEFORMAT_RGB_DXT1;
+			colourFormat = PL_COLOURFORMAT_RGB;
+			break;
+		case PGFX_FORMAT_DXT1_ALPHA:
+			imageFormat = PL_IMAGEFORMAT_RGBA_DXT1;
+			break;
+		case PGFX_FORMAT_DXT3:
+			imageFormat = PL_IMAGEFORMAT_RGBA_DXT3;
+			break;
+		case PGFX_FORMAT_DXT5:
+			imageFormat = PL_IMAGEFORMAT_RGBA_DXT5;
+			break;
+		default:
+			Warning( "Unknown format for \"%s\" (%u)!\n", path, format );
+			return NULL;
+	}
+
+	PLImage *image = PlCreateImage( NULL, width, height, 0, colourFormat, imageFormat );
+	if ( image == NULL )
+	{
+		Warning( "Failed to create image handle!\nPL: %s\n", PlGetError() );
+		PlFree( buffer );
+		return NULL;
+	}
+
+	SetupImageLevels( image, numLevels );
+
+	for ( unsigned int i = 0; i < numLevels; ++i )
+	{
+		unsigned int levelWidth  = GetLevelDimension( width, i );
+		unsigned int levelHeight = GetLevelDimension( height, i );
+
+		bool status;
+		if ( format == PGFX_FORMAT_CLUSTER )
+		{
+			unsigned int numChannels = ( imageFormat == PL_IMAGEFORMAT_RGBA8 ) ? 4 : 3;
+			if ( isReference )
+				status = ReadClusterLevelReference( file, image->data[ i ], levelWidth, levelHeight, numChannels );
+			else
+				status = ReadClusterLevel( &reader, image->data[ i ], levelWidth, levelHeight, numChannels );
+		}
+		else
+		{
+			/* compressed levels go straight through, the driver deals with them */
+			size_t size = PlGetImageSize( imageFormat, levelWidth, levelHeight );
+			status      = ( PlReadFile( file, image->data[ i ], sizeof( uint8_t ), size ) == size );
+		}
+
+		if ( !status )
+		{
+			Warning( "Failed to read level %u for \"%s\"!\n", i, path );
+			PlDestroyImage( image );
+			image = NULL;
+			break;
+		}
+	}
+
+	PlFree( buffer );
+
+	return image;
+}
+
+/**
+ * Switches cluster images back to the original per-byte decoder,
+ * so there's something to measure the current one against.
+ */
+void Common_Image_SetReferenceDecoder( bool enable )
+{
+	useReferenceDecoder = enable;
+}
+
+PLImage *Common_Image_LoadPackedImage( PLFile *file )
+{
+	const char *path = PlGetFilePath( file );
+
+	char identifier[ 4 ];
+	if ( PlReadFile( file, identifier, sizeof( char ), 4 ) != 4 )
+	{
+		Warning( "Failed to read in identifier for \"%s\"!\nPL: %s\n", path, PlGetError() );
+		return NULL;
+	}
+
+	bool isLegacy = false;
+	if ( strncmp( identifier, GFX_LEGACY_IDENTIFIER, 4 ) == 0 )
+		isLegacy = true;
+	else if ( strncmp( identifier, GFX_IDENTIFIER, 4 ) != 0 )
+	{
+		Warning( "Invalid identifier for \"%s\", expected %s!\n", path, GFX_IDENTIFIER );
+		return NULL;
+	}
+
+	PLImage *image = isLegacy ? ParseLegacyImage( file ) : ParsePackedImage( file );
+
+	if ( image != NULL )
+		snprintf( image->path, sizeof( image->path ), "%s", path );
+
+	return image;
+}
@@ -0,0 +1,134 @@
+// SPDX-License-Identifier: LGPL-3.0-or-later
+// Copyright © 2020-2023 OldTimes Software, Mark E Sowden <hogsy@oldtimes-software.com>
+
+#include <plcore/pl_console.h>
+
+#include "common.h"
+#include "common_light_cull.h"
+
+/**
+ * Builds the table by testing each light against a tree over the
+ * groups, rather than every light against every group.
+ */
+bool Common_LightCull_Assign( CommonLightCullTable *table, const CommonLightCullLight *lights, unsigned int numLights, const CommonBVHBounds *groups, unsigned int numGroups )
+{
+	PL_ZERO( table, sizeof( CommonLightCullTable ) );
+
+	table->numGroups = numGroups;
+	table->offsets   = PL_NEW_( uint32_t, numGroups + 1 );
+	if ( numLights == 0 || numGroups == 0 )
+		return true;
+
+	CommonBVH tree;
+	PL_ZERO_( tree );
+
+	if ( !Common_BVH_Build( &tree, groups, numGroups ) )
+	{
+		Warning( "Failed to build group tree for lights!\n" );
+		Common_LightCull_Destroy( table );
+		return false;
+	}
+
+	/* first count how many each group gets, so the table can be sized up front */
+	uint32_t *touched = PL_NEW_( uint32_t, numGroups );
+	for ( unsigned int i = 0; i < numLights; ++i )
+	{
+		unsigned int numTouched = Common_BVH_QuerySphere( &tree, &lights[ i ].origin, lights[ i ].radius, touched, numGroups );
+		for ( unsigned int j = 0; j < numTouched; ++j )
+			table->offsets[ touched[ j ] + 1 ]++;
+	}
+
+	for ( unsigned int i = 0; i < numGroups; ++i )
+		table->offsets[ i + 1 ] += table->offsets[ i ];
+
+	table->lights = PL_NEW_( uint32_t, table->offsets[ numGroups ] + 1 );
+
+	/* then fill it in, going through the lights in order keeps each list sorted */
+	uint32_t *cursors = PL_NEW_( uint32_t, numGroups );
+	memcpy( cursors, table->offsets, sizeof( uint32_t ) * numGroups );
+	for ( unsigned int i = 0; i < numLights; ++i )
+	{
+		unsigned int numTouched = Common_BVH_QuerySphere( &tree, &lights[ i ].origin, lights[ i ].radius, touched, numGroups );
+		for ( unsigned int j = 0; j < numTouched; ++j )
+			table->lights[ cursors[ touched[ j ] ]++ ] = i;
+	}
+
+	PL_DELETE( cursors );
+	PL_DELETE( touched );
+	Common_BVH_Destroy( &tree );
+
+	return true;
+}
+
+void Common_LightCull_Destroy( CommonLightCullTable *table )
+{
+	PL_DELETE( table->offsets );
+	PL_DELETE( table->lights );
+	PL_ZERO( table, sizeof( CommonLightCullTable ) );
+}
+
+const uint32_t *Common_LightCull_GetLights( const CommonLightCullTable *table, unsigned int group, unsigned int *numLights )
+{
+	if ( group >= table->numGroups || table->lights == NULL )
+	{
+		*numLights = 0;
+		return NULL;
+	}
+
+	*numLights = table->offsets[ group + 1 ] - table->offsets[ group ];
+	return &table->lights[ table->offsets[ group ] ];
+}
+
+/**
+ * Rough measure of how much a light matters from the given point of
+ * view; bright and big lights close by win out over dim, distant ones.
+ */
+float Common_LightCull_GetImportance( const CommonLightCullLight *light, const PLVector3 *viewOrigin )
+{
+	float x = light->origin.x - viewOrigin->x;
+	float y = light->origin.y - viewOrigin->y;
+	float z = light->origin.z - viewOrigin->z;
+
+	float r2 = light->radius * light->radius;
+	return light->intensity * r2 / ( r2 + x * x + y * y + z * z );
+}
+
+/**
+ * Picks out up to maxOut of the candidates that pass the given test,
+ * most important first. Ties go to the lower index, so the selection
+ * doesn't flicker between equally important lights.
+ */
+unsigned int Common_LightCull_Select( const CommonLightCullLight *lights, const uint32_t *candidates, unsigned int numCandidates, const PLVector3 *viewOrigin, CommonLightCullTestFunction test, void *user, uint32_t *out, unsigned int maxOut )
+{
+	if ( maxOut > CMN_LIGHTCULL_MAX_SELECT )
+		maxOut = CMN_LIGHTCULL_MAX_SELECT;
+	else if ( maxOut == 0 )
+		return 0;
+
+	/* maxOut is small, so just keep a sorted list */
+	float        scores[ CMN_LIGHTCULL_MAX_SELECT ];
+	unsigned int numOut = 0;
+	for ( unsigned int i = 0; i < numCandidates; ++i )
+	{
+		const CommonLightCullLight *light = &lights[ candidates[ i ] ];
+
+		float score = Common_LightCull_GetImportance( light, viewOrigin );
+		if ( numOut == maxOut && ( score < scores[ numOut - 1 ] || ( score == scores[ numOut - 1 ] && candidates[ i ] > out[ numOut - 1 ] ) ) )
+			continue;
+
+		if ( test != NULL && !test( light, user ) )
+			continue;
+
+		unsigned int j = ( numOut < maxOut ) ? numOut++ : numOut - 1;
+		for ( ; j > 0 && ( scores[ j - 1 ] < score || ( scores[ j - 1 ] == score && out[ j - 1 ] > candidates[ i ] ) ); --j )
+		{
+			scores[ j ] = scores[ j - 1 ];
+			out[ j ]    = out[ j - 1 ];
+		}
+
+		scores[ j ] = score;
+		out[ j ]    = candidates[ i ];
+	}
+
+	return numOut;
+}
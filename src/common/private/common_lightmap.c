@@ -0,0 +1,686 @@
+// SPDX-License-Identifier: LGPL-3.0-or-later
+// Copyright © 2020-2023 OldTimes Software, Mark E Sowden <hogsy@oldtimes-software.com>
+
+#include <SDL2/SDL.h>
+
+#include <plcore/pl_console.h>
+
+#include <yin/node.h>
+
+#include "common.h"
+#include "common_lightmap.h"
+
+/* matches the layout of YNCoreWorldVertex; position, normal, uv, colour */
+#define LIGHTMAP_VERTEX_ELEMENTS 12
+
+/* WORLD_FACE_FLAG_PORTAL and WORLD_FACE_FLAG_SKIP, neither get drawn */
+#define LIGHTMAP_SKIP_FACE_FLAGS ( 1U | 4U )
+
+static float DotProduct( const PLVector3 *a, const PLVector3 *b )
+{
+	return a->x * b->x + a->y * b->y + a->z * b->z;
+}
+
+static PLVector3 CrossProduct( const PLVector3 *a, const PLVector3 *b )
+{
+	return PLVector3( a->y * b->z - a->z * b->y,
+	                  a->z * b->x - a->x * b->z,
+	                  a->x * b->y - a->y * b->x );
+}
+
+static PLVector3 Normalize( const PLVector3 *v )
+{
+	float length = sqrtf( DotProduct( v, v ) );
+	if ( length < 1e-6f )
+		return pl_vecOrigin3;
+
+	return PLVector3( v->x / length, v->y / length, v->z / length );
+}
+
+void Common_Lightmap_Setup( CommonLightmapBaker *baker, float luxelSize, unsigned int atlasSize )
+{
+	PL_ZERO( baker, sizeof( CommonLightmapBaker ) );
+
+	baker->luxelSize = ( luxelSize > 0.0f ) ? luxelSize : CMN_LIGHTMAP_DEFAULT_LUXEL_SIZE;
+	baker->atlasSize = ( atlasSize > CMN_LIGHTMAP_PADDING * 4 ) ? atlasSize : CMN_LIGHTMAP_DEFAULT_ATLAS_SIZE;
+}
+
+void Common_Lightmap_Destroy( CommonLightmapBaker *baker )
+{
+	for ( unsigned int i = 0; i < baker->numAtlases; ++i )
+		PL_DELETE( baker->atlases[ i ].luxels );
+
+	PL_DELETE( baker->atlases );
+	PL_DELETE( baker->charts );
+	PL_DELETE( baker->triangles );
+	PL_DELETE( baker->lights );
+
+	Common_BVH_Destroy( &baker->tree );
+
+	PL_ZERO( baker, sizeof( CommonLightmapBaker ) );
+}
+
+/****************************************
+ * CHARTING
+ ****************************************/
+
+/**
+ * Gives the surface a chart, planar mapped along its own plane. The
+ * surface is also added to the set of triangles shadows are cast by.
+ */
+bool Common_Lightmap_AddSurface( CommonLightmapBaker *baker, const PLVector3 *points, unsigned int numPoints, uint32_t mesh, uint32_t face )
+{
+	if ( numPoints < 3 )
+		return false;
+	if ( numPoints > CMN_LIGHTMAP_MAX_POINTS )
+		numPoints = CMN_LIGHTMAP_MAX_POINTS;
+
+	/* newell's method, so it's fine if the first few points happen to line up */
+	PLVector3 normal = pl_vecOrigin3;
+	for ( unsigned int i = 0; i < numPoints; ++i )
+	{
+		const PLVector3 *a = &points[ i ];
+		const PLVector3 *b = &points[ ( i + 1 ) % numPoints ];
+		normal.x += ( a->y - b->y ) * ( a->z + b->z );
+		normal.y += ( a->z - b->z ) * ( a->x + b->x );
+		normal.z += ( a->x - b->x ) * ( a->y + b->y );
+	}
+
+	normal = Normalize( &normal );
+	if ( DotProduct( &normal, &normal ) == 0.0f )
+		return false;
+
+	PLVector3 up    = ( fabsf( normal.z ) < 0.9f ) ? PLVector3( 0.0f, 0.0f, 1.0f ) : PLVector3( 1.0f, 0.0f, 0.0f );
+	PLVector3 sAxis = CrossProduct( &up, &normal );
+	sAxis           = Normalize( &sAxis );
+	PLVector3 tAxis = CrossProduct( &normal, &sAxis );
+
+	float mins[ 2 ] = { INFINITY, INFINITY };
+	float maxs[ 2 ] = { -INFINITY, -INFINITY };
+	for ( unsigned int i = 0; i < numPoints; ++i )
+	{
+		float s = DotProduct( &sAxis, &points[ i ] );
+		float t = DotProduct( &tAxis, &points[ i ] );
+		mins[ 0 ] = ( s < mins[ 0 ] ) ? s : mins[ 0 ];
+		maxs[ 0 ] = ( s > maxs[ 0 ] ) ? s : maxs[ 0 ];
+		mins[ 1 ] = ( t < mins[ 1 ] ) ? t : mins[ 1 ];
+		maxs[ 1 ] = ( t > maxs[ 1 ] ) ? t : maxs[ 1 ];
+	}
+
+	/* anything too big for an atlas just gets coarser luxels */
+	float        luxelSize = baker->luxelSize;
+	float        extent    = ( maxs[ 0 ] - mins[ 0 ] > maxs[ 1 ] - mins[ 1 ] ) ? maxs[ 0 ] - mins[ 0 ] : maxs[ 1 ] - mins[ 1 ];
+	unsigned int maxLuxels = baker->atlasSize - CMN_LIGHTMAP_PADDING * 2;
+	if ( extent / luxelSize + 1.0f > ( float ) maxLuxels )
+		luxelSize = extent / ( float ) ( maxLuxels - 1 );
+
+	if ( baker->numCharts == baker->maxCharts )
+	{
+		baker->maxCharts = ( baker->maxCharts > 0 ) ? baker->maxCharts * 2 : 256;
+		baker->charts    = PlReAlloc( baker->charts, sizeof( CommonLightmapChart ) * baker->maxCharts, true );
+	}
+
+	CommonLightmapChart *chart = &baker->charts[ baker->numCharts++ ];
+	PL_ZERO( chart, sizeof( CommonLightmapChart ) );
+	chart->mesh   = mesh;
+	chart->face   = face;
+	chart->width  = ( unsigned int ) ceilf( ( maxs[ 0 ] - mins[ 0 ] ) / luxelSize ) + 1;
+	chart->height = ( unsigned int ) ceilf( ( maxs[ 1 ] - mins[ 1 ] ) / luxelSize ) + 1;
+	/* rounding can still push the coarser luxels one over */
+	chart->width  = ( ( chart->width < maxLuxels ) ? chart->width : maxLuxels ) + CMN_LIGHTMAP_PADDING * 2;
+	chart->height = ( ( chart->height < maxLuxels ) ? chart->height : maxLuxels ) + CMN_LIGHTMAP_PADDING * 2;
+	chart->normal = normal;
+	chart->sAxis  = PlScaleVector3F( sAxis, luxelSize );
+	chart->tAxis  = PlScaleVector3F( tAxis, luxelSize );
+
+	float distance = DotProduct( &normal, &points[ 0 ] );
+	chart->origin  = PlScaleVector3F( normal, distance );
+	chart->origin  = PlAddVector3( chart->origin, PlScaleVector3F( sAxis, mins[ 0 ] - luxelSize * CMN_LIGHTMAP_PADDING ) );
+	chart->origin  = PlAddVector3( chart->origin, PlScaleVector3F( tAxis, mins[ 1 ] - luxelSize * CMN_LIGHTMAP_PADDING ) );
+
+	unsigned int numTriangles = numPoints - 2;
+	if ( baker->numTriangles + numTriangles > baker->maxTriangles )
+	{
+		baker->maxTriangles = ( baker->maxTriangles > 0 ) ? baker->maxTriangles * 2 : 1024;
+		if ( baker->maxTriangles < baker->numTriangles + numTriangles )
+			baker->maxTriangles = baker->numTriangles + numTriangles;
+
+		baker->triangles = PlReAlloc( baker->triangles, sizeof( CommonLightmapTriangle ) * baker->maxTriangles, true );
+	}
+
+	for ( unsigned int i = 1; i + 1 < numPoints; ++i )
+	{
+		CommonLightmapTriangle *triangle = &baker->triangles[ baker->numTriangles++ ];
+		triangle->origin                 = points[ 0 ];
+		triangle->edges[ 0 ]             = PlSubtractVector3( points[ i ], points[ 0 ] );
+		triangle->edges[ 1 ]             = PlSubtractVector3( points[ i + 1 ], points[ 0 ] );
+	}
+
+	return true;
+}
+
+void Common_Lightmap_AddLight( CommonLightmapBaker *baker, const CommonLightmapLight *light )
+{
+	if ( baker->numLights == baker->maxLights )
+	{
+		baker->maxLights = ( baker->maxLights > 0 ) ? baker->maxLights * 2 : 16;
+		baker->lights    = PlReAlloc( baker->lights, sizeof( CommonLightmapLight ) * baker->maxLights, true );
+	}
+
+	baker->lights[ baker->numLights++ ] = *light;
+}
+
+static int CompareChartHeight( const void *a, const void *b )
+{
+	const CommonLightmapChart *chartA = a;
+	const CommonLightmapChart *chartB = b;
+	if ( chartA->height != chartB->height )
+		return ( chartA->height < chartB->height ) ? 1 : -1;
+
+	return ( chartA->width < chartB->width ) - ( chartA->width > chartB->width );
+}
+
+/**
+ * Packs the charts onto shelves, tallest first, starting a new
+ * atlas whenever the current one's full. Fails if any chart
+ * can't fit in an atlas at all.
+ */
+static bool PackCharts( CommonLightmapBaker *baker )
+{
+	qsort( baker->charts, baker->numCharts, sizeof( CommonLightmapChart ), CompareChartHeight );
+
+	CommonLightmapAtlas *atlas = NULL;
+	for ( unsigned int i = 0; i < baker->numCharts; ++i )
+	{
+		CommonLightmapChart *chart = &baker->charts[ i ];
+		if ( chart->width > baker->atlasSize || chart->height > baker->atlasSize )
+		{
+			Warning( "Chart for face %u in mesh %u is %ux%u, too big for a %u atlas!\n",
+			         chart->face, chart->mesh, chart->width, chart->height, baker->atlasSize );
+			return false;
+		}
+
+		if ( atlas != NULL && atlas->shelfX + chart->width > atlas->size )
+		{
+			atlas->shelfY += atlas->shelfHeight;
+			atlas->shelfX      = 0;
+			atlas->shelfHeight = 0;
+		}
+
+		if ( atlas == NULL || atlas->shelfY + chart->height > atlas->size )
+		{
+			baker->atlases = PlReAlloc( baker->atlases, sizeof( CommonLightmapAtlas ) * ( baker->numAtlases + 1 ), true );
+			atlas          = &baker->atlases[ baker->numAtlases++ ];
+			PL_ZERO( atlas, sizeof( CommonLightmapAtlas ) );
+			atlas->size = baker->atlasSize;
+		}
+
+		chart->atlas = baker->numAtlases - 1;
+		chart->x     = atlas->shelfX;
+		chart->y     = atlas->shelfY;
+
+		atlas->shelfX += chart->width;
+		if ( chart->height > atlas->shelfHeight )
+			atlas->shelfHeight = chart->height;
+	}
+
+	for ( unsigned int i = 0; i < baker->numAtlases; ++i )
+		baker->atlases[ i ].luxels = PL_NEW_( float, baker->atlases[ i ].size * baker->atlases[ i ].size * 3 );
+
+	return true;
+}
+
+bool Common_Lightmap_Prepare( CommonLightmapBaker *baker )
+{
+	if ( baker->numCharts == 0 )
+	{
+		Warning( "No surfaces to lightmap!\n" );
+		return false;
+	}
+
+	if ( !PackCharts( baker ) )
+		return false;
+
+	CommonBVHBounds *bounds = PL_NEW_( CommonBVHBounds, baker->numTriangles );
+	for ( unsigned int i = 0; i < baker->numTriangles; ++i )
+	{
+		const CommonLightmapTriangle *triangle = &baker->triangles[ i ];
+
+		const PLVector3 points[ 3 ] = {
+		        triangle->origin,
+		        PlAddVector3( triangle->origin, triangle->edges[ 0 ] ),
+		        PlAddVector3( triangle->origin, triangle->edges[ 1 ] ),
+		};
+
+		bounds[ i ].mins = bounds[ i ].maxs = points[ 0 ];
+		for ( unsigned int j = 1; j < 3; ++j )
+		{
+			bounds[ i ].mins.x = ( points[ j ].x < bounds[ i ].mins.x ) ? points[ j ].x : bounds[ i ].mins.x;
+			bounds[ i ].mins.y = ( points[ j ].y < bounds[ i ].mins.y ) ? points[ j ].y : bounds[ i ].mins.y;
+			bounds[ i ].mins.z = ( points[ j ].z < bounds[ i ].mins.z ) ? points[ j ].z : bounds[ i ].mins.z;
+			bounds[ i ].maxs.x = ( points[ j ].x > bounds[ i ].maxs.x ) ? points[ j ].x : bounds[ i ].maxs.x;
+			bounds[ i ].maxs.y = ( points[ j ].y > bounds[ i ].maxs.y ) ? points[ j ].y : bounds[ i ].maxs.y;
+			bounds[ i ].maxs.z = ( points[ j ].z > bounds[ i ].maxs.z ) ? points[ j ].z : bounds[ i ].maxs.z;
+		}
+	}
+
+	bool status = Common_BVH_Build( &baker->tree, bounds, baker->numTriangles );
+	PL_DELETE( bounds );
+
+	return status;
+}
+
+/****************************************
+ * TRACING
+ ****************************************/
+
+/**
+ * Möller–Trumbore, returning the distance along the ray or
+ * a negative value if it misses.
+ */
+static float IntersectTriangle( const CommonLightmapTriangle *triangle, const PLVector3 *origin, const PLVector3 *direction )
+{
+	PLVector3 p   = CrossProduct( direction, &triangle->edges[ 1 ] );
+	float     det = DotProduct( &triangle->edges[ 0 ], &p );
+	if ( fabsf( det ) < 1e-8f )
+		return -1.0f;
+
+	float     invDet = 1.0f / det;
+	PLVector3 s      = PlSubtractVector3( *origin, triangle->origin );
+	float     u      = DotProduct( &s, &p ) * invDet;
+	if ( u < 0.0f || u > 1.0f )
+		return -1.0f;
+
+	PLVector3 q = CrossProduct( &s, &triangle->edges[ 0 ] );
+	float     v = DotProduct( direction, &q ) * invDet;
+	if ( v < 0.0f || u + v > 1.0f )
+		return -1.0f;
+
+	return DotProduct( &triangle->edges[ 1 ], &q ) * invDet;
+}
+
+/**
+ * Returns true if anything is hit along the ray before the given
+ * distance; it doesn't matter what, so it stops at the first hit.
+ */
+bool Common_Lightmap_IsOccluded( const CommonLightmapBaker *baker, const PLVector3 *origin, const PLVector3 *direction, float distance )
+{
+	const CommonBVH *tree = &baker->tree;
+	if ( tree->numNodes == 0 )
+		return false;
+
+	uint32_t     stack[ CMN_BVH_MAX_DEPTH ];
+	unsigned int stackSize = 0;
+	uint32_t     nodeIndex = 0;
+	for ( ;; )
+	{
+		const CommonBVHNode *node = &tree->nodes[ nodeIndex ];
+		if ( Common_BVH_TestRay( &node->bounds, origin, direction, distance ) )
+		{
+			if ( node->numItems == 0 )
+			{
+				stack[ stackSize++ ] = node->offset;
+				nodeIndex++;
+				continue;
+			}
+
+			for ( unsigned int i = node->offset; i < node->offset + node->numItems; ++i )
+			{
+				float t = IntersectTriangle( &baker->triangles[ tree->items[ i ] ], origin, direction );
+				if ( t > 1e-4f && t < distance )
+					return true;
+			}
+		}
+
+		if ( stackSize == 0 )
+			break;
+
+		nodeIndex = stack[ --stackSize ];
+	}
+
+	return false;
+}
+
+/**
+ * Gathers direct light for each of the chart's luxels, returning
+ * how many shadow rays it took.
+ */
+uint64_t Common_Lightmap_BakeChart( CommonLightmapBaker *baker, unsigned int chartIndex )
+{
+	const CommonLightmapChart *chart = &baker->charts[ chartIndex ];
+	CommonLightmapAtlas       *atlas = &baker->atlases[ chart->atlas ];
+
+	/* nudged off the surface, so it doesn't shadow itself */
+	PLVector3 origin = PlAddVector3( chart->origin, PlScaleVector3F( chart->normal, CMN_LIGHTMAP_EPSILON ) );
+
+	uint64_t numRays = 0;
+	for ( unsigned int y = 0; y < chart->height; ++y )
+	{
+		for ( unsigned int x = 0; x < chart->width; ++x )
+		{
+			PLVector3 position = origin;
+			position           = PlAddVector3( position, PlScaleVector3F( chart->sAxis, ( float ) x + 0.5f ) );
+			position           = PlAddVector3( position, PlScaleVector3F( chart->tAxis, ( float ) y + 0.5f ) );
+
+			PLVector3 colour = baker->ambience;
+			for ( unsigned int i = 0; i < baker->numLights; ++i )
+			{
+				const CommonLightmapLight *light = &baker->lights[ i ];
+
+				PLVector3 direction = PlSubtractVector3( light->position, position );
+				float     distance  = sqrtf( DotProduct( &direction, &direction ) );
+				if ( distance >= light->radius || distance < 1e-4f )
+					continue;
+
+				direction = PlScaleVector3F( direction, 1.0f / distance );
+
+				float nDotL = DotProduct( &chart->normal, &direction );
+				if ( nDotL <= 0.0f )
+					continue;
+
+				numRays++;
+				if ( Common_Lightmap_IsOccluded( baker, &position, &direction, distance ) )
+					continue;
+
+				float scale = nDotL * ( 1.0f - distance / light->radius );
+				colour      = PlAddVector3( colour, PlScaleVector3F( light->colour, scale ) );
+			}
+
+			float *luxel = &atlas->luxels[ ( ( chart->y + y ) * atlas->size + chart->x + x ) * 3 ];
+			luxel[ 0 ]   = colour.x;
+			luxel[ 1 ]   = colour.y;
+			luxel[ 2 ]   = colour.z;
+		}
+	}
+
+	return numRays;
+}
+
+typedef struct LightmapBakeWorker
+{
+	CommonLightmapBaker *baker;
+	SDL_atomic_t        *nextChart;
+	uint64_t             numRays;
+} LightmapBakeWorker;
+
+static int LightmapBakeThread( void *userData )
+{
+	LightmapBakeWorker *worker = userData;
+	for ( ;; )
+	{
+		unsigned int chart = ( unsigned int ) SDL_AtomicAdd( worker->nextChart, 1 );
+		if ( chart >= worker->baker->numCharts )
+			break;
+
+		worker->numRays += Common_Lightmap_BakeChart( worker->baker, chart );
+	}
+
+	return 0;
+}
+
+/**
+ * Bakes every chart, with each thread grabbing the next one until
+ * there's none left. The calling thread pitches in too, and picks
+ * up the slack if any failed to start. Returns the total rays.
+ */
+uint64_t Common_LightmapBaker_BakeThreaded( CommonLightmapBaker *baker, unsigned int numThreads )
+{
+	if ( numThreads < 1 )
+		numThreads = 1;
+	else if ( numThreads > CMN_LIGHTMAP_MAX_THREADS )
+		numThreads = CMN_LIGHTMAP_MAX_THREADS;
+
+	SDL_atomic_t nextChart;
+	SDL_AtomicSet( &nextChart, 0 );
+
+	LightmapBakeWorker workers[ CMN_LIGHTMAP_MAX_THREADS ];
+	SDL_Thread        *threads[ CMN_LIGHTMAP_MAX_THREADS ];
+	for ( unsigned int i = 0; i < numThreads; ++i )
+	{
+		workers[ i ].baker     = baker;
+		workers[ i ].nextChart = &nextChart;
+		workers[ i ].numRays   = 0;
+		threads[ i ]           = ( i > 0 ) ? SDL_CreateThread( LightmapBakeThread, "Lightmapper", &workers[ i ] ) : NULL;
+	}
+
+	LightmapBakeThread( &workers[ 0 ] );
+
+	uint64_t numRays = 0;
+	for ( unsigned int i = 0; i < numThreads; ++i )
+	{
+		if ( threads[ i ] != NULL )
+			SDL_WaitThread( threads[ i ], NULL );
+
+		numRays += workers[ i ].numRays;
+	}
+
+	return numRays;
+}
+
+/****************************************
+ * WORLD
+ ****************************************/
+
+static void LoadWorldLights( CommonLightmapBaker *baker, YNNodeBranch *lightList )
+{
+	if ( lightList == NULL )
+		return;
+
+	for ( YNNodeBranch *c = YnNode_GetFirstChild( lightList ); c != NULL; c = YnNode_GetNextChild( c ) )
+	{
+		PLColourF32 colour = { 1.0f, 1.0f, 1.0f, 1.0f };
+		YnNode_DS_DeserializeColourF32( YnNode_GetChildByName( c, "colour" ), &colour );
+
+		CommonLightmapLight light;
+		light.position = pl_vecOrigin3;
+		YnNode_DS_DeserializeVector3( YnNode_GetChildByName( c, "position" ), &light.position );
+		light.colour = PLVector3( colour.r * colour.a, colour.g * colour.a, colour.b * colour.a );
+		light.radius = YnNode_GetF32ByName( c, "radius", 256.0f );
+
+		Common_Lightmap_AddLight( baker, &light );
+	}
+}
+
+static void LoadWorldMesh( CommonLightmapBaker *baker, const char *path, uint32_t meshIndex )
+{
+	YNNodeBranch *root = YnNode_LoadFile( path, "worldMesh" );
+	if ( root == NULL )
+	{
+		Warning( "Failed to load world mesh: %s\n", path );
+		return;
+	}
+
+	YNNodeBranch *vertexList = YnNode_GetChildByName( root, "vertices" );
+	YNNodeBranch *faceList   = YnNode_GetChildByName( root, "faces" );
+	if ( vertexList == NULL || faceList == NULL )
+	{
+		Warning( "No vertices or faces for world mesh: %s\n", path );
+		YnNode_DestroyBranch( root );
+		return;
+	}
+
+	unsigned int numElements = YnNode_GetNumOfChildren( vertexList );
+	unsigned int numVertices = numElements / LIGHTMAP_VERTEX_ELEMENTS;
+	float       *vertices    = PL_NEW_( float, numElements + 1 );
+	if ( YnNode_GetF32Array( vertexList, vertices, numElements ) != YN_NODE_ERROR_SUCCESS )
+	{
+		Warning( "Failed to fetch vertices for world mesh: %s\n", path );
+		PL_DELETE( vertices );
+		YnNode_DestroyBranch( root );
+		return;
+	}
+
+	uint32_t faceIndex = 0;
+	for ( YNNodeBranch *c = YnNode_GetFirstChild( faceList ); c != NULL; c = YnNode_GetNextChild( c ), ++faceIndex )
+	{
+		if ( ( uint32_t ) YnNode_GetI32ByName( c, "flags", 0 ) & LIGHTMAP_SKIP_FACE_FLAGS )
+			continue;
+
+		YNNodeBranch *indexList = YnNode_GetChildByName( c, "vertices" );
+		if ( indexList == NULL )
+			continue;
+
+		unsigned int numIndices = YnNode_GetNumOfChildren( indexList );
+		if ( numIndices > CMN_LIGHTMAP_MAX_POINTS )
+			numIndices = CMN_LIGHTMAP_MAX_POINTS;
+
+		uint32_t indices[ CMN_LIGHTMAP_MAX_POINTS ];
+		if ( YnNode_GetUI32Array( indexList, indices, numIndices ) != YN_NODE_ERROR_SUCCESS )
+			continue;
+
+		PLVector3    points[ CMN_LIGHTMAP_MAX_POINTS ];
+		unsigned int numPoints = 0;
+		for ( unsigned int i = 0; i < numIndices; ++i )
+		{
+			if ( indices[ i ] >= numVertices )
+				break;
+
+			const float *v        = &vertices[ indices[ i ] * LIGHTMAP_VERTEX_ELEMENTS ];
+			points[ numPoints++ ] = PLVector3( v[ 0 ], v[ 1 ], v[ 2 ] );
+		}
+
+		if ( numPoints == numIndices )
+			Common_Lightmap_AddSurface( baker, points, numPoints, meshIndex, faceIndex );
+	}
+
+	PL_DELETE( vertices );
+	YnNode_DestroyBranch( root );
+}
+
+/**
+ * Adds the sector bodies and lights from the given world file, along
+ * with its ambience. The meshes are read straight from their files, so
+ * none of the engine needs to be up for this.
+ */
+bool Common_Lightmap_LoadWorld( CommonLightmapBaker *baker, const char *path )
+{
+	YNNodeBranch *root = YnNode_LoadFile( path, "world" );
+	if ( root == NULL )
+	{
+		Warning( "Failed to load world: %s\n", path );
+		return false;
+	}
+
+	PLColourF32   ambience   = { 0.0f, 0.0f, 0.0f, 1.0f };
+	YNNodeBranch *properties = YnNode_GetChildByName( root, "properties" );
+	if ( properties != NULL )
+		YnNode_DS_DeserializeColourF32( YnNode_GetChildByName( properties, "ambience" ), &ambience );
+	baker->ambience = PLVector3( ambience.r, ambience.g, ambience.b );
+
+	LoadWorldLights( baker, YnNode_GetChildByName( root, "lights" ) );
+
+	/* only meshes used as sector bodies, since static objects get moved around */
+	YNNodeBranch *meshList   = YnNode_GetChildByName( root, "meshes" );
+	YNNodeBranch *sectorList = YnNode_GetChildByName( root, "sectors" );
+	if ( meshList == NULL || sectorList == NULL )
+	{
+		Warning( "No meshes or sectors in world: %s\n", path );
+		YnNode_DestroyBranch( root );
+		return false;
+	}
+
+	unsigned int numMeshes = YnNode_GetNumOfChildren( meshList );
+	bool        *isBody    = PL_NEW_( bool, numMeshes + 1 );
+	for ( YNNodeBranch *c = YnNode_GetFirstChild( sectorList ); c != NULL; c = YnNode_GetNextChild( c ) )
+	{
+		int meshIndex = YnNode_GetI32ByName( c, "mesh", -1 );
+		if ( meshIndex >= 0 && ( unsigned int ) meshIndex < numMeshes )
+			isBody[ meshIndex ] = true;
+	}
+
+	YNNodeBranch *c = YnNode_GetFirstChild( meshList );
+	for ( unsigned int i = 0; i < numMeshes && c != NULL; ++i, c = YnNode_GetNextChild( c ) )
+	{
+		if ( !isBody[ i ] )
+			continue;
+
+		PLPath meshPath;
+		if ( YnNode_GetStr( c, meshPath, sizeof( meshPath ) ) == YN_NODE_ERROR_SUCCESS )
+			LoadWorldMesh( baker, meshPath, i );
+	}
+
+	PL_DELETE( isBody );
+	YnNode_DestroyBranch( root );
+
+	return true;
+}
+
+static uint8_t PackLuxelChannel( float v )
+{
+	if ( v <= 0.0f )
+		return 0;
+	if ( v >= 1.0f )
+		return 255;
+
+	return ( uint8_t ) ( v * 255.0f + 0.5f );
+}
+
+/**
+ * Writes out the atlases, as packed rgba, and where each
+ * face's chart lives so it can be mapped at runtime.
+ */
+YNNodeBranch *Common_Lightmap_Serialise( const CommonLightmapBaker *baker )
+{
+	YNNodeBranch *root = YnNode_PushBackObject( NULL, "lightmaps" );
+	YnNode_PushBackI32( root, "version", 1 );
+	YnNode_PushBackF32( root, "luxelSize", baker->luxelSize );
+
+	YNNodeBranch *atlasList = YnNode_PushBackObjectArray( root, "atlases" );
+	for ( unsigned int i = 0; i < baker->numAtlases; ++i )
+	{
+		const CommonLightmapAtlas *atlas     = &baker->atlases[ i ];
+		unsigned int               numLuxels = atlas->size * atlas->size;
+
+		int32_t *pixels = PL_NEW_( int32_t, numLuxels );
+		for ( unsigned int j = 0; j < numLuxels; ++j )
+		{
+			const float *luxel = &atlas->luxels[ j * 3 ];
+			pixels[ j ]        = ( int32_t ) ( ( uint32_t ) PackLuxelChannel( luxel[ 0 ] ) |
+                                        ( ( uint32_t ) PackLuxelChannel( luxel[ 1 ] ) << 8 ) |
+                                        ( ( uint32_t ) PackLuxelChannel( luxel[ 2 ] ) << 16 ) |
+                                        ( 255U << 24 ) );
+		}
+
+		YNNodeBranch *atlasNode = YnNode_PushBackObject( atlasList, NULL );
+		YnNode_PushBackI32( atlasNode, "size", ( int32_t ) atlas->size );
+		YnNode_PushBackI32Array( atlasNode, "pixels", pixels, numLuxels );
+
+		PL_DELETE( pixels );
+	}
+
+	YNNodeBranch *chartList = YnNode_PushBackObjectArray( root, "charts" );
+	for ( unsigned int i = 0; i < baker->numCharts; ++i )
+	{
+		const CommonLightmapChart *chart = &baker->charts[ i ];
+
+		YNNodeBranch *chartNode = YnNode_PushBackObject( chartList, NULL );
+		YnNode_PushBackI32( chartNode, "mesh", ( int32_t ) chart->mesh );
+		YnNode_PushBackI32( chartNode, "face", ( int32_t ) chart->face );
+		YnNode_PushBackI32( chartNode, "atlas", ( int32_t ) chart->atlas );
+
+		const int32_t rect[ 4 ] = { ( int32_t ) chart->x, ( int32_t ) chart->y, ( int32_t ) chart->width, ( int32_t ) chart->height };
+		YnNode_PushBackI32Array( chartNode, "rect", rect, 4 );
+
+		NL_DS_SerializeVector3( chartNode, "origin", &chart->origin );
+		NL_DS_SerializeVector3( chartNode, "sAxis", &chart->sAxis );
+		NL_DS_SerializeVector3( chartNode, "tAxis", &chart->tAxis );
+	}
+
+	return root;
+}
+
+/**
+ * Lightmaps live alongside the world they're for, i.e.
+ * worlds/foo/foo.wld.n gets worlds/foo/foo.wlm.n
+ */
+bool Common_Lightmap_GetOutputPath( const char *worldPath, char *dest, size_t length )
+{
+	const char *fileName = strrchr( worldPath, '/' );
+	fileName             = ( fileName != NULL ) ? fileName + 1 : worldPath;
+
+	const char *extension = strchr( fileName, '.' );
+	size_t      baseLength = ( extension != NULL ) ? ( size_t ) ( extension - worldPath ) : strlen( worldPath );
+
+	int n = snprintf( dest, length, "%.*s." CMN_LIGHTMAP_EXTENSION, ( int ) baseLength, worldPath );
+	return ( n > 0 && ( size_t ) n < length );
+}
@@ -0,0 +1,493 @@
+// SPDX-License-Identifier: LGPL-3.0-or-later
+// Copyright © 2020-2023 OldTimes Software, Mark E Sowden <hogsy@oldtimes-software.com>
+
+#include <float.h>
+
+#include "common.h"
+#include "common_occlusion.h"
+
+#if defined( __SSE2__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 )
+#	define OCCLUSION_USE_SSE2
+#	include <emmintrin.h>
+#endif
+
+/* a triangle gets clipped against the near plane and the four sides
+ * of the screen, each of which can add at most one more vertex */
+#define OCCLUSION_MAX_CLIP_VERTICES ( 3 + 5 )
+
+/* a box is only hidden if whatever's in front of it is nearer by at
+ * least this much, so faces aren't hidden by their own depth */
+#define OCCLUSION_DEPTH_BIAS 1.001f
+
+typedef struct OcclusionVertex
+{
+	float x, y, z, w;
+} OcclusionVertex;
+
+static inline float MinF( float a, float b ) { return ( a < b ) ? a : b; }
+static inline float MaxF( float a, float b ) { return ( a > b ) ? a : b; }
+
+bool Common_OcclusionBuffer_Create( CommonOcclusionBuffer *buffer, unsigned int width, unsigned int height )
+{
+	PL_ZERO( buffer, sizeof( CommonOcclusionBuffer ) );
+
+	/* keep each row a multiple of four long, so they all start aligned */
+	width = ( width + 3 ) & ~3u;
+	if ( width == 0 || height == 0 )
+	{
+		Warning( "Invalid occlusion buffer size (%ux%u)!\n", width, height );
+		return false;
+	}
+
+	buffer->depth = PL_NEW_( float, ( size_t ) width * height );
+	if ( buffer->depth == NULL )
+	{
+		Warning( "Failed to allocate %ux%u occlusion buffer!\n", width, height );
+		return false;
+	}
+
+	buffer->width  = width;
+	buffer->height = height;
+	return true;
+}
+
+void Common_OcclusionBuffer_Destroy( CommonOcclusionBuffer *buffer )
+{
+	PL_DELETE( buffer->depth );
+	PL_DELETE( buffer->triangles );
+	PL_ZERO( buffer, sizeof( CommonOcclusionBuffer ) );
+}
+
+/**
+ * Throws away the triangles from last time, and takes the matrix any
+ * new ones, and any tested boxes, are going to be transformed by.
+ */
+void Common_OcclusionBuffer_Begin( CommonOcclusionBuffer *buffer, const float *viewProjection )
+{
+	memcpy( buffer->viewProjection, viewProjection, sizeof( buffer->viewProjection ) );
+	buffer->numTriangles = 0;
+}
+
+/****************************************
+ * SETUP
+ ****************************************/
+
+static inline void TransformVertex( const float *m, const PLVector3 *v, OcclusionVertex *out )
+{
+	out->x = m[ 0 ] * v->x + m[ 1 ] * v->y + m[ 2 ] * v->z + m[ 3 ];
+	out->y = m[ 4 ] * v->x + m[ 5 ] * v->y + m[ 6 ] * v->z + m[ 7 ];
+	out->z = m[ 8 ] * v->x + m[ 9 ] * v->y + m[ 10 ] * v->z + m[ 11 ];
+	out->w = m[ 12 ] * v->x + m[ 13 ] * v->y + m[ 14 ] * v->z + m[ 15 ];
+}
+
+/* how far inside each clip plane a vertex is, see ClipPolygon */
+static inline float GetPlaneDistance( const OcclusionVertex *v, unsigned int plane )
+{
+	switch ( plane )
+	{
+		case 0: return v->w - CMN_OCCLUSION_MIN_W;
+		case 1: return v->w - v->x;
+		case 2: return v->w + v->x;
+		case 3: return v->w - v->y;
+		default: return v->w + v->y;
+	}
+}
+
+/**
+ * Sutherland-Hodgman against each plane in turn, in clip space. Only
+ * the near plane actually needs it, but clipping to the sides as well
+ * keeps everything that reaches setup within the bounds of the screen,
+ * rather than out where floats start running out of precision.
+ */
+static unsigned int ClipPolygon( OcclusionVertex *vertices, unsigned int numVertices )
+{
+	OcclusionVertex scratch[ OCCLUSION_MAX_CLIP_VERTICES ];
+	for ( unsigned int plane = 0; plane < 5; ++plane )
+	{
+		unsigned int numOut = 0;
+		for ( unsigned int i = 0; i < numVertices; ++i )
+		{
+			const OcclusionVertex *a  = &vertices[ i ];
+			const OcclusionVertex *b  = &vertices[ ( i + 1 ) % numVertices ];
+			float                  da = GetPlaneDistance( a, plane );
+			float                  db = GetPlaneDistance( b, plane );
+			if ( da >= 0.0f )
+				scratch[ numOut++ ] = *a;
+
+			if ( ( da >= 0.0f ) != ( db >= 0.0f ) )
+			{
+				OcclusionVertex *out = &scratch[ numOut++ ];
+				float            t   = da / ( da - db );
+				out->x               = a->x + ( b->x - a->x ) * t;
+				out->y               = a->y + ( b->y - a->y ) * t;
+				out->z               = a->z + ( b->z - a->z ) * t;
+				out->w               = a->w + ( b->w - a->w ) * t;
+			}
+		}
+
+		numVertices = numOut;
+		if ( numVertices < 3 )
+			return 0;
+
+		memcpy( vertices, scratch, sizeof( OcclusionVertex ) * numVertices );
+	}
+
+	return numVertices;
+}
+
+static CommonOcclusionTriangle *AllocTriangle( CommonOcclusionBuffer *buffer )
+{
+	if ( buffer->numTriangles == buffer->maxTriangles )
+	{
+		buffer->maxTriangles = ( buffer->maxTriangles > 0 ) ? buffer->maxTriangles * 2 : 256;
+		buffer->triangles    = PlReAlloc( buffer->triangles, sizeof( CommonOcclusionTriangle ) * buffer->maxTriangles, true );
+	}
+
+	return &buffer->triangles[ buffer->numTriangles++ ];
+}
+
+/**
+ * Takes a triangle that's already on screen, in pixels, with 1/w in z,
+ * and works out the edge and depth planes. Occluders are drawn from
+ * either side, so the winding doesn't matter.
+ */
+static bool SetupTriangle( CommonOcclusionBuffer *buffer, const OcclusionVertex *v0, const OcclusionVertex *v1, const OcclusionVertex *v2 )
+{
+	float area = ( v1->x - v0->x ) * ( v2->y - v0->y ) - ( v2->x - v0->x ) * ( v1->y - v0->y );
+	if ( area < 0.0f )
+	{
+		const OcclusionVertex *swap = v1;
+		v1                          = v2;
+		v2                          = swap;
+		area                        = -area;
+	}
+
+	if ( area < 1e-6f )
+		return false;
+
+	/* only the pixels whose centres it could cover */
+	float x0 = MaxF( ceilf( MinF( v0->x, MinF( v1->x, v2->x ) ) - 0.5f ), 0.0f );
+	float x1 = MinF( floorf( MaxF( v0->x, MaxF( v1->x, v2->x ) ) - 0.5f ), ( float ) ( buffer->width - 1 ) );
+	float y0 = MaxF( ceilf( MinF( v0->y, MinF( v1->y, v2->y ) ) - 0.5f ), 0.0f );
+	float y1 = MinF( floorf( MaxF( v0->y, MaxF( v1->y, v2->y ) ) - 0.5f ), ( float ) ( buffer->height - 1 ) );
+	if ( x0 > x1 || y0 > y1 )
+		return false;
+
+	CommonOcclusionTriangle *triangle = AllocTriangle( buffer );
+	triangle->minX                    = ( int ) x0;
+	triangle->maxX                    = ( int ) x1;
+	triangle->minY                    = ( int ) y0;
+	triangle->maxY                    = ( int ) y1;
+
+	/* each edge is positive on the side of the vertex opposite it */
+	const OcclusionVertex *v[ 3 ] = { v0, v1, v2 };
+	for ( unsigned int i = 0; i < 3; ++i )
+	{
+		const OcclusionVertex *a = v[ ( i + 1 ) % 3 ];
+		const OcclusionVertex *b = v[ ( i + 2 ) % 3 ];
+		triangle->edges[ i ][ 0 ] = a->y - b->y;
+		triangle->edges[ i ][ 1 ] = b->x - a->x;
+		triangle->edges[ i ][ 2 ] = a->x * b->y - a->y * b->x;
+	}
+
+	/* and the edges divided by the area are the barycentrics, which gives the depth */
+	float invArea = 1.0f / area;
+	for ( unsigned int i = 0; i < 3; ++i )
+	{
+		triangle->depth[ i ] = ( triangle->edges[ 0 ][ i ] * v0->z +
+		                         triangle->edges[ 1 ][ i ] * v1->z +
+		                         triangle->edges[ 2 ][ i ] * v2->z ) *
+		                       invArea;
+	}
+
+	return true;
+}
+
+/**
+ * Transforms and clips a triangle in world space, and sets up whatever
+ * is left of it to be drawn. Returns how many triangles it became.
+ */
+unsigned int Common_OcclusionBuffer_AddTriangle( CommonOcclusionBuffer *buffer, const PLVector3 *a, const PLVector3 *b, const PLVector3 *c )
+{
+	OcclusionVertex vertices[ OCCLUSION_MAX_CLIP_VERTICES ];
+	TransformVertex( buffer->viewProjection, a, &vertices[ 0 ] );
+	TransformVertex( buffer->viewProjection, b, &vertices[ 1 ] );
+	TransformVertex( buffer->viewProjection, c, &vertices[ 2 ] );
+
+	/* don't bother clipping anything that's entirely off to one side */
+	for ( unsigned int plane = 0; plane < 5; ++plane )
+	{
+		if ( GetPlaneDistance( &vertices[ 0 ], plane ) < 0.0f &&
+		     GetPlaneDistance( &vertices[ 1 ], plane ) < 0.0f &&
+		     GetPlaneDistance( &vertices[ 2 ], plane ) < 0.0f )
+			return 0;
+	}
+
+	unsigned int numVertices = ClipPolygon( vertices, 3 );
+	for ( unsigned int i = 0; i < numVertices; ++i )
+	{
+		float invW      = 1.0f / vertices[ i ].w;
+		vertices[ i ].x = ( vertices[ i ].x * invW * 0.5f + 0.5f ) * ( float ) buffer->width;
+		vertices[ i ].y = ( 0.5f - vertices[ i ].y * invW * 0.5f ) * ( float ) buffer->height;
+		vertices[ i ].z = invW;
+	}
+
+	unsigned int numAdded = 0;
+	for ( unsigned int i = 2; i < numVertices; ++i )
+		numAdded += SetupTriangle( buffer, &vertices[ 0 ], &vertices[ i - 1 ], &vertices[ i ] );
+
+	return numAdded;
+}
+
+/****************************************
+ * DRAWING
+ ****************************************/
+
+static void ClearRows( CommonOcclusionBuffer *buffer, unsigned int firstRow, unsigned int *numRows )
+{
+	if ( firstRow >= buffer->height )
+	{
+		*numRows = 0;
+		return;
+	}
+
+	if ( *numRows > buffer->height - firstRow )
+		*numRows = buffer->height - firstRow;
+
+	memset( buffer->depth + ( size_t ) firstRow * buffer->width, 0, sizeof( float ) * buffer->width * *numRows );
+}
+
+/**
+ * Narrows the pixels to step through on a row down to those that all
+ * three edges allow, give or take a pixel either side for rounding.
+ * The edges are still tested for each pixel, so this only saves time.
+ */
+static bool GetRowSpan( const CommonOcclusionTriangle *triangle, const float *rows, int *start, int *end )
+{
+	float minX = ( float ) triangle->minX, maxX = ( float ) triangle->maxX;
+	for ( unsigned int i = 0; i < 3; ++i )
+	{
+		float a = triangle->edges[ i ][ 0 ];
+		if ( a == 0.0f )
+		{
+			if ( rows[ i ] < 0.0f )
+				return false;
+
+			continue;
+		}
+
+		/* where the edge crosses the row, as a pixel rather than a pixel centre */
+		float x = -rows[ i ] / a - 0.5f;
+		if ( a > 0.0f )
+			minX = MaxF( minX, x - 1.0f );
+		else
+			maxX = MinF( maxX, x + 2.0f );
+	}
+
+	/* both are clamped to the bounds by now, so truncating is the same as flooring */
+	if ( minX > maxX )
+		return false;
+
+	*start = ( int ) minX;
+	*end   = ( int ) maxX;
+	return true;
+}
+
+void Common_OcclusionBuffer_DrawRowsScalar( CommonOcclusionBuffer *buffer, unsigned int firstRow, unsigned int numRows )
+{
+	ClearRows( buffer, firstRow, &numRows );
+	if ( numRows == 0 )
+		return;
+
+	int bandMinY = ( int ) firstRow;
+	int bandMaxY = ( int ) ( firstRow + numRows - 1 );
+	for ( unsigned int i = 0; i < buffer->numTriangles; ++i )
+	{
+		const CommonOcclusionTriangle *triangle = &buffer->triangles[ i ];
+
+		int minY = ( triangle->minY > bandMinY ) ? triangle->minY : bandMinY;
+		int maxY = ( triangle->maxY < bandMaxY ) ? triangle->maxY : bandMaxY;
+		for ( int y = minY; y <= maxY; ++y )
+		{
+			float py        = ( float ) y + 0.5f;
+			float rows[ 3 ] = {
+			        triangle->edges[ 0 ][ 1 ] * py + triangle->edges[ 0 ][ 2 ],
+			        triangle->edges[ 1 ][ 1 ] * py + triangle->edges[ 1 ][ 2 ],
+			        triangle->edges[ 2 ][ 1 ] * py + triangle->edges[ 2 ][ 2 ],
+			};
+
+			int start, end;
+			if ( !GetRowSpan( triangle, rows, &start, &end ) )
+				continue;
+
+			float  rowZ = triangle->depth[ 1 ] * py + triangle->depth[ 2 ];
+			float *line = buffer->depth + ( size_t ) y * buffer->width;
+			for ( int x = start; x <= end; ++x )
+			{
+				float px = ( float ) x + 0.5f;
+				if ( triangle->edges[ 0 ][ 0 ] * px + rows[ 0 ] < 0.0f ||
+				     triangle->edges[ 1 ][ 0 ] * px + rows[ 1 ] < 0.0f ||
+				     triangle->edges[ 2 ][ 0 ] * px + rows[ 2 ] < 0.0f )
+					continue;
+
+				float z = triangle->depth[ 0 ] * px + rowZ;
+				if ( z > line[ x ] )
+					line[ x ] = z;
+			}
+		}
+	}
+}
+
+#if defined( OCCLUSION_USE_SSE2 )
+
+/**
+ * Steps along each row four pixels at a time. Works out each pixel
+ * with exactly the same sums as the scalar version, so the two of
+ * them fill in exactly the same depths.
+ */
+void Common_OcclusionBuffer_DrawRows( CommonOcclusionBuffer *buffer, unsigned int firstRow, unsigned int numRows )
+{
+	ClearRows( buffer, firstRow, &numRows );
+	if ( numRows == 0 )
+		return;
+
+	const __m128 laneOffsets = _mm_setr_ps( 0.5f, 1.5f, 2.5f, 3.5f );
+	const __m128 zero        = _mm_setzero_ps();
+
+	int bandMinY = ( int ) firstRow;
+	int bandMaxY = ( int ) ( firstRow + numRows - 1 );
+	for ( unsigned int i = 0; i < buffer->numTriangles; ++i )
+	{
+		const CommonOcclusionTriangle *triangle = &buffer->triangles[ i ];
+
+		int minY = ( triangle->minY > bandMinY ) ? triangle->minY : bandMinY;
+		int maxY = ( triangle->maxY < bandMaxY ) ? triangle->maxY : bandMaxY;
+		if ( minY > maxY )
+			continue;
+
+		__m128 a0 = _mm_set1_ps( triangle->edges[ 0 ][ 0 ] );
+		__m128 a1 = _mm_set1_ps( triangle->edges[ 1 ][ 0 ] );
+		__m128 a2 = _mm_set1_ps( triangle->edges[ 2 ][ 0 ] );
+		__m128 aZ = _mm_set1_ps( triangle->depth[ 0 ] );
+
+		/* lanes either side of the bounds are masked off, same as the scalar loop never reaching them */
+		__m128 minX = _mm_set1_ps( ( float ) triangle->minX + 0.5f );
+		__m128 maxX = _mm_set1_ps( ( float ) triangle->maxX + 0.5f );
+
+		for ( int y = minY; y <= maxY; ++y )
+		{
+			float py        = ( float ) y + 0.5f;
+			float rows[ 3 ] = {
+			        triangle->edges[ 0 ][ 1 ] * py + triangle->edges[ 0 ][ 2 ],
+			        triangle->edges[ 1 ][ 1 ] * py + triangle->edges[ 1 ][ 2 ],
+			        triangle->edges[ 2 ][ 1 ] * py + triangle->edges[ 2 ][ 2 ],
+			};
+
+			int start, end;
+			if ( !GetRowSpan( triangle, rows, &start, &end ) )
+				continue;
+
+			__m128 row0 = _mm_set1_ps( rows[ 0 ] );
+			__m128 row1 = _mm_set1_ps( rows[ 1 ] );
+			__m128 row2 = _mm_set1_ps( rows[ 2 ] );
+			__m128 rowZ = _mm_set1_ps( triangle->depth[ 1 ] * py + triangle->depth[ 2 ] );
+			float *line = buffer->depth + ( size_t ) y * buffer->width;
+			for ( int x = start & ~3; x <= end; x += 4 )
+			{
+				__m128 px = _mm_add_ps( _mm_set1_ps( ( float ) x ), laneOffsets );
+
+				__m128 inside = _mm_and_ps( _mm_cmpge_ps( px, minX ), _mm_cmple_ps( px, maxX ) );
+				inside        = _mm_and_ps( inside, _mm_cmpge_ps( _mm_add_ps( _mm_mul_ps( a0, px ), row0 ), zero ) );
+				inside        = _mm_and_ps( inside, _mm_cmpge_ps( _mm_add_ps( _mm_mul_ps( a1, px ), row1 ), zero ) );
+				inside        = _mm_and_ps( inside, _mm_cmpge_ps( _mm_add_ps( _mm_mul_ps( a2, px ), row2 ), zero ) );
+				if ( _mm_movemask_ps( inside ) == 0 )
+					continue;
+
+				__m128 z   = _mm_add_ps( _mm_mul_ps( aZ, px ), rowZ );
+				__m128 old = _mm_loadu_ps( line + x );
+				__m128 nearer = _mm_and_ps( inside, _mm_cmpgt_ps( z, old ) );
+				_mm_storeu_ps( line + x, _mm_or_ps( _mm_and_ps( nearer, z ), _mm_andnot_ps( nearer, old ) ) );
+			}
+		}
+	}
+}
+
+#else
+
+void Common_OcclusionBuffer_DrawRows( CommonOcclusionBuffer *buffer, unsigned int firstRow, unsigned int numRows )
+{
+	Common_OcclusionBuffer_DrawRowsScalar( buffer, firstRow, numRows );
+}
+
+#endif
+
+/****************************************
+ * TESTING
+ ****************************************/
+
+/**
+ * Returns false only if every pixel the box covers on screen already
+ * has something nearer than the nearest corner of the box. Anything
+ * poking through the near plane is always visible, and anything off
+ * the screen entirely is left to frustum culling to deal with.
+ */
+bool Common_OcclusionBuffer_TestBounds( const CommonOcclusionBuffer *buffer, const CommonBVHBounds *bounds )
+{
+	const float *m = buffer->viewProjection;
+
+	float minX = FLT_MAX, minY = FLT_MAX;
+	float maxX = -FLT_MAX, maxY = -FLT_MAX;
+	float nearest = 0.0f;
+	for ( unsigned int i = 0; i < 8; ++i )
+	{
+		PLVector3 corner = PLVector3( ( i & 1 ) ? bounds->maxs.x : bounds->mins.x,
+		                              ( i & 2 ) ? bounds->maxs.y : bounds->mins.y,
+		                              ( i & 4 ) ? bounds->maxs.z : bounds->mins.z );
+
+		OcclusionVertex v;
+		TransformVertex( m, &corner, &v );
+		if ( v.w < CMN_OCCLUSION_MIN_W )
+			return true;
+
+		float invW = 1.0f / v.w;
+		float x    = ( v.x * invW * 0.5f + 0.5f ) * ( float ) buffer->width;
+		float y    = ( 0.5f - v.y * invW * 0.5f ) * ( float ) buffer->height;
+		minX       = MinF( minX, x );
+		maxX       = MaxF( maxX, x );
+		minY       = MinF( minY, y );
+		maxY       = MaxF( maxY, y );
+		nearest    = MaxF( nearest, invW );
+	}
+
+	if ( maxX < 0.0f || maxY < 0.0f || minX >= ( float ) buffer->width || minY >= ( float ) buffer->height )
+		return true;
+
+	/* every pixel the box touches, not just those whose centres it covers */
+	int x0 = ( int ) MaxF( floorf( minX ), 0.0f );
+	int x1 = ( int ) MinF( floorf( maxX ), ( float ) ( buffer->width - 1 ) );
+	int y0 = ( int ) MaxF( floorf( minY ), 0.0f );
+	int y1 = ( int ) MinF( floorf( maxY ), ( float ) ( buffer->height - 1 ) );
+
+	float threshold = nearest * OCCLUSION_DEPTH_BIAS;
+	for ( int y = y0; y <= y1; ++y )
+	{
+		const float *line = buffer->depth + ( size_t ) y * buffer->width;
+
+		int x = x0;
+#if defined( OCCLUSION_USE_SSE2 )
+		__m128 limit = _mm_set1_ps( threshold );
+		for ( ; x + 3 <= x1; x += 4 )
+		{
+			if ( _mm_movemask_ps( _mm_cmple_ps( _mm_loadu_ps( line + x ), limit ) ) != 0 )
+				return true;
+		}
+#endif
+		for ( ; x <= x1; ++x )
+		{
+			if ( line[ x ] <= threshold )
+				return true;
+		}
+	}
+
+	return false;
+}
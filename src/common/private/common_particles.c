@@ -0,0 +1,436 @@
+// SPDX-License-Identifier: LGPL-3.0-or-later
+// Copyright © 2020-2023 OldTimes Software, Mark E Sowden <hogsy@oldtimes-software.com>
+
+#include "common.h"
+#include "common_particles.h"
+
+#if defined( __SSE2__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 )
+#define PARTICLES_USE_SSE2
+#include <emmintrin.h>
+#endif
+
+#define PARTICLE_NUM_FLOAT_ARRAYS 16
+
+/* 24 bits is all a float can hold exactly, so that's all that's used */
+#define PARTICLE_RANDOM_SCALE ( 1.0f / 16777216.0f )
+
+static inline uint32_t StepRandom( uint32_t *state )
+{
+	uint32_t x = *state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	*state = x;
+	return x;
+}
+
+static inline float RandomFloat( uint32_t *state )
+{
+	return ( float ) ( StepRandom( state ) >> 8 ) * PARTICLE_RANDOM_SCALE;
+}
+
+void Common_ParticlePool_Seed( CommonParticlePool *pool, uint32_t seed )
+{
+	/* spread the seed out so neighbouring seeds don't give neighbouring lanes */
+	for ( unsigned int i = 0; i < CMN_PARTICLE_RANDOM_LANES; ++i )
+	{
+		uint32_t x = seed + ( i + 1 ) * 0x9E3779B9u;
+		x          = ( x ^ ( x >> 16 ) ) * 0x85EBCA6Bu;
+		x          = ( x ^ ( x >> 13 ) ) * 0xC2B2AE35u;
+		x ^= x >> 16;
+		pool->random[ i ] = ( x != 0 ) ? x : 0x6D2B79F5u; /* xorshift never leaves zero */
+	}
+}
+
+static void AssignArrays( CommonParticlePool *pool, void *memory, unsigned int maxParticles )
+{
+	float  *f                                   = memory;
+	float **arrays[ PARTICLE_NUM_FLOAT_ARRAYS ] = {
+	        &pool->x, &pool->y, &pool->z,
+	        &pool->velocityX, &pool->velocityY, &pool->velocityZ,
+	        &pool->r, &pool->g, &pool->b, &pool->a,
+	        &pool->deltaR, &pool->deltaG, &pool->deltaB, &pool->deltaA,
+	        &pool->scale, &pool->deltaScale,
+	};
+	for ( unsigned int i = 0; i < PARTICLE_NUM_FLOAT_ARRAYS; ++i )
+		*arrays[ i ] = f + ( i * maxParticles );
+
+	pool->life   = ( int32_t * ) ( f + ( PARTICLE_NUM_FLOAT_ARRAYS * maxParticles ) );
+	pool->memory = memory;
+}
+
+/**
+ * Makes sure there's room for at least the given number of particles.
+ * Only ever grows, and keeps whatever is currently alive.
+ */
+bool Common_ParticlePool_Reserve( CommonParticlePool *pool, unsigned int maxParticles )
+{
+	if ( maxParticles <= pool->maxParticles )
+		return true;
+
+	/* keep each array a multiple of four long, so they all start aligned */
+	maxParticles = ( maxParticles + 3 ) & ~3u;
+
+	void *memory = PL_NEW_( float, ( PARTICLE_NUM_FLOAT_ARRAYS + 1 ) * ( size_t ) maxParticles );
+	if ( memory == NULL )
+	{
+		Warning( "Failed to allocate room for %u particles!\n", maxParticles );
+		return false;
+	}
+
+	CommonParticlePool old = *pool;
+	AssignArrays( pool, memory, maxParticles );
+	pool->maxParticles = maxParticles;
+
+	if ( old.memory != NULL )
+	{
+		size_t size = sizeof( float ) * old.numParticles;
+		memcpy( pool->x, old.x, size );
+		memcpy( pool->y, old.y, size );
+		memcpy( pool->z, old.z, size );
+		memcpy( pool->velocityX, old.velocityX, size );
+		memcpy( pool->velocityY, old.velocityY, size );
+		memcpy( pool->velocityZ, old.velocityZ, size );
+		memcpy( pool->r, old.r, size );
+		memcpy( pool->g, old.g, size );
+		memcpy( pool->b, old.b, size );
+		memcpy( pool->a, old.a, size );
+		memcpy( pool->deltaR, old.deltaR, size );
+		memcpy( pool->deltaG, old.deltaG, size );
+		memcpy( pool->deltaB, old.deltaB, size );
+		memcpy( pool->deltaA, old.deltaA, size );
+		memcpy( pool->scale, old.scale, size );
+		memcpy( pool->deltaScale, old.deltaScale, size );
+		memcpy( pool->life, old.life, sizeof( int32_t ) * old.numParticles );
+
+		PL_DELETE( old.memory );
+	}
+
+	return true;
+}
+
+void Common_ParticlePool_Destroy( CommonParticlePool *pool )
+{
+	PL_DELETE( pool->memory );
+	PL_ZERO( pool, sizeof( CommonParticlePool ) );
+}
+
+/**
+ * Returns a number between 0 and 1, for whatever the caller needs
+ * when setting up new particles.
+ */
+float Common_ParticlePool_Random( CommonParticlePool *pool )
+{
+	return RandomFloat( &pool->random[ 0 ] );
+}
+
+/**
+ * Adds a particle with everything zeroed, returning where it is, or
+ * CMN_PARTICLE_POOL_FULL if there's no room left for it.
+ */
+unsigned int Common_ParticlePool_Spawn( CommonParticlePool *pool )
+{
+	if ( pool->numParticles >= pool->maxParticles )
+		return CMN_PARTICLE_POOL_FULL;
+
+	unsigned int i = pool->numParticles++;
+
+	pool->x[ i ] = pool->y[ i ] = pool->z[ i ] = 0.0f;
+	pool->velocityX[ i ] = pool->velocityY[ i ] = pool->velocityZ[ i ] = 0.0f;
+	pool->r[ i ] = pool->g[ i ] = pool->b[ i ] = pool->a[ i ] = 0.0f;
+	pool->deltaR[ i ] = pool->deltaG[ i ] = pool->deltaB[ i ] = pool->deltaA[ i ] = 0.0f;
+	pool->scale[ i ] = pool->deltaScale[ i ] = 0.0f;
+	pool->life[ i ] = 0;
+
+	return i;
+}
+
+/**
+ * Drops any particle that has run out of life by moving the last one
+ * into its place.
+ */
+static void RemoveDeadParticles( CommonParticlePool *pool )
+{
+	unsigned int i = 0;
+	while ( i < pool->numParticles )
+	{
+		if ( pool->life[ i ] > 0 )
+		{
+			++i;
+			continue;
+		}
+
+		unsigned int last = --pool->numParticles;
+		if ( i == last )
+			break;
+
+		pool->x[ i ]          = pool->x[ last ];
+		pool->y[ i ]          = pool->y[ last ];
+		pool->z[ i ]          = pool->z[ last ];
+		pool->velocityX[ i ]  = pool->velocityX[ last ];
+		pool->velocityY[ i ]  = pool->velocityY[ last ];
+		pool->velocityZ[ i ]  = pool->velocityZ[ last ];
+		pool->r[ i ]          = pool->r[ last ];
+		pool->g[ i ]          = pool->g[ last ];
+		pool->b[ i ]          = pool->b[ last ];
+		pool->a[ i ]          = pool->a[ last ];
+		pool->deltaR[ i ]     = pool->deltaR[ last ];
+		pool->deltaG[ i ]     = pool->deltaG[ last ];
+		pool->deltaB[ i ]     = pool->deltaB[ last ];
+		pool->deltaA[ i ]     = pool->deltaA[ last ];
+		pool->scale[ i ]      = pool->scale[ last ];
+		pool->deltaScale[ i ] = pool->deltaScale[ last ];
+		pool->life[ i ]       = pool->life[ last ];
+	}
+}
+
+/**
+ * Moves a single particle along; this is both the tail end of the
+ * vectorised tick and the whole of the scalar one, so the two can't
+ * drift apart.
+ */
+static inline void TickParticle( CommonParticlePool *pool, unsigned int i, const CommonParticleForce *force, CommonBVHBounds *bounds )
+{
+	uint32_t *random = &pool->random[ i & ( CMN_PARTICLE_RANDOM_LANES - 1 ) ];
+
+	float jx = force->forceVar.x * RandomFloat( random );
+	float jy = force->forceVar.y * RandomFloat( random );
+	float jz = force->forceVar.z * RandomFloat( random );
+
+	pool->x[ i ] = ( pool->x[ i ] + pool->velocityX[ i ] ) + ( force->force.x + jx );
+	pool->y[ i ] = ( pool->y[ i ] + pool->velocityY[ i ] ) + ( force->force.y + jy );
+	pool->z[ i ] = ( pool->z[ i ] + pool->velocityZ[ i ] ) + ( force->force.z + jz );
+
+	pool->r[ i ] += pool->deltaR[ i ];
+	pool->g[ i ] += pool->deltaG[ i ];
+	pool->b[ i ] += pool->deltaB[ i ];
+	pool->a[ i ] += pool->deltaA[ i ];
+
+	pool->scale[ i ] += pool->deltaScale[ i ];
+
+	pool->life[ i ]--;
+
+	if ( bounds->mins.x > pool->x[ i ] ) bounds->mins.x = pool->x[ i ];
+	if ( bounds->mins.y > pool->y[ i ] ) bounds->mins.y = pool->y[ i ];
+	if ( bounds->mins.z > pool->z[ i ] ) bounds->mins.z = pool->z[ i ];
+	if ( bounds->maxs.x < pool->x[ i ] ) bounds->maxs.x = pool->x[ i ];
+	if ( bounds->maxs.y < pool->y[ i ] ) bounds->maxs.y = pool->y[ i ];
+	if ( bounds->maxs.z < pool->z[ i ] ) bounds->maxs.z = pool->z[ i ];
+}
+
+static void BeginBounds( const CommonParticlePool *pool, CommonBVHBounds *bounds )
+{
+	/* seeded from a particle that's about to move, but that's only ever
+	 * a frame behind and saves needing a sentinel */
+	bounds->mins = bounds->maxs = PLVector3( pool->x[ 0 ], pool->y[ 0 ], pool->z[ 0 ] );
+}
+
+/**
+ * Plain C version of the tick, which is what the vectorised one is
+ * tested against. Returns how many particles are left alive; the
+ * bounds are only updated if there are any.
+ */
+unsigned int Common_ParticlePool_TickScalar( CommonParticlePool *pool, const CommonParticleForce *force, CommonBVHBounds *bounds )
+{
+	RemoveDeadParticles( pool );
+	if ( pool->numParticles == 0 )
+		return 0;
+
+	CommonBVHBounds tickBounds;
+	BeginBounds( pool, &tickBounds );
+
+	for ( unsigned int i = 0; i < pool->numParticles; ++i )
+		TickParticle( pool, i, force, &tickBounds );
+
+	*bounds = tickBounds;
+	return pool->numParticles;
+}
+
+#if defined( PARTICLES_USE_SSE2 )
+
+static inline __m128i StepRandom4( __m128i x )
+{
+	x = _mm_xor_si128( x, _mm_slli_epi32( x, 13 ) );
+	x = _mm_xor_si128( x, _mm_srli_epi32( x, 17 ) );
+	x = _mm_xor_si128( x, _mm_slli_epi32( x, 5 ) );
+	return x;
+}
+
+static inline __m128 RandomFloat4( __m128i x )
+{
+	return _mm_mul_ps( _mm_cvtepi32_ps( _mm_srli_epi32( x, 8 ) ), _mm_set1_ps( PARTICLE_RANDOM_SCALE ) );
+}
+
+#	define PARTICLE_ADD4( A, B )                                                                    \
+		_mm_storeu_ps( pool->A + i, _mm_add_ps( _mm_loadu_ps( pool->A + i ), _mm_loadu_ps( pool->B + i ) ) )
+
+/**
+ * Steps four particles at a time, one per lane of the generator. Does
+ * exactly the same sums in the same order as the scalar version, so
+ * the results match it bit for bit.
+ */
+unsigned int Common_ParticlePool_Tick( CommonParticlePool *pool, const CommonParticleForce *force, CommonBVHBounds *bounds )
+{
+	RemoveDeadParticles( pool );
+	if ( pool->numParticles == 0 )
+		return 0;
+
+	CommonBVHBounds tickBounds;
+	BeginBounds( pool, &tickBounds );
+
+	__m128 forceX = _mm_set1_ps( force->force.x );
+	__m128 forceY = _mm_set1_ps( force->force.y );
+	__m128 forceZ = _mm_set1_ps( force->force.z );
+	__m128 varX   = _mm_set1_ps( force->forceVar.x );
+	__m128 varY   = _mm_set1_ps( force->forceVar.y );
+	__m128 varZ   = _mm_set1_ps( force->forceVar.z );
+
+	__m128 minX = _mm_set1_ps( tickBounds.mins.x ), maxX = minX;
+	__m128 minY = _mm_set1_ps( tickBounds.mins.y ), maxY = minY;
+	__m128 minZ = _mm_set1_ps( tickBounds.mins.z ), maxZ = minZ;
+
+	__m128i random = _mm_loadu_si128( ( const __m128i * ) pool->random );
+	__m128i one    = _mm_set1_epi32( 1 );
+
+	unsigned int numBlocks = pool->numParticles & ~3u;
+	unsigned int i;
+	for ( i = 0; i < numBlocks; i += 4 )
+	{
+		random    = StepRandom4( random );
+		__m128 jx = _mm_mul_ps( varX, RandomFloat4( random ) );
+		random    = StepRandom4( random );
+		__m128 jy = _mm_mul_ps( varY, RandomFloat4( random ) );
+		random    = StepRandom4( random );
+		__m128 jz = _mm_mul_ps( varZ, RandomFloat4( random ) );
+
+		__m128 x = _mm_add_ps( _mm_add_ps( _mm_loadu_ps( pool->x + i ), _mm_loadu_ps( pool->velocityX + i ) ), _mm_add_ps( forceX, jx ) );
+		__m128 y = _mm_add_ps( _mm_add_ps( _mm_loadu_ps( pool->y + i ), _mm_loadu_ps( pool->velocityY + i ) ), _mm_add_ps( forceY, jy ) );
+		__m128 z = _mm_add_ps( _mm_add_ps( _mm_loadu_ps( pool->z + i ), _mm_loadu_ps( pool->velocityZ + i ) ), _mm_add_ps( forceZ, jz ) );
+		_mm_storeu_ps( pool->x + i, x );
+		_mm_storeu_ps( pool->y + i, y );
+		_mm_storeu_ps( pool->z + i, z );
+
+		minX = _mm_min_ps( minX, x );
+		minY = _mm_min_ps( minY, y );
+		minZ = _mm_min_ps( minZ, z );
+		maxX = _mm_max_ps( maxX, x );
+		maxY = _mm_max_ps( maxY, y );
+		maxZ = _mm_max_ps( maxZ, z );
+
+		PARTICLE_ADD4( r, deltaR );
+		PARTICLE_ADD4( g, deltaG );
+		PARTICLE_ADD4( b, deltaB );
+		PARTICLE_ADD4( a, deltaA );
+		PARTICLE_ADD4( scale, deltaScale );
+
+		__m128i *life = ( __m128i * ) ( pool->life + i );
+		_mm_storeu_si128( life, _mm_sub_epi32( _mm_loadu_si128( life ), one ) );
+	}
+
+	_mm_storeu_si128( ( __m128i * ) pool->random, random );
+
+	float lanes[ 4 ];
+#	define PARTICLE_REDUCE( V, OUT, OP )                  \
+		_mm_storeu_ps( lanes, V );                         \
+		OUT = lanes[ 0 ];                                  \
+		for ( unsigned int j = 1; j < 4; ++j )             \
+			if ( lanes[ j ] OP OUT ) OUT = lanes[ j ];
+	PARTICLE_REDUCE( minX, tickBounds.mins.x, < )
+	PARTICLE_REDUCE( minY, tickBounds.mins.y, < )
+	PARTICLE_REDUCE( minZ, tickBounds.mins.z, < )
+	PARTICLE_REDUCE( maxX, tickBounds.maxs.x, > )
+	PARTICLE_REDUCE( maxY, tickBounds.maxs.y, > )
+	PARTICLE_REDUCE( maxZ, tickBounds.maxs.z, > )
+#	undef PARTICLE_REDUCE
+
+	for ( ; i < pool->numParticles; ++i )
+		TickParticle( pool, i, force, &tickBounds );
+
+	*bounds = tickBounds;
+	return pool->numParticles;
+}
+
+#	undef PARTICLE_ADD4
+
+#else
+
+unsigned int Common_ParticlePool_Tick( CommonParticlePool *pool, const CommonParticleForce *force, CommonBVHBounds *bounds )
+{
+	return Common_ParticlePool_TickScalar( pool, force, bounds );
+}
+
+#endif
+
+/****************************************
+ * QUADS
+ ****************************************/
+
+static inline uint8_t ColourToByte( float c )
+{
+	if ( c <= 0.0f )
+		return 0;
+	if ( c >= 1.0f )
+		return 255;
+
+	return ( uint8_t ) ( c * 255.0f );
+}
+
+static inline void WriteQuadVertex( uint8_t *vertex, const CommonParticleVertexLayout *layout, const float *position, const uint8_t *colour, float u, float v )
+{
+	memcpy( vertex + layout->positionOffset, position, sizeof( float ) * 3 );
+	memcpy( vertex + layout->colourOffset, colour, 4 );
+
+	float uv[ 2 ] = { u, v };
+	memcpy( vertex + layout->uvOffset, uv, sizeof( uv ) );
+}
+
+/**
+ * Writes a quad facing along the given axes for each of the particles
+ * in the range, four vertices apiece, in the order
+ * ( -right -up ), ( -right +up ), ( +right -up ), ( +right +up ).
+ * Ranges don't overlap in what they write, so a system can be split
+ * up between whoever's building them. Returns the vertices written.
+ */
+unsigned int Common_ParticlePool_BuildQuads( const CommonParticlePool *pool, unsigned int first, unsigned int count, const PLVector3 *right, const PLVector3 *up, const CommonParticleVertexLayout *layout )
+{
+	if ( first >= pool->numParticles )
+		return 0;
+	if ( count > pool->numParticles - first )
+		count = pool->numParticles - first;
+
+	uint8_t *vertex = layout->vertices;
+	for ( unsigned int i = first; i < first + count; ++i )
+	{
+		float s = pool->scale[ i ];
+
+		/* the two diagonals, which is all four corners are made from */
+		float ax = ( right->x + up->x ) * s, ay = ( right->y + up->y ) * s, az = ( right->z + up->z ) * s;
+		float bx = ( right->x - up->x ) * s, by = ( right->y - up->y ) * s, bz = ( right->z - up->z ) * s;
+
+		float x = pool->x[ i ], y = pool->y[ i ], z = pool->z[ i ];
+
+		uint8_t colour[ 4 ];
+		colour[ 0 ] = ColourToByte( pool->r[ i ] );
+		colour[ 1 ] = ColourToByte( pool->g[ i ] );
+		colour[ 2 ] = ColourToByte( pool->b[ i ] );
+		colour[ 3 ] = ColourToByte( pool->a[ i ] );
+
+		float corners[ CMN_PARTICLE_QUAD_VERTICES ][ 3 ] = {
+		        {x - ax, y - ay, z - az},
+		        {x - bx, y - by, z - bz},
+		        {x + bx, y + by, z + bz},
+		        {x + ax, y + ay, z + az},
+		};
+
+		WriteQuadVertex( vertex, layout, corners[ 0 ], colour, 0.0f, 0.0f );
+		vertex += layout->stride;
+		WriteQuadVertex( vertex, layout, corners[ 1 ], colour, 0.0f, 1.0f );
+		vertex += layout->stride;
+		WriteQuadVertex( vertex, layout, corners[ 2 ], colour, 1.0f, 0.0f );
+		vertex += layout->stride;
+		WriteQuadVertex( vertex, layout, corners[ 3 ], colour, 1.0f, 1.0f );
+		vertex += layout->stride;
+	}
+
+	return count * CMN_PARTICLE_QUAD_VERTICES;
+}
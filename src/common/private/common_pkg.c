@@ -1,11 +1,20 @@
 // SPDX-License-Identifier: LGPL-3.0-or-later
 // Copyright © 2020-2022 Mark E Sowden <hogsy@oldtimes-software.com>
 
+#include <SDL2/SDL_atomic.h>
+
 #include <plcore/pl_package.h>
+#include <plcore/pl_hashtable.h>
+#include <plcore/pl_compression.h>
 
 #include "common.h"
 
-#define PKG_MAGIC PL_MAGIC_TO_NUM( 'P', 'K', 'G', '2' )
+#define PKG_MAGIC        PL_MAGIC_TO_NUM( 'P', 'K', 'G', '3' )
+#define PKG_MAGIC_LEGACY PL_MAGIC_TO_NUM( 'P', 'K', 'G', '2' )
+
+/* PKG3 adds aliased entries; these have a decompressed size, a
+ * compressed size of zero, and are followed by the index of the
+ * entry whose stored data they share, rather than the data itself */
 
 typedef struct PkgHeader
 {
@@ -14,14 +23,126 @@ typedef struct PkgHeader
 } PkgHeader;
 static const size_t PKG_HEADER_SIZE = sizeof( PkgHeader );
 
+#define PKG_BLOB_ID_LENGTH ( PL_SYSTEM_MAX_PATH + 16 )
+
 /////////////////////////////////////////////////////////////////
 // READ
 
+/* blobs referenced by more than one entry, keyed by blob id; these
+ * only hold the size of the blob rather than pointing into a package's
+ * table, and are cleared along with the mounted packages. Packages get
+ * read from loader threads while others are mounted, hence the lock */
+typedef struct PkgSharedBlob
+{
+	size_t fileSize;
+} PkgSharedBlob;
+
+static PLHashTable *sharedBlobs    = NULL;
+static SDL_SpinLock sharedBlobLock = 0;
+
+/* the cache keeps hold of whatever it's given until the packages are
+ * unmounted, so only blobs shared by several entries are passed to it */
+static CommonPkgBlob *( *GetCachedBlob )( const char *id )            = NULL;
+static void ( *AddCachedBlob )( const char *id, CommonPkgBlob *blob ) = NULL;
+
+static void GetBlobId( const char *packagePath, const PLPackageIndex *index, char *dest, size_t destSize )
+{
+	snprintf( dest, destSize, "%s:%lu", packagePath, ( unsigned long ) index->offset );
+}
+
+static void MarkSharedBlob( const char *packagePath, const PLPackageIndex *index )
+{
+	char id[ PKG_BLOB_ID_LENGTH ];
+	GetBlobId( packagePath, index, id, sizeof( id ) );
+
+	SDL_AtomicLock( &sharedBlobLock );
+	if ( sharedBlobs == NULL )
+		sharedBlobs = PlCreateHashTable();
+
+	if ( PlLookupHashTableUserData( sharedBlobs, id, strlen( id ) ) == NULL )
+	{
+		PkgSharedBlob *sharedBlob = PL_NEW( PkgSharedBlob );
+		sharedBlob->fileSize      = index->fileSize;
+		PlInsertHashTableNode( sharedBlobs, id, strlen( id ), sharedBlob );
+	}
+	SDL_AtomicUnlock( &sharedBlobLock );
+}
+
+static uint8_t *LoadPkgIndex( PLFile *file, PLPackageIndex *index )
+{
+	char id[ PKG_BLOB_ID_LENGTH ];
+	GetBlobId( PlGetFilePath( file ), index, id, sizeof( id ) );
+
+	/* if the blob is shared with another entry, we might have already decoded it */
+	SDL_AtomicLock( &sharedBlobLock );
+	const PkgSharedBlob *sharedBlob = ( sharedBlobs != NULL ) ? PlLookupHashTableUserData( sharedBlobs, id, strlen( id ) ) : NULL;
+	bool                 isShared   = ( sharedBlob != NULL && sharedBlob->fileSize == index->fileSize );
+	SDL_AtomicUnlock( &sharedBlobLock );
+	if ( isShared && GetCachedBlob != NULL )
+	{
+		CommonPkgBlob *blob = GetCachedBlob( id );
+		if ( blob != NULL )
+		{
+			if ( blob->size == index->fileSize )
+			{
+				uint8_t *buf = PlMAllocA( blob->size );
+				memcpy( buf, blob->data, blob->size );
+				return buf;
+			}
+
+			/* shouldn't happen, but don't hand back somebody else's data; just read it again */
+			Warning( "Cached blob for \"%s\" is the wrong size (%lu != %lu), ignoring!\n",
+			         index->fileName, ( unsigned long ) blob->size, ( unsigned long ) index->fileSize );
+			isShared = false;
+		}
+	}
+
+	if ( !PlFileSeek( file, ( PLFileOffset ) index->offset, PL_SEEK_SET ) )
+	{
+		Warning( "Failed to seek to \"%s\" within package: %s\n", index->fileName, PlGetError() );
+		return NULL;
+	}
+
+	uint8_t *buf = PlMAllocA( index->compressedSize );
+	if ( PlReadFile( file, buf, sizeof( uint8_t ), index->compressedSize ) != index->compressedSize )
+	{
+		Warning( "Failed to read \"%s\" from package: %s\n", index->fileName, PlGetError() );
+		PL_DELETE( buf );
+		return NULL;
+	}
+
+	if ( index->compressionType == PL_COMPRESSION_DEFLATE )
+	{
+		size_t   decompressedSize;
+		uint8_t *decompressedBuf = PlDecompress_Deflate( buf, index->compressedSize, &decompressedSize );
+		PL_DELETE( buf );
+		if ( decompressedBuf == NULL || decompressedSize != index->fileSize )
+		{
+			Warning( "Failed to decompress \"%s\" from package: %s\n", index->fileName, PlGetError() );
+			PL_DELETE( decompressedBuf );
+			return NULL;
+		}
+
+		buf = decompressedBuf;
+	}
+
+	if ( isShared && AddCachedBlob != NULL )
+	{
+		CommonPkgBlob *blob = PL_NEW( CommonPkgBlob );
+		blob->size          = index->fileSize;
+		blob->data          = PlMAllocA( blob->size );
+		memcpy( blob->data, buf, blob->size );
+		AddCachedBlob( id, blob );
+	}
+
+	return buf;
+}
+
 static PLPackage *ParsePkgFile( PLFile *file )
 {
 	PkgHeader header;
 	header.magic = PlReadInt32( file, false, NULL );
-	if ( header.magic != PKG_MAGIC )
+	if ( header.magic != PKG_MAGIC && header.magic != PKG_MAGIC_LEGACY )
 	{
 		Warning( "Unexpected magic for pkg: %d\n", header.magic );
 		return NULL;
@@ -35,7 +156,7 @@ static PLPackage *ParsePkgFile( PLFile *file )
 	}
 
 	const char *path = PlGetFilePath( file );
-	PLPackage  *package = PlCreatePackageHandle( path, header.numFiles, NULL );
+	PLPackage  *package = PlCreatePackageHandle( path, header.numFiles, LoadPkgIndex );
 	for ( unsigned int i = 0; i < header.numFiles; ++i )
 	{
 		PLPackageIndex *index = &package->table[ i ];
@@ -50,6 +171,26 @@ static PLPackage *ParsePkgFile( PLFile *file )
 		index->fileSize = PlReadInt32( file, false, NULL );
 		index->compressedSize = PlReadInt32( file, false, NULL );
 
+		if ( header.magic == PKG_MAGIC && index->compressedSize == 0 && index->fileSize != 0 )
+		{
+			/* aliased entry, so point it at the data of the entry it shares */
+			uint32_t sourceIndex = PlReadInt32( file, false, NULL );
+			if ( sourceIndex >= i || package->table[ sourceIndex ].fileSize != index->fileSize )
+			{
+				Warning( "Invalid alias for \"%s\" within package!\n", index->fileName );
+				package->table_size = i;
+				break;
+			}
+
+			PLPackageIndex *source = &package->table[ sourceIndex ];
+			index->offset          = source->offset;
+			index->compressedSize  = source->compressedSize;
+			index->compressionType = source->compressionType;
+
+			MarkSharedBlob( path, source );
+			continue;
+		}
+
 		if ( index->fileSize != index->compressedSize )
 			index->compressionType = PL_COMPRESSION_DEFLATE;
 
@@ -85,6 +226,54 @@ void Common_Pkg_RegisterInterface( void )
 	PlRegisterPackageLoader( "pkg", LoadPkgFile, NULL );
 }
 
+/**
+ * Provides a cache for decoded blobs that are shared between
+ * multiple entries, so they're only decompressed once.
+ */
+void Common_Pkg_SetBlobCacheInterface( CommonPkgBlob *( *getCachedBlob )( const char *id ),
+                                       void ( *addCachedBlob )( const char *id, CommonPkgBlob *blob ) )
+{
+	GetCachedBlob = getCachedBlob;
+	AddCachedBlob = addCachedBlob;
+}
+
+/**
+ * Forgets which entries share their data. Must be called whenever
+ * packages are unmounted, as blob ids may be reused by whatever gets
+ * mounted next.
+ */
+void Common_Pkg_ClearSharedBlobs( void )
+{
+	/* take the table out from under any loaders first, then free it at our leisure */
+	SDL_AtomicLock( &sharedBlobLock );
+	PLHashTable *table = sharedBlobs;
+	sharedBlobs        = NULL;
+	SDL_AtomicUnlock( &sharedBlobLock );
+
+	if ( table == NULL )
+		return;
+
+	PLHashTableNode *node = PlGetFirstHashTableNode( table );
+	while ( node != NULL )
+	{
+		PkgSharedBlob *sharedBlob = PlGetHashTableNodeUserData( node );
+		PL_DELETE( sharedBlob );
+
+		node = PlGetNextHashTableNode( table, node );
+	}
+
+	PlDestroyHashTable( table );
+}
+
+void Common_Pkg_DestroyBlob( CommonPkgBlob *blob )
+{
+	if ( blob == NULL )
+		return;
+
+	PL_DELETE( blob->data );
+	PL_DELETE( blob );
+}
+
 /////////////////////////////////////////////////////////////////
 // WRITE
 
@@ -130,3 +319,21 @@ void Common_Pkg_AddData( FILE *pack, const char *path, const void *buf, size_t s
 
 	PL_DELETE( compressedData );
 }
+
+/**
+ * Writes out an entry that shares the data of a previously
+ * written entry, rather than storing its own copy.
+ */
+void Common_Pkg_AddAlias( FILE *pack, const char *path, size_t size, unsigned int sourceIndex )
+{
+	uint8_t nameLength = ( uint8_t ) strlen( path );
+	fwrite( &nameLength, sizeof( uint8_t ), 1, pack );
+	fwrite( path, sizeof( char ), nameLength, pack );
+	fwrite( &size, sizeof( uint32_t ), 1, pack );
+
+	uint32_t compressedSize = 0;
+	fwrite( &compressedSize, sizeof( uint32_t ), 1, pack );
+
+	uint32_t index = sourceIndex;
+	fwrite( &index, sizeof( uint32_t ), 1, pack );
+}
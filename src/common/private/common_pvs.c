@@ -0,0 +1,389 @@
+// SPDX-License-Identifier: LGPL-3.0-or-later
+// Copyright © 2020-2023 OldTimes Software, Mark E Sowden <hogsy@oldtimes-software.com>
+
+#include <plcore/pl_console.h>
+
+#include "common.h"
+#include "common_pvs.h"
+
+static float DotProduct( const PLVector3 *a, const PLVector3 *b )
+{
+	return a->x * b->x + a->y * b->y + a->z * b->z;
+}
+
+static float PlaneDistance( const CommonPVSPlane *plane, const PLVector3 *point )
+{
+	return DotProduct( &plane->normal, point ) - plane->distance;
+}
+
+/****************************************
+ * WINDINGS
+ ****************************************/
+
+void Common_PVS_SetupWinding( CommonPVSWinding *winding, const PLVector3 *points, unsigned int numPoints )
+{
+	if ( numPoints > CMN_PVS_MAX_WINDING_POINTS )
+		numPoints = CMN_PVS_MAX_WINDING_POINTS;
+
+	memcpy( winding->points, points, sizeof( PLVector3 ) * numPoints );
+	winding->numPoints = numPoints;
+}
+
+/**
+ * Generates a plane passing through the three points, returns false
+ * if they're too close to being in a line to make one.
+ */
+bool Common_PVS_MakePlane( CommonPVSPlane *plane, const PLVector3 *a, const PLVector3 *b, const PLVector3 *c )
+{
+	PLVector3 u = PLVector3( b->x - a->x, b->y - a->y, b->z - a->z );
+	PLVector3 v = PLVector3( c->x - a->x, c->y - a->y, c->z - a->z );
+	PLVector3 n = PLVector3( u.y * v.z - u.z * v.y,
+	                         u.z * v.x - u.x * v.z,
+	                         u.x * v.y - u.y * v.x );
+
+	float length = sqrtf( DotProduct( &n, &n ) );
+	if ( length < 1e-6f )
+		return false;
+
+	plane->normal   = PLVector3( n.x / length, n.y / length, n.z / length );
+	plane->distance = DotProduct( &plane->normal, a );
+	return true;
+}
+
+/**
+ * Cuts away whatever part of the winding is behind the plane. Points
+ * within CMN_PVS_EPSILON of the plane are kept, so that we err on the
+ * side of keeping things visible. Returns false if nothing is left.
+ */
+bool Common_PVS_ClipWinding( CommonPVSWinding *winding, const CommonPVSPlane *plane )
+{
+	float        distances[ CMN_PVS_MAX_WINDING_POINTS ];
+	unsigned int numFront = 0, numBack = 0;
+	for ( unsigned int i = 0; i < winding->numPoints; ++i )
+	{
+		distances[ i ] = PlaneDistance( plane, &winding->points[ i ] );
+		if ( distances[ i ] > CMN_PVS_EPSILON )
+			numFront++;
+		else if ( distances[ i ] < -CMN_PVS_EPSILON )
+			numBack++;
+	}
+
+	/* lying on the plane counts as not being seen through it */
+	if ( numFront == 0 )
+	{
+		winding->numPoints = 0;
+		return false;
+	}
+
+	if ( numBack == 0 )
+		return true;
+
+	PLVector3    points[ CMN_PVS_MAX_WINDING_POINTS * 2 ];
+	unsigned int numPoints = 0;
+	for ( unsigned int i = 0; i < winding->numPoints; ++i )
+	{
+		const PLVector3 *a = &winding->points[ i ];
+		if ( distances[ i ] >= -CMN_PVS_EPSILON )
+			points[ numPoints++ ] = *a;
+
+		unsigned int j = ( i + 1 ) % winding->numPoints;
+		if ( !( distances[ i ] > CMN_PVS_EPSILON && distances[ j ] < -CMN_PVS_EPSILON ) &&
+		     !( distances[ i ] < -CMN_PVS_EPSILON && distances[ j ] > CMN_PVS_EPSILON ) )
+			continue;
+
+		const PLVector3 *b = &winding->points[ j ];
+		float            t = distances[ i ] / ( distances[ i ] - distances[ j ] );
+		points[ numPoints++ ] = PLVector3( a->x + ( b->x - a->x ) * t,
+		                                   a->y + ( b->y - a->y ) * t,
+		                                   a->z + ( b->z - a->z ) * t );
+	}
+
+	/* if it won't fit, leaving it unclipped is still safe, just less tight */
+	if ( numPoints > CMN_PVS_MAX_WINDING_POINTS )
+		return true;
+
+	memcpy( winding->points, points, sizeof( PLVector3 ) * numPoints );
+	winding->numPoints = numPoints;
+	return true;
+}
+
+/****************************************
+ * FLOW
+ ****************************************/
+
+typedef struct FlowContext
+{
+	const CommonPVSPortal *portals;
+	const CommonPVSPlane  *planes;
+	const uint32_t        *clusterOffsets;/* where each cluster's portals start in clusterPortals */
+	const uint32_t        *clusterPortals;
+
+	uint8_t          *onPath;
+	CommonPVSWinding *stack;/* a clipped winding for each step along the path */
+
+	const CommonPVSWinding *source;
+	const CommonPVSPlane   *sourcePlane;
+
+	uint32_t *row;
+} FlowContext;
+
+static void ClassifyWinding( const CommonPVSWinding *winding, const CommonPVSPlane *plane, unsigned int *numFront, unsigned int *numBack )
+{
+	*numFront = *numBack = 0;
+	for ( unsigned int i = 0; i < winding->numPoints; ++i )
+	{
+		float distance = PlaneDistance( plane, &winding->points[ i ] );
+		if ( distance > CMN_PVS_EPSILON )
+			( *numFront )++;
+		else if ( distance < -CMN_PVS_EPSILON )
+			( *numBack )++;
+	}
+}
+
+/**
+ * Any line passing through both the source and the pass has to end up
+ * on the far side of any plane that separates the two, so the target
+ * gets clipped by each one we can find. The planes are formed between
+ * the edges of one winding and the points of the other.
+ */
+static bool ClipToSeparators( const CommonPVSWinding *source, const CommonPVSWinding *pass, CommonPVSWinding *target, bool edgesFromPass )
+{
+	const CommonPVSWinding *edges  = edgesFromPass ? pass : source;
+	const CommonPVSWinding *points = edgesFromPass ? source : pass;
+	for ( unsigned int i = 0; i < edges->numPoints; ++i )
+	{
+		const PLVector3 *a = &edges->points[ i ];
+		const PLVector3 *b = &edges->points[ ( i + 1 ) % edges->numPoints ];
+		for ( unsigned int j = 0; j < points->numPoints; ++j )
+		{
+			CommonPVSPlane plane;
+			if ( !Common_PVS_MakePlane( &plane, a, b, &points->points[ j ] ) )
+				continue;
+
+			unsigned int passFront, passBack, sourceFront, sourceBack;
+			ClassifyWinding( pass, &plane, &passFront, &passBack );
+			ClassifyWinding( source, &plane, &sourceFront, &sourceBack );
+
+			/* flip it round so the pass is in front */
+			if ( passFront == 0 && sourceBack == 0 )
+			{
+				plane.normal   = PLVector3( -plane.normal.x, -plane.normal.y, -plane.normal.z );
+				plane.distance = -plane.distance;
+
+				unsigned int tmp = passFront;
+				passFront        = passBack;
+				passBack         = tmp;
+				tmp              = sourceFront;
+				sourceFront      = sourceBack;
+				sourceBack       = tmp;
+			}
+
+			if ( passBack > 0 || sourceFront > 0 || ( passFront == 0 && sourceBack == 0 ) )
+				continue;
+
+			if ( !Common_PVS_ClipWinding( target, &plane ) )
+				return false;
+		}
+	}
+
+	return true;
+}
+
+static void SetVisible( uint32_t *row, uint32_t cluster )
+{
+	row[ cluster / 32 ] |= ( 1U << ( cluster % 32 ) );
+}
+
+static void RecursiveFlow( FlowContext *ctx, uint32_t cluster, const CommonPVSWinding *pass, const CommonPVSPlane *passPlane, unsigned int depth )
+{
+	ctx->onPath[ cluster ] = true;
+
+	for ( unsigned int i = ctx->clusterOffsets[ cluster ]; i < ctx->clusterOffsets[ cluster + 1 ]; ++i )
+	{
+		uint32_t               portalIndex = ctx->clusterPortals[ i ];
+		const CommonPVSPortal *portal      = &ctx->portals[ portalIndex ];
+		if ( ctx->onPath[ portal->to ] )
+			continue;
+
+		/* if the pass is entirely in front of this portal, we'd be
+		 * looking through it the wrong way */
+		unsigned int numFront, numBack;
+		ClassifyWinding( pass, &ctx->planes[ portalIndex ], &numFront, &numBack );
+		if ( numBack == 0 )
+			continue;
+
+		CommonPVSWinding *target = &ctx->stack[ depth ];
+		Common_PVS_SetupWinding( target, portal->points, portal->numPoints );
+		if ( !Common_PVS_ClipWinding( target, ctx->sourcePlane ) || !Common_PVS_ClipWinding( target, passPlane ) )
+			continue;
+
+		/* the first portal along is always visible through the source */
+		if ( depth > 0 )
+		{
+			if ( !ClipToSeparators( ctx->source, pass, target, false ) || !ClipToSeparators( ctx->source, pass, target, true ) )
+				continue;
+		}
+
+		SetVisible( ctx->row, portal->to );
+		RecursiveFlow( ctx, portal->to, target, &ctx->planes[ portalIndex ], depth + 1 );
+	}
+
+	ctx->onPath[ cluster ] = false;
+}
+
+/**
+ * Works out which clusters can possibly be seen from each cluster,
+ * by following the portals out of it.
+ */
+bool Common_PVS_Compute( CommonPVS *pvs, const CommonPVSPortal *portals, unsigned int numPortals, unsigned int numClusters )
+{
+	PL_ZERO( pvs, sizeof( CommonPVS ) );
+	if ( numClusters == 0 )
+		return false;
+
+	for ( unsigned int i = 0; i < numPortals; ++i )
+	{
+		if ( portals[ i ].from >= numClusters || portals[ i ].to >= numClusters )
+		{
+			Warning( "Portal %u references an invalid cluster!\n", i );
+			return false;
+		}
+
+		if ( portals[ i ].numPoints < 3 || portals[ i ].numPoints > CMN_PVS_MAX_WINDING_POINTS )
+		{
+			Warning( "Portal %u has an invalid number of points (%u)!\n", i, portals[ i ].numPoints );
+			return false;
+		}
+	}
+
+	CommonPVSPlane *planes         = PL_NEW_( CommonPVSPlane, numPortals + 1 );
+	uint32_t       *clusterOffsets = PL_NEW_( uint32_t, numClusters + 1 );
+	uint32_t       *clusterPortals = PL_NEW_( uint32_t, numPortals + 1 );
+	for ( unsigned int i = 0; i < numPortals; ++i )
+	{
+		const CommonPVSPortal *portal = &portals[ i ];
+
+		float length = sqrtf( DotProduct( &portal->normal, &portal->normal ) );
+		if ( length > 0.0f )
+			planes[ i ].normal = PLVector3( portal->normal.x / length, portal->normal.y / length, portal->normal.z / length );
+
+		/* average it out, in case the points aren't quite planar */
+		for ( unsigned int j = 0; j < portal->numPoints; ++j )
+			planes[ i ].distance += DotProduct( &planes[ i ].normal, &portal->points[ j ] );
+		planes[ i ].distance /= ( float ) portal->numPoints;
+
+		clusterOffsets[ portal->from + 1 ]++;
+	}
+
+	for ( unsigned int i = 0; i < numClusters; ++i )
+		clusterOffsets[ i + 1 ] += clusterOffsets[ i ];
+
+	uint32_t *fill = PL_NEW_( uint32_t, numClusters );
+	for ( unsigned int i = 0; i < numPortals; ++i )
+		clusterPortals[ clusterOffsets[ portals[ i ].from ] + fill[ portals[ i ].from ]++ ] = i;
+	PL_DELETE( fill );
+
+	pvs->numClusters = numClusters;
+	pvs->numWords    = CMN_PVS_NUM_WORDS( numClusters );
+	pvs->bits        = PL_NEW_( uint32_t, pvs->numWords * numClusters );
+
+	FlowContext ctx;
+	PL_ZERO_( ctx );
+	ctx.portals        = portals;
+	ctx.planes         = planes;
+	ctx.clusterOffsets = clusterOffsets;
+	ctx.clusterPortals = clusterPortals;
+	ctx.onPath         = PL_NEW_( uint8_t, numClusters );
+	ctx.stack          = PL_NEW_( CommonPVSWinding, numClusters );
+
+	CommonPVSWinding source;
+	for ( unsigned int i = 0; i < numClusters; ++i )
+	{
+		ctx.row = &pvs->bits[ i * pvs->numWords ];
+		SetVisible( ctx.row, i );
+
+		ctx.onPath[ i ] = true;
+		for ( unsigned int j = clusterOffsets[ i ]; j < clusterOffsets[ i + 1 ]; ++j )
+		{
+			const CommonPVSPortal *portal = &portals[ clusterPortals[ j ] ];
+			if ( portal->to == i )
+				continue;
+
+			SetVisible( ctx.row, portal->to );
+
+			Common_PVS_SetupWinding( &source, portal->points, portal->numPoints );
+			ctx.source      = &source;
+			ctx.sourcePlane = &planes[ clusterPortals[ j ] ];
+			RecursiveFlow( &ctx, portal->to, &source, ctx.sourcePlane, 0 );
+		}
+		ctx.onPath[ i ] = false;
+	}
+
+	PL_DELETE( ctx.stack );
+	PL_DELETE( ctx.onPath );
+	PL_DELETE( clusterPortals );
+	PL_DELETE( clusterOffsets );
+	PL_DELETE( planes );
+
+	return true;
+}
+
+/**
+ * Sets up the visible sets from previously computed bits,
+ * laid out the same way as they are in CommonPVS.
+ */
+bool Common_PVS_Load( CommonPVS *pvs, const uint32_t *bits, unsigned int numClusters )
+{
+	PL_ZERO( pvs, sizeof( CommonPVS ) );
+	if ( numClusters == 0 )
+		return false;
+
+	pvs->numClusters = numClusters;
+	pvs->numWords    = CMN_PVS_NUM_WORDS( numClusters );
+	pvs->bits        = PL_NEW_( uint32_t, pvs->numWords * numClusters );
+	memcpy( pvs->bits, bits, sizeof( uint32_t ) * pvs->numWords * numClusters );
+
+	return true;
+}
+
+void Common_PVS_Destroy( CommonPVS *pvs )
+{
+	PL_DELETE( pvs->bits );
+	PL_ZERO( pvs, sizeof( CommonPVS ) );
+}
+
+const uint32_t *Common_PVS_GetRow( const CommonPVS *pvs, unsigned int cluster )
+{
+	if ( cluster >= pvs->numClusters )
+		return NULL;
+
+	return &pvs->bits[ cluster * pvs->numWords ];
+}
+
+/**
+ * If there's no set for either cluster, we
+ * just have to assume it's visible.
+ */
+bool Common_PVS_IsVisible( const CommonPVS *pvs, unsigned int from, unsigned int to )
+{
+	if ( from >= pvs->numClusters || to >= pvs->numClusters )
+		return true;
+
+	return ( pvs->bits[ from * pvs->numWords + to / 32 ] & ( 1U << ( to % 32 ) ) ) != 0;
+}
+
+unsigned int Common_PVS_GetNumVisible( const CommonPVS *pvs, unsigned int cluster )
+{
+	const uint32_t *row = Common_PVS_GetRow( pvs, cluster );
+	if ( row == NULL )
+		return 0;
+
+	unsigned int numVisible = 0;
+	for ( unsigned int i = 0; i < pvs->numWords; ++i )
+	{
+		for ( uint32_t word = row[ i ]; word != 0; word &= word - 1 )
+			numVisible++;
+	}
+
+	return numVisible;
+}
@@ -0,0 +1,64 @@
+// SPDX-License-Identifier: LGPL-3.0-or-later
+// Copyright © 2020-2023 OldTimes Software, Mark E Sowden <hogsy@oldtimes-software.com>
+
+#include "common.h"
+#include "common_sort.h"
+
+#define RADIX_BITS    8
+#define RADIX_BUCKETS ( 1 << RADIX_BITS )
+#define RADIX_PASSES  ( 64 / RADIX_BITS )
+
+void Common_RadixSort64( uint64_t *keys, uint32_t *values, uint64_t *scratchKeys, uint32_t *scratchValues, unsigned int numKeys )
+{
+	if ( numKeys < 2 )
+		return;
+
+	/* count every digit up front, in one go over the keys */
+	uint32_t counts[ RADIX_PASSES ][ RADIX_BUCKETS ];
+	PL_ZERO( counts, sizeof( counts ) );
+	for ( unsigned int i = 0; i < numKeys; ++i )
+	{
+		uint64_t key = keys[ i ];
+		for ( unsigned int j = 0; j < RADIX_PASSES; ++j )
+			counts[ j ][ ( key >> ( j * RADIX_BITS ) ) & ( RADIX_BUCKETS - 1 ) ]++;
+	}
+
+	uint64_t *srcKeys = keys, *dstKeys = scratchKeys;
+	uint32_t *srcValues = values, *dstValues = scratchValues;
+	for ( unsigned int i = 0; i < RADIX_PASSES; ++i )
+	{
+		/* if every key has the same digit here, this pass wouldn't move anything */
+		unsigned int shift = i * RADIX_BITS;
+		if ( counts[ i ][ ( srcKeys[ 0 ] >> shift ) & ( RADIX_BUCKETS - 1 ) ] == numKeys )
+			continue;
+
+		uint32_t offsets[ RADIX_BUCKETS ];
+		uint32_t total = 0;
+		for ( unsigned int j = 0; j < RADIX_BUCKETS; ++j )
+		{
+			offsets[ j ] = total;
+			total += counts[ i ][ j ];
+		}
+
+		for ( unsigned int j = 0; j < numKeys; ++j )
+		{
+			uint32_t slot     = offsets[ ( srcKeys[ j ] >> shift ) & ( RADIX_BUCKETS - 1 ) ]++;
+			dstKeys[ slot ]   = srcKeys[ j ];
+			dstValues[ slot ] = srcValues[ j ];
+		}
+
+		uint64_t *tmpKeys = srcKeys;
+		srcKeys           = dstKeys;
+		dstKeys           = tmpKeys;
+
+		uint32_t *tmpValues = srcValues;
+		srcValues           = dstValues;
+		dstValues           = tmpValues;
+	}
+
+	if ( srcKeys != keys )
+	{
+		memcpy( keys, srcKeys, sizeof( uint64_t ) * numKeys );
+		memcpy( values, srcValues, sizeof( uint32_t ) * numKeys );
+	}
+}
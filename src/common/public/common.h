@@ -52,5 +52,24 @@ bool           Common_WriteConfig( struct YNNodeBranch *root, const char *name )
 
 void Common_Pkg_WriteHeader( FILE *pack, unsigned int numFiles );
 void Common_Pkg_AddData( FILE *pack, const char *path, const void *buf, size_t size );
+void Common_Pkg_AddAlias( FILE *pack, const char *path, size_t size, unsigned int sourceIndex );
+
+/* decoded data shared between aliased package entries */
+typedef struct CommonPkgBlob
+{
+	size_t   size;
+	uint8_t *data;
+} CommonPkgBlob;
+
+void Common_Pkg_SetBlobCacheInterface( CommonPkgBlob *( *getCachedBlob )( const char *id ),
+                                       void ( *addCachedBlob )( const char *id, CommonPkgBlob *blob ) );
+void Common_Pkg_ClearSharedBlobs( void );
+void Common_Pkg_DestroyBlob( CommonPkgBlob *blob );
+
+typedef struct PLImage PLImage;
+typedef struct PLFile  PLFile;
+
+PLImage *Common_Image_LoadPackedImage( PLFile *file );// loader for packed images produced by pkgman, see common_format_gfx.h
+void     Common_Image_SetReferenceDecoder( bool enable );// switches back to the original per-byte decoder, for benchmarking
 
 PL_EXTERN_C_END
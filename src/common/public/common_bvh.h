@@ -0,0 +1,62 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* Copyright © 2020-2023 Mark E Sowden <hogsy@oldtimes-software.com> */
+
+#pragma once
+
+#include <plcore/pl_math.h>
+
+PL_EXTERN_C
+
+/**
+ * Bounding volume hierarchy over a set of axis-aligned boxes.
+ *
+ * Nodes are stored depth-first, so an internal node's left child always
+ * directly follows it, and only the right child needs to be referenced.
+ * Items are the indices of the boxes the tree was built from, grouped so
+ * that each leaf's items are contiguous.
+ */
+
+#define CMN_BVH_MAX_LEAF_ITEMS 4
+#define CMN_BVH_MAX_DEPTH      64
+
+typedef struct CommonBVHBounds
+{
+	PLVector3 mins;
+	PLVector3 maxs;
+} CommonBVHBounds;
+
+typedef struct CommonBVHNode
+{
+	CommonBVHBounds bounds;
+	uint32_t        offset;  /* leaf; first slot in items, otherwise the right child */
+	uint32_t        numItems;/* 0 for internal nodes */
+} CommonBVHNode;
+
+typedef struct CommonBVH
+{
+	CommonBVHNode   *nodes;
+	unsigned int     numNodes;
+	uint32_t        *items;
+	CommonBVHBounds *itemBounds;/* copy of each item's bounds, in the same order as items */
+	unsigned int     numItems;
+} CommonBVH;
+
+typedef bool ( *CommonBVHTestFunction )( const CommonBVHBounds *bounds, void *user );
+
+bool Common_BVH_Build( CommonBVH *bvh, const CommonBVHBounds *bounds, unsigned int numBounds );
+bool Common_BVH_Load( CommonBVH *bvh, const uint32_t *nodes, unsigned int numNodes, const uint32_t *items, const CommonBVHBounds *bounds, unsigned int numBounds );
+void Common_BVH_Refit( CommonBVH *bvh );
+void Common_BVH_Destroy( CommonBVH *bvh );
+
+/* each query writes out up to maxItems indices of the boxes that pass, and returns how many it wrote */
+unsigned int Common_BVH_Query( const CommonBVH *bvh, CommonBVHTestFunction test, void *user, uint32_t *items, unsigned int maxItems );
+unsigned int Common_BVH_QueryBounds( const CommonBVH *bvh, const CommonBVHBounds *bounds, uint32_t *items, unsigned int maxItems );
+unsigned int Common_BVH_QuerySphere( const CommonBVH *bvh, const PLVector3 *origin, float radius, uint32_t *items, unsigned int maxItems );
+unsigned int Common_BVH_QueryRay( const CommonBVH *bvh, const PLVector3 *origin, const PLVector3 *direction, float distance, uint32_t *items, unsigned int maxItems );
+
+/* the tests used by the above, for anyone wanting to check boxes directly */
+bool Common_BVH_TestBounds( const CommonBVHBounds *a, const CommonBVHBounds *b );
+bool Common_BVH_TestSphere( const CommonBVHBounds *bounds, const PLVector3 *origin, float radius );
+bool Common_BVH_TestRay( const CommonBVHBounds *bounds, const PLVector3 *origin, const PLVector3 *direction, float distance );
+
+PL_EXTERN_C_END
@@ -0,0 +1,47 @@
+// SPDX-License-Identifier: LGPL-3.0-or-later
+// Copyright © 2020-2023 OldTimes Software, Mark E Sowden <hogsy@oldtimes-software.com>
+
+#pragma once
+
+/**
+ * Packed image format, as produced by pkgman.
+ *
+ * char     identifier[ 4 ];    GFX_IDENTIFIER
+ * uint8_t  format;             PGFX_FORMAT_*
+ * uint8_t  numLevels;          number of mip levels that follow, at least 1
+ * uint16_t width;
+ * uint16_t height;
+ *
+ * then for each level, halving in size down to 1x1...
+ *
+ * PGFX_FORMAT_CLUSTER:
+ *  uint8_t  channels;          PGFX_CHANNEL_* used by the level
+ *  uint16_t numBlocks;         if this is 0, it means there's just plain data
+ *  for each block:
+ *   uint8_t  channels;         followed by a byte for each channel set
+ *   uint16_t numPixels;        followed by the pixel offsets, which are 8, 16 or
+ *                              32 bits depending on the number of pixels in the level
+ *
+ * PGFX_FORMAT_DXT*:
+ *  compressed blocks for the level
+ */
+
+enum
+{
+	PL_BITFLAG( PGFX_CHANNEL_RED, 0 ),
+	PL_BITFLAG( PGFX_CHANNEL_GREEN, 1 ),
+	PL_BITFLAG( PGFX_CHANNEL_BLUE, 2 ),
+	PL_BITFLAG( PGFX_CHANNEL_ALPHA, 3 ),
+};
+
+enum
+{
+	PGFX_FORMAT_CLUSTER    = 0,
+	PGFX_FORMAT_DXT1       = 1,
+	PGFX_FORMAT_DXT1_ALPHA = 2,
+	PGFX_FORMAT_DXT3       = 3,
+	PGFX_FORMAT_DXT5       = 4,
+};
+
+#define GFX_IDENTIFIER "GFX2"
+#define GFX_MAX_LEVELS 16
@@ -0,0 +1,47 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* Copyright © 2020-2023 Mark E Sowden <hogsy@oldtimes-software.com> */
+
+#pragma once
+
+#include <plcore/pl_math.h>
+
+#include "common_bvh.h"
+
+PL_EXTERN_C
+
+/**
+ * Assigns point lights to groups (sectors, cells, whatever) by whether
+ * the light's sphere of influence touches the group's bounds, and then
+ * picks out the most important of those to actually light with.
+ *
+ * Each group's lights are kept in ascending order, packed one group
+ * after another, so a group's list is just a slice of the table.
+ */
+
+#define CMN_LIGHTCULL_MAX_SELECT 32
+
+typedef struct CommonLightCullLight
+{
+	PLVector3 origin;
+	float     radius;
+	float     intensity;
+} CommonLightCullLight;
+
+typedef struct CommonLightCullTable
+{
+	uint32_t    *offsets;/* where each group starts in lights, plus one past the end */
+	uint32_t    *lights;
+	unsigned int numGroups;
+} CommonLightCullTable;
+
+typedef bool ( *CommonLightCullTestFunction )( const CommonLightCullLight *light, void *user );
+
+bool Common_LightCull_Assign( CommonLightCullTable *table, const CommonLightCullLight *lights, unsigned int numLights, const CommonBVHBounds *groups, unsigned int numGroups );
+void Common_LightCull_Destroy( CommonLightCullTable *table );
+
+const uint32_t *Common_LightCull_GetLights( const CommonLightCullTable *table, unsigned int group, unsigned int *numLights );
+
+float        Common_LightCull_GetImportance( const CommonLightCullLight *light, const PLVector3 *viewOrigin );
+unsigned int Common_LightCull_Select( const CommonLightCullLight *lights, const uint32_t *candidates, unsigned int numCandidates, const PLVector3 *viewOrigin, CommonLightCullTestFunction test, void *user, uint32_t *out, unsigned int maxOut );
+
+PL_EXTERN_C_END
@@ -0,0 +1,110 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* Copyright © 2020-2023 Mark E Sowden <hogsy@oldtimes-software.com> */
+
+#pragma once
+
+#include <plcore/pl_math.h>
+
+#include "common_bvh.h"
+
+PL_EXTERN_C
+
+/**
+ * CPU lightmapper for world surfaces.
+ *
+ * Each surface is a convex polygon, which gets its own chart, planar mapped
+ * at a fixed number of world units per luxel. Charts are packed into square
+ * atlases, and direct lighting is then gathered for every luxel, with a
+ * shadow ray to each light traced against a tree over all the surfaces.
+ *
+ * Charts only ever write to their own part of an atlas, so any number of
+ * threads can bake different charts at the same time.
+ */
+
+#define CMN_LIGHTMAP_DEFAULT_LUXEL_SIZE 8.0f
+#define CMN_LIGHTMAP_DEFAULT_ATLAS_SIZE 1024
+#define CMN_LIGHTMAP_PADDING            1
+#define CMN_LIGHTMAP_MAX_POINTS         32
+#define CMN_LIGHTMAP_EPSILON            0.125f
+#define CMN_LIGHTMAP_MAX_THREADS        64
+
+#define CMN_LIGHTMAP_EXTENSION "wlm.n"
+
+typedef struct CommonLightmapLight
+{
+	PLVector3 position;
+	PLVector3 colour;/* already scaled by intensity */
+	float     radius;
+} CommonLightmapLight;
+
+typedef struct CommonLightmapTriangle
+{
+	PLVector3 origin;
+	PLVector3 edges[ 2 ];
+} CommonLightmapTriangle;
+
+typedef struct CommonLightmapChart
+{
+	uint32_t mesh;/* where the surface came from */
+	uint32_t face;
+
+	unsigned int atlas;
+	unsigned int x, y;         /* in the atlas, including padding */
+	unsigned int width, height;
+
+	/* the world position of each luxel's corner is
+	 * origin + sAxis * x + tAxis * y */
+	PLVector3 origin;
+	PLVector3 sAxis;
+	PLVector3 tAxis;
+	PLVector3 normal;
+} CommonLightmapChart;
+
+typedef struct CommonLightmapAtlas
+{
+	unsigned int size;
+	float       *luxels;/* rgb */
+
+	unsigned int shelfX, shelfY, shelfHeight;
+} CommonLightmapAtlas;
+
+typedef struct CommonLightmapBaker
+{
+	float        luxelSize;
+	unsigned int atlasSize;
+	PLVector3    ambience;
+
+	CommonLightmapTriangle *triangles;
+	unsigned int            numTriangles;
+	unsigned int            maxTriangles;
+	CommonBVH               tree;
+
+	CommonLightmapChart *charts;
+	unsigned int         numCharts;
+	unsigned int         maxCharts;
+
+	CommonLightmapAtlas *atlases;
+	unsigned int         numAtlases;
+
+	CommonLightmapLight *lights;
+	unsigned int         numLights;
+	unsigned int         maxLights;
+} CommonLightmapBaker;
+
+void Common_Lightmap_Setup( CommonLightmapBaker *baker, float luxelSize, unsigned int atlasSize );
+void Common_Lightmap_Destroy( CommonLightmapBaker *baker );
+
+bool Common_Lightmap_AddSurface( CommonLightmapBaker *baker, const PLVector3 *points, unsigned int numPoints, uint32_t mesh, uint32_t face );
+void Common_Lightmap_AddLight( CommonLightmapBaker *baker, const CommonLightmapLight *light );
+bool Common_Lightmap_LoadWorld( CommonLightmapBaker *baker, const char *path );
+
+/* packs the charts and builds the tree, call once everything's been added */
+bool     Common_Lightmap_Prepare( CommonLightmapBaker *baker );
+uint64_t Common_Lightmap_BakeChart( CommonLightmapBaker *baker, unsigned int chartIndex );
+uint64_t Common_LightmapBaker_BakeThreaded( CommonLightmapBaker *baker, unsigned int numThreads );
+bool     Common_Lightmap_IsOccluded( const CommonLightmapBaker *baker, const PLVector3 *origin, const PLVector3 *direction, float distance );
+
+struct YNNodeBranch *Common_Lightmap_Serialise( const CommonLightmapBaker *baker );
+bool                 Common_Lightmap_GetOutputPath( const char *worldPath, char *dest, size_t length );
+
+PL_EXTERN_C_END
@@ -0,0 +1,61 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* Copyright © 2020-2023 Mark E Sowden <hogsy@oldtimes-software.com> */
+
+#pragma once
+
+#include <plcore/pl_math.h>
+
+#include "common_bvh.h"
+
+PL_EXTERN_C
+
+/**
+ * Low resolution depth buffer that big occluders are drawn into on the
+ * CPU, so that boxes sitting entirely behind them can be thrown out
+ * before anything gets submitted.
+ *
+ * Depth is stored as 1/w, which can be interpolated straight across
+ * the screen and gets bigger the closer something is; a clear buffer
+ * is all zeroes, where nothing can be hidden.
+ *
+ * Triangles are transformed, clipped and set up as they're added, and
+ * then drawn a band of rows at a time. Each band only ever touches its
+ * own rows, so separate bands can be drawn on separate threads without
+ * any locking, as long as nothing is added or tested in the meantime.
+ */
+
+#define CMN_OCCLUSION_MIN_W 0.1f /* anything nearer than this is clipped away */
+
+typedef struct CommonOcclusionTriangle
+{
+	float edges[ 3 ][ 3 ];        /* a, b and c of each edge, ax + by + c >= 0 inside */
+	float depth[ 3 ];             /* and the plane 1/w lies on, in the same form */
+	int   minX, minY, maxX, maxY; /* pixels it might cover, inclusive */
+} CommonOcclusionTriangle;
+
+typedef struct CommonOcclusionBuffer
+{
+	float       *depth;
+	unsigned int width; /* always a multiple of four */
+	unsigned int height;
+
+	float viewProjection[ 16 ]; /* row-major, the same as PLMatrix4 */
+
+	CommonOcclusionTriangle *triangles;
+	unsigned int             numTriangles;
+	unsigned int             maxTriangles;
+} CommonOcclusionBuffer;
+
+bool Common_OcclusionBuffer_Create( CommonOcclusionBuffer *buffer, unsigned int width, unsigned int height );
+void Common_OcclusionBuffer_Destroy( CommonOcclusionBuffer *buffer );
+
+void         Common_OcclusionBuffer_Begin( CommonOcclusionBuffer *buffer, const float *viewProjection );
+unsigned int Common_OcclusionBuffer_AddTriangle( CommonOcclusionBuffer *buffer, const PLVector3 *a, const PLVector3 *b, const PLVector3 *c );
+
+/* clears the given rows, and then draws whatever part of each triangle falls in them */
+void Common_OcclusionBuffer_DrawRows( CommonOcclusionBuffer *buffer, unsigned int firstRow, unsigned int numRows );
+void Common_OcclusionBuffer_DrawRowsScalar( CommonOcclusionBuffer *buffer, unsigned int firstRow, unsigned int numRows );
+
+bool Common_OcclusionBuffer_TestBounds( const CommonOcclusionBuffer *buffer, const CommonBVHBounds *bounds );
+
+PL_EXTERN_C_END
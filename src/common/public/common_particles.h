@@ -0,0 +1,77 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* Copyright © 2020-2023 Mark E Sowden <hogsy@oldtimes-software.com> */
+
+#pragma once
+
+#include <plcore/pl_math.h>
+
+#include "common_bvh.h"
+
+PL_EXTERN_C
+
+/**
+ * Fixed-capacity pool of particles, kept as one array per attribute so
+ * that ticking them is a handful of straight runs over floats. Dead
+ * particles are swapped out for the last one, so the live ones are
+ * always packed at the front.
+ *
+ * Each pool carries its own random number generator, made up of four
+ * independent lanes so it can be stepped alongside four particles at
+ * once; particle i always draws from lane i % 4, which keeps the
+ * results the same however many particles are ticked at a time.
+ */
+
+#define CMN_PARTICLE_RANDOM_LANES 4
+#define CMN_PARTICLE_POOL_FULL    ( ( unsigned int ) -1 )
+
+typedef struct CommonParticlePool
+{
+	float   *x, *y, *z;
+	float   *velocityX, *velocityY, *velocityZ;
+	float   *r, *g, *b, *a;
+	float   *deltaR, *deltaG, *deltaB, *deltaA;
+	float   *scale, *deltaScale;
+	int32_t *life; /* ticks left */
+
+	unsigned int numParticles;
+	unsigned int maxParticles; /* how many there's room for */
+
+	uint32_t random[ CMN_PARTICLE_RANDOM_LANES ];
+
+	void *memory;
+} CommonParticlePool;
+
+typedef struct CommonParticleForce
+{
+	PLVector3 force;
+	PLVector3 forceVar; /* up to this much more is added, per particle and tick */
+} CommonParticleForce;
+
+void Common_ParticlePool_Seed( CommonParticlePool *pool, uint32_t seed );
+bool Common_ParticlePool_Reserve( CommonParticlePool *pool, unsigned int maxParticles );
+void Common_ParticlePool_Destroy( CommonParticlePool *pool );
+
+float        Common_ParticlePool_Random( CommonParticlePool *pool );
+unsigned int Common_ParticlePool_Spawn( CommonParticlePool *pool );
+
+/**
+ * Describes where each part of a vertex goes, so quads can be written
+ * straight into whatever vertex type the renderer is using.
+ */
+typedef struct CommonParticleVertexLayout
+{
+	void  *vertices;       /* where the first vertex is written */
+	size_t stride;         /* bytes from one vertex to the next */
+	size_t positionOffset; /* three floats */
+	size_t colourOffset;   /* four bytes, red first */
+	size_t uvOffset;       /* two floats */
+} CommonParticleVertexLayout;
+
+#define CMN_PARTICLE_QUAD_VERTICES 4
+
+unsigned int Common_ParticlePool_BuildQuads( const CommonParticlePool *pool, unsigned int first, unsigned int count, const PLVector3 *right, const PLVector3 *up, const CommonParticleVertexLayout *layout );
+
+unsigned int Common_ParticlePool_Tick( CommonParticlePool *pool, const CommonParticleForce *force, CommonBVHBounds *bounds );
+unsigned int Common_ParticlePool_TickScalar( CommonParticlePool *pool, const CommonParticleForce *force, CommonBVHBounds *bounds );
+
+PL_EXTERN_C_END
@@ -0,0 +1,68 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* Copyright © 2020-2023 Mark E Sowden <hogsy@oldtimes-software.com> */
+
+#pragma once
+
+#include <plcore/pl_math.h>
+
+PL_EXTERN_C
+
+/**
+ * Potentially visible sets between clusters (sectors, rooms, whatever)
+ * that are connected by convex portals.
+ *
+ * Each portal is one-way, leading out of one cluster and into another,
+ * and its normal is expected to face into the cluster it leads to. Rather
+ * than just flooding through every portal, the portal chain is followed
+ * while clipping each portal down to what can be seen through the ones
+ * before it, so the result is conservative; it may claim more is visible
+ * than actually is, but never less.
+ */
+
+#define CMN_PVS_MAX_WINDING_POINTS 64
+#define CMN_PVS_EPSILON            0.01f
+
+typedef struct CommonPVSPlane
+{
+	PLVector3 normal;
+	float     distance;
+} CommonPVSPlane;
+
+typedef struct CommonPVSWinding
+{
+	PLVector3    points[ CMN_PVS_MAX_WINDING_POINTS ];
+	unsigned int numPoints;
+} CommonPVSWinding;
+
+typedef struct CommonPVSPortal
+{
+	const PLVector3 *points;
+	unsigned int     numPoints;
+	PLVector3        normal;/* facing into the 'to' cluster */
+	uint32_t         from;
+	uint32_t         to;
+} CommonPVSPortal;
+
+typedef struct CommonPVS
+{
+	uint32_t    *bits;       /* a row of numWords per cluster */
+	unsigned int numClusters;
+	unsigned int numWords;
+} CommonPVS;
+
+#define CMN_PVS_NUM_WORDS( NUM_CLUSTERS ) ( ( ( NUM_CLUSTERS ) + 31 ) / 32 )
+
+bool Common_PVS_Compute( CommonPVS *pvs, const CommonPVSPortal *portals, unsigned int numPortals, unsigned int numClusters );
+bool Common_PVS_Load( CommonPVS *pvs, const uint32_t *bits, unsigned int numClusters );
+void Common_PVS_Destroy( CommonPVS *pvs );
+
+const uint32_t *Common_PVS_GetRow( const CommonPVS *pvs, unsigned int cluster );
+bool            Common_PVS_IsVisible( const CommonPVS *pvs, unsigned int from, unsigned int to );
+unsigned int    Common_PVS_GetNumVisible( const CommonPVS *pvs, unsigned int cluster );
+
+/* winding helpers, shared with anything doing its own portal clipping at runtime */
+void Common_PVS_SetupWinding( CommonPVSWinding *winding, const PLVector3 *points, unsigned int numPoints );
+bool Common_PVS_ClipWinding( CommonPVSWinding *winding, const CommonPVSPlane *plane );
+bool Common_PVS_MakePlane( CommonPVSPlane *plane, const PLVector3 *a, const PLVector3 *b, const PLVector3 *c );
+
+PL_EXTERN_C_END
@@ -0,0 +1,18 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* Copyright © 2020-2023 Mark E Sowden <hogsy@oldtimes-software.com> */
+
+#pragma once
+
+#include <plcore/pl.h>
+
+PL_EXTERN_C
+
+/**
+ * Sorts 64-bit keys in ascending order, carrying a value alongside each,
+ * a byte at a time. Equal keys keep the order they came in. Scratch must
+ * be big enough for the same number of keys and values, and the result
+ * always ends up back in keys and values.
+ */
+void Common_RadixSort64( uint64_t *keys, uint32_t *values, uint64_t *scratchKeys, uint32_t *scratchValues, unsigned int numKeys );
+
+PL_EXTERN_C_END
@@ -307,6 +307,9 @@ void Client_Console_Draw( const YNCoreViewport *viewport )
 
 	BitmapFont *font = Font_GetDefault();
 
+	/* whatever was written beneath the console needs to go first */
+	Font_FlushBatches();
+
 	PlgSetTexture( NULL, 0 );
 	PlgSetBlendMode( PLG_BLEND_DEFAULT );
 	PlgSetShaderProgram( defaultShaderPrograms[ RS_SHADER_DEFAULT_VERTEX ] );
@@ -328,8 +331,6 @@ void Client_Console_Draw( const YNCoreViewport *viewport )
 	PlgDrawRectangle( 0.0f, height - ( float ) font->ch, width, ( float ) font->ch, CON_INPUT_COLOUR );
 	PlgDrawRectangle( 0.0f, 0.0f, consoleScrollBarWidth, consoleHeight, CON_SIDE_COLOUR );
 
-	Font_BeginDraw( font );
-
 	ConsoleOutput *output = Console_GetOutput();
 	if ( output->numLines > 0 )
 	{
@@ -358,14 +359,18 @@ void Client_Console_Draw( const YNCoreViewport *viewport )
 		}
 	}
 
-	Font_Draw( font );
-
 	PlgSetShaderProgram( defaultShaderPrograms[ RS_SHADER_DEFAULT_VERTEX ] );
 	PlgSetTexture( NULL, 0 );
 
 	// auto-completion list
 	if ( enableAutoCompleteList && ( autoComplete[ 0 ] != NULL ) )
 	{
+		/* it's drawn over the output */
+		Font_FlushBatches();
+
+		PlgSetShaderProgram( defaultShaderPrograms[ RS_SHADER_DEFAULT_VERTEX ] );
+		PlgSetTexture( NULL, 0 );
+
 		float autoCompleteHeight = 0.0f;
 		float autoCompleteWidth  = 0.0f;
 
@@ -381,12 +386,8 @@ void Client_Console_Draw( const YNCoreViewport *viewport )
 		}
 	}
 
-	Font_BeginDraw( font );
-
 	Client_Console_DrawInputField( viewport );
 
-	Font_Draw( font );
-
 	/* draw version info */
 	{
 		BitmapFont *smallFont = Font_GetDefaultSmall();
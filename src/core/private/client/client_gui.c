@@ -31,6 +31,8 @@ void YnCore_InitializeGUI( void )
 	PlRegisterConsoleVariable( "gui.width", "Width of the GUI canvas.", "800", PL_VAR_I32, &guiWidth, NULL, false );
 	PlRegisterConsoleVariable( "gui.height", "Height of the GUI canvas.", "600", PL_VAR_I32, &guiHeight, NULL, false );
 
+	PlRegisterConsoleCommand( "gui.benchmark", "Time drawing a menu that's sat idle, optionally specifying how many frames.", -1, YnCore_BenchmarkGUICommand );
+
 	YNCoreRenderTarget *guiTarget = YnCore_RenderTarget_Create( "gui", 640, 480, PLG_BUFFER_COLOUR | PLG_BUFFER_DEPTH );
 	if ( guiTarget == NULL )
 		PRINT_ERROR( "Failed to create default render target for GUI!\n" );
@@ -68,6 +70,8 @@ void YnCore_ShutdownGUI( void )
 	GUI_Shutdown();
 }
 
+static void YnCore_BenchmarkGUICommand( unsigned int argc, char **argv );
+
 void YnCore_DrawGUI( const YNCoreViewport *viewport )
 {
 	PlgBindFrameBuffer( NULL, PLG_FRAMEBUFFER_DRAW );
@@ -155,3 +159,117 @@ GUIPanel *YnCore_GetGUIRootPanel( void )
 {
 	return rootPanel;
 }
+
+/****************************************
+ * BENCHMARK
+ ****************************************/
+
+#define GUI_BENCHMARK_DEFAULT_FRAMES 1000
+#define GUI_BENCHMARK_BUTTON_ROWS    16
+#define GUI_BENCHMARK_BUTTON_COLUMNS 4
+
+typedef struct GUIBenchmarkResult
+{
+	double       frameTime;
+	GUIDrawStats stats;// totals across all the frames
+} GUIBenchmarkResult;
+
+static void YnCore_TimeGUIFrames( GUICanvas *benchCanvas, GUIPanel *root, GUIPanel *status, unsigned int numFrames, GUIBenchmarkResult *result )
+{
+	PL_ZERO( result, sizeof( GUIBenchmarkResult ) );
+
+	double startTime = PlGetCurrentSeconds();
+	for ( unsigned int i = 0; i < numFrames; ++i )
+	{
+		/* something small outside of the menu that changes every frame, like a clock */
+		if ( status != NULL )
+		{
+			PLColour colour = ( i & 1 ) ? PL_COLOUR_RED : PL_COLOUR_GREEN;
+			GUI_Panel_SetBackgroundColour( status, &colour );
+		}
+
+		GUI_Tick( root );
+		GUI_Draw( benchCanvas, root );
+
+		GUIDrawStats stats;
+		GUI_GetDrawStats( &stats );
+		result->stats.numBatches += stats.numBatches;
+		result->stats.numTriangles += stats.numTriangles;
+		result->stats.numCacheHits += stats.numCacheHits;
+		result->stats.numCacheUpdates += stats.numCacheUpdates;
+	}
+	result->frameTime = ( PlGetCurrentSeconds() - startTime ) / numFrames;
+}
+
+static void YnCore_PrintGUIBenchmarkResult( const char *label, const GUIBenchmarkResult *result, unsigned int numFrames )
+{
+	PRINT( "  %-20s %.4fms, %.1f batches, %.1f triangles, %.1f cache hits, %.1f cache updates per frame\n",
+	       label,
+	       result->frameTime * 1000.0,
+	       ( double ) result->stats.numBatches / numFrames,
+	       ( double ) result->stats.numTriangles / numFrames,
+	       ( double ) result->stats.numCacheHits / numFrames,
+	       ( double ) result->stats.numCacheUpdates / numFrames );
+}
+
+/**
+ * Builds a menu off to the side of the real one, and times drawing it
+ * when nothing is changing, when something outside of the menu changes
+ * every frame, and with caching switched off altogether.
+ */
+static void YnCore_BenchmarkGUICommand( unsigned int argc, char **argv )
+{
+	unsigned int numFrames = GUI_BENCHMARK_DEFAULT_FRAMES;
+	if ( argc > 1 )
+	{
+		numFrames = strtoul( argv[ 1 ], NULL, 10 );
+		if ( numFrames == 0 )
+		{
+			PRINT_WARNING( "Invalid number of frames specified!\n" );
+			return;
+		}
+	}
+
+	GUICanvas *benchCanvas = GUI_CreateCanvas( guiWidth, guiHeight );
+	if ( benchCanvas == NULL )
+	{
+		PRINT_WARNING( "Failed to create canvas for benchmark!\n" );
+		return;
+	}
+
+	GUIPanel *root = GUI_Panel_Create( NULL, 0, 0, guiWidth, guiHeight, GUI_PANEL_BACKGROUND_NONE, GUI_PANEL_BORDER_NONE );
+	GUIPanel *menu = GUI_Panel_Create( root, 32, 32, GUI_BENCHMARK_BUTTON_COLUMNS * 128 + 16, GUI_BENCHMARK_BUTTON_ROWS * 24 + 16, GUI_PANEL_BACKGROUND_DEFAULT, GUI_PANEL_BORDER_OUTSET );
+	for ( unsigned int i = 0; i < GUI_BENCHMARK_BUTTON_ROWS; ++i )
+	{
+		for ( unsigned int j = 0; j < GUI_BENCHMARK_BUTTON_COLUMNS; ++j )
+			GUI_Panel_Create( menu, ( int ) ( 8 + j * 128 ), ( int ) ( 8 + i * 24 ), 120, 20, GUI_PANEL_BACKGROUND_DEFAULT, GUI_PANEL_BORDER_OUTSET );
+	}
+	GUI_Panel_SetCached( menu, true );
+
+	GUIPanel *status = GUI_Panel_Create( root, guiWidth - 40, 8, 32, 16, GUI_PANEL_BACKGROUND_SOLID, GUI_PANEL_BORDER_INSET );
+
+	PlgSetShaderProgram( defaultShaderPrograms[ RS_SHADER_DEFAULT_VERTEX ] );
+
+	bool wasCaching = GUI_SetCaching( true );
+
+	/* the first frame has to draw everything regardless */
+	GUI_Tick( root );
+	GUI_Draw( benchCanvas, root );
+
+	GUIBenchmarkResult idle, changing, uncached;
+	YnCore_TimeGUIFrames( benchCanvas, root, NULL, numFrames, &idle );
+	YnCore_TimeGUIFrames( benchCanvas, root, status, numFrames, &changing );
+
+	GUI_SetCaching( false );
+	YnCore_TimeGUIFrames( benchCanvas, root, NULL, numFrames, &uncached );
+
+	GUI_SetCaching( wasCaching );
+
+	GUI_Panel_Destroy( root );
+	GUI_DestroyCanvas( benchCanvas );
+
+	PRINT( "Drew a menu of %u panels for %u frames:\n", GUI_BENCHMARK_BUTTON_ROWS * GUI_BENCHMARK_BUTTON_COLUMNS + 3, numFrames );
+	YnCore_PrintGUIBenchmarkResult( "idle:", &idle, numFrames );
+	YnCore_PrintGUIBenchmarkResult( "changing:", &changing, numFrames );
+	YnCore_PrintGUIBenchmarkResult( "idle, uncached:", &uncached, numFrames );
+}
@@ -7,9 +7,11 @@
 #include "legacy/actor.h"
 #include "renderer_font.h"
 #include "world.h"
+#include "renderer_visibility.h"
 #include "game_interface.h"
 #include "renderer.h"
 #include "renderer_particle.h"
+#include "renderer_occlusion.h"
 
 #include "client/client_gui.h"
 #include "editor/editor.h"
@@ -130,6 +132,8 @@ void YnCore_BeginDraw( YNCoreViewport *viewport )
 	}
 	viewport->perf.oldTime = newTime;
 
+	YnCore_Texture_UpdateLoads();
+
 	YnCore_SetupDefaultRenderState( viewport );
 
 	PlgSetViewport( viewport->x, viewport->y, viewport->width, viewport->height );
@@ -148,6 +152,7 @@ static YNCoreMaterial *ppFXAAMaterial = NULL;
 
 void YR_Shader_Initialize( void );  /* renderer/shaders.c */
 void RT_InitializeTextures( void ); /* texture.c */
+void RT_ShutdownTextures( void );   /* texture.c */
 
 /* renderer_rendertarget.c */
 void YnCore_InitializeRenderTargets( void );
@@ -165,12 +170,26 @@ void Renderer_RegisterConsoleVariables( void )
 	PlRegisterConsoleVariable( "r.skipDiffuse", "Skip diffuse map.", "0", PL_VAR_BOOL, NULL, NULL, false );
 	PlRegisterConsoleVariable( "r.skipNormal", "Skip normal map.", "0", PL_VAR_BOOL, NULL, NULL, false );
 	PlRegisterConsoleVariable( "r.skipSpecular", "Skip specular map.", "0", PL_VAR_BOOL, NULL, NULL, false );
+	YnCore_CommandBuffer_RegisterConsoleVariables();
+
+	PlRegisterConsoleVariable( "r.sortDraws", "Sort world draws by state before submitting them.", "1", PL_VAR_BOOL, NULL, NULL, false );
+	PlRegisterConsoleVariable( "r.instancing", "Draw repeated static objects as instances, rather than one by one.", "1", PL_VAR_BOOL, NULL, NULL, false );
+	PlRegisterConsoleVariable( "r.cacheUniforms", "Use uniform slots resolved at link time, and only upload shared uniforms when they change.", "1", PL_VAR_BOOL, NULL, NULL, false );
+	PlRegisterConsoleVariable( "r.occlusionCulling", "Draw the biggest faces in view into a depth buffer on the CPU, and skip whatever's entirely behind them.", "1", PL_VAR_BOOL, NULL, NULL, false );
+	PlRegisterConsoleVariable( "r.batchText", "Cache laid out text, and draw all the text for each font together.", "1", PL_VAR_BOOL, NULL, NULL, false );
 	PlRegisterConsoleVariable( "r.driver", "Sets the default graphics driver. Requires restart.", "opengl", PL_VAR_STRING, NULL, NULL, true );
 
 	// Camera
 	PlRegisterConsoleVariable( "r.fov", "", "75", PL_VAR_F32, NULL, NULL, true );
 	PlRegisterConsoleVariable( "r.near", "", "0.1", PL_VAR_F32, NULL, NULL, true );
 	PlRegisterConsoleVariable( "r.far", "", "1000.0", PL_VAR_F32, NULL, NULL, true );
+
+	PlRegisterConsoleCommand( "r.benchmarkCulling", "Time culling a set of random faces, optionally specifying how many.", -1, VIS_BenchmarkCommand );
+	PlRegisterConsoleCommand( "r.benchmarkWorld", "Time drawing the current world through the null backend, optionally specifying how many frames.", -1, YnCore_World_BenchmarkCommand );
+	PlRegisterConsoleCommand( "r.benchmarkSort", "Time sorting a set of random draw keys, optionally specifying how many.", -1, YnCore_RenderQueue_BenchmarkCommand );
+	PlRegisterConsoleCommand( "r.benchmarkParticles", "Time simulating a set of particles without drawing them, optionally specifying how many.", -1, PS_BenchmarkCommand );
+	PlRegisterConsoleCommand( "r.benchmarkOcclusion", "Time drawing a set of random occluders on the CPU and testing objects against them, optionally specifying how many.", -1, OCC_BenchmarkCommand );
+	PlRegisterConsoleCommand( "r.benchmarkText", "Time drawing lines of console text through the null backend, optionally specifying how many.", -1, Font_BenchmarkCommand );
 }
 
 void YnCore_InitializeRenderer( void )
@@ -185,6 +204,8 @@ void YnCore_InitializeRenderer( void )
 	YnCore_InitializeRenderTargets();
 	YnCore_InitializeMaterialSystem();
 	YR_Font_Initialize();
+	PS_Initialize();
+	OCC_Initialize();
 
 	auxCamera = PlgCreateCamera();
 	if ( auxCamera == NULL )
@@ -203,8 +224,13 @@ void YnCore_InitializeRenderer( void )
 void YnCore_ShutdownRenderer( void )
 {
 	Font_Shutdown();
+	YnCore_RenderQueue_Shutdown();
+	YnCore_World_ShutdownStaticObjects();
+	PS_Shutdown();
+	OCC_Shutdown();
 	YnCore_ShutdownMaterialSystem();
 	YnCore_ShutdownRenderTargets();
+	RT_ShutdownTextures();
 }
 
 /**
@@ -279,7 +305,6 @@ void YR_DrawGraph( const char *heading, float x, float y, float w, float h, cons
 	PlgDrawLines( points, numOutPoints, PL_COLOUR_WHITE );
 
 	BitmapFont *font = Font_GetDefaultSmall();
-	Font_BeginDraw( font );
 
 	if ( heading != NULL )
 	{
@@ -307,8 +332,6 @@ void YR_DrawGraph( const char *heading, float x, float y, float w, float h, cons
 	snprintf( buf, sizeof( buf ), "y-:%02f", min );
 	Font_AddBitmapStringToPass( font, x + 2.0f, y + ( h - font->ch ) - 2.0f, 1.0f, outOfBounds ? PL_COLOUR_INDIAN_RED : PL_COLOUR_SEA_GREEN, buf, strlen( buf ), false );
 
-	Font_Draw( font );
-
 	PlFree( points );
 }
 
@@ -377,8 +400,6 @@ static void DrawEditorOverlay( const YNCoreViewport *viewport )
 	if ( defaultFont == NULL )
 		return;
 
-	Font_BeginDraw( defaultFont );
-
 	const char *label;
 	if ( camera != NULL )
 	{
@@ -406,8 +427,6 @@ static void DrawEditorOverlay( const YNCoreViewport *viewport )
 	                            ( float ) ( ( viewport->width - ( defaultFont->cw * 2 ) ) - ( defaultFont->cw * strlen( label ) ) ),
 	                            ( float ) ( viewport->height - ( defaultFont->ch * 2 ) ),
 	                            1.0f, PL_COLOUR_GOLD, label, strlen( label ), true );
-
-	Font_Draw( defaultFont );
 }
 
 static void DrawDebugOverlay( const YNCoreViewport *viewport )
@@ -421,8 +440,6 @@ static void DrawDebugOverlay( const YNCoreViewport *viewport )
 	if ( defaultFont == NULL )
 		return;
 
-	Font_BeginDraw( defaultFont );
-
 	static const float sy = 8;
 	static const float sx = 8;
 	static const float tx = 8 + 4;
@@ -451,10 +468,32 @@ static void DrawDebugOverlay( const YNCoreViewport *viewport )
 	Font_AddBitmapStringToPass( defaultFont, tx, y += defaultFont->ch, 1.0f, PL_COLOUR_GOLD, buf, strlen( buf ), false );
 	snprintf( buf, sizeof( buf ), "Num portals:   " PL_FMT_uint32 "\n", g_gfxPerfStats.numVisiblePortals );
 	Font_AddBitmapStringToPass( defaultFont, tx, y += defaultFont->ch, 1.0f, PL_COLOUR_GOLD, buf, strlen( buf ), false );
+	snprintf( buf, sizeof( buf ), "Num sectors:   " PL_FMT_uint32 "\n", g_gfxPerfStats.numVisibleSectors );
+	Font_AddBitmapStringToPass( defaultFont, tx, y += defaultFont->ch, 1.0f, PL_COLOUR_GOLD, buf, strlen( buf ), false );
+	snprintf( buf, sizeof( buf ), "Occluders:     " PL_FMT_uint32 "\n", g_gfxPerfStats.numOccluderTriangles );
+	Font_AddBitmapStringToPass( defaultFont, tx, y += defaultFont->ch, 1.0f, PL_COLOUR_GOLD, buf, strlen( buf ), false );
+	snprintf( buf, sizeof( buf ), "Occluded:      " PL_FMT_uint32 " faces, " PL_FMT_uint32 " objects\n", g_gfxPerfStats.numOccludedFaces, g_gfxPerfStats.numOccludedObjects );
+	Font_AddBitmapStringToPass( defaultFont, tx, y += defaultFont->ch, 1.0f, PL_COLOUR_GOLD, buf, strlen( buf ), false );
 	snprintf( buf, sizeof( buf ), "Num triangles: " PL_FMT_uint32 "\n", g_gfxPerfStats.numTriangles );
 	Font_AddBitmapStringToPass( defaultFont, tx, y += defaultFont->ch, 1.0f, PL_COLOUR_GOLD, buf, strlen( buf ), false );
 	snprintf( buf, sizeof( buf ), "Num batches:   " PL_FMT_uint32 "\n", g_gfxPerfStats.numBatches );
 	Font_AddBitmapStringToPass( defaultFont, tx, y += defaultFont->ch, 1.0f, PL_COLOUR_GOLD, buf, strlen( buf ), false );
+	snprintf( buf, sizeof( buf ), "Num instances: " PL_FMT_uint32 "\n", g_gfxPerfStats.numInstances );
+	Font_AddBitmapStringToPass( defaultFont, tx, y += defaultFont->ch, 1.0f, PL_COLOUR_GOLD, buf, strlen( buf ), false );
+	snprintf( buf, sizeof( buf ), "State changes: " PL_FMT_uint32 "\n", g_gfxPerfStats.numStateChanges );
+	Font_AddBitmapStringToPass( defaultFont, tx, y += defaultFont->ch, 1.0f, PL_COLOUR_GOLD, buf, strlen( buf ), false );
+	snprintf( buf, sizeof( buf ), "Num commands:  " PL_FMT_uint32 "\n", g_gfxPerfStats.numCommands );
+	Font_AddBitmapStringToPass( defaultFont, tx, y += defaultFont->ch, 1.0f, PL_COLOUR_GOLD, buf, strlen( buf ), false );
+	snprintf( buf, sizeof( buf ), "Num indices:   " PL_FMT_uint32 "\n", g_gfxPerfStats.numIndicesSubmitted );
+	Font_AddBitmapStringToPass( defaultFont, tx, y += defaultFont->ch, 1.0f, PL_COLOUR_GOLD, buf, strlen( buf ), false );
+	snprintf( buf, sizeof( buf ), "Num lights:    " PL_FMT_uint32 "\n", g_gfxPerfStats.numLightsSubmitted );
+	Font_AddBitmapStringToPass( defaultFont, tx, y += defaultFont->ch, 1.0f, PL_COLOUR_GOLD, buf, strlen( buf ), false );
+	snprintf( buf, sizeof( buf ), "Uniform gets:  " PL_FMT_uint32 "\n", g_gfxPerfStats.numUniformLookups );
+	Font_AddBitmapStringToPass( defaultFont, tx, y += defaultFont->ch, 1.0f, PL_COLOUR_GOLD, buf, strlen( buf ), false );
+	snprintf( buf, sizeof( buf ), "Uniform sets:  " PL_FMT_uint32 "\n", g_gfxPerfStats.numUniformUploads );
+	Font_AddBitmapStringToPass( defaultFont, tx, y += defaultFont->ch, 1.0f, PL_COLOUR_GOLD, buf, strlen( buf ), false );
+	snprintf( buf, sizeof( buf ), "Uploaded:      %.2lfKB\n", ( double ) g_gfxPerfStats.numBytesUploaded / 1024.0 );
+	Font_AddBitmapStringToPass( defaultFont, tx, y += defaultFont->ch, 1.0f, PL_COLOUR_GOLD, buf, strlen( buf ), false );
 	snprintf( buf, sizeof( buf ), "Alloc memory:  %.2lfMB\n", PlBytesToMegabytes( PlGetTotalAllocatedMemory() ) );
 	Font_AddBitmapStringToPass( defaultFont, tx, y += defaultFont->ch, 1.0f, PL_COLOUR_ORCHID, buf, strlen( buf ), false );
 	snprintf( buf, sizeof( buf ), "Total memory:  %.2lfMB\n", PlBytesToMegabytes( PlGetCurrentMemoryUsage() ) );
@@ -479,7 +518,8 @@ static void DrawDebugOverlay( const YNCoreViewport *viewport )
 	PlgDrawRectangle( sx, sy, bw, y - sy, PLColour( 0, 0, 0, 200 ) );
 	PlgSetBlendMode( PLG_BLEND_DISABLE );
 
-	Font_Draw( defaultFont );
+	/* text goes over the top of the backdrop */
+	Font_FlushBatches();
 
 	if ( debugOverlay->i_value > 1 )
 	{
@@ -499,6 +539,8 @@ static void DrawDebugOverlay( const YNCoreViewport *viewport )
 			YR_DrawGraph( cpuProfilerDescriptions[ i ], x, y, bw, graphHeight, graph, numPoints, .0f, 1.0f );
 			y += graphHeight;
 		}
+
+		Font_FlushBatches();
 	}
 }
 
@@ -535,11 +577,16 @@ void YnCore_DrawMenu( const YNCoreViewport *viewport )
 
 	YnCore_DrawGUI( viewport );
 
+	/* anything written by the gui goes beneath the overlays */
+	Font_FlushBatches();
+
 	if ( viewport != NULL )
 		DrawEditorOverlay( viewport );
 
 	DrawDebugOverlay( viewport );
 
+	Font_FlushBatches();
+
 	PlgSetTexture( NULL, 0 );
 
 	PlPopMatrix();
@@ -682,6 +729,8 @@ void YR_DrawScene( YNCoreCamera *camera, const YNCoreViewport *viewport )
 	if ( ( camera != NULL && camera->drawMode == YN_CORE_CAMERA_DRAW_MODE_WIREFRAME ) || wireframeMode->b_value )
 		PlgEnableGraphicsState( PLG_GFX_STATE_WIREFRAME );
 
+	YnCore_Material_UpdateFrameParameters();
+
 	YR_RenderScene( camera, viewport );
 
 	if ( ( camera != NULL && camera->drawMode == YN_CORE_CAMERA_DRAW_MODE_WIREFRAME ) || wireframeMode->b_value )
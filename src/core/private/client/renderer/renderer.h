@@ -16,9 +16,21 @@ typedef struct YNCoreRendererStats
 {
 	PLVector3 cameraPos;
 	unsigned int numBatches;
+	unsigned int numInstances;
 	unsigned int numTriangles;
 	unsigned int numFacesDrawn;
 	unsigned int numVisiblePortals;
+	unsigned int numVisibleSectors;
+	unsigned int numOccluderTriangles;
+	unsigned int numOccludedFaces;
+	unsigned int numOccludedObjects;
+	unsigned int numIndicesSubmitted;
+	unsigned int numLightsSubmitted; /* summed over each submission */
+	unsigned int numUniformLookups;
+	unsigned int numUniformUploads;
+	unsigned int numStateChanges;
+	unsigned int numCommands;
+	size_t numBytesUploaded;
 } YNCoreRendererStats;
 extern YNCoreRendererStats g_gfxPerfStats;
 
@@ -80,7 +92,6 @@ typedef enum YNCoreLightType
 	YN_CORE_MAX_LIGHT_TYPES
 } YNCoreLightType;
 
-#define YN_CORE_MAX_LIGHTS_PER_PASS 8
 typedef struct YNCoreLight
 {
 	YNCoreLightType type;
@@ -101,7 +112,9 @@ extern YNCoreRendererPassState rendererState;
 #define YR_NUM_SPRITE_ANGLES 8
 
 #include "renderer_scenegraph.h"
+#include "renderer_commands.h"
 #include "renderer_material.h"
+#include "renderer_queue.h"
 
 void YnCore_InitializeRenderer( void );
 void YnCore_ShutdownRenderer( void );
@@ -125,10 +138,15 @@ void YnCore_DrawPerspective( YNCoreCamera *camera, const YNCoreViewport *viewpor
 void YnCore_Draw2DQuad( YNCoreMaterial *material, int x, int y, int w, int h );
 void YnCore_DrawAxesPivot( PLVector3 position, PLVector3 rotation );
 
+void YnCore_World_ShutdownStaticObjects( void );                      /* renderer_world.c */
+void YnCore_World_BenchmarkCommand( unsigned int argc, char **argv ); /* renderer_world.c */
+
 void YnCore_Sprite_DrawAnimationFrame( YNCoreSpriteFrame *frame, const PLVector3 *position, float spriteAngle );
 void YnCore_Sprite_DrawAnimation( YNCoreSpriteFrame **animation, unsigned int numFrames, unsigned int curFrame, const PLVector3 *position, float angle );
 
 PLGTexture *YnCore_LoadTexture( const char *path, PLGTextureFilter filterMode );
+PLGTexture *YnCore_LoadTextureAsync( const char *path, PLGTextureFilter filterMode );
+void        YnCore_Texture_UpdateLoads( void );
 PLGTexture *YnCore_GetFallbackTexture( void );
 
 #if 0
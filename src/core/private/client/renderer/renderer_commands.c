@@ -0,0 +1,271 @@
+// SPDX-License-Identifier: LGPL-3.0-or-later
+// Copyright © 2020-2023 OldTimes Software, Mark E Sowden <hogsy@oldtimes-software.com>
+
+#include "core_private.h"
+#include "renderer.h"
+#include "renderer_commands.h"
+
+static bool nullBackendEnabled;
+static bool wasNullBackendEnabled;
+
+static YNCoreCommandStats nullStats;
+
+void YnCore_CommandBuffer_RegisterConsoleVariables( void )
+{
+	PlRegisterConsoleVariable( "r.nullBackend", "Replay draws into a backend that only validates and counts them.", "0", PL_VAR_BOOL, &nullBackendEnabled, NULL, false );
+}
+
+/****************************************
+ * RECORDING
+ ****************************************/
+
+void YnCore_CommandBuffer_Reset( YNCoreCommandBuffer *buffer )
+{
+	buffer->numCommands = 0;
+	buffer->dataSize    = 0;
+}
+
+void YnCore_CommandBuffer_Destroy( YNCoreCommandBuffer *buffer )
+{
+	PL_DELETE( buffer->commands );
+	PL_DELETE( buffer->data );
+	PL_ZERO( buffer, sizeof( YNCoreCommandBuffer ) );
+}
+
+static YNCoreRenderCommand *PushCommand( YNCoreCommandBuffer *buffer, YNCoreRenderCommandType type )
+{
+	if ( buffer->numCommands == buffer->maxCommands )
+	{
+		buffer->maxCommands = ( buffer->maxCommands > 0 ) ? buffer->maxCommands * 2 : 256;
+		buffer->commands    = PlReAlloc( buffer->commands, sizeof( YNCoreRenderCommand ) * buffer->maxCommands, true );
+	}
+
+	YNCoreRenderCommand *command = &buffer->commands[ buffer->numCommands++ ];
+	command->type                = ( uint8_t ) type;
+	return command;
+}
+
+void YnCore_CommandBuffer_BindProgram( YNCoreCommandBuffer *buffer, PLGShaderProgram *program )
+{
+	PushCommand( buffer, YN_CORE_RENDER_COMMAND_BIND_PROGRAM )->args.program = program;
+}
+
+void YnCore_CommandBuffer_BindBlendMode( YNCoreCommandBuffer *buffer, PLGBlend a, PLGBlend b )
+{
+	YNCoreRenderCommand *command = PushCommand( buffer, YN_CORE_RENDER_COMMAND_BIND_BLEND_MODE );
+	command->args.blendMode[ 0 ] = ( uint8_t ) a;
+	command->args.blendMode[ 1 ] = ( uint8_t ) b;
+}
+
+void YnCore_CommandBuffer_BindCullMode( YNCoreCommandBuffer *buffer, PLGCullMode cullMode )
+{
+	PushCommand( buffer, YN_CORE_RENDER_COMMAND_BIND_CULL_MODE )->args.cullMode = ( uint8_t ) cullMode;
+}
+
+void YnCore_CommandBuffer_BindTexture( YNCoreCommandBuffer *buffer, PLGTexture *texture, unsigned int unit, int filter )
+{
+	YNCoreRenderCommand *command  = PushCommand( buffer, YN_CORE_RENDER_COMMAND_BIND_TEXTURE );
+	command->args.texture.texture = texture;
+	command->args.texture.unit    = ( uint8_t ) unit;
+	command->args.texture.filter  = ( int8_t ) filter;
+}
+
+/**
+ * Copies the given data into the buffer, so whatever it came
+ * from doesn't need to stick around, and returns where it went.
+ */
+static size_t PushData( YNCoreCommandBuffer *buffer, const void *data, size_t size )
+{
+	/* keep everything aligned, as matrices get handed straight back out */
+	size_t offset = ( buffer->dataSize + 15 ) & ~( size_t ) 15;
+	if ( offset + size > buffer->maxDataSize )
+	{
+		while ( offset + size > buffer->maxDataSize )
+			buffer->maxDataSize = ( buffer->maxDataSize > 0 ) ? buffer->maxDataSize * 2 : 4096;
+
+		buffer->data = PlReAlloc( buffer->data, buffer->maxDataSize, true );
+	}
+
+	memcpy( &buffer->data[ offset ], data, size );
+	buffer->dataSize = offset + size;
+
+	return offset;
+}
+
+void YnCore_CommandBuffer_SetUniform( YNCoreCommandBuffer *buffer, PLGShaderProgram *program, int slot, const void *value, size_t size, bool transpose )
+{
+	size_t offset = PushData( buffer, value, size );
+
+	YNCoreRenderCommand *command    = PushCommand( buffer, YN_CORE_RENDER_COMMAND_SET_UNIFORM );
+	command->args.uniform.program   = program;
+	command->args.uniform.slot      = ( int16_t ) slot;
+	command->args.uniform.size      = ( uint16_t ) size;
+	command->args.uniform.offset    = ( uint32_t ) offset;
+	command->args.uniform.transpose = transpose;
+}
+
+void YnCore_CommandBuffer_DrawMesh( YNCoreCommandBuffer *buffer, PLGMesh *mesh )
+{
+	PushCommand( buffer, YN_CORE_RENDER_COMMAND_DRAW_MESH )->args.mesh = mesh;
+}
+
+/**
+ * Draws the mesh once for each of the given transforms, which are
+ * handed to the program through the given (model matrix) slot.
+ */
+void YnCore_CommandBuffer_DrawMeshInstanced( YNCoreCommandBuffer *buffer, PLGMesh *mesh, PLGShaderProgram *program, int slot, const PLMatrix4 *transforms, unsigned int numInstances )
+{
+	size_t offset = PushData( buffer, transforms, sizeof( PLMatrix4 ) * numInstances );
+
+	YNCoreRenderCommand *command         = PushCommand( buffer, YN_CORE_RENDER_COMMAND_DRAW_MESH_INSTANCED );
+	command->args.instanced.mesh         = mesh;
+	command->args.instanced.program      = program;
+	command->args.instanced.slot         = ( int16_t ) slot;
+	command->args.instanced.offset       = ( uint32_t ) offset;
+	command->args.instanced.numInstances = numInstances;
+}
+
+/****************************************
+ * BACKENDS
+ ****************************************/
+
+static void ReplayGraphicsCommands( const YNCoreCommandBuffer *buffer )
+{
+	for ( unsigned int i = 0; i < buffer->numCommands; ++i )
+	{
+		const YNCoreRenderCommand *command = &buffer->commands[ i ];
+		switch ( command->type )
+		{
+			case YN_CORE_RENDER_COMMAND_BIND_PROGRAM:
+				PlgSetShaderProgram( command->args.program );
+				break;
+			case YN_CORE_RENDER_COMMAND_BIND_BLEND_MODE:
+				PlgSetBlendMode( ( PLGBlend ) command->args.blendMode[ 0 ], ( PLGBlend ) command->args.blendMode[ 1 ] );
+				break;
+			case YN_CORE_RENDER_COMMAND_BIND_CULL_MODE:
+				PlgSetCullMode( ( PLGCullMode ) command->args.cullMode );
+				break;
+			case YN_CORE_RENDER_COMMAND_BIND_TEXTURE:
+				PlgSetTexture( command->args.texture.texture, command->args.texture.unit );
+				if ( command->args.texture.filter >= 0 )
+					PlgSetTextureFilter( command->args.texture.texture, ( PLGTextureFilter ) command->args.texture.filter );
+				break;
+			case YN_CORE_RENDER_COMMAND_SET_UNIFORM:
+				PlgSetShaderUniformValueByIndex( command->args.uniform.program, command->args.uniform.slot,
+				                                 &buffer->data[ command->args.uniform.offset ], command->args.uniform.transpose );
+				break;
+			case YN_CORE_RENDER_COMMAND_DRAW_MESH:
+				PlgUploadMesh( command->args.mesh );
+				PlgDrawMesh( command->args.mesh );
+				break;
+			case YN_CORE_RENDER_COMMAND_DRAW_MESH_INSTANCED:
+			{
+				/* plgraphics has no instanced draw for us to hand this to
+				 * yet, so for now it's expanded out here; that still spares
+				 * everything leading up to the draw for each instance */
+				const PLMatrix4 *transforms = ( const PLMatrix4 * ) &buffer->data[ command->args.instanced.offset ];
+				PlgUploadMesh( command->args.instanced.mesh );
+				for ( unsigned int j = 0; j < command->args.instanced.numInstances; ++j )
+				{
+					PlgSetShaderUniformValueByIndex( command->args.instanced.program, command->args.instanced.slot, &transforms[ j ], true );
+					PlgDrawMesh( command->args.instanced.mesh );
+				}
+				break;
+			}
+			default:
+				break;
+		}
+	}
+}
+
+/**
+ * Checks each command makes sense given what came before it,
+ * without ever touching the graphics library.
+ */
+static void ReplayNullCommands( const YNCoreCommandBuffer *buffer )
+{
+	const PLGShaderProgram *boundProgram = NULL;
+	for ( unsigned int i = 0; i < buffer->numCommands; ++i )
+	{
+		const YNCoreRenderCommand *command = &buffer->commands[ i ];
+		if ( command->type >= YN_CORE_MAX_RENDER_COMMANDS )
+		{
+			nullStats.numInvalidCommands++;
+			continue;
+		}
+
+		nullStats.numCommands[ command->type ]++;
+		nullStats.numBytes += sizeof( YNCoreRenderCommand );
+
+		bool isValid = true;
+		switch ( command->type )
+		{
+			case YN_CORE_RENDER_COMMAND_BIND_PROGRAM:
+				boundProgram = command->args.program;
+				isValid      = ( boundProgram != NULL );
+				break;
+			case YN_CORE_RENDER_COMMAND_BIND_BLEND_MODE:
+				isValid = ( command->args.blendMode[ 0 ] < PLG_MAX_BLEND_MODES && command->args.blendMode[ 1 ] < PLG_MAX_BLEND_MODES );
+				break;
+			case YN_CORE_RENDER_COMMAND_SET_UNIFORM:
+				nullStats.numBytes += command->args.uniform.size;
+				isValid = ( command->args.uniform.program != NULL && command->args.uniform.slot >= 0 && command->args.uniform.size > 0 &&
+				            command->args.uniform.offset + command->args.uniform.size <= buffer->dataSize );
+				break;
+			case YN_CORE_RENDER_COMMAND_DRAW_MESH:
+				isValid = ( boundProgram != NULL && command->args.mesh != NULL && command->args.mesh->num_verts > 0 );
+				nullStats.numDraws++;
+				break;
+			case YN_CORE_RENDER_COMMAND_DRAW_MESH_INSTANCED:
+				nullStats.numBytes += sizeof( PLMatrix4 ) * command->args.instanced.numInstances;
+				/* the real backend expands these into a draw per instance */
+				nullStats.numDraws += command->args.instanced.numInstances;
+				isValid = ( boundProgram != NULL && command->args.instanced.program == boundProgram && command->args.instanced.slot >= 0 &&
+				            command->args.instanced.mesh != NULL && command->args.instanced.mesh->num_verts > 0 && command->args.instanced.numInstances > 0 &&
+				            command->args.instanced.offset + sizeof( PLMatrix4 ) * command->args.instanced.numInstances <= buffer->dataSize );
+				break;
+			default:
+				break;
+		}
+
+		if ( !isValid )
+			nullStats.numInvalidCommands++;
+	}
+}
+
+void YnCore_CommandBuffer_Submit( const YNCoreCommandBuffer *buffer )
+{
+	/* uniforms given to one backend never made it to the other */
+	if ( nullBackendEnabled != wasNullBackendEnabled )
+	{
+		wasNullBackendEnabled = nullBackendEnabled;
+		YnCore_Material_ResetSharedUniforms();
+	}
+
+	g_gfxPerfStats.numCommands += buffer->numCommands;
+
+	if ( nullBackendEnabled )
+		ReplayNullCommands( buffer );
+	else
+		ReplayGraphicsCommands( buffer );
+}
+
+/**
+ * Switches to/from the null backend, returning whether it was enabled before.
+ */
+bool YnCore_CommandBuffer_SetNullBackend( bool enable )
+{
+	bool wasEnabled    = nullBackendEnabled;
+	nullBackendEnabled = enable;
+	return wasEnabled;
+}
+
+void YnCore_CommandBuffer_GetNullStats( YNCoreCommandStats *stats )
+{
+	*stats = nullStats;
+}
+
+void YnCore_CommandBuffer_ResetNullStats( void )
+{
+	PL_ZERO_( nullStats );
+}
@@ -0,0 +1,101 @@
+// SPDX-License-Identifier: LGPL-3.0-or-later
+// Copyright © 2020-2023 OldTimes Software, Mark E Sowden <hogsy@oldtimes-software.com>
+
+#pragma once
+
+/**
+ * Draws are recorded into a command buffer, which is then replayed by
+ * a backend; either the graphics library, or a null backend that only
+ * validates and counts what it's given, so the cost of producing a frame
+ * can be measured without a graphics context.
+ *
+ * Only one buffer can be recorded at a time, and only from the main
+ * thread; materials record into whichever buffer was given to
+ * YnCore_Material_BeginRecording, and track what's bound and which
+ * shared uniforms each program has been given in global state.
+ */
+
+typedef enum YNCoreRenderCommandType
+{
+	YN_CORE_RENDER_COMMAND_BIND_PROGRAM,
+	YN_CORE_RENDER_COMMAND_BIND_BLEND_MODE,
+	YN_CORE_RENDER_COMMAND_BIND_CULL_MODE,
+	YN_CORE_RENDER_COMMAND_BIND_TEXTURE,
+	YN_CORE_RENDER_COMMAND_SET_UNIFORM,
+	YN_CORE_RENDER_COMMAND_DRAW_MESH,
+	YN_CORE_RENDER_COMMAND_DRAW_MESH_INSTANCED,
+
+	YN_CORE_MAX_RENDER_COMMANDS
+} YNCoreRenderCommandType;
+
+typedef struct YNCoreRenderCommand
+{
+	uint8_t type;
+	union
+	{
+		PLGShaderProgram *program;
+		PLGMesh          *mesh;
+		uint8_t           blendMode[ 2 ];
+		uint8_t           cullMode;
+		struct
+		{
+			PLGTexture *texture;
+			uint8_t     unit;
+			int8_t      filter; /* -1 if it's left alone */
+		} texture;
+		struct
+		{
+			PLGShaderProgram *program;
+			int16_t           slot;
+			uint16_t          size;
+			uint32_t          offset; /* into the buffer's data */
+			bool              transpose;
+		} uniform;
+		struct
+		{
+			PLGMesh          *mesh;
+			PLGShaderProgram *program;
+			int16_t           slot;   /* model matrix */
+			uint32_t          offset; /* transforms in the buffer's data */
+			uint32_t          numInstances;
+		} instanced;
+	} args;
+} YNCoreRenderCommand;
+
+typedef struct YNCoreCommandBuffer
+{
+	YNCoreRenderCommand *commands;
+	unsigned int         numCommands;
+	unsigned int         maxCommands;
+
+	uint8_t *data;
+	size_t   dataSize;
+	size_t   maxDataSize;
+} YNCoreCommandBuffer;
+
+typedef struct YNCoreCommandStats
+{
+	unsigned int numCommands[ YN_CORE_MAX_RENDER_COMMANDS ];
+	unsigned int numInvalidCommands;
+	unsigned int numDraws; /* as the real backend makes them, so once per instance */
+	size_t       numBytes;
+} YNCoreCommandStats;
+
+void YnCore_CommandBuffer_RegisterConsoleVariables( void );
+
+void YnCore_CommandBuffer_Reset( YNCoreCommandBuffer *buffer );
+void YnCore_CommandBuffer_Destroy( YNCoreCommandBuffer *buffer );
+
+void YnCore_CommandBuffer_BindProgram( YNCoreCommandBuffer *buffer, PLGShaderProgram *program );
+void YnCore_CommandBuffer_BindBlendMode( YNCoreCommandBuffer *buffer, PLGBlend a, PLGBlend b );
+void YnCore_CommandBuffer_BindCullMode( YNCoreCommandBuffer *buffer, PLGCullMode cullMode );
+void YnCore_CommandBuffer_BindTexture( YNCoreCommandBuffer *buffer, PLGTexture *texture, unsigned int unit, int filter );
+void YnCore_CommandBuffer_SetUniform( YNCoreCommandBuffer *buffer, PLGShaderProgram *program, int slot, const void *value, size_t size, bool transpose );
+void YnCore_CommandBuffer_DrawMesh( YNCoreCommandBuffer *buffer, PLGMesh *mesh );
+void YnCore_CommandBuffer_DrawMeshInstanced( YNCoreCommandBuffer *buffer, PLGMesh *mesh, PLGShaderProgram *program, int slot, const PLMatrix4 *transforms, unsigned int numInstances );
+
+void YnCore_CommandBuffer_Submit( const YNCoreCommandBuffer *buffer );
+
+bool YnCore_CommandBuffer_SetNullBackend( bool enable );
+void YnCore_CommandBuffer_GetNullStats( YNCoreCommandStats *stats );
+void YnCore_CommandBuffer_ResetNullStats( void );
@@ -7,42 +7,39 @@
 
 static BitmapFont *defaultFont, *defaultFontSmall;
 
-void Font_AddBitmapCharacterToPass( const BitmapFont *font, float x, float y, float scale, PLColour colour, uint8_t character )
-{
-	int row = ( character - font->start ) / ( font->w / font->cw );
-	int col = ( character - font->start ) % ( font->w / font->cw );
+static PLConsoleVariable *batchTextVar;
+static bool               forceUnbatched; /* for comparison while benchmarking */
 
-	int cX = col * font->cw;
-	int cY = row * font->ch;
+#define FONT_MAX_BATCH_GLYPHS 4096
 
-	/* figure out the correct coords we need in the font sheet */
-	float tw = ( float ) font->cw / ( float ) font->w;
-	float th = ( float ) font->ch / ( float ) font->h;
-	float tx = ( float ) cX / ( float ) font->w;
-	float ty = ( float ) cY / ( float ) font->h;
+/****************************************
+ * GLYPHS
+ ****************************************/
 
-	unsigned int vX = PlgAddMeshVertex( font->mesh, PLVector3( x, y, 0 ), pl_vecOrigin3, colour, PLVector2( tx, ty ) );
-	unsigned int vY = PlgAddMeshVertex( font->mesh, PLVector3( x, y + ( ( float ) font->ch * scale ), 0 ), pl_vecOrigin3, colour, PLVector2( tx, ty + th ) );
-	unsigned int vZ = PlgAddMeshVertex( font->mesh, PLVector3( x + ( ( float ) font->cw * scale ), y, 0 ), pl_vecOrigin3, colour, PLVector2( tx + tw, ty ) );
-	unsigned int vW = PlgAddMeshVertex( font->mesh, PLVector3( x + ( ( float ) font->cw * scale ), y + ( ( float ) font->ch * scale ), 0 ), pl_vecOrigin3, colour, PLVector2( tx + tw, ty + th ) );
-
-	PlgAddMeshTriangle( font->mesh, vX, vY, vZ );
-	PlgAddMeshTriangle( font->mesh, vZ, vY, vW );
-}
+/* only what can't be worked out again cheaply is kept for each glyph;
+ * the rest comes from the run it's in and the font's own tables */
+typedef struct FontGlyph
+{
+	float   x, y; /* relative to wherever the run starts */
+	uint8_t character;
+} FontGlyph;
 
-void Font_AddBitmapStringToPass( const BitmapFont *font, float x, float y, float scale, PLColour colour, const char *msg, size_t length, bool shadow )
+/**
+ * Lays a string out into glyphs, starting from 0,0. Returns how many
+ * were written, which is never more than the length.
+ */
+static unsigned int Font_LayoutString( const BitmapFont *font, float scale, const char *msg, size_t length, FontGlyph *out )
 {
-	if ( length == 0 )
-		return;
+	unsigned int numGlyphs = 0;
 
-	float n_x = x;
-	float n_y = y;
+	float n_x = 0.0f;
+	float n_y = 0.0f;
 	for ( size_t i = 0; i < length; ++i )
 	{
 		if ( msg[ i ] == '\n' )
 		{
 			n_y += ( font->ch * scale );
-			n_x = x;
+			n_x = 0.0f;
 			continue;
 		}
 		else if ( msg[ i ] == '\t' )
@@ -51,36 +48,297 @@ void Font_AddBitmapStringToPass( const BitmapFont *font, float x, float y, float
 			continue;
 		}
 
-		if ( shadow )
-			Font_AddBitmapCharacterToPass( font, n_x + 1, n_y + 1, scale, PLColourRGB( 0, 0, 0 ), ( uint8_t ) msg[ i ] );
+		/* anything the sheet doesn't have is left as a gap */
+		uint8_t character = ( uint8_t ) msg[ i ];
+		if ( character < font->start || character >= font->end )
+		{
+			n_x += ( font->cw * scale );
+			continue;
+		}
 
-		Font_AddBitmapCharacterToPass( font, n_x, n_y, scale, colour, ( uint8_t ) msg[ i ] );
+		FontGlyph *glyph = &out[ numGlyphs++ ];
+		glyph->x         = n_x;
+		glyph->y         = n_y;
+		glyph->character = character;
 
 		n_x += ( font->cw * scale );
 	}
+
+	return numGlyphs;
+}
+
+/****************************************
+ * RUN CACHE
+ ****************************************/
+
+/* Strings that have been laid out before are found through an
+ * open-addressed table, keyed on everything that went into the layout,
+ * so most text is only laid out the first time it's drawn. Runs that
+ * haven't been used since the last sweep are dropped when it fills up. */
+
+typedef struct FontTextRun
+{
+	uint32_t          hash;
+	const BitmapFont *font;
+	float             scale;
+	PLColour          colour;
+	bool              shadow;
+	bool              isCached; /* otherwise it's freed once drawn */
+	bool              used;
+	size_t            length;
+	unsigned int      numGlyphs;
+	FontGlyph        *glyphs;
+	char              text[]; /* not terminated */
+} FontTextRun;
+
+#define FONT_RUN_CACHE_MIN_RUNS 1024
+
+static struct
+{
+	FontTextRun **runs;
+	unsigned int  numRuns;
+	unsigned int  maxRuns; /* always a power of two */
+} runCache;
+
+static uint32_t Font_HashRun( const BitmapFont *font, float scale, PLColour colour, bool shadow, const char *msg, size_t length )
+{
+	uint32_t hash = 2166136261u;
+	for ( size_t i = 0; i < length; ++i )
+	{
+		hash ^= ( unsigned char ) msg[ i ];
+		hash *= 16777619u;
+	}
+
+	uint32_t scaleBits;
+	memcpy( &scaleBits, &scale, sizeof( scaleBits ) );
+
+	hash ^= ( uint32_t ) ( ( uintptr_t ) font >> 4 );
+	hash *= 16777619u;
+	hash ^= scaleBits;
+	hash *= 16777619u;
+	hash ^= ( uint32_t ) colour.r | ( ( uint32_t ) colour.g << 8 ) | ( ( uint32_t ) colour.b << 16 ) | ( ( uint32_t ) colour.a << 24 );
+	hash *= 16777619u;
+	hash ^= shadow;
+
+	return hash;
+}
+
+static FontTextRun *Font_CreateRun( const BitmapFont *font, float scale, PLColour colour, bool shadow, const char *msg, size_t length )
+{
+	/* the glyphs go in the same allocation, straight after the text */
+	size_t       glyphOffset = ( sizeof( FontTextRun ) + length + sizeof( FontGlyph ) - 1 ) / sizeof( FontGlyph ) * sizeof( FontGlyph );
+	FontTextRun *run         = PlMAlloc( glyphOffset + sizeof( FontGlyph ) * length, true );
+	run->font                = font;
+	run->scale               = scale;
+	run->colour              = colour;
+	run->shadow              = shadow;
+	run->length              = length;
+	run->glyphs              = ( FontGlyph * ) ( ( uint8_t * ) run + glyphOffset );
+	run->numGlyphs           = Font_LayoutString( font, scale, msg, length, run->glyphs );
+	memcpy( run->text, msg, length );
+
+	return run;
+}
+
+static void Font_InsertRun( FontTextRun *run )
+{
+	unsigned int mask = runCache.maxRuns - 1;
+	unsigned int slot = run->hash & mask;
+	while ( runCache.runs[ slot ] != NULL )
+		slot = ( slot + 1 ) & mask;
+
+	runCache.runs[ slot ] = run;
+	runCache.numRuns++;
 }
 
 /**
- * Draw a single bitmap character at the specified coordinates.
+ * Rebuilds the table, dropping either every run belonging to the given
+ * font, or every run that hasn't been used since the last sweep. It
+ * doubles in size if what's left would still leave it too full.
  */
-void Font_DrawBitmapCharacter( BitmapFont *font, float x, float y, float scale, PLColour colour, char character )
+static void Font_SweepRuns( const BitmapFont *dropFont )
 {
-	if ( scale <= 0 )
+	FontTextRun **oldRuns    = runCache.runs;
+	unsigned int  oldMaxRuns = runCache.maxRuns;
+
+	unsigned int numKept = 0;
+	for ( unsigned int i = 0; i < oldMaxRuns; ++i )
+	{
+		FontTextRun *run = oldRuns[ i ];
+		if ( run == NULL )
+			continue;
+
+		if ( ( dropFont != NULL ) ? ( run->font == dropFont ) : !run->used )
+		{
+			PL_DELETE( run );
+			oldRuns[ i ] = NULL;
+			continue;
+		}
+
+		if ( dropFont == NULL )
+			run->used = false;
+
+		numKept++;
+	}
+
+	unsigned int maxRuns = ( oldMaxRuns == 0 ) ? FONT_RUN_CACHE_MIN_RUNS : oldMaxRuns;
+	while ( ( numKept + 1 ) * 2 > maxRuns )
+		maxRuns *= 2;
+
+	runCache.runs    = PL_NEW_( FontTextRun *, maxRuns );
+	runCache.maxRuns = maxRuns;
+	runCache.numRuns = 0;
+
+	for ( unsigned int i = 0; i < oldMaxRuns; ++i )
+	{
+		if ( oldRuns[ i ] != NULL )
+			Font_InsertRun( oldRuns[ i ] );
+	}
+
+	PL_DELETE( oldRuns );
+}
+
+static void Font_ClearRuns( void )
+{
+	for ( unsigned int i = 0; i < runCache.maxRuns; ++i )
+		PL_DELETE( runCache.runs[ i ] );
+
+	PL_DELETE( runCache.runs );
+	PL_ZERO_( runCache );
+}
+
+static FontTextRun *Font_GetRun( const BitmapFont *font, float scale, PLColour colour, bool shadow, const char *msg, size_t length )
+{
+	uint32_t hash = Font_HashRun( font, scale, colour, shadow, msg, length );
+	if ( runCache.maxRuns > 0 )
+	{
+		unsigned int mask = runCache.maxRuns - 1;
+		for ( unsigned int slot = hash & mask; runCache.runs[ slot ] != NULL; slot = ( slot + 1 ) & mask )
+		{
+			FontTextRun *run = runCache.runs[ slot ];
+			if ( run->hash != hash || run->font != font || run->length != length || run->shadow != shadow || run->scale != scale ||
+			     memcmp( &run->colour, &colour, sizeof( PLColour ) ) != 0 || memcmp( run->text, msg, length ) != 0 )
+				continue;
+
+			run->used = true;
+			return run;
+		}
+	}
+
+	/* keep it under three quarters full; anything still waiting to be
+	 * drawn goes first, so the sweep can't pull a run out from under it */
+	if ( ( runCache.numRuns + 1 ) * 4 > runCache.maxRuns * 3 )
+	{
+		Font_FlushBatches();
+		Font_SweepRuns( NULL );
+	}
+
+	FontTextRun *run = Font_CreateRun( font, scale, colour, shadow, msg, length );
+	run->hash        = hash;
+	run->isCached    = true;
+	run->used        = true;
+
+	Font_InsertRun( run );
+
+	return run;
+}
+
+/****************************************
+ * BATCHING
+ ****************************************/
+
+typedef struct FontBatchRun
+{
+	FontTextRun *run;
+	float        x, y;
+} FontBatchRun;
+
+static BitmapFont  **queuedFonts;
+static unsigned int  numQueuedFonts;
+static unsigned int  maxQueuedFonts;
+
+static bool Font_IsBatching( void )
+{
+	return !forceUnbatched && ( batchTextVar == NULL || batchTextVar->b_value );
+}
+
+static void Font_QueueRun( BitmapFont *font, FontTextRun *run, float x, float y )
+{
+	if ( font->numBatchRuns >= font->maxBatchRuns )
+	{
+		font->maxBatchRuns = ( font->maxBatchRuns == 0 ) ? 64 : font->maxBatchRuns * 2;
+		font->batchRuns    = PlReAlloc( font->batchRuns, sizeof( FontBatchRun ) * font->maxBatchRuns, true );
+	}
+
+	FontBatchRun *batchRun = &font->batchRuns[ font->numBatchRuns++ ];
+	batchRun->run          = run;
+	batchRun->x            = x;
+	batchRun->y            = y;
+
+	if ( font->isQueued )
 		return;
 
-	int w, h;
-	PlgGetViewport( NULL, NULL, &w, &h );
+	if ( numQueuedFonts >= maxQueuedFonts )
+	{
+		maxQueuedFonts = ( maxQueuedFonts == 0 ) ? 4 : maxQueuedFonts * 2;
+		queuedFonts    = PlReAlloc( queuedFonts, sizeof( BitmapFont * ) * maxQueuedFonts, true );
+	}
 
-	float dw = ( float ) w;
-	float dh = ( float ) h;
-	if ( x > dw || y > dh )
+	queuedFonts[ numQueuedFonts++ ] = font;
+	font->isQueued                  = true;
+}
+
+/**
+ * Drops anything queued for the font without drawing it.
+ */
+static void Font_DiscardBatch( BitmapFont *font )
+{
+	for ( unsigned int i = 0; i < font->numBatchRuns; ++i )
+	{
+		if ( !font->batchRuns[ i ].run->isCached )
+			PL_DELETE( font->batchRuns[ i ].run );
+	}
+
+	font->numBatchRuns = 0;
+
+	if ( !font->isQueued )
 		return;
 
-	/* setup our render pass */
+	for ( unsigned int i = 0; i < numQueuedFonts; ++i )
+	{
+		if ( queuedFonts[ i ] != font )
+			continue;
+
+		memmove( &queuedFonts[ i ], &queuedFonts[ i + 1 ], sizeof( BitmapFont * ) * ( numQueuedFonts - i - 1 ) );
+		numQueuedFonts--;
+		break;
+	}
 
-	Font_BeginDraw( font );
+	font->isQueued = false;
+}
 
-	Font_AddBitmapCharacterToPass( font, x, y, scale, colour, character );
+/**
+ * Draws however many glyphs have been written into the font's mesh.
+ * The triangles only depend on how many quads there are, so they're
+ * left alone unless that changes.
+ */
+static void Font_DrawMesh( BitmapFont *font, unsigned int numGlyphs )
+{
+	if ( numGlyphs == 0 )
+		return;
+
+	if ( font->mesh->num_triangles > numGlyphs * 2 )
+		PlgClearMeshTriangles( font->mesh );
+
+	for ( unsigned int i = font->mesh->num_triangles / 2; i < numGlyphs; ++i )
+	{
+		unsigned int v = i * 4;
+		PlgAddMeshTriangle( font->mesh, v, v + 1, v + 2 );
+		PlgAddMeshTriangle( font->mesh, v + 2, v + 1, v + 3 );
+	}
+
+	font->mesh->num_verts = numGlyphs * 4;
+	font->mesh->isDirty   = true;
 
 	PlMatrixMode( PL_MODELVIEW_MATRIX );
 	PlPushMatrix();
@@ -92,40 +350,135 @@ void Font_DrawBitmapCharacter( BitmapFont *font, float x, float y, float scale,
 	PlPopMatrix();
 }
 
-void Font_DrawBitmapString( BitmapFont *font, float x, float y, float spacing, float scale, PLColour colour, const char *msg, bool shadow )
+static PLGVertex *Font_WriteQuad( PLGVertex *vertex, float x, float y, float w, float h, const PLVector2 *st, float sw, float th, PLColour colour )
 {
-	if ( scale == 0.0f )
-		return;
+	vertex[ 0 ].position = PLVector3( x, y, 0 );
+	vertex[ 0 ].st[ 0 ]  = PLVector2( st->x, st->y );
+	vertex[ 1 ].position = PLVector3( x, y + h, 0 );
+	vertex[ 1 ].st[ 0 ]  = PLVector2( st->x, st->y + th );
+	vertex[ 2 ].position = PLVector3( x + w, y, 0 );
+	vertex[ 2 ].st[ 0 ]  = PLVector2( st->x + sw, st->y );
+	vertex[ 3 ].position = PLVector3( x + w, y + h, 0 );
+	vertex[ 3 ].st[ 0 ]  = PLVector2( st->x + sw, st->y + th );
+
+	vertex[ 0 ].colour = vertex[ 1 ].colour = vertex[ 2 ].colour = vertex[ 3 ].colour = colour;
+
+	return vertex + 4;
+}
 
-	size_t numChars = strlen( msg );
-	if ( numChars == 0 )
-		return;
+/**
+ * Draws all of the text added since the last flush, one batch per
+ * font (or more, if a font has more glyphs than its mesh holds).
+ * Anything drawn after this goes over the top of it.
+ */
+void Font_FlushBatches( void )
+{
+	for ( unsigned int i = 0; i < numQueuedFonts; ++i )
+	{
+		BitmapFont *font = queuedFonts[ i ];
 
-	Font_BeginDraw( font );
+		/* figure out the size of a character in the font sheet */
+		float sw = ( float ) font->cw / ( float ) font->w;
+		float th = ( float ) font->ch / ( float ) font->h;
 
-	if ( shadow )
-		Font_AddBitmapStringToPass( font, x + 1, y + 1, scale, PL_COLOUR_BLACK, msg, numChars, false );
+		PLGVertex   *vertex    = font->mesh->vertices;
+		unsigned int numGlyphs = 0;
+		for ( unsigned int j = 0; j < font->numBatchRuns; ++j )
+		{
+			const FontBatchRun *batchRun = &font->batchRuns[ j ];
+			const FontTextRun  *run      = batchRun->run;
+
+			float w = ( float ) font->cw * run->scale;
+			float h = ( float ) font->ch * run->scale;
+
+			unsigned int quadsPerGlyph = run->shadow ? 2 : 1;
+			for ( unsigned int k = 0; k < run->numGlyphs; ++k )
+			{
+				if ( numGlyphs + quadsPerGlyph > FONT_MAX_BATCH_GLYPHS )
+				{
+					Font_DrawMesh( font, numGlyphs );
+					vertex    = font->mesh->vertices;
+					numGlyphs = 0;
+				}
+
+				const FontGlyph *glyph = &run->glyphs[ k ];
+				const PLVector2 *st    = &font->glyphCoords[ glyph->character ];
+
+				float x = batchRun->x + glyph->x;
+				float y = batchRun->y + glyph->y;
+				if ( run->shadow )
+					vertex = Font_WriteQuad( vertex, x + 1, y + 1, w, h, st, sw, th, PLColourRGB( 0, 0, 0 ) );
+
+				vertex = Font_WriteQuad( vertex, x, y, w, h, st, sw, th, run->colour );
+				numGlyphs += quadsPerGlyph;
+			}
+		}
 
-	Font_AddBitmapStringToPass( font, x, y, scale, colour, msg, numChars, false );
+		Font_DrawMesh( font, numGlyphs );
 
-	Font_Draw( font );
+		font->isQueued = false;
+		Font_DiscardBatch( font );
+	}
+
+	numQueuedFonts = 0;
 }
 
-void Font_BeginDraw( BitmapFont *font )
+void Font_AddBitmapCharacterToPass( const BitmapFont *font, float x, float y, float scale, PLColour colour, uint8_t character )
 {
-	PlgClearMesh( font->mesh );
+	Font_AddBitmapStringToPass( font, x, y, scale, colour, ( const char * ) &character, 1, false );
 }
 
-void Font_Draw( BitmapFont *font )
+void Font_AddBitmapStringToPass( const BitmapFont *font, float x, float y, float scale, PLColour colour, const char *msg, size_t length, bool shadow )
 {
-	PlMatrixMode( PL_MODELVIEW_MATRIX );
-	PlPushMatrix();
+	if ( length == 0 )
+		return;
 
-	PlLoadIdentityMatrix();
+	/* with batching off, it's laid out every time, as it used to be */
+	FontTextRun *run = Font_IsBatching() ? Font_GetRun( font, scale, colour, shadow, msg, length )
+	                                     : Font_CreateRun( font, scale, colour, shadow, msg, length );
 
-	YnCore_Material_DrawMesh( font->material, font->mesh, NULL, 0 );
+	/* todo: the pass functions should take a mutable font */
+	Font_QueueRun( ( BitmapFont * ) font, run, x, y );
+}
 
-	PlPopMatrix();
+/**
+ * Draw a single bitmap character at the specified coordinates.
+ */
+void Font_DrawBitmapCharacter( BitmapFont *font, float x, float y, float scale, PLColour colour, char character )
+{
+	if ( scale <= 0 )
+		return;
+
+	int w, h;
+	PlgGetViewport( NULL, NULL, &w, &h );
+
+	float dw = ( float ) w;
+	float dh = ( float ) h;
+	if ( x > dw || y > dh )
+		return;
+
+	Font_AddBitmapCharacterToPass( font, x, y, scale, colour, character );
+
+	if ( !Font_IsBatching() )
+		Font_FlushBatches();
+}
+
+void Font_DrawBitmapString( BitmapFont *font, float x, float y, float spacing, float scale, PLColour colour, const char *msg, bool shadow )
+{
+	if ( scale == 0.0f )
+		return;
+
+	size_t numChars = strlen( msg );
+	if ( numChars == 0 )
+		return;
+
+	if ( shadow )
+		Font_AddBitmapStringToPass( font, x + 1, y + 1, scale, PL_COLOUR_BLACK, msg, numChars, false );
+
+	Font_AddBitmapStringToPass( font, x, y, scale, colour, msg, numChars, false );
+
+	if ( !Font_IsBatching() )
+		Font_FlushBatches();
 }
 
 void YR_Font_Initialize( void )
@@ -135,12 +488,24 @@ void YR_Font_Initialize( void )
 
 	if ( defaultFont == NULL || defaultFontSmall == NULL )
 		PRINT_ERROR( "Failed to load default fonts!\n" );
+
+	PL_GET_CVAR( "r.batchText", batchText );
+	batchTextVar = batchText;
 }
 
 void Font_Shutdown( void )
 {
 	Font_ReleaseBitmap( defaultFont );
 	defaultFont = NULL;
+
+	while ( numQueuedFonts > 0 )
+		Font_DiscardBatch( queuedFonts[ 0 ] );
+
+	Font_ClearRuns();
+
+	PL_DELETE( queuedFonts );
+	queuedFonts    = NULL;
+	numQueuedFonts = maxQueuedFonts = 0;
 }
 
 static void Font_CB_DestroyBitmap( void *userData )
@@ -148,6 +513,14 @@ static void Font_CB_DestroyBitmap( void *userData )
 	BitmapFont *font = userData;
 	assert( font != NULL );
 
+	/* anything laid out for it can't be found again, and mustn't be
+	 * mistaken for another font that ends up at the same address */
+	Font_DiscardBatch( font );
+	if ( runCache.maxRuns > 0 )
+		Font_SweepRuns( font );
+
+	PL_DELETE( font->batchRuns );
+
 	YnCore_Material_Release( font->material );
 
 	PlgDestroyMesh( font->mesh );
@@ -164,7 +537,7 @@ BitmapFont *Font_CacheBitmap( const char *materialPath, int w, int h, int cw, in
 		return font;
 	}
 
-	PLGMesh *mesh = PlgCreateMesh( PLG_MESH_TRIANGLES, PLG_DRAW_DYNAMIC, 4096, 4096 );
+	PLGMesh *mesh = PlgCreateMesh( PLG_MESH_TRIANGLES, PLG_DRAW_DYNAMIC, FONT_MAX_BATCH_GLYPHS * 2, FONT_MAX_BATCH_GLYPHS * 4 );
 	if ( mesh == NULL )
 	{
 		PRINT_WARNING( "Failed to create font mesh, %s, aborting!\n", PlGetError() );
@@ -189,6 +562,19 @@ BitmapFont *Font_CacheBitmap( const char *materialPath, int w, int h, int cw, in
 	font->start	   = start;
 	font->end	   = end;
 
+	if ( font->end > PL_ARRAY_ELEMENTS( font->glyphCoords ) )
+		font->end = PL_ARRAY_ELEMENTS( font->glyphCoords );
+
+	/* where each character is in the font sheet, anything outside of
+	 * start and end is skipped when laying out strings */
+	for ( unsigned int i = start; i < font->end; ++i )
+	{
+		int row = ( i - start ) / ( w / cw );
+		int col = ( i - start ) % ( w / cw );
+
+		font->glyphCoords[ i ] = PLVector2( ( float ) ( col * cw ) / ( float ) w, ( float ) ( row * ch ) / ( float ) h );
+	}
+
 	strncpy( font->path, materialPath, sizeof( font->path ) );
 
 	MM_AddToCache( materialPath, MEM_CACHE_FONT, font );
@@ -206,3 +592,86 @@ void Font_ReleaseBitmap( BitmapFont *font )
 
 BitmapFont *Font_GetDefault( void ) { return defaultFont; }
 BitmapFont *Font_GetDefaultSmall( void ) { return defaultFontSmall; }
+
+/****************************************
+ * BENCHMARK
+ ****************************************/
+
+#define FONT_BENCHMARK_DEFAULT_LINES 2048
+#define FONT_BENCHMARK_FRAMES        30
+
+static double Font_TimeBenchmarkFrames( BitmapFont *font, char **lines, unsigned int numLines, unsigned int *numDraws )
+{
+	YnCore_CommandBuffer_ResetNullStats();
+
+	double startTime = PlGetCurrentSeconds();
+	for ( unsigned int i = 0; i < FONT_BENCHMARK_FRAMES; ++i )
+	{
+		for ( unsigned int j = 0; j < numLines; ++j )
+			Font_DrawBitmapString( font, 4.0f, ( float ) ( j * font->ch ), 0, 1.0f, PL_COLOUR_WHITE, lines[ j ], true );
+
+		Font_FlushBatches();
+	}
+	double time = PlGetCurrentSeconds() - startTime;
+
+	YNCoreCommandStats stats;
+	YnCore_CommandBuffer_GetNullStats( &stats );
+	*numDraws = stats.numDraws;
+
+	return time;
+}
+
+/**
+ * Draws a screen full of console output through the null backend, once
+ * string by string as it used to be, and then batched, and reports the
+ * cost of each frame along with how many draws it took.
+ */
+void Font_BenchmarkCommand( unsigned int argc, char **argv )
+{
+	unsigned int numLines = FONT_BENCHMARK_DEFAULT_LINES;
+	if ( argc > 1 )
+	{
+		numLines = strtoul( argv[ 1 ], NULL, 10 );
+		if ( numLines == 0 )
+		{
+			PRINT_WARNING( "Invalid number of lines specified!\n" );
+			return;
+		}
+	}
+
+	BitmapFont *font = Font_GetDefault();
+	if ( font == NULL )
+	{
+		PRINT_WARNING( "No default font to benchmark with!\n" );
+		return;
+	}
+
+	/* anything still waiting would be counted against the benchmark */
+	Font_FlushBatches();
+
+	char **lines = PL_NEW_( char *, numLines );
+	for ( unsigned int i = 0; i < numLines; ++i )
+	{
+		lines[ i ] = PL_NEW_( char, 64 );
+		snprintf( lines[ i ], 64, "[%06.2f] Loaded \"materials/test_%u.mat.n\" (%u KB)", i * 0.01, i, ( i * 37 ) % 4096 );
+	}
+
+	bool wasNullBackend = YnCore_CommandBuffer_SetNullBackend( true );
+
+	unsigned int numUnbatchedDraws, numBatchedDraws;
+	forceUnbatched       = true;
+	double unbatchedTime = Font_TimeBenchmarkFrames( font, lines, numLines, &numUnbatchedDraws );
+	forceUnbatched       = false;
+	double batchedTime   = Font_TimeBenchmarkFrames( font, lines, numLines, &numBatchedDraws );
+
+	YnCore_CommandBuffer_SetNullBackend( wasNullBackend );
+
+	for ( unsigned int i = 0; i < numLines; ++i )
+		PL_DELETE( lines[ i ] );
+	PL_DELETE( lines );
+
+	PRINT( "Drew %u lines for %u frames:\n", numLines, FONT_BENCHMARK_FRAMES );
+	PRINT( "  unbatched: %.3fms, %.1f draws per frame\n", unbatchedTime * 1000.0 / FONT_BENCHMARK_FRAMES, ( double ) numUnbatchedDraws / FONT_BENCHMARK_FRAMES );
+	PRINT( "  batched:   %.3fms, %.1f draws per frame\n", batchedTime * 1000.0 / FONT_BENCHMARK_FRAMES, ( double ) numBatchedDraws / FONT_BENCHMARK_FRAMES );
+	PRINT( "  runs:      %u cached\n", runCache.numRuns );
+}
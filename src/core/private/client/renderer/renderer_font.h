@@ -10,6 +10,13 @@ typedef struct BitmapFont
 	int				 w, h, cw, ch;
 	char			 path[ PL_SYSTEM_MAX_PATH ];
 	unsigned int	 start, end;
+	PLVector2		 glyphCoords[ 256 ]; /* top left of each character in the sheet */
+
+	/* text added since the last flush, drawn together */
+	struct FontBatchRun *batchRuns;
+	unsigned int         numBatchRuns;
+	unsigned int         maxBatchRuns;
+	bool                 isQueued;
 
 	YNCoreMemoryReference mem;
 } BitmapFont;
@@ -29,5 +36,6 @@ void Font_AddBitmapStringToPass( const BitmapFont *font, float x, float y, float
 void Font_DrawBitmapCharacter( BitmapFont *font, float x, float y, float scale, PLColour colour, char character );
 void Font_DrawBitmapString( BitmapFont *font, float x, float y, float spacing, float scale, PLColour colour, const char *msg, bool shadow );
 
-void Font_BeginDraw( BitmapFont *font );
-void Font_Draw( BitmapFont *font );
+void Font_FlushBatches( void );
+
+void Font_BenchmarkCommand( unsigned int argc, char **argv );
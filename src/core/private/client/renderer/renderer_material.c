@@ -27,11 +27,27 @@ typedef struct YNCoreMaterial
 	PLGTexture *preview;// preview utilised for editor
 	PLLinkedListNode *node;
 
+	/* used to group draws with the same material and textures, see YnCore_Material_GetSortKey */
+	uint16_t sortId;
+	uint16_t textureSetId;
+
 	YNCoreMemoryReference mem;
 } YNCoreMaterial;
 
+static uint16_t numMaterialSortIds;
+
 static YNCoreMaterial *fallbackMaterial;
 
+/* looked up once, rather than on every draw */
+static PLConsoleVariable *skipDiffuseVar;
+static PLConsoleVariable *skipNormalVar;
+static PLConsoleVariable *skipSpecularVar;
+static PLConsoleVariable *cacheUniformsVar;
+
+/* see YnCore_Material_BeginRecording */
+static YNCoreCommandBuffer *recordBuffer;
+static YNCoreCommandBuffer  immediateBuffer;
+
 YNCoreMaterial *YnCore_GetFallbackMaterial( void )
 {
 	return fallbackMaterial;
@@ -53,18 +69,29 @@ void YnCore_InitializeMaterialSystem( void )
 	previewFallbackTexture  = YnCore_LoadTexture( "materials/editor/no_preview.png", PLG_TEXTURE_FILTER_NEAREST );
 
 	/* go ahead and create the fallback material */
-	fallbackMaterial = PL_NEW( YNCoreMaterial );
+	fallbackMaterial         = PL_NEW( YNCoreMaterial );
+	fallbackMaterial->sortId = numMaterialSortIds++;
 	/* setup passes */
 	fallbackMaterial->numPasses                  = 1;
 	fallbackMaterial->preview                    = previewFallbackTexture;
 	fallbackMaterial->isCached                   = true;
 	fallbackMaterial->passes[ 0 ].program        = defaultShaderPrograms[ RS_SHADER_DEFAULT_VERTEX ];
+	fallbackMaterial->passes[ 0 ].slots          = YnCore_GetShaderProgramSlots( fallbackMaterial->passes[ 0 ].program );
 	fallbackMaterial->passes[ 0 ].blendMode[ 0 ] = PLG_BLEND_NONE;
 	fallbackMaterial->passes[ 0 ].blendMode[ 1 ] = PLG_BLEND_NONE;
 	/* setup variables */
 	fallbackMaterial->passes[ 0 ].numVariables                = 1;
 	fallbackMaterial->passes[ 0 ].variables[ 0 ].type         = MATERIAL_VAR_TEXTURE;
 	fallbackMaterial->passes[ 0 ].variables[ 0 ].data.userPtr = YnCore_GetFallbackTexture();
+
+	PL_GET_CVAR( "r.skipDiffuse", skipDiffuse );
+	PL_GET_CVAR( "r.skipNormal", skipNormal );
+	PL_GET_CVAR( "r.skipSpecular", skipSpecular );
+	PL_GET_CVAR( "r.cacheUniforms", cacheUniforms );
+	skipDiffuseVar   = skipDiffuse;
+	skipNormalVar    = skipNormal;
+	skipSpecularVar  = skipSpecular;
+	cacheUniformsVar = cacheUniforms;
 }
 
 void YnCore_ShutdownMaterialSystem( void )
@@ -72,6 +99,8 @@ void YnCore_ShutdownMaterialSystem( void )
 	/* Flush any objects pending deletion in case they are holding a material handle. */
 	MemoryManager_FlushUnreferencedResources();
 
+	YnCore_CommandBuffer_Destroy( &immediateBuffer );
+
 	unsigned int totalCachedMaterials = 0;
 	unsigned int orphanedCaches       = 0;
 
@@ -347,7 +376,7 @@ static void ParseShaderParameters( YNCoreMaterialPass *materialPass, YNNodeBranc
 						materialVariable->hint = RM_VAR_HINT_SPECULAR;
 
 					materialVariable->type         = MATERIAL_VAR_TEXTURE;
-					materialVariable->data.userPtr = YnCore_LoadTexture( texturePath, materialPass->textureFilter );
+					materialVariable->data.userPtr = YnCore_LoadTextureAsync( texturePath, materialPass->textureFilter );
 					break;
 				}
 			}
@@ -422,6 +451,29 @@ void YnCore_Material_ParsePass( YNNodeBranch *root, YNCoreMaterialPass *material
 	 * a case where we only want to use the shader defaults? */
 }
 
+/**
+ * Folds together the textures used by the first pass, so materials
+ * that happen to share them can be drawn one after the other.
+ */
+static uint16_t GetTextureSetId( const YNCoreMaterial *material )
+{
+	if ( material->numPasses == 0 )
+		return 0;
+
+	uint64_t hash = 14695981039346656037ull;
+	for ( unsigned int i = 0; i < material->passes[ 0 ].numVariables; ++i )
+	{
+		const MaterialVariable *variable = &material->passes[ 0 ].variables[ i ];
+		if ( variable->type != MATERIAL_VAR_TEXTURE && variable->type != MATERIAL_VAR_RENDERTARGET )
+			continue;
+
+		hash ^= ( uint64_t ) ( uintptr_t ) variable->data.userPtr;
+		hash *= 1099511628211ull;
+	}
+
+	return ( uint16_t ) ( hash ^ ( hash >> 16 ) ^ ( hash >> 32 ) ^ ( hash >> 48 ) );
+}
+
 static YNCoreMaterial *ParseMaterial( YNCoreMaterial *material, YNNodeBranch *root, bool preview )
 {
 	// see if the preview texture is specified
@@ -455,6 +507,7 @@ static YNCoreMaterial *ParseMaterial( YNCoreMaterial *material, YNNodeBranch *ro
 			if ( programIndex == NULL )
 			{
 				currentPass->program = defaultShaderPrograms[ RS_SHADER_DEFAULT ];
+				currentPass->slots   = YnCore_GetShaderProgramSlots( currentPass->program );
 				PRINT_WARNING( "Failed to find program \"%s\", using fallback!\n", programName );
 			}
 			else
@@ -472,7 +525,8 @@ static YNCoreMaterial *ParseMaterial( YNCoreMaterial *material, YNNodeBranch *ro
 	if ( material->numPasses == 0 )
 		PRINT_WARNING( "No passes specified for material!\n" );
 
-	material->isCached = true;
+	material->textureSetId = GetTextureSetId( material );
+	material->isCached     = true;
 
 	return material;
 }
@@ -559,7 +613,8 @@ YNCoreMaterial *YnCore_Material_Cache( const char *path, YNCoreCacheGroup group,
 		return fallbackPtr;
 	}
 
-	material = PL_NEW( YNCoreMaterial );
+	material         = PL_NEW( YNCoreMaterial );
+	material->sortId = numMaterialSortIds++;
 	ParseMaterial( material, root, preview );
 
 	YnNode_DestroyBranch( root );
@@ -584,6 +639,116 @@ void YnCore_Material_Release( YNCoreMaterial *material )
 	MemoryManager_ReleaseReference( &material->mem );
 }
 
+/****************************************
+ * RECORDING
+ ****************************************/
+
+/* Everything a draw needs is recorded into a command buffer, rather than
+ * going straight to the graphics library. The render queue records all its
+ * draws into one buffer, otherwise each draw gets its own, submitted as
+ * soon as it's done.
+ *
+ * While the queue is recording, nothing else touches the graphics state
+ * between draws, so we also keep track of what's bound and skip anything
+ * that's the same as it was for the previous draw. */
+
+#define MATERIAL_MAX_TEXTURE_UNITS 16
+
+static struct
+{
+	bool              active;
+	PLGShaderProgram *program;
+	int               blendMode[ 2 ];
+	int               cullMode;
+	PLGTexture       *textures[ MATERIAL_MAX_TEXTURE_UNITS ];
+	int               textureFilters[ MATERIAL_MAX_TEXTURE_UNITS ];
+	bool              isTextureBound[ MATERIAL_MAX_TEXTURE_UNITS ];
+} boundState;
+
+static YNCoreCommandBuffer *GetCommandBuffer( void )
+{
+	return ( recordBuffer != NULL ) ? recordBuffer : &immediateBuffer;
+}
+
+void YnCore_Material_BeginRecording( YNCoreCommandBuffer *buffer )
+{
+	recordBuffer = buffer;
+
+	PL_ZERO_( boundState );
+	boundState.blendMode[ 0 ] = boundState.blendMode[ 1 ] = -1;
+	boundState.cullMode                                   = -1;
+	boundState.active                                     = true;
+}
+
+void YnCore_Material_EndRecording( void )
+{
+	YnCore_CommandBuffer_BindCullMode( GetCommandBuffer(), PLG_CULL_POSITIVE );
+
+	boundState.active = false;
+	recordBuffer      = NULL;
+}
+
+static void BindProgram( PLGShaderProgram *program )
+{
+	if ( boundState.active && boundState.program == program )
+		return;
+
+	boundState.program = program;
+	g_gfxPerfStats.numStateChanges++;
+	YnCore_CommandBuffer_BindProgram( GetCommandBuffer(), program );
+}
+
+static void BindBlendMode( PLGBlend a, PLGBlend b )
+{
+	if ( boundState.active && boundState.blendMode[ 0 ] == ( int ) a && boundState.blendMode[ 1 ] == ( int ) b )
+		return;
+
+	boundState.blendMode[ 0 ] = ( int ) a;
+	boundState.blendMode[ 1 ] = ( int ) b;
+	g_gfxPerfStats.numStateChanges++;
+	YnCore_CommandBuffer_BindBlendMode( GetCommandBuffer(), a, b );
+}
+
+static void BindCullMode( PLGCullMode cullMode )
+{
+	if ( boundState.active && boundState.cullMode == ( int ) cullMode )
+		return;
+
+	boundState.cullMode = ( int ) cullMode;
+	g_gfxPerfStats.numStateChanges++;
+	YnCore_CommandBuffer_BindCullMode( GetCommandBuffer(), cullMode );
+}
+
+/**
+ * Binds the texture to the given unit, and sets its filter
+ * if one is provided (otherwise pass -1).
+ */
+static void BindTexture( PLGTexture *texture, unsigned int unit, int filter )
+{
+	if ( unit < MATERIAL_MAX_TEXTURE_UNITS )
+	{
+		if ( boundState.active && boundState.isTextureBound[ unit ] && boundState.textures[ unit ] == texture &&
+		     ( filter < 0 || boundState.textureFilters[ unit ] == filter ) )
+			return;
+
+		boundState.textures[ unit ]       = texture;
+		boundState.textureFilters[ unit ] = filter;
+		boundState.isTextureBound[ unit ] = true;
+	}
+
+	g_gfxPerfStats.numStateChanges++;
+	YnCore_CommandBuffer_BindTexture( GetCommandBuffer(), texture, unit, filter );
+}
+
+static void SetUniform( PLGShaderProgram *program, int slot, const void *value, size_t size, bool transpose )
+{
+	if ( slot < 0 )
+		return;
+
+	g_gfxPerfStats.numUniformUploads++;
+	YnCore_CommandBuffer_SetUniform( GetCommandBuffer(), program, slot, value, size, transpose );
+}
+
 static void SetBuiltInVariable( PLGShaderProgram *program, int uniformSlot, int variable, unsigned int *curUnit )
 {
 	if ( variable == -1 )
@@ -594,7 +759,7 @@ static void SetBuiltInVariable( PLGShaderProgram *program, int uniformSlot, int
 		case MATERIAL_BUILTIN_TIME:
 		{
 			unsigned int numTicks = YnCore_GetNumTicks();
-			PlgSetShaderUniformValueByIndex( program, uniformSlot, &numTicks, false );
+			SetUniform( program, uniformSlot, &numTicks, sizeof( numTicks ), false );
 			break;
 		}
 
@@ -604,8 +769,8 @@ static void SetBuiltInVariable( PLGShaderProgram *program, int uniformSlot, int
 			if ( depthTexture == NULL )
 				break;
 
-			PlgSetTexture( depthTexture, *curUnit );
-			PlgSetShaderUniformValueByIndex( program, uniformSlot, curUnit, false );
+			BindTexture( depthTexture, *curUnit, -1 );
+			SetUniform( program, uniformSlot, curUnit, sizeof( unsigned int ), false );
 			*curUnit++;
 			break;
 		}
@@ -614,7 +779,8 @@ static void SetBuiltInVariable( PLGShaderProgram *program, int uniformSlot, int
 		{
 			int w, h;
 			YnCore_Get2DViewportSize( &w, &h );
-			PlgSetShaderUniformValueByIndex( program, uniformSlot, &PLVector2( ( float ) w, ( float ) h ), false );
+			PLVector2 size = PLVector2( ( float ) w, ( float ) h );
+			SetUniform( program, uniformSlot, &size, sizeof( size ), false );
 			break;
 		}
 
@@ -623,52 +789,247 @@ static void SetBuiltInVariable( PLGShaderProgram *program, int uniformSlot, int
 	}
 }
 
-static void SetGlobalUniforms( PLGShaderProgram *program, YNCoreLight *lights, unsigned int numLights )
+/****************************************
+ * SHARED PARAMETERS
+ ****************************************/
+
+/* Uniforms stay with the program they were set on, so anything that's
+ * shared between draws, like the sun, fog and lights, is collected here
+ * and only sent to a program if it's changed since the program last had it. */
+
+typedef struct MaterialFrameParameters
+{
+	bool        hasWorld;
+	PLColourF32 sunColour;
+	PLVector3   sunPosition;
+	PLColourF32 ambience;
+	PLColourF32 fogColour;
+	float       fogNear;
+	float       fogFar;
+} MaterialFrameParameters;
+
+static MaterialFrameParameters frameParameters;
+static unsigned int            frameParametersVersion = 1;
+
+static YNCoreLight  lightParameters[ MAX_MATERIAL_LIGHTS ];
+static unsigned int numLightParameters;
+static unsigned int lightParametersVersion = 1;
+
+static int GetUniformSlot( PLGShaderProgram *program, const char *name )
+{
+	g_gfxPerfStats.numUniformLookups++;
+	return PlgGetShaderUniformSlot( program, name );
+}
+
+void YnCore_Material_ResolveProgramSlots( PLGShaderProgram *program, MaterialProgramSlots *slots )
+{
+	static const char *globalNames[ MAX_MATERIAL_GLOBALS ] = {
+	        "pl_model",
+	        "sun.colour",
+	        "sun.position",
+	        "sun.ambience",
+	        "fogColour",
+	        "fogNear",
+	        "fogFar",
+	        "numLights",
+	};
+	static const char *lightNames[ MAX_MATERIAL_LIGHT_UNIFORMS ] = {
+	        "colour",
+	        "position",
+	        "radius",
+	};
+
+	PL_ZERO( slots, sizeof( MaterialProgramSlots ) );
+
+	for ( unsigned int i = 0; i < MAX_MATERIAL_GLOBALS; ++i )
+		slots->globals[ i ] = GetUniformSlot( program, globalNames[ i ] );
+
+	for ( unsigned int i = 0; i < MAX_MATERIAL_LIGHTS; ++i )
+	{
+		for ( unsigned int j = 0; j < MAX_MATERIAL_LIGHT_UNIFORMS; ++j )
+		{
+			char buf[ 32 ];
+			snprintf( buf, sizeof( buf ), "lights[%u].%s", i, lightNames[ j ] );
+			slots->lights[ i ][ j ] = GetUniformSlot( program, buf );
+		}
+	}
+}
+
+/**
+ * Gathers up the parameters from the current world, should be
+ * called once before drawing the scene.
+ */
+void YnCore_Material_UpdateFrameParameters( void )
+{
+	MaterialFrameParameters parameters;
+	PL_ZERO_( parameters );
+
+	YNCoreWorld *world = Game_GetCurrentWorld();
+	if ( world != NULL )
+	{
+		parameters.hasWorld    = true;
+		parameters.sunColour   = world->sunColour;
+		parameters.sunPosition = world->sunPosition;
+		parameters.ambience    = world->ambience;
+		parameters.fogColour   = world->fogColour;
+		parameters.fogNear     = world->fogNear;
+		parameters.fogFar      = world->fogFar;
+	}
+
+	if ( memcmp( &parameters, &frameParameters, sizeof( MaterialFrameParameters ) ) == 0 )
+		return;
+
+	frameParameters = parameters;
+	frameParametersVersion++;
+}
+
+/**
+ * Forces the shared parameters to be sent again to every program,
+ * for when whatever had them previously is no longer around.
+ */
+void YnCore_Material_ResetSharedUniforms( void )
+{
+	frameParametersVersion++;
+	lightParametersVersion++;
+}
+
+static void UpdateLightParameters( const YNCoreLight *lights, unsigned int numLights )
+{
+	if ( numLights > MAX_MATERIAL_LIGHTS )
+		numLights = MAX_MATERIAL_LIGHTS;
+
+	if ( numLights == numLightParameters && ( numLights == 0 || memcmp( lights, lightParameters, sizeof( YNCoreLight ) * numLights ) == 0 ) )
+		return;
+
+	if ( numLights > 0 )
+		memcpy( lightParameters, lights, sizeof( YNCoreLight ) * numLights );
+
+	numLightParameters = numLights;
+	lightParametersVersion++;
+}
+
+static void SetSharedUniforms( PLGShaderProgram *program, MaterialProgramSlots *slots )
+{
+	if ( slots->frameParametersVersion != frameParametersVersion )
+	{
+		slots->frameParametersVersion = frameParametersVersion;
+		if ( frameParameters.hasWorld )
+		{
+			SetUniform( program, slots->globals[ MATERIAL_GLOBAL_SUN_COLOUR ], &frameParameters.sunColour, sizeof( frameParameters.sunColour ), false );
+			SetUniform( program, slots->globals[ MATERIAL_GLOBAL_SUN_POSITION ], &frameParameters.sunPosition, sizeof( frameParameters.sunPosition ), false );
+			SetUniform( program, slots->globals[ MATERIAL_GLOBAL_SUN_AMBIENCE ], &frameParameters.ambience, sizeof( frameParameters.ambience ), false );
+
+			SetUniform( program, slots->globals[ MATERIAL_GLOBAL_FOG_COLOUR ], &frameParameters.fogColour, sizeof( frameParameters.fogColour ), false );
+			SetUniform( program, slots->globals[ MATERIAL_GLOBAL_FOG_NEAR ], &frameParameters.fogNear, sizeof( frameParameters.fogNear ), false );
+			SetUniform( program, slots->globals[ MATERIAL_GLOBAL_FOG_FAR ], &frameParameters.fogFar, sizeof( frameParameters.fogFar ), false );
+		}
+	}
+
+	if ( slots->lightParametersVersion != lightParametersVersion && slots->globals[ MATERIAL_GLOBAL_NUM_LIGHTS ] >= 0 )
+	{
+		slots->lightParametersVersion = lightParametersVersion;
+
+		SetUniform( program, slots->globals[ MATERIAL_GLOBAL_NUM_LIGHTS ], &numLightParameters, sizeof( numLightParameters ), false );
+		for ( unsigned int i = 0; i < numLightParameters; ++i )
+		{
+			SetUniform( program, slots->lights[ i ][ MATERIAL_LIGHT_COLOUR ], &lightParameters[ i ].colour, sizeof( lightParameters[ i ].colour ), false );
+			SetUniform( program, slots->lights[ i ][ MATERIAL_LIGHT_POSITION ], &lightParameters[ i ].position, sizeof( lightParameters[ i ].position ), false );
+			SetUniform( program, slots->lights[ i ][ MATERIAL_LIGHT_RADIUS ], &lightParameters[ i ].radius, sizeof( lightParameters[ i ].radius ), false );
+		}
+	}
+}
+
+/**
+ * Old path, looking everything up by name on every draw.
+ * Kept around for comparison, see r.cacheUniforms.
+ */
+static void SetGlobalUniformsByName( PLGShaderProgram *program, const YNCoreLight *lights, unsigned int numLights )
 {
 	int slot;
 
 	YNCoreWorld *world = Game_GetCurrentWorld();
 	if ( world != NULL )
 	{
-		if ( ( slot = PlgGetShaderUniformSlot( program, "sun.colour" ) ) >= 0 )
-			PlgSetShaderUniformValueByIndex( program, slot, &world->sunColour, false );
-		if ( ( slot = PlgGetShaderUniformSlot( program, "sun.position" ) ) >= 0 )
-			PlgSetShaderUniformValueByIndex( program, slot, &world->sunPosition, false );
-		if ( ( slot = PlgGetShaderUniformSlot( program, "sun.ambience" ) ) >= 0 )
-			PlgSetShaderUniformValueByIndex( program, slot, &world->ambience, false );
-
-		if ( ( slot = PlgGetShaderUniformSlot( program, "fogColour" ) ) >= 0 )
-			PlgSetShaderUniformValueByIndex( program, slot, &world->fogColour, false );
-		if ( ( slot = PlgGetShaderUniformSlot( program, "fogNear" ) ) >= 0 )
-			PlgSetShaderUniformValueByIndex( program, slot, &world->fogNear, false );
-		if ( ( slot = PlgGetShaderUniformSlot( program, "fogFar" ) ) >= 0 )
-			PlgSetShaderUniformValueByIndex( program, slot, &world->fogFar, false );
+		SetUniform( program, GetUniformSlot( program, "sun.colour" ), &world->sunColour, sizeof( world->sunColour ), false );
+		SetUniform( program, GetUniformSlot( program, "sun.position" ), &world->sunPosition, sizeof( world->sunPosition ), false );
+		SetUniform( program, GetUniformSlot( program, "sun.ambience" ), &world->ambience, sizeof( world->ambience ), false );
+
+		SetUniform( program, GetUniformSlot( program, "fogColour" ), &world->fogColour, sizeof( world->fogColour ), false );
+		SetUniform( program, GetUniformSlot( program, "fogNear" ), &world->fogNear, sizeof( world->fogNear ), false );
+		SetUniform( program, GetUniformSlot( program, "fogFar" ), &world->fogFar, sizeof( world->fogFar ), false );
 	}
 
-	if ( ( slot = PlgGetShaderUniformSlot( program, "numLights" ) ) >= 0 )
+	if ( ( slot = GetUniformSlot( program, "numLights" ) ) >= 0 )
 	{
-		PlgSetShaderUniformValueByIndex( program, slot, &numLights, false );
+		SetUniform( program, slot, &numLights, sizeof( numLights ), false );
 		for ( unsigned int i = 0; i < numLights; ++i )
 		{
-			/* todo: this would be a lot less fucking disturbing if we were using a proper static layout! */
-			char buf[ 32 ] = "lights[0].";
-			buf[ 7 ]       = '0' + i;
-			char *p        = &buf[ 10 ];
+			char buf[ 32 ];
+			snprintf( buf, sizeof( buf ), "lights[%u].colour", i );
+			SetUniform( program, GetUniformSlot( program, buf ), &lights[ i ].colour, sizeof( lights[ i ].colour ), false );
+			snprintf( buf, sizeof( buf ), "lights[%u].position", i );
+			SetUniform( program, GetUniformSlot( program, buf ), &lights[ i ].position, sizeof( lights[ i ].position ), false );
+			snprintf( buf, sizeof( buf ), "lights[%u].radius", i );
+			SetUniform( program, GetUniformSlot( program, buf ), &lights[ i ].radius, sizeof( lights[ i ].radius ), false );
+		}
+	}
 
-			strcpy( p, "colour" );
-			PlgSetShaderUniformValue( program, buf, &lights[ i ].colour, false );
+	/* so the cached path re-sends everything when switched back */
+	YnCore_Material_ResetSharedUniforms();
+}
 
-			strcpy( p, "position" );
-			PlgSetShaderUniformValue( program, buf, &lights[ i ].position, false );
+/**
+ * Returns a key for ordering draws so that those sharing state end up
+ * next to each other; opaque draws are grouped by program, material and
+ * textures and then drawn front to back, while translucent draws come
+ * last and are drawn back to front.
+ */
+uint64_t YnCore_Material_GetSortKey( const YNCoreMaterial *material, float depth )
+{
+	bool     translucent = false;
+	uint64_t program     = 0;
+	if ( material->numPasses > 0 )
+	{
+		const YNCoreMaterialPass *pass = &material->passes[ 0 ];
+		translucent                    = !( pass->blendMode[ 0 ] == PLG_BLEND_NONE || ( pass->blendMode[ 0 ] == PLG_BLEND_ONE && pass->blendMode[ 1 ] == PLG_BLEND_ZERO ) );
 
-			strcpy( p, "radius" );
-			PlgSetShaderUniformValue( program, buf, &lights[ i ].radius, false );
-		}
+		uintptr_t p = ( uintptr_t ) pass->program;
+		program     = ( ( p >> 4 ) ^ ( p >> 14 ) ^ ( p >> 24 ) ) & 0x3FF;
 	}
+
+	/* positive floats sort the same as their bits, so just take the top of those */
+	uint32_t depthBits;
+	depth = ( depth > 0.0f ) ? depth : 0.0f;
+	memcpy( &depthBits, &depth, sizeof( uint32_t ) );
+	depthBits >>= 8;
+
+	uint64_t materialId = material->sortId;
+	uint64_t textureSet = material->textureSetId & 0xFFF;
+	if ( translucent )
+		return ( 1ull << 62 ) | ( ( uint64_t ) ( ~depthBits & 0xFFFFFF ) << 38 ) | ( program << 28 ) | ( materialId << 12 ) | textureSet;
+
+	return ( program << 52 ) | ( materialId << 36 ) | ( textureSet << 24 ) | depthBits;
 }
 
 void YnCore_Material_DrawMesh( YNCoreMaterial *material, PLGMesh *mesh, YNCoreLight *lights, unsigned int numLights )
 {
+	YnCore_Material_DrawMeshWithTransform( material, mesh, PlGetMatrix( PL_MODELVIEW_MATRIX ), lights, numLights );
+}
+
+void YnCore_Material_DrawMeshWithTransform( YNCoreMaterial *material, PLGMesh *mesh, const PLMatrix4 *transform, const YNCoreLight *lights, unsigned int numLights )
+{
+	YnCore_Material_DrawMeshInstanced( material, mesh, transform, 1, lights, numLights );
+}
+
+/**
+ * Draws the mesh once per transform, all sharing the same material
+ * and lights; everything but the model matrix is only set up once.
+ */
+void YnCore_Material_DrawMeshInstanced( YNCoreMaterial *material, PLGMesh *mesh, const PLMatrix4 *transforms, unsigned int numInstances, const YNCoreLight *lights, unsigned int numLights )
+{
+	if ( numInstances == 0 )
+		return;
+
 	// If it's not had a full cache, use the fallback,
 	// though ideally this shouldn't happen!
 	assert( material->isCached );
@@ -678,12 +1039,22 @@ void YnCore_Material_DrawMesh( YNCoreMaterial *material, PLGMesh *mesh, YNCoreLi
 		material                                                  = fallbackMaterial;
 	}
 
+	bool cacheUniforms = ( cacheUniformsVar == NULL || cacheUniformsVar->b_value );
+	if ( cacheUniforms )
+		UpdateLightParameters( lights, numLights );
+
+	bool skipDiffuse  = ( skipDiffuseVar != NULL && skipDiffuseVar->b_value );
+	bool skipNormal   = ( skipNormalVar != NULL && skipNormalVar->b_value );
+	bool skipSpecular = ( skipSpecularVar != NULL && skipSpecularVar->b_value );
+
 	for ( unsigned int i = 0; i < material->numPasses; ++i )
 	{
 		YNCoreMaterialPass *curPass = &material->passes[ i ];
+		if ( curPass->slots == NULL )
+			curPass->slots = YnCore_GetShaderProgramSlots( curPass->program );
 
-		PlgSetShaderProgram( curPass->program );
-		PlgSetBlendMode( curPass->blendMode[ 0 ], curPass->blendMode[ 1 ] );
+		BindProgram( curPass->program );
+		BindBlendMode( curPass->blendMode[ 0 ], curPass->blendMode[ 1 ] );
 
 		// Mirror mode requires flipping the matrix,
 		// so we'll need to update the cull mode
@@ -700,11 +1071,19 @@ void YnCore_Material_DrawMesh( YNCoreMaterial *material, PLGMesh *mesh, YNCoreLi
 		else
 			cullMode = curPass->cullMode;
 
-		PlgSetCullMode( cullMode );
-
-		PlgSetShaderUniformValue( curPass->program, "pl_model", PlGetMatrix( PL_MODELVIEW_MATRIX ), true );
+		BindCullMode( cullMode );
 
-		SetGlobalUniforms( curPass->program, lights, numLights );
+		int modelSlot;
+		if ( cacheUniforms && curPass->slots != NULL )
+		{
+			modelSlot = curPass->slots->globals[ MATERIAL_GLOBAL_MODEL ];
+			SetSharedUniforms( curPass->program, curPass->slots );
+		}
+		else
+		{
+			modelSlot = GetUniformSlot( curPass->program, "pl_model" );
+			SetGlobalUniformsByName( curPass->program, lights, numLights );
+		}
 
 		unsigned int curUnit = 0;
 		for ( unsigned int j = 0; j < curPass->numVariables; ++j )
@@ -717,8 +1096,7 @@ void YnCore_Material_DrawMesh( YNCoreMaterial *material, PLGMesh *mesh, YNCoreLi
 			// textures just need to be set per their respective unit
 			else if ( curPass->variables[ j ].type == MATERIAL_VAR_TEXTURE || curPass->variables[ j ].type == MATERIAL_VAR_RENDERTARGET )
 			{
-				PL_GET_CVAR( "r.skipDiffuse", skipDiffuse );
-				if ( skipDiffuse != NULL && ( curPass->variables[ j ].hint == RM_VAR_HINT_DIFFUSE && skipDiffuse->b_value ) )
+				if ( skipDiffuse && curPass->variables[ j ].hint == RM_VAR_HINT_DIFFUSE )
 					continue;
 
 				PLGTexture *texture;
@@ -733,36 +1111,54 @@ void YnCore_Material_DrawMesh( YNCoreMaterial *material, PLGMesh *mesh, YNCoreLi
 
 				assert( texture != NULL );
 
-				PL_GET_CVAR( "r.skipNormal", skipNormal );
-				if ( skipNormal != NULL && ( curPass->variables[ j ].hint == RM_VAR_HINT_NORMAL && skipNormal->b_value ) )
+				if ( skipNormal && curPass->variables[ j ].hint == RM_VAR_HINT_NORMAL )
 					texture = normalFallbackTexture;
 
-				PL_GET_CVAR( "r.skipSpecular", skipSpecular );
-				if ( skipSpecular != NULL && ( curPass->variables[ j ].hint == RM_VAR_HINT_SPECULAR && skipSpecular->b_value ) )
+				if ( skipSpecular && curPass->variables[ j ].hint == RM_VAR_HINT_SPECULAR )
 					texture = specularFallbackTexture;
 
-				PlgSetTexture( texture, curUnit );
-				PlgSetTextureFilter( texture, curPass->textureFilter );
+				BindTexture( texture, curUnit, ( int ) curPass->textureFilter );
 
-				PlgSetShaderUniformValueByIndex( curPass->program, curPass->variables[ j ].programSlot, &curUnit, false );
+				SetUniform( curPass->program, curPass->variables[ j ].programSlot, &curUnit, sizeof( curUnit ), false );
 				curUnit++;
 				continue;
 			}
 
-			PlgSetShaderUniformValueByIndex( curPass->program, curPass->variables[ j ].programSlot, &curPass->variables[ j ].data, false );
+			SetUniform( curPass->program, curPass->variables[ j ].programSlot, &curPass->variables[ j ].data, sizeof( MaterialVariableData ), false );
 		}
 
-		PlgUploadMesh( mesh );
-		PlgDrawMesh( mesh );
+		/* meshes only go back to the driver when they've been flagged as changed */
+		if ( mesh->isDirty )
+			g_gfxPerfStats.numBytesUploaded += ( sizeof( PLGVertex ) * mesh->num_verts ) + ( sizeof( unsigned int ) * mesh->num_triangles * 3 );
 
-		g_gfxPerfStats.numBatches++;
+		if ( numInstances > 1 && modelSlot >= 0 )
+		{
+			YnCore_CommandBuffer_DrawMeshInstanced( GetCommandBuffer(), mesh, curPass->program, modelSlot, transforms, numInstances );
+			g_gfxPerfStats.numBatches++;
+		}
+		else
+		{
+			for ( unsigned int j = 0; j < numInstances; ++j )
+			{
+				SetUniform( curPass->program, modelSlot, &transforms[ j ], sizeof( PLMatrix4 ), true );
+				YnCore_CommandBuffer_DrawMesh( GetCommandBuffer(), mesh );
+			}
+			g_gfxPerfStats.numBatches += numInstances;
+		}
+
+		g_gfxPerfStats.numInstances += numInstances;
 		if ( mesh->primitive == PLG_MESH_TRIANGLES )
-			g_gfxPerfStats.numTriangles += mesh->num_triangles;
+			g_gfxPerfStats.numTriangles += mesh->num_triangles * numInstances;
 		else
-			g_gfxPerfStats.numTriangles += ( mesh->num_verts / 2 );
+			g_gfxPerfStats.numTriangles += ( mesh->num_verts / 2 ) * numInstances;
 	}
 
-	PlgSetCullMode( PLG_CULL_POSITIVE );
+	if ( recordBuffer == NULL )
+	{
+		YnCore_CommandBuffer_BindCullMode( &immediateBuffer, PLG_CULL_POSITIVE );
+		YnCore_CommandBuffer_Submit( &immediateBuffer );
+		YnCore_CommandBuffer_Reset( &immediateBuffer );
+	}
 
 	if ( !material->isCached )
 		fallbackMaterial->passes[ 0 ].variables[ 0 ].data.userPtr = YnCore_GetFallbackTexture();
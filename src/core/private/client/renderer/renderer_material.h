@@ -3,8 +3,11 @@
 
 #pragma once
 
+#include <yin/core_renderer.h>
+
 #define MAX_MATERIAL_PASSES    4
 #define MAX_MATERIAL_VARIABLES 64
+#define MAX_MATERIAL_LIGHTS    YN_CORE_MAX_LIGHTS_PER_PASS
 
 /* built-in variable types */
 typedef enum MaterialBuiltinVar
@@ -90,13 +93,52 @@ typedef struct MaterialVariable
 	MaterialVariableHint hint;
 } MaterialVariable;
 
+/* uniforms any program might use, rather than being set by the material */
+typedef enum MaterialGlobalUniform
+{
+	MATERIAL_GLOBAL_MODEL,
+	MATERIAL_GLOBAL_SUN_COLOUR,
+	MATERIAL_GLOBAL_SUN_POSITION,
+	MATERIAL_GLOBAL_SUN_AMBIENCE,
+	MATERIAL_GLOBAL_FOG_COLOUR,
+	MATERIAL_GLOBAL_FOG_NEAR,
+	MATERIAL_GLOBAL_FOG_FAR,
+	MATERIAL_GLOBAL_NUM_LIGHTS,
+
+	MAX_MATERIAL_GLOBALS
+} MaterialGlobalUniform;
+
+typedef enum MaterialLightUniform
+{
+	MATERIAL_LIGHT_COLOUR,
+	MATERIAL_LIGHT_POSITION,
+	MATERIAL_LIGHT_RADIUS,
+
+	MAX_MATERIAL_LIGHT_UNIFORMS
+} MaterialLightUniform;
+
+/**
+ * Slots for the global uniforms, resolved once when the program is
+ * linked. Uniforms stick with the program, so we also track which
+ * version of the shared parameters it was last given.
+ */
+typedef struct MaterialProgramSlots
+{
+	int globals[ MAX_MATERIAL_GLOBALS ];
+	int lights[ MAX_MATERIAL_LIGHTS ][ MAX_MATERIAL_LIGHT_UNIFORMS ];
+
+	unsigned int frameParametersVersion;
+	unsigned int lightParametersVersion;
+} MaterialProgramSlots;
+
 typedef struct MaterialPass
 {
-	PLGShaderProgram *program;
-	PLGTextureFilter  textureFilter;
-	PLGBlend          blendMode[ 2 ];
-	MaterialVariable  variables[ MAX_MATERIAL_VARIABLES ];
-	unsigned int      numVariables;
+	PLGShaderProgram     *program;
+	MaterialProgramSlots *slots;
+	PLGTextureFilter      textureFilter;
+	PLGBlend              blendMode[ 2 ];
+	MaterialVariable      variables[ MAX_MATERIAL_VARIABLES ];
+	unsigned int          numVariables;
 
 	bool depthTest;
 	int  cullMode;
@@ -124,10 +166,22 @@ typedef struct YNCoreShaderProgramIndex
 	YNCoreMaterialPass defaultPass;
 
 	PLGShaderProgram        *internalPtr;
+	MaterialProgramSlots     slots;
 	struct PLLinkedListNode *node;
 } YNCoreShaderProgramIndex;
 
 void YnCore_Material_ParsePass( struct YNNodeBranch *root, YNCoreMaterialPass *materialPass );
+void YnCore_Material_ResolveProgramSlots( PLGShaderProgram *program, MaterialProgramSlots *slots );
+void YnCore_Material_UpdateFrameParameters( void );
+
+uint64_t YnCore_Material_GetSortKey( const YNCoreMaterial *material, float depth );
+void     YnCore_Material_DrawMeshWithTransform( YNCoreMaterial *material, PLGMesh *mesh, const PLMatrix4 *transform, const YNCoreLight *lights, unsigned int numLights );
+void     YnCore_Material_DrawMeshInstanced( YNCoreMaterial *material, PLGMesh *mesh, const PLMatrix4 *transforms, unsigned int numInstances, const YNCoreLight *lights, unsigned int numLights );
+void     YnCore_Material_BeginRecording( struct YNCoreCommandBuffer *buffer );
+void     YnCore_Material_EndRecording( void );
+void     YnCore_Material_ResetSharedUniforms( void );
+
+MaterialProgramSlots *YnCore_GetShaderProgramSlots( const PLGShaderProgram *program );
 
 void YnCore_InitializeMaterialSystem( void );
 void YnCore_ShutdownMaterialSystem( void );
@@ -0,0 +1,455 @@
+// SPDX-License-Identifier: LGPL-3.0-or-later
+// Copyright © 2020-2023 OldTimes Software, Mark E Sowden <hogsy@oldtimes-software.com>
+
+#include <SDL2/SDL.h>
+
+#include "core_private.h"
+#include "renderer.h"
+#include "world.h"
+#include "renderer_occlusion.h"
+
+#include "common_occlusion.h"
+
+/* Once everything in view has been frustum culled, the biggest faces
+ * that are left get drawn into a small depth buffer on the CPU, and the
+ * bounds of the sectors, faces and static objects are tested against it
+ * before any of them are submitted. The buffer is drawn in bands of rows,
+ * which are handed out between a few worker threads and the main thread. */
+
+#define OCC_BUFFER_WIDTH  256
+#define OCC_BUFFER_HEIGHT 128
+#define OCC_BAND_ROWS     8
+
+#define OCC_MAX_WORKER_THREADS 4
+
+/* not worth waking the workers up for less than this */
+#define OCC_MIN_THREADED_TRIANGLES 64
+
+/* faces are only drawn if they're at least this big relative to how far
+ * away they are, and only so many of them, since the nearest come first */
+#define OCC_MIN_OCCLUDER_SCALE     0.1f
+#define OCC_MAX_OCCLUDER_TRIANGLES 4096
+
+static CommonOcclusionBuffer occlusionBuffer;
+static PLVector3             viewOrigin;
+static bool                  isDrawing; /* taking occluders */
+static bool                  isReady;   /* occluders are drawn, and boxes can be tested */
+
+static void ( *drawRows )( CommonOcclusionBuffer *buffer, unsigned int firstRow, unsigned int numRows ) = Common_OcclusionBuffer_DrawRows;
+
+static SDL_Thread  *workerThreads[ OCC_MAX_WORKER_THREADS ];
+static unsigned int numWorkerThreads;
+static SDL_sem     *workSemaphore;
+static SDL_sem     *doneSemaphore;
+static SDL_atomic_t nextBand;
+static SDL_atomic_t workerShutdown;
+
+/****************************************
+ * WORKER THREADS
+ ****************************************/
+
+/**
+ * Draws whichever bands nobody else has got to yet. Each band only
+ * writes to its own rows, so there's nothing to lock.
+ */
+static void DrawBands( void )
+{
+	int numBands = ( int ) ( ( occlusionBuffer.height + OCC_BAND_ROWS - 1 ) / OCC_BAND_ROWS );
+	int band;
+	while ( ( band = SDL_AtomicAdd( &nextBand, 1 ) ) < numBands )
+		drawRows( &occlusionBuffer, ( unsigned int ) band * OCC_BAND_ROWS, OCC_BAND_ROWS );
+}
+
+static int WorkerThread( void *userData )
+{
+	( void ) ( userData );
+
+	while ( true )
+	{
+		SDL_SemWait( workSemaphore );
+		if ( SDL_AtomicGet( &workerShutdown ) )
+			break;
+
+		DrawBands();
+		SDL_SemPost( doneSemaphore );
+	}
+
+	return 0;
+}
+
+static void StartWorkerThreads( void )
+{
+	workSemaphore = SDL_CreateSemaphore( 0 );
+	doneSemaphore = SDL_CreateSemaphore( 0 );
+	if ( workSemaphore == NULL || doneSemaphore == NULL )
+	{
+		PRINT_WARNING( "Failed to create occlusion worker primitives: %s\n", SDL_GetError() );
+		return;
+	}
+
+	/* the main thread draws bands too, so leave a core for it */
+	int numThreads = SDL_GetCPUCount() - 1;
+	if ( numThreads > OCC_MAX_WORKER_THREADS )
+		numThreads = OCC_MAX_WORKER_THREADS;
+
+	SDL_AtomicSet( &workerShutdown, 0 );
+	for ( int i = 0; i < numThreads; ++i )
+	{
+		if ( ( workerThreads[ numWorkerThreads ] = SDL_CreateThread( WorkerThread, "OcclusionWorker", NULL ) ) == NULL )
+		{
+			PRINT_WARNING( "Failed to create occlusion worker thread: %s\n", SDL_GetError() );
+			break;
+		}
+
+		numWorkerThreads++;
+	}
+}
+
+static void StopWorkerThreads( void )
+{
+	SDL_AtomicSet( &workerShutdown, 1 );
+	for ( unsigned int i = 0; i < numWorkerThreads; ++i )
+		SDL_SemPost( workSemaphore );
+	for ( unsigned int i = 0; i < numWorkerThreads; ++i )
+		SDL_WaitThread( workerThreads[ i ], NULL );
+	numWorkerThreads = 0;
+
+	if ( workSemaphore != NULL )
+		SDL_DestroySemaphore( workSemaphore );
+	if ( doneSemaphore != NULL )
+		SDL_DestroySemaphore( doneSemaphore );
+	workSemaphore = NULL;
+	doneSemaphore = NULL;
+}
+
+/**
+ * Draws every band of the buffer, with the help of however many of
+ * the workers, and returns once they're all done.
+ */
+static void DrawBuffer( unsigned int numThreads )
+{
+	if ( numThreads > numWorkerThreads )
+		numThreads = numWorkerThreads;
+
+	SDL_AtomicSet( &nextBand, 0 );
+	for ( unsigned int i = 0; i < numThreads; ++i )
+		SDL_SemPost( workSemaphore );
+
+	DrawBands();
+
+	for ( unsigned int i = 0; i < numThreads; ++i )
+		SDL_SemWait( doneSemaphore );
+}
+
+void OCC_Initialize( void )
+{
+	if ( !Common_OcclusionBuffer_Create( &occlusionBuffer, OCC_BUFFER_WIDTH, OCC_BUFFER_HEIGHT ) )
+		return;
+
+	StartWorkerThreads();
+}
+
+void OCC_Shutdown( void )
+{
+	StopWorkerThreads();
+	Common_OcclusionBuffer_Destroy( &occlusionBuffer );
+	isDrawing = isReady = false;
+}
+
+/****************************************
+ * OCCLUDERS
+ ****************************************/
+
+static void BeginBuffer( YNCoreCamera *camera )
+{
+	/* PLMatrix4 is row-major, which is what the buffer expects */
+	PLMatrix4 viewProjection = PlMultiplyMatrix4( camera->internal->internal.proj, camera->internal->internal.view );
+	Common_OcclusionBuffer_Begin( &occlusionBuffer, ( const float * ) &viewProjection );
+
+	viewOrigin = camera->internal->position;
+}
+
+/**
+ * Returns true if occlusion culling is going to be used for the frame,
+ * in which case the occluders should be added and drawn before testing.
+ */
+bool OCC_BeginFrame( YNCoreCamera *camera )
+{
+	isDrawing = isReady = false;
+	if ( occlusionBuffer.depth == NULL )
+		return false;
+
+	PL_GET_CVAR( "r.occlusionCulling", occlusionCulling );
+	if ( occlusionCulling != NULL && !occlusionCulling->b_value )
+		return false;
+
+	BeginBuffer( camera );
+
+	isDrawing = true;
+	return true;
+}
+
+static void GetBounds( const PLCollisionAABB *aabb, CommonBVHBounds *bounds )
+{
+	bounds->mins = PlAddVector3( aabb->origin, aabb->mins );
+	bounds->maxs = PlAddVector3( aabb->origin, aabb->maxs );
+}
+
+/**
+ * Picks out the faces that are big enough, and near enough, to be worth
+ * drawing. Anything that can be seen through is left out.
+ */
+void OCC_AddOccluders( const YNCoreWorldMesh *mesh, const unsigned int *faces, unsigned int numFaces )
+{
+	if ( !isDrawing )
+		return;
+
+	for ( unsigned int i = 0; i < numFaces; ++i )
+	{
+		if ( occlusionBuffer.numTriangles >= OCC_MAX_OCCLUDER_TRIANGLES )
+			break;
+
+		if ( mesh->faceFlags[ faces[ i ] ] & ( WORLD_FACE_FLAG_PORTAL | WORLD_FACE_FLAG_MIRROR | WORLD_FACE_FLAG_SKIP ) )
+			continue;
+
+		const YNCoreWorldFace *face = mesh->faceTable[ faces[ i ] ];
+		if ( face->batchIndex >= mesh->numBatches || mesh->batches[ face->batchIndex ].isPortal )
+			continue;
+
+		CommonBVHBounds bounds;
+		GetBounds( &mesh->faceBounds[ faces[ i ] ], &bounds );
+
+		PLVector3 size   = PlSubtractVector3( bounds.maxs, bounds.mins );
+		PLVector3 centre = PlScaleVector3F( PlAddVector3( bounds.mins, bounds.maxs ), 0.5f );
+		PLVector3 delta  = PlSubtractVector3( centre, viewOrigin );
+		float     scale  = OCC_MIN_OCCLUDER_SCALE * OCC_MIN_OCCLUDER_SCALE;
+		if ( PlVector3DotProduct( size, size ) < PlVector3DotProduct( delta, delta ) * scale )
+			continue;
+
+		const PLVector3 *origin = &mesh->vertices[ face->vertices[ 0 ] ].position;
+		for ( unsigned int j = 2; j < face->numVertices; ++j )
+		{
+			Common_OcclusionBuffer_AddTriangle( &occlusionBuffer, origin,
+			                                    &mesh->vertices[ face->vertices[ j - 1 ] ].position,
+			                                    &mesh->vertices[ face->vertices[ j ] ].position );
+		}
+	}
+}
+
+void OCC_DrawOccluders( void )
+{
+	if ( !isDrawing )
+		return;
+
+	isDrawing = false;
+	if ( occlusionBuffer.numTriangles == 0 )
+		return;
+
+	DrawBuffer( ( occlusionBuffer.numTriangles >= OCC_MIN_THREADED_TRIANGLES ) ? numWorkerThreads : 0 );
+	g_gfxPerfStats.numOccluderTriangles += occlusionBuffer.numTriangles;
+
+	isReady = true;
+}
+
+/**
+ * Nothing else should be tested against the buffer once the frame's
+ * world has been drawn, since the view it was drawn from may change.
+ */
+void OCC_EndFrame( void )
+{
+	isDrawing = isReady = false;
+}
+
+/****************************************
+ * TESTING
+ ****************************************/
+
+/**
+ * Returns false if the box is entirely hidden behind the occluders.
+ * Always returns true if there's nothing drawn to test against.
+ */
+bool OCC_IsBoxVisible( const PLCollisionAABB *bounds )
+{
+	if ( !isReady )
+		return true;
+
+	CommonBVHBounds box;
+	GetBounds( bounds, &box );
+	return Common_OcclusionBuffer_TestBounds( &occlusionBuffer, &box );
+}
+
+/**
+ * Filters the given set of face indices down to just those that
+ * aren't hidden, and returns how many are left.
+ */
+unsigned int OCC_CullFaces( const YNCoreWorldMesh *mesh, unsigned int *faces, unsigned int numFaces )
+{
+	if ( !isReady )
+		return numFaces;
+
+	unsigned int numVisible = 0;
+	for ( unsigned int i = 0; i < numFaces; ++i )
+	{
+		CommonBVHBounds bounds;
+		GetBounds( &mesh->faceBounds[ faces[ i ] ], &bounds );
+		if ( !Common_OcclusionBuffer_TestBounds( &occlusionBuffer, &bounds ) )
+			continue;
+
+		faces[ numVisible++ ] = faces[ i ];
+	}
+
+	g_gfxPerfStats.numOccludedFaces += numFaces - numVisible;
+	return numVisible;
+}
+
+/****************************************
+ * BENCHMARK
+ ****************************************/
+
+#define OCC_BENCHMARK_DEFAULT_OCCLUDERS 512
+#define OCC_BENCHMARK_NUM_OBJECTS       10000
+#define OCC_BENCHMARK_FRAMES            60
+#define OCC_BENCHMARK_EXTENT            4096.0f
+
+static float RandomRange( float min, float max )
+{
+	return min + ( ( float ) rand() / ( float ) RAND_MAX ) * ( max - min );
+}
+
+static CommonBVHBounds RandomBox( float minSize, float maxSize )
+{
+	/* keep the camera out of them */
+	CommonBVHBounds box;
+	do
+	{
+		PLVector3 centre = PLVector3( RandomRange( -OCC_BENCHMARK_EXTENT, OCC_BENCHMARK_EXTENT ),
+		                              RandomRange( -OCC_BENCHMARK_EXTENT, OCC_BENCHMARK_EXTENT ),
+		                              RandomRange( -OCC_BENCHMARK_EXTENT, OCC_BENCHMARK_EXTENT ) );
+		PLVector3 extent = PLVector3( RandomRange( minSize, maxSize ), RandomRange( minSize, maxSize ), RandomRange( minSize, maxSize ) );
+		box.mins         = PlSubtractVector3( centre, extent );
+		box.maxs         = PlAddVector3( centre, extent );
+	} while ( box.mins.x < 0.0f && box.maxs.x > 0.0f && box.mins.y < 0.0f && box.maxs.y > 0.0f && box.mins.z < 0.0f && box.maxs.z > 0.0f );
+
+	return box;
+}
+
+static void AddBoxOccluder( const CommonBVHBounds *box )
+{
+	PLVector3 corners[ 8 ];
+	for ( unsigned int i = 0; i < 8; ++i )
+	{
+		corners[ i ] = PLVector3( ( i & 1 ) ? box->maxs.x : box->mins.x,
+		                          ( i & 2 ) ? box->maxs.y : box->mins.y,
+		                          ( i & 4 ) ? box->maxs.z : box->mins.z );
+	}
+
+	static const unsigned int sides[ 6 ][ 4 ] = {
+	        { 0, 1, 3, 2 },
+	        { 4, 5, 7, 6 },
+	        { 0, 1, 5, 4 },
+	        { 2, 3, 7, 6 },
+	        { 0, 2, 6, 4 },
+	        { 1, 3, 7, 5 },
+	};
+	for ( unsigned int i = 0; i < 6; ++i )
+	{
+		const unsigned int *side = sides[ i ];
+		Common_OcclusionBuffer_AddTriangle( &occlusionBuffer, &corners[ side[ 0 ] ], &corners[ side[ 1 ] ], &corners[ side[ 2 ] ] );
+		Common_OcclusionBuffer_AddTriangle( &occlusionBuffer, &corners[ side[ 0 ] ], &corners[ side[ 2 ] ], &corners[ side[ 3 ] ] );
+	}
+}
+
+/**
+ * Scatters a load of big boxes to draw as occluders, and a load of
+ * small ones to test against them, around a camera at the origin. The
+ * camera is spun around over a number of frames, and each frame is
+ * drawn with the scalar rasteriser, the SIMD one, and then the SIMD one
+ * across the workers.
+ */
+void OCC_BenchmarkCommand( unsigned int argc, char **argv )
+{
+	if ( occlusionBuffer.depth == NULL )
+	{
+		PRINT_WARNING( "No occlusion buffer to benchmark!\n" );
+		return;
+	}
+
+	unsigned int numOccluders = OCC_BENCHMARK_DEFAULT_OCCLUDERS;
+	if ( argc > 1 )
+	{
+		numOccluders = strtoul( argv[ 1 ], NULL, 10 );
+		if ( numOccluders == 0 )
+		{
+			PRINT_WARNING( "Invalid number of occluders specified!\n" );
+			return;
+		}
+	}
+
+	srand( 0 );
+
+	CommonBVHBounds *occluders = PL_NEW_( CommonBVHBounds, numOccluders );
+	for ( unsigned int i = 0; i < numOccluders; ++i )
+		occluders[ i ] = RandomBox( 64.0f, 512.0f );
+
+	CommonBVHBounds *objects = PL_NEW_( CommonBVHBounds, OCC_BENCHMARK_NUM_OBJECTS );
+	for ( unsigned int i = 0; i < OCC_BENCHMARK_NUM_OBJECTS; ++i )
+		objects[ i ] = RandomBox( 8.0f, 64.0f );
+
+	size_t bufferSize  = sizeof( float ) * occlusionBuffer.width * occlusionBuffer.height;
+	float *scalarDepth = PlMAllocA( bufferSize );
+
+	YNCoreCamera *camera = YnCore_Camera_Create( "occlusionBenchmark", &pl_vecOrigin3, &pl_vecOrigin3 );
+
+	double       setupTime = 0.0, scalarTime = 0.0, simdTime = 0.0, threadedTime = 0.0, testTime = 0.0;
+	unsigned int numTriangles = 0, numCulled = 0, numMismatches = 0;
+	for ( unsigned int i = 0; i < OCC_BENCHMARK_FRAMES; ++i )
+	{
+		YnCore_Camera_SetAngles( camera, &PLVector3( 0.0f, ( 360.0f / OCC_BENCHMARK_FRAMES ) * i, 0.0f ) );
+		PlgSetupCamera( camera->internal );
+
+		double startTime = PlGetCurrentSeconds();
+		BeginBuffer( camera );
+		for ( unsigned int j = 0; j < numOccluders; ++j )
+			AddBoxOccluder( &occluders[ j ] );
+		setupTime += PlGetCurrentSeconds() - startTime;
+		numTriangles += occlusionBuffer.numTriangles;
+
+		drawRows  = Common_OcclusionBuffer_DrawRowsScalar;
+		startTime = PlGetCurrentSeconds();
+		DrawBuffer( 0 );
+		scalarTime += PlGetCurrentSeconds() - startTime;
+		memcpy( scalarDepth, occlusionBuffer.depth, bufferSize );
+
+		drawRows  = Common_OcclusionBuffer_DrawRows;
+		startTime = PlGetCurrentSeconds();
+		DrawBuffer( 0 );
+		simdTime += PlGetCurrentSeconds() - startTime;
+
+		startTime = PlGetCurrentSeconds();
+		DrawBuffer( numWorkerThreads );
+		threadedTime += PlGetCurrentSeconds() - startTime;
+
+		if ( memcmp( scalarDepth, occlusionBuffer.depth, bufferSize ) != 0 )
+			numMismatches++;
+
+		startTime = PlGetCurrentSeconds();
+		for ( unsigned int j = 0; j < OCC_BENCHMARK_NUM_OBJECTS; ++j )
+			numCulled += !Common_OcclusionBuffer_TestBounds( &occlusionBuffer, &objects[ j ] );
+		testTime += PlGetCurrentSeconds() - startTime;
+	}
+
+	YnCore_Camera_Destroy( camera );
+
+	PRINT( "Drew %u frames of %u occluders (%.1f triangles per frame):\n", OCC_BENCHMARK_FRAMES, numOccluders, ( double ) numTriangles / OCC_BENCHMARK_FRAMES );
+	PRINT( "  setup:    %.3fms\n", setupTime * 1000.0 / OCC_BENCHMARK_FRAMES );
+	PRINT( "  scalar:   %.3fms (%.2fM triangles per second)\n", scalarTime * 1000.0 / OCC_BENCHMARK_FRAMES, numTriangles / scalarTime / 1000000.0 );
+	PRINT( "  simd:     %.3fms (%.2fM triangles per second)\n", simdTime * 1000.0 / OCC_BENCHMARK_FRAMES, numTriangles / simdTime / 1000000.0 );
+	PRINT( "  threaded: %.3fms (%.2fM triangles per second, %u workers)\n", threadedTime * 1000.0 / OCC_BENCHMARK_FRAMES, numTriangles / threadedTime / 1000000.0, numWorkerThreads );
+	PRINT( "  testing:  %.3fms (%.1f of %u objects culled per frame)\n", testTime * 1000.0 / OCC_BENCHMARK_FRAMES, ( double ) numCulled / OCC_BENCHMARK_FRAMES, OCC_BENCHMARK_NUM_OBJECTS );
+	if ( numMismatches > 0 )
+		PRINT_WARNING( "Scalar and SIMD depths differ on %u frames!\n", numMismatches );
+
+	PL_DELETE( scalarDepth );
+	PL_DELETE( objects );
+	PL_DELETE( occluders );
+}
@@ -0,0 +1,17 @@
+// SPDX-License-Identifier: LGPL-3.0-or-later
+// Copyright © 2020-2023 OldTimes Software, Mark E Sowden <hogsy@oldtimes-software.com>
+
+#pragma once
+
+void OCC_Initialize( void );
+void OCC_Shutdown( void );
+
+bool OCC_BeginFrame( YNCoreCamera *camera );
+void OCC_AddOccluders( const YNCoreWorldMesh *mesh, const unsigned int *faces, unsigned int numFaces );
+void OCC_DrawOccluders( void );
+void OCC_EndFrame( void );
+
+bool         OCC_IsBoxVisible( const PLCollisionAABB *bounds );
+unsigned int OCC_CullFaces( const YNCoreWorldMesh *mesh, unsigned int *faces, unsigned int numFaces );
+
+void OCC_BenchmarkCommand( unsigned int argc, char **argv );
@@ -1,22 +1,12 @@
 // SPDX-License-Identifier: LGPL-3.0-or-later
 // Copyright © 2020-2023 OldTimes Software, Mark E Sowden <hogsy@oldtimes-software.com>
 
-#include <plcore/pl_linkedlist.h>
-
 #include "core_private.h"
 #include "renderer_particle.h"
 #include "renderer.h"
 
 #include <yin/node.h>
 
-void PS_Initialize( void )
-{
-}
-
-void PS_Shutdown( void )
-{
-}
-
 static void PS_CB_DestroyEmitterTemplate( void *userData )
 {
 	PSEmitter *emitter = userData;
@@ -24,8 +14,6 @@ static void PS_CB_DestroyEmitterTemplate( void *userData )
 
 	YnCore_Material_Release( emitter->material );
 
-	PlgDestroyMesh( emitter->mesh );
-
 	PlFree( emitter );
 }
 
@@ -87,6 +75,8 @@ void PS_CacheEmitterTemplate( const char *path )
 	MemoryManager_AddReference( &emitter->mem );
 }
 
+static uint32_t emitterSeed;
+
 PSEmitter *PS_SpawnEmitterTemplateInstance( const char *path )
 {
 	PSEmitter *emitterTemplate = MM_GetCachedData( path, MEM_CACHE_PARTICLES );
@@ -99,17 +89,17 @@ PSEmitter *PS_SpawnEmitterTemplateInstance( const char *path )
 	PSEmitter *emitter = PlMAlloc( sizeof( PSEmitter ), true );
 	memcpy( emitter, emitterTemplate, sizeof( PSEmitter ) );
 
+	/* each instance gets its own particles */
+	PL_ZERO_( emitter->particles );
+	Common_ParticlePool_Seed( &emitter->particles, ++emitterSeed );
+
 	return emitter;
 }
 
 PSEmitter *PS_SpawnEmitter( void )
 {
 	PSEmitter *emitter = PlMAlloc( sizeof( PSEmitter ), true );
-	emitter->particles = PlCreateLinkedList();
-
-	emitter->mesh = PlgCreateMesh( PLG_MESH_TRIANGLE_STRIP, PLG_DRAW_DYNAMIC, 1000, 1000 );
-	if ( emitter->mesh == NULL )
-		PRINT_ERROR( "Failed to create emitter mesh!\nPL: %s\n", PlGetError() );
+	Common_ParticlePool_Seed( &emitter->particles, ++emitterSeed );
 
 	emitter->startScale = 10.0f;
 	emitter->endScale = 0.0f;
@@ -124,175 +114,382 @@ void PS_DestroyEmitter( PSEmitter *emitter )
 	if ( emitter == NULL )
 		return;
 
-	/* free all the particles we've created */
-	PLLinkedListNode *node = PlGetFirstNode( emitter->particles );
-	while ( node != NULL )
-	{
-		PSParticle *particle = PlGetLinkedListNodeUserData( node );
-		node = PlGetNextLinkedListNode( node );
-		PlFree( particle );
-	}
-
 	if ( emitter->material != NULL )
 		YnCore_Material_Release( emitter->material );
 
-	PlDestroyLinkedList( emitter->particles );
+	Common_ParticlePool_Destroy( &emitter->particles );
 	PlFree( emitter );
 }
 
-int U_Rand_I32( int max )
+/**
+ * Returns a random value between 0 and max, from the emitter's own
+ * generator rather than the global one.
+ */
+static inline float PS_Random( PSEmitter *emitter, float max )
 {
-	return ( rand() % max );
+	return Common_ParticlePool_Random( &emitter->particles ) * max;
 }
 
-static void PS_TickParticle( PSParticle *particle, PSEmitter *emitter )
+static void PS_SpawnParticle( PSEmitter *emitter )
 {
-	if ( particle->life <= 0 )
-	{
-		PlDestroyLinkedListNode( particle->node );
-		PlFree( particle );
+	CommonParticlePool *pool = &emitter->particles;
+
+	/* only grows when the emitter asks for more than it's had before */
+	if ( !Common_ParticlePool_Reserve( pool, ( unsigned int ) emitter->maxParticles ) )
+		return;
+
+	unsigned int i = Common_ParticlePool_Spawn( pool );
+	if ( i == CMN_PARTICLE_POOL_FULL )
 		return;
+
+	pool->x[ i ] = emitter->transform.translation.x + ( PS_Random( emitter, emitter->transformVar.translation.x ) - PS_Random( emitter, emitter->transformVar.translation.x ) );
+	pool->y[ i ] = emitter->transform.translation.y + ( PS_Random( emitter, emitter->transformVar.translation.y ) - PS_Random( emitter, emitter->transformVar.translation.y ) );
+	pool->z[ i ] = emitter->transform.translation.z + ( PS_Random( emitter, emitter->transformVar.translation.z ) - PS_Random( emitter, emitter->transformVar.translation.z ) );
+
+	int life = emitter->particleLife + ( emitter->particleLifeVar * ( int ) PS_Random( emitter, 100.0f ) );
+	if ( life <= 0 )
+		life = 1;
+
+	pool->life[ i ] = life;
+
+	PLColourF32 startColour, endColour;
+	startColour.r = emitter->startColour.r + PS_Random( emitter, emitter->startColourVar.r );
+	startColour.g = emitter->startColour.g + PS_Random( emitter, emitter->startColourVar.g );
+	startColour.b = emitter->startColour.b + PS_Random( emitter, emitter->startColourVar.b );
+	startColour.a = emitter->startColour.a + PS_Random( emitter, emitter->startColourVar.a );
+	endColour.r   = emitter->endColour.r + PS_Random( emitter, emitter->endColourVar.r );
+	endColour.g   = emitter->endColour.g + PS_Random( emitter, emitter->endColourVar.g );
+	endColour.b   = emitter->endColour.b + PS_Random( emitter, emitter->endColourVar.b );
+	endColour.a   = emitter->endColour.a + PS_Random( emitter, emitter->endColourVar.a );
+
+	pool->r[ i ]      = startColour.r;
+	pool->g[ i ]      = startColour.g;
+	pool->b[ i ]      = startColour.b;
+	pool->a[ i ]      = startColour.a;
+	pool->deltaR[ i ] = ( endColour.r - startColour.r ) / ( float ) life;
+	pool->deltaG[ i ] = ( endColour.g - startColour.g ) / ( float ) life;
+	pool->deltaB[ i ] = ( endColour.b - startColour.b ) / ( float ) life;
+	pool->deltaA[ i ] = ( endColour.a - startColour.a ) / ( float ) life;
+
+	float startScale      = emitter->startScale + PS_Random( emitter, emitter->scaleVar );
+	float endScale        = emitter->endScale + PS_Random( emitter, emitter->scaleVar );
+	pool->scale[ i ]      = startScale;
+	pool->deltaScale[ i ] = ( endScale - startScale ) / ( float ) life;
+}
+
+void PS_TickEmitter( PSEmitter *emitter )
+{
+	if ( ( int ) emitter->particles.numParticles < emitter->maxParticles && emitter->numTicks > emitter->maxTicks )
+	{
+		PS_SpawnParticle( emitter );
+
+		emitter->numTicks = 0;
+		emitter->maxTicks = emitter->emissionRate + ( emitter->emissionVar * ( int ) PS_Random( emitter, 100.0f ) );
+	}
+
+	/* simulate all of the existing particles that we've emitted */
+	CommonParticleForce force;
+	force.force    = emitter->force;
+	force.forceVar = emitter->forceVar;
+
+	CommonBVHBounds bounds;
+	if ( Common_ParticlePool_Tick( &emitter->particles, &force, &bounds ) > 0 )
+	{
+		emitter->bounds.mins = bounds.mins;
+		emitter->bounds.maxs = bounds.maxs;
 	}
 
-	particle->oldTransform = particle->transform;
+	emitter->bounds.absOrigin = PLVector3( ( emitter->bounds.mins.x + emitter->bounds.maxs.x ) / 2, ( emitter->bounds.mins.y + emitter->bounds.maxs.y ) / 2, ( emitter->bounds.mins.z + emitter->bounds.maxs.z ) / 2 );
+	emitter->bounds.origin = emitter->transform.translation;
 
-	PLVector3 force;
-	force.x = emitter->force.x + ( PlGenerateRandomFloat( emitter->forceVar.x ) );
-	force.y = emitter->force.y + ( PlGenerateRandomFloat( emitter->forceVar.y ) );
-	force.z = emitter->force.z + ( PlGenerateRandomFloat( emitter->forceVar.z ) );
+	emitter->numTicks++;
+}
 
-	particle->transform.translation = PlAddVector3( particle->transform.translation, force );
+/****************************************
+ * DRAWING
+ ****************************************/
 
-	particle->bounds.origin = particle->transform.translation;
+#define PS_MAX_BATCH_QUADS 4096
 
-	particle->oldColour = particle->colour;
-	particle->colour = PlAddColourF32( &particle->colour, &particle->deltaColour );
+/* every system drawn in a frame is streamed through this one mesh */
+static PLGMesh *batchMesh;
 
-	particle->scale += particle->deltaScale;
+static const PSEmitter **queuedEmitters;
+static unsigned int      numQueuedEmitters;
+static unsigned int      maxQueuedEmitters;
 
-	/* keep the emitter bounds updated */
-	if ( emitter->bounds.maxs.x < particle->transform.translation.x ) emitter->bounds.maxs.x = particle->transform.translation.x;
-	if ( emitter->bounds.maxs.y < particle->transform.translation.y ) emitter->bounds.maxs.y = particle->transform.translation.y;
-	if ( emitter->bounds.maxs.z < particle->transform.translation.z ) emitter->bounds.maxs.z = particle->transform.translation.z;
-	if ( emitter->bounds.mins.x > particle->transform.translation.x ) emitter->bounds.mins.x = particle->transform.translation.x;
-	if ( emitter->bounds.mins.y > particle->transform.translation.y ) emitter->bounds.mins.y = particle->transform.translation.y;
-	if ( emitter->bounds.mins.z > particle->transform.translation.z ) emitter->bounds.mins.z = particle->transform.translation.z;
+void PS_Initialize( void )
+{
+	batchMesh = PlgCreateMesh( PLG_MESH_TRIANGLES, PLG_DRAW_DYNAMIC, PS_MAX_BATCH_QUADS * 2, PS_MAX_BATCH_QUADS * CMN_PARTICLE_QUAD_VERTICES );
+	if ( batchMesh == NULL )
+		PRINT_ERROR( "Failed to create particle mesh!\nPL: %s\n", PlGetError() );
+}
 
-	particle->life--;
+void PS_Shutdown( void )
+{
+	PlgDestroyMesh( batchMesh );
+	batchMesh = NULL;
+
+	PL_DELETE( queuedEmitters );
+	queuedEmitters    = NULL;
+	numQueuedEmitters = maxQueuedEmitters = 0;
 }
 
-void PS_TickEmitter( PSEmitter *emitter )
+/**
+ * Queues the emitter's particles up to be drawn by PS_DrawBatches,
+ * alongside any others that share its material.
+ */
+void PS_Draw( const PSEmitter *emitter, const YNCoreCamera *camera )
 {
-	int numParticles = ( int ) PlGetNumLinkedListNodes( emitter->particles );
-	if ( numParticles < emitter->maxParticles && emitter->numTicks > emitter->maxTicks )
+	if ( emitter->material == NULL || emitter->particles.numParticles == 0 )
+		return;
+
+	if ( numQueuedEmitters >= maxQueuedEmitters )
 	{
-		PSParticle *particle = PlMAlloc( sizeof( PSParticle ), true );
-		particle->emitter = emitter;
-
-		PLVector3 translationMod;
-		translationMod.x = emitter->transform.translation.x + ( PlGenerateRandomFloat( emitter->transformVar.translation.x ) + PlGenerateRandomFloat( -emitter->transformVar.translation.x ) );
-		translationMod.y = emitter->transform.translation.y + ( PlGenerateRandomFloat( emitter->transformVar.translation.y ) + PlGenerateRandomFloat( -emitter->transformVar.translation.y ) );
-		translationMod.z = emitter->transform.translation.z + ( PlGenerateRandomFloat( emitter->transformVar.translation.z ) + PlGenerateRandomFloat( -emitter->transformVar.translation.z ) );
-		particle->transform.translation = translationMod;
-
-		particle->life = emitter->particleLife + ( emitter->particleLifeVar * U_Rand_I32( 100 ) );
-
-		PLColourF32 startColour, endColour;
-		startColour.r = emitter->startColour.r + ( emitter->startColourVar.r * PlGenerateRandomFloat( 1.0f ) );
-		startColour.g = emitter->startColour.g + ( emitter->startColourVar.g * PlGenerateRandomFloat( 1.0f ) );
-		startColour.b = emitter->startColour.b + ( emitter->startColourVar.b * PlGenerateRandomFloat( 1.0f ) );
-		startColour.a = emitter->startColour.a + ( emitter->startColourVar.a * PlGenerateRandomFloat( 1.0f ) );
-		endColour.r = emitter->endColour.r + ( emitter->endColourVar.r * PlGenerateRandomFloat( 1.0f ) );
-		endColour.g = emitter->endColour.g + ( emitter->endColourVar.g * PlGenerateRandomFloat( 1.0f ) );
-		endColour.b = emitter->endColour.b + ( emitter->endColourVar.b * PlGenerateRandomFloat( 1.0f ) );
-		endColour.a = emitter->endColour.a + ( emitter->endColourVar.a * PlGenerateRandomFloat( 1.0f ) );
-
-		particle->colour = startColour;
-		particle->deltaColour.r = ( ( endColour.r - startColour.r ) / 1.0f ) / ( float ) particle->life;
-		particle->deltaColour.g = ( ( endColour.g - startColour.g ) / 1.0f ) / ( float ) particle->life;
-		particle->deltaColour.b = ( ( endColour.b - startColour.b ) / 1.0f ) / ( float ) particle->life;
-		particle->deltaColour.a = ( ( endColour.a - startColour.a ) / 1.0f ) / ( float ) particle->life;
-
-		float startScale = emitter->startScale + ( emitter->scaleVar * PlGenerateRandomFloat( 1.0f ) );
-		float endScale = emitter->endScale + ( emitter->scaleVar * PlGenerateRandomFloat( 1.0f ) );
-		particle->deltaScale = ( ( endScale - startScale ) / 1.0f ) / ( float ) particle->life;
-
-		particle->bounds.maxs = PLVector3( 2.0f, 2.0f, 2.0f );
-		particle->bounds.mins = PLVector3( -2.0f, -2.0f, -2.0f );
-
-		particle->node = PlInsertLinkedListNode( emitter->particles, particle );
+		maxQueuedEmitters = ( maxQueuedEmitters == 0 ) ? 64 : maxQueuedEmitters * 2;
+		queuedEmitters    = PlReAlloc( queuedEmitters, sizeof( PSEmitter * ) * maxQueuedEmitters, true );
+	}
 
-		emitter->numTicks = 0;
-		emitter->maxTicks = emitter->emissionRate + ( emitter->emissionVar * U_Rand_I32( 100 ) );
+	queuedEmitters[ numQueuedEmitters++ ] = emitter;
+}
+
+static int PS_CompareEmitterMaterials( const void *a, const void *b )
+{
+	uintptr_t x = ( uintptr_t ) ( *( const PSEmitter ** ) a )->material;
+	uintptr_t y = ( uintptr_t ) ( *( const PSEmitter ** ) b )->material;
+	return ( x > y ) - ( x < y );
+}
+
+/**
+ * The triangles only depend on how many quads there are, so they're
+ * left alone unless that changes.
+ */
+static void PS_FlushBatch( YNCoreMaterial *material, unsigned int numQuads )
+{
+	if ( numQuads == 0 )
+		return;
+
+	if ( batchMesh->num_triangles > numQuads * 2 )
+		PlgClearMeshTriangles( batchMesh );
+
+	for ( unsigned int i = batchMesh->num_triangles / 2; i < numQuads; ++i )
+	{
+		unsigned int v = i * CMN_PARTICLE_QUAD_VERTICES;
+		PlgAddMeshTriangle( batchMesh, v, v + 1, v + 2 );
+		PlgAddMeshTriangle( batchMesh, v + 2, v + 1, v + 3 );
 	}
 
-	/* simulate all of the existing particles that we've emitted */
-	unsigned int      i = 0;
-	PLLinkedListNode *node = PlGetFirstNode( emitter->particles );
-	while ( node != NULL )
+	batchMesh->num_verts = numQuads * CMN_PARTICLE_QUAD_VERTICES;
+	batchMesh->isDirty   = true;
+
+	YnCore_Material_DrawMesh( material, batchMesh, NULL, 0 );
+}
+
+static CommonParticleVertexLayout PS_GetVertexLayout( PLGVertex *vertices )
+{
+	CommonParticleVertexLayout layout;
+	layout.vertices       = vertices;
+	layout.stride         = sizeof( PLGVertex );
+	layout.positionOffset = offsetof( PLGVertex, position );
+	layout.colourOffset   = offsetof( PLGVertex, colour );
+	layout.uvOffset       = offsetof( PLGVertex, st );
+	return layout;
+}
+
+/**
+ * Draws everything queued up by PS_Draw. Quads facing the camera are
+ * written straight into the shared mesh, and it's only sent off when
+ * the material changes or it runs out of room.
+ */
+void PS_DrawBatches( const YNCoreCamera *camera )
+{
+	if ( numQueuedEmitters == 0 )
+		return;
+
+	if ( batchMesh == NULL )
+	{
+		numQueuedEmitters = 0;
+		return;
+	}
+
+	qsort( queuedEmitters, numQueuedEmitters, sizeof( PSEmitter * ), PS_CompareEmitterMaterials );
+
+	PLVector3 left, up, forward;
+	PlAnglesAxes( camera->internal->angles, &left, &up, &forward );
+	PLVector3 right = PlInverseVector3( left );
+
+	PlMatrixMode( PL_MODELVIEW_MATRIX );
+	PlPushMatrix();
+	PlLoadIdentityMatrix();
+
+	YNCoreMaterial *material = queuedEmitters[ 0 ]->material;
+	unsigned int    numQuads = 0;
+	for ( unsigned int i = 0; i < numQueuedEmitters; ++i )
 	{
-		PSParticle *particle = PlGetLinkedListNodeUserData( node );
-		if ( i == 0 )
+		const PSEmitter *emitter = queuedEmitters[ i ];
+		if ( emitter->material != material )
 		{
-			emitter->bounds.maxs = ( PLVector3 ){ particle->transform.translation.x, particle->transform.translation.y, particle->transform.translation.z };
-			emitter->bounds.mins = ( PLVector3 ){ particle->transform.translation.x, particle->transform.translation.y, particle->transform.translation.z };
+			PS_FlushBatch( material, numQuads );
+			material = emitter->material;
+			numQuads = 0;
 		}
 
-		node = PlGetNextLinkedListNode( node );
-		PS_TickParticle( particle, emitter );
+		const CommonParticlePool *pool = &emitter->particles;
+		for ( unsigned int first = 0; first < pool->numParticles; )
+		{
+			if ( numQuads == PS_MAX_BATCH_QUADS )
+			{
+				PS_FlushBatch( material, numQuads );
+				numQuads = 0;
+			}
+
+			unsigned int count = pool->numParticles - first;
+			if ( count > PS_MAX_BATCH_QUADS - numQuads )
+				count = PS_MAX_BATCH_QUADS - numQuads;
 
-		++i;
+			CommonParticleVertexLayout layout = PS_GetVertexLayout( &batchMesh->vertices[ numQuads * CMN_PARTICLE_QUAD_VERTICES ] );
+			Common_ParticlePool_BuildQuads( pool, first, count, &right, &up, &layout );
+
+			numQuads += count;
+			first += count;
+		}
 	}
 
-	emitter->bounds.absOrigin = PLVector3( ( emitter->bounds.mins.x + emitter->bounds.maxs.x ) / 2, ( emitter->bounds.mins.y + emitter->bounds.maxs.y ) / 2, ( emitter->bounds.mins.z + emitter->bounds.maxs.z ) / 2 );
-	emitter->bounds.origin = emitter->transform.translation;
+	PS_FlushBatch( material, numQuads );
 
-	emitter->numTicks++;
+	PlPopMatrix();
+
+	numQueuedEmitters = 0;
 }
 
-void PS_Draw( const PSEmitter *emitter, const YNCoreCamera *camera )
-{
-	PlgSetShaderProgram( defaultShaderPrograms[ RS_SHADER_DEFAULT_ALPHA ] );
+/****************************************
+ * BENCHMARK
+ ****************************************/
 
-	PlMatrixMode( PL_MODELVIEW_MATRIX );
-	PlPushMatrix();
+#define PARTICLE_BENCHMARK_DEFAULT_PARTICLES 1000000
+#define PARTICLE_BENCHMARK_PER_EMITTER       10000
+#define PARTICLE_BENCHMARK_TICKS             30
 
-	PlLoadIdentityMatrix();
+static void PS_FillBenchmarkPools( CommonParticlePool *pools, unsigned int numPools, unsigned int numParticles )
+{
+	for ( unsigned int i = 0; i < numPools; ++i )
+	{
+		CommonParticlePool *pool = &pools[ i ];
+		Common_ParticlePool_Destroy( pool );
+		Common_ParticlePool_Seed( pool, i + 1 );
 
-	//R_DrawAxesPivot( emitter->transform.translation, PlQuaternionToEuler( &emitter->transform.rotation ) );
-	//PlgDrawBoundingVolume( &emitter->bounds, PLColour( 255, 0, 255, 255 ) );
+		unsigned int num = numParticles - ( i * PARTICLE_BENCHMARK_PER_EMITTER );
+		if ( num > PARTICLE_BENCHMARK_PER_EMITTER )
+			num = PARTICLE_BENCHMARK_PER_EMITTER;
 
-	PlgClearMesh( emitter->mesh );
+		Common_ParticlePool_Reserve( pool, num );
+		for ( unsigned int j = 0; j < num; ++j )
+		{
+			unsigned int p        = Common_ParticlePool_Spawn( pool );
+			pool->x[ p ]          = Common_ParticlePool_Random( pool ) * 512.0f;
+			pool->y[ p ]          = Common_ParticlePool_Random( pool ) * 512.0f;
+			pool->z[ p ]          = Common_ParticlePool_Random( pool ) * 512.0f;
+			pool->velocityY[ p ]  = Common_ParticlePool_Random( pool );
+			pool->r[ p ]          = pool->g[ p ] = pool->b[ p ] = pool->a[ p ] = 1.0f;
+			pool->deltaA[ p ]     = -0.01f;
+			pool->scale[ p ]      = 10.0f;
+			pool->deltaScale[ p ] = -0.1f;
+			/* a few die along the way, so removal is part of what's timed */
+			pool->life[ p ]       = 1 + ( int32_t ) ( Common_ParticlePool_Random( pool ) * PARTICLE_BENCHMARK_TICKS * 8 );
+		}
+	}
+}
+
+static double PS_TimeBenchmarkPools( CommonParticlePool *pools, unsigned int numPools, bool scalar, uint64_t *numParticleTicks )
+{
+	CommonParticleForce force;
+	force.force    = PLVector3( 0.0f, -0.5f, 0.0f );
+	force.forceVar = PLVector3( 0.05f, 0.05f, 0.05f );
 
-	PlgSetCullMode( PLG_CULL_NONE );
+	*numParticleTicks = 0;
 
-	PLLinkedListNode *node = PlGetFirstNode( emitter->particles );
-	while ( node != NULL )
+	double startTime = PlGetCurrentSeconds();
+	for ( unsigned int i = 0; i < PARTICLE_BENCHMARK_TICKS; ++i )
 	{
-		PSParticle *particle = PlGetLinkedListNodeUserData( node );
+		for ( unsigned int j = 0; j < numPools; ++j )
+		{
+			CommonBVHBounds bounds;
+			*numParticleTicks += scalar ? Common_ParticlePool_TickScalar( &pools[ j ], &force, &bounds )
+			                            : Common_ParticlePool_Tick( &pools[ j ], &force, &bounds );
+		}
+	}
+
+	return PlGetCurrentSeconds() - startTime;
+}
+
+/**
+ * Times writing out quads for every particle, into a scratch buffer
+ * rather than anything the driver will see.
+ */
+static double PS_TimeBenchmarkQuads( const CommonParticlePool *pools, unsigned int numPools, uint64_t *numVertices )
+{
+	PLGVertex                 *vertices = PL_NEW_( PLGVertex, PARTICLE_BENCHMARK_PER_EMITTER * CMN_PARTICLE_QUAD_VERTICES );
+	CommonParticleVertexLayout layout   = PS_GetVertexLayout( vertices );
 
-		//PlgDrawBoundingVolume( &particle->bounds, PlColourF32ToU8( &particle->colour ) );
+	PLVector3 right = PLVector3( 0.70710678f, 0.0f, -0.70710678f );
+	PLVector3 up    = PLVector3( 0.0f, 1.0f, 0.0f );
 
-		float x = particle->transform.translation.x;
-		float y = particle->transform.translation.y;
-		float z = particle->transform.translation.z;
+	*numVertices = 0;
 
-		PLColour colour = PlColourF32ToU8( &particle->colour );
+	double startTime = PlGetCurrentSeconds();
+	for ( unsigned int i = 0; i < PARTICLE_BENCHMARK_TICKS; ++i )
+	{
+		for ( unsigned int j = 0; j < numPools; ++j )
+			*numVertices += Common_ParticlePool_BuildQuads( &pools[ j ], 0, pools[ j ].numParticles, &right, &up, &layout );
+	}
+	double time = PlGetCurrentSeconds() - startTime;
 
-		unsigned int a = PlgAddMeshVertex( emitter->mesh, PLVector3( x - particle->scale, y - particle->scale, z - particle->scale ), pl_vecOrigin3, colour, PLVector2( 0.0f, 0.0f ) );
-		unsigned int b = PlgAddMeshVertex( emitter->mesh, PLVector3( x - particle->scale, y - particle->scale, z + particle->scale ), pl_vecOrigin3, colour, PLVector2( 0.0f, 1.0f ) );
-		//unsigned int c = PlgAddMeshVertex( emitter->mesh, PLVector3( x + particle->scale, y - particle->scale, z - particle->scale ), pl_vecOrigin3, colour, PLVector2( 1.0f, 0.0f ) );
-		//unsigned int d = PlgAddMeshVertex( emitter->mesh, PLVector3( x + particle->scale, y - particle->scale, z + particle->scale ), pl_vecOrigin3, colour, PLVector2( 1.0f, 1.0f ) );
+	PL_DELETE( vertices );
 
-		//PlgAddMeshTriangle( emitter->mesh, a, b, c );
-		//PlgAddMeshTriangle( emitter->mesh, c, b, d );
+	return time;
+}
 
-		node = PlGetNextLinkedListNode( node );
+/**
+ * Ticks a large number of particles without drawing them, split across
+ * emitter sized pools, and reports the cost of each particle per tick,
+ * and then of building the quads that would be drawn for them.
+ */
+void PS_BenchmarkCommand( unsigned int argc, char **argv )
+{
+	unsigned int numParticles = PARTICLE_BENCHMARK_DEFAULT_PARTICLES;
+	if ( argc > 1 )
+	{
+		numParticles = strtoul( argv[ 1 ], NULL, 10 );
+		if ( numParticles == 0 )
+		{
+			PRINT_WARNING( "Invalid number of particles specified!\n" );
+			return;
+		}
 	}
 
-	YnCore_Material_DrawMesh( emitter->material, emitter->mesh, NULL, 0 );
+	unsigned int        numPools = ( numParticles + PARTICLE_BENCHMARK_PER_EMITTER - 1 ) / PARTICLE_BENCHMARK_PER_EMITTER;
+	CommonParticlePool *pools    = PL_NEW_( CommonParticlePool, numPools );
 
-	PlgSetCullMode( PLG_CULL_POSITIVE );
+	uint64_t numSimdTicks;
+	PS_FillBenchmarkPools( pools, numPools, numParticles );
+	double simdTime = PS_TimeBenchmarkPools( pools, numPools, false, &numSimdTicks );
 
-	PlPopMatrix();
+	uint64_t numVertices;
+	double   quadTime = PS_TimeBenchmarkQuads( pools, numPools, &numVertices );
+
+	uint64_t numScalarTicks;
+	PS_FillBenchmarkPools( pools, numPools, numParticles );
+	double scalarTime = PS_TimeBenchmarkPools( pools, numPools, true, &numScalarTicks );
+
+	for ( unsigned int i = 0; i < numPools; ++i )
+		Common_ParticlePool_Destroy( &pools[ i ] );
+
+	PL_DELETE( pools );
+
+	PRINT( "Ticked %u particles across %u emitters for %u ticks:\n", numParticles, numPools, PARTICLE_BENCHMARK_TICKS );
+	PRINT( "  simd:   %.3fms per tick, %.3fns per particle tick\n", ( simdTime * 1000.0 ) / PARTICLE_BENCHMARK_TICKS, ( simdTime * 1e9 ) / ( double ) numSimdTicks );
+	PRINT( "  scalar: %.3fms per tick, %.3fns per particle tick\n", ( scalarTime * 1000.0 ) / PARTICLE_BENCHMARK_TICKS, ( scalarTime * 1e9 ) / ( double ) numScalarTicks );
+	PRINT( "  quads:  %.3fms per tick, %.1fM vertices per second\n", ( quadTime * 1000.0 ) / PARTICLE_BENCHMARK_TICKS, ( ( double ) numVertices / quadTime ) / 1e6 );
+	if ( numSimdTicks != numScalarTicks )
+		PRINT_WARNING( "Particle counts didn't match (%llu vs %llu)!\n", ( unsigned long long ) numSimdTicks, ( unsigned long long ) numScalarTicks );
 }
@@ -5,6 +5,8 @@
 
 #include "renderer_scenegraph.h"
 
+#include "common_particles.h"
+
 typedef struct YNCoreCamera YNCoreCamera;
 
 typedef enum PSParticleDrawType
@@ -38,33 +40,12 @@ typedef struct PSEmitter
 
 	PLCollisionAABB bounds;
 
-	struct PLGMesh  *mesh;
 	struct YNCoreMaterial *material;
 	YNCoreMemoryReference mem;
 
-	struct PLLinkedList *particles;
+	CommonParticlePool particles; /* everything it's emitted that's still alive */
 } PSEmitter;
 
-typedef struct PSParticle
-{
-	SGTransform transform, oldTransform;
-
-	PLVector3 dir;
-
-	PLColourF32 colour;
-	PLColourF32 oldColour;
-	PLColourF32 deltaColour;
-
-	float scale, oldScale, deltaScale;
-
-	int		   life;
-	PSEmitter *emitter;
-
-	PLCollisionAABB bounds;
-
-	struct PLLinkedListNode *node;
-} PSParticle;
-
 void PS_Initialize( void );
 void PS_Shutdown( void );
 
@@ -74,3 +55,6 @@ void	   PS_DestroyEmitter( PSEmitter *emitter );
 
 void PS_TickEmitter( PSEmitter *emitter );
 void PS_Draw( const PSEmitter *emitter, const YNCoreCamera *camera );
+void PS_DrawBatches( const YNCoreCamera *camera );
+
+void PS_BenchmarkCommand( unsigned int argc, char **argv );
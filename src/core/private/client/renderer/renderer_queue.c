@@ -0,0 +1,267 @@
+// SPDX-License-Identifier: LGPL-3.0-or-later
+// Copyright © 2020-2023 OldTimes Software, Mark E Sowden <hogsy@oldtimes-software.com>
+
+#include "core_private.h"
+#include "renderer.h"
+#include "renderer_queue.h"
+
+#include "common_sort.h"
+
+/* Rather than drawing straight away, draws are collected here along with
+ * a key describing the state they need (see YnCore_Material_GetSortKey).
+ * The keys are sorted on flush, so draws sharing a program, material or
+ * textures get recorded together and anything already bound is skipped. */
+
+typedef struct RenderQueueItem
+{
+	YNCoreMaterial *material;
+	PLGMesh        *mesh;
+	unsigned int    firstTransform;
+	unsigned int    numTransforms;
+	unsigned int    firstLight;
+	unsigned int    numLights;
+} RenderQueueItem;
+
+static struct
+{
+	bool      active;
+	PLVector3 viewOrigin;
+
+	RenderQueueItem *items;
+	uint64_t        *keys;
+	uint64_t        *scratchKeys;
+	uint32_t        *order;
+	uint32_t        *scratchOrder;
+	unsigned int     numItems;
+	unsigned int     maxItems;
+
+	PLMatrix4   *transforms;
+	unsigned int numTransforms;
+	unsigned int maxTransforms;
+
+	YNCoreLight *lights;
+	unsigned int numLights;
+	unsigned int maxLights;
+
+	YNCoreCommandBuffer commands;
+} renderQueue;
+
+void YnCore_RenderQueue_Begin( const PLVector3 *viewOrigin )
+{
+	PL_GET_CVAR( "r.sortDraws", sortDraws );
+
+	renderQueue.active     = ( sortDraws == NULL || sortDraws->b_value );
+	renderQueue.viewOrigin = *viewOrigin;
+	renderQueue.numItems      = 0;
+	renderQueue.numTransforms = 0;
+	renderQueue.numLights     = 0;
+}
+
+/**
+ * Queues up the mesh to be drawn with the current model matrix. If the
+ * queue isn't active, or we're drawing a mirror, it's drawn immediately.
+ */
+void YnCore_RenderQueue_Submit( YNCoreMaterial *material, PLGMesh *mesh, const PLVector3 *origin, const YNCoreLight *lights, unsigned int numLights )
+{
+	YnCore_RenderQueue_SubmitInstanced( material, mesh, PlGetMatrix( PL_MODELVIEW_MATRIX ), 1, origin, lights, numLights );
+}
+
+/**
+ * Queues up the mesh to be drawn once for each of the given transforms,
+ * see YnCore_Material_DrawMeshInstanced.
+ */
+void YnCore_RenderQueue_SubmitInstanced( YNCoreMaterial *material, PLGMesh *mesh, const PLMatrix4 *transforms, unsigned int numTransforms, const PLVector3 *origin, const YNCoreLight *lights, unsigned int numLights )
+{
+	if ( !renderQueue.active || rendererState.depth > 0 )
+	{
+		YnCore_Material_DrawMeshInstanced( material, mesh, transforms, numTransforms, lights, numLights );
+		return;
+	}
+
+	if ( renderQueue.numItems == renderQueue.maxItems )
+	{
+		renderQueue.maxItems     = ( renderQueue.maxItems > 0 ) ? renderQueue.maxItems * 2 : 256;
+		renderQueue.items        = PlReAlloc( renderQueue.items, sizeof( RenderQueueItem ) * renderQueue.maxItems, true );
+		renderQueue.keys         = PlReAlloc( renderQueue.keys, sizeof( uint64_t ) * renderQueue.maxItems, true );
+		renderQueue.scratchKeys  = PlReAlloc( renderQueue.scratchKeys, sizeof( uint64_t ) * renderQueue.maxItems, true );
+		renderQueue.order        = PlReAlloc( renderQueue.order, sizeof( uint32_t ) * renderQueue.maxItems, true );
+		renderQueue.scratchOrder = PlReAlloc( renderQueue.scratchOrder, sizeof( uint32_t ) * renderQueue.maxItems, true );
+	}
+
+	if ( renderQueue.numTransforms + numTransforms > renderQueue.maxTransforms )
+	{
+		while ( renderQueue.numTransforms + numTransforms > renderQueue.maxTransforms )
+			renderQueue.maxTransforms = ( renderQueue.maxTransforms > 0 ) ? renderQueue.maxTransforms * 2 : 256;
+
+		renderQueue.transforms = PlReAlloc( renderQueue.transforms, sizeof( PLMatrix4 ) * renderQueue.maxTransforms, true );
+	}
+
+	if ( renderQueue.numLights + numLights > renderQueue.maxLights )
+	{
+		while ( renderQueue.numLights + numLights > renderQueue.maxLights )
+			renderQueue.maxLights = ( renderQueue.maxLights > 0 ) ? renderQueue.maxLights * 2 : 64;
+
+		renderQueue.lights = PlReAlloc( renderQueue.lights, sizeof( YNCoreLight ) * renderQueue.maxLights, true );
+	}
+
+	RenderQueueItem *item = &renderQueue.items[ renderQueue.numItems ];
+	item->material        = material;
+	item->mesh            = mesh;
+	item->firstTransform  = renderQueue.numTransforms;
+	item->numTransforms   = numTransforms;
+	item->firstLight      = renderQueue.numLights;
+	item->numLights       = numLights;
+
+	memcpy( &renderQueue.transforms[ renderQueue.numTransforms ], transforms, sizeof( PLMatrix4 ) * numTransforms );
+	renderQueue.numTransforms += numTransforms;
+
+	if ( numLights > 0 )
+	{
+		memcpy( &renderQueue.lights[ renderQueue.numLights ], lights, sizeof( YNCoreLight ) * numLights );
+		renderQueue.numLights += numLights;
+	}
+
+	/* distance is only compared, so no need for the square root */
+	PLVector3 d = PlSubtractVector3( *origin, renderQueue.viewOrigin );
+
+	renderQueue.keys[ renderQueue.numItems ]  = YnCore_Material_GetSortKey( material, d.x * d.x + d.y * d.y + d.z * d.z );
+	renderQueue.order[ renderQueue.numItems ] = renderQueue.numItems;
+	renderQueue.numItems++;
+}
+
+void YnCore_RenderQueue_Flush( void )
+{
+	if ( !renderQueue.active )
+		return;
+
+	renderQueue.active = false;
+	if ( renderQueue.numItems == 0 )
+		return;
+
+	Common_RadixSort64( renderQueue.keys, renderQueue.order, renderQueue.scratchKeys, renderQueue.scratchOrder, renderQueue.numItems );
+
+	YnCore_Material_BeginRecording( &renderQueue.commands );
+	for ( unsigned int i = 0; i < renderQueue.numItems; ++i )
+	{
+		const RenderQueueItem *item = &renderQueue.items[ renderQueue.order[ i ] ];
+		YnCore_Material_DrawMeshInstanced( item->material, item->mesh, &renderQueue.transforms[ item->firstTransform ], item->numTransforms,
+		                                   ( item->numLights > 0 ) ? &renderQueue.lights[ item->firstLight ] : NULL, item->numLights );
+	}
+	YnCore_Material_EndRecording();
+
+	YnCore_CommandBuffer_Submit( &renderQueue.commands );
+	YnCore_CommandBuffer_Reset( &renderQueue.commands );
+
+	renderQueue.numItems      = 0;
+	renderQueue.numTransforms = 0;
+	renderQueue.numLights     = 0;
+}
+
+void YnCore_RenderQueue_Shutdown( void )
+{
+	PL_DELETE( renderQueue.items );
+	PL_DELETE( renderQueue.keys );
+	PL_DELETE( renderQueue.scratchKeys );
+	PL_DELETE( renderQueue.order );
+	PL_DELETE( renderQueue.scratchOrder );
+	PL_DELETE( renderQueue.transforms );
+	PL_DELETE( renderQueue.lights );
+	YnCore_CommandBuffer_Destroy( &renderQueue.commands );
+	PL_ZERO_( renderQueue );
+}
+
+/****************************************
+ * BENCHMARK
+ ****************************************/
+
+#define QUEUE_BENCHMARK_DEFAULT_KEYS 100000
+#define QUEUE_BENCHMARK_ITERATIONS   20
+
+typedef struct QueueBenchmarkPair
+{
+	uint64_t key;
+	uint32_t value;
+} QueueBenchmarkPair;
+
+static int CompareBenchmarkPairs( const void *a, const void *b )
+{
+	const QueueBenchmarkPair *x = a;
+	const QueueBenchmarkPair *y = b;
+	if ( x->key != y->key )
+		return ( x->key > y->key ) ? 1 : -1;
+
+	return ( x->value > y->value ) - ( x->value < y->value );
+}
+
+void YnCore_RenderQueue_BenchmarkCommand( unsigned int argc, char **argv )
+{
+	unsigned int numKeys = QUEUE_BENCHMARK_DEFAULT_KEYS;
+	if ( argc > 1 )
+	{
+		numKeys = strtoul( argv[ 1 ], NULL, 10 );
+		if ( numKeys == 0 )
+		{
+			PRINT_WARNING( "Invalid number of keys specified!\n" );
+			return;
+		}
+	}
+
+	uint64_t           *source        = PL_NEW_( uint64_t, numKeys );
+	uint64_t           *keys          = PL_NEW_( uint64_t, numKeys );
+	uint64_t           *scratchKeys   = PL_NEW_( uint64_t, numKeys );
+	uint32_t           *values        = PL_NEW_( uint32_t, numKeys );
+	uint32_t           *scratchValues = PL_NEW_( uint32_t, numKeys );
+	QueueBenchmarkPair *pairs         = PL_NEW_( QueueBenchmarkPair, numKeys );
+
+	/* roughly what a frame's worth of opaque draws looks like */
+	srand( 0 );
+	for ( unsigned int i = 0; i < numKeys; ++i )
+	{
+		uint64_t program  = rand() % 16;
+		uint64_t material = rand() % 512;
+		source[ i ]       = ( program << 52 ) | ( material << 36 ) | ( ( ( material * 7 ) & 0xFFF ) << 24 ) | ( ( uint64_t ) rand() & 0xFFFFFF );
+	}
+
+	double startTime = PlGetCurrentSeconds();
+	for ( unsigned int i = 0; i < QUEUE_BENCHMARK_ITERATIONS; ++i )
+	{
+		memcpy( keys, source, sizeof( uint64_t ) * numKeys );
+		for ( unsigned int j = 0; j < numKeys; ++j )
+			values[ j ] = j;
+
+		Common_RadixSort64( keys, values, scratchKeys, scratchValues, numKeys );
+	}
+	double radixTime = ( PlGetCurrentSeconds() - startTime ) / QUEUE_BENCHMARK_ITERATIONS;
+
+	startTime = PlGetCurrentSeconds();
+	for ( unsigned int i = 0; i < QUEUE_BENCHMARK_ITERATIONS; ++i )
+	{
+		for ( unsigned int j = 0; j < numKeys; ++j )
+		{
+			pairs[ j ].key   = source[ j ];
+			pairs[ j ].value = j;
+		}
+
+		qsort( pairs, numKeys, sizeof( QueueBenchmarkPair ), CompareBenchmarkPairs );
+	}
+	double qsortTime = ( PlGetCurrentSeconds() - startTime ) / QUEUE_BENCHMARK_ITERATIONS;
+
+	PRINT( "Sorted %u keys:\n", numKeys );
+	PRINT( "  radix: %.3fms\n", radixTime * 1000.0 );
+	PRINT( "  qsort: %.3fms\n", qsortTime * 1000.0 );
+	for ( unsigned int i = 0; i < numKeys; ++i )
+	{
+		if ( keys[ i ] != pairs[ i ].key || values[ i ] != pairs[ i ].value )
+		{
+			PRINT_WARNING( "Sort mismatch at %u!\n", i );
+			break;
+		}
+	}
+
+	PL_DELETE( pairs );
+	PL_DELETE( scratchValues );
+	PL_DELETE( values );
+	PL_DELETE( scratchKeys );
+	PL_DELETE( keys );
+	PL_DELETE( source );
+}
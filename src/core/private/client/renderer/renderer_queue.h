@@ -0,0 +1,12 @@
+// SPDX-License-Identifier: LGPL-3.0-or-later
+// Copyright © 2020-2023 OldTimes Software, Mark E Sowden <hogsy@oldtimes-software.com>
+
+#pragma once
+
+void YnCore_RenderQueue_Begin( const PLVector3 *viewOrigin );
+void YnCore_RenderQueue_Submit( YNCoreMaterial *material, PLGMesh *mesh, const PLVector3 *origin, const YNCoreLight *lights, unsigned int numLights );
+void YnCore_RenderQueue_SubmitInstanced( YNCoreMaterial *material, PLGMesh *mesh, const PLMatrix4 *transforms, unsigned int numTransforms, const PLVector3 *origin, const YNCoreLight *lights, unsigned int numLights );
+void YnCore_RenderQueue_Flush( void );
+void YnCore_RenderQueue_Shutdown( void );
+
+void YnCore_RenderQueue_BenchmarkCommand( unsigned int argc, char **argv );
@@ -139,6 +139,8 @@ static YNCoreShaderProgramIndex *RS_ParseShaderProgram( YNNodeBranch *root )
 		return NULL;
 	}
 
+	YnCore_Material_ResolveProgramSlots( program.internalPtr, &program.slots );
+
 	/* the default pass is an optional field that can outline
 	 * the initial properties that should be used during a draw.
 	 * a material can of course overwrite these. */
@@ -153,7 +155,8 @@ static YNCoreShaderProgramIndex *RS_ParseShaderProgram( YNNodeBranch *root )
 
 	/* allocate and return our program index */
 	YNCoreShaderProgramIndex *out = PlMAlloc( sizeof( YNCoreShaderProgramIndex ), true );
-	*out = program;
+	*out                   = program;
+	out->defaultPass.slots = &out->slots;
 	return out;
 }
 
@@ -197,6 +200,25 @@ YNCoreShaderProgramIndex *YnCore_GetShaderProgramByName( const char *name )
 	return NULL;
 }
 
+/**
+ * Fetch the uniform slots resolved for the given program,
+ * or NULL if it's not one we've indexed.
+ */
+MaterialProgramSlots *YnCore_GetShaderProgramSlots( const PLGShaderProgram *program )
+{
+	PLLinkedListNode *root = PlGetFirstNode( shaderPrograms );
+	while ( root != NULL )
+	{
+		YNCoreShaderProgramIndex *programIndex = PlGetLinkedListNodeUserData( root );
+		if ( programIndex->internalPtr == program )
+			return &programIndex->slots;
+
+		root = PlGetNextLinkedListNode( root );
+	}
+
+	return NULL;
+}
+
 void YR_Shader_Initialize( void )
 {
 	shaderPrograms = PlCreateLinkedList();
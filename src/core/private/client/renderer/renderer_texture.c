@@ -1,11 +1,10 @@
 // SPDX-License-Identifier: LGPL-3.0-or-later
 // Copyright © 2020-2023 OldTimes Software, Mark E Sowden <hogsy@oldtimes-software.com>
 
+#include <SDL2/SDL.h>
+
 #include "core_private.h"
 #include "renderer.h"
-#include "core_image.h"
-
-static PLLinkedList *textures;
 
 static void CleanupTexture( void *user )
 {
@@ -14,9 +13,31 @@ static void CleanupTexture( void *user )
 
 YNCoreTexture *YnCore_Texture_Load( const char *path )
 {
-	PLGTexture *internal = PlgLoadTextureFromImage( path, PLG_TEXTURE_FILTER_MIPMAP_LINEAR );
+	PLImage *image = PlLoadImage( path );
+	if ( image == NULL )
+		return NULL;
+
+	PLGTexture *internal = PlgCreateTexture();
 	if ( internal == NULL )
+	{
+		PRINT_WARNING( "Failed to create texture!\nPL: %s\n", PlGetError() );
+		PlDestroyImage( image );
 		return NULL;
+	}
+
+	/* packed images carry their own pre-filtered mip chain, in which case
+	 * every level is uploaded as-is rather than the driver generating them */
+	internal->filter = PLG_TEXTURE_FILTER_MIPMAP_LINEAR;
+	bool status      = PlgUploadTextureImage( internal, image );
+	PlDestroyImage( image );
+	if ( !status )
+	{
+		PRINT_WARNING( "Failed to upload texture \"%s\"!\nPL: %s\n", path, PlGetError() );
+		PlgDestroyTexture( internal );
+		return NULL;
+	}
+
+	snprintf( internal->path, sizeof( internal->path ), "%s", path );
 
 	YNCoreTexture *texture  = PL_NEW( YNCoreTexture );
 	texture->internal = internal;
@@ -91,9 +112,320 @@ static PLGTexture *GenerateTextureFromData( uint8_t *data, unsigned int w, unsig
 	return texture;
 }
 
+/****************************************
+ * CACHE
+ ****************************************/
+
+/* Loaded textures are found through an open-addressed table keyed on a
+ * case-folded hash of their path, rather than walking them all. */
+
+typedef struct TextureCacheEntry
+{
+	uint32_t    hash;
+	PLGTexture *texture;
+} TextureCacheEntry;
+
+static struct
+{
+	TextureCacheEntry *entries;
+	unsigned int       numEntries;
+	unsigned int       maxEntries; /* always a power of two */
+} textureCache;
+
+static uint32_t HashTexturePath( const char *path )
+{
+	uint32_t hash = 2166136261u;
+	for ( ; *path != '\0'; ++path )
+	{
+		unsigned char c = ( unsigned char ) *path;
+		if ( c >= 'A' && c <= 'Z' )
+			c += 'a' - 'A';
+
+		hash ^= c;
+		hash *= 16777619u;
+	}
+
+	return hash;
+}
+
+static PLGTexture *GetTexture( const char *path )
+{
+	if ( textureCache.numEntries == 0 )
+		return NULL;
+
+	uint32_t     hash = HashTexturePath( path );
+	unsigned int mask = textureCache.maxEntries - 1;
+	for ( unsigned int i = hash & mask; textureCache.entries[ i ].texture != NULL; i = ( i + 1 ) & mask )
+	{
+		const TextureCacheEntry *entry = &textureCache.entries[ i ];
+		if ( entry->hash == hash && pl_strcasecmp( path, entry->texture->path ) == 0 )
+			return entry->texture;
+	}
+
+	return NULL;
+}
+
+static void InsertCacheEntry( TextureCacheEntry *entries, unsigned int maxEntries, uint32_t hash, PLGTexture *texture )
+{
+	unsigned int mask = maxEntries - 1;
+	unsigned int i    = hash & mask;
+	while ( entries[ i ].texture != NULL )
+		i = ( i + 1 ) & mask;
+
+	entries[ i ].hash    = hash;
+	entries[ i ].texture = texture;
+}
+
+static void InsertTexture( PLGTexture *texture )
+{
+	/* keep it under three quarters full, so probes stay short */
+	if ( ( textureCache.numEntries + 1 ) * 4 > textureCache.maxEntries * 3 )
+	{
+		unsigned int       maxEntries = ( textureCache.maxEntries > 0 ) ? textureCache.maxEntries * 2 : 256;
+		TextureCacheEntry *entries    = PL_NEW_( TextureCacheEntry, maxEntries );
+		for ( unsigned int i = 0; i < textureCache.maxEntries; ++i )
+		{
+			if ( textureCache.entries[ i ].texture != NULL )
+				InsertCacheEntry( entries, maxEntries, textureCache.entries[ i ].hash, textureCache.entries[ i ].texture );
+		}
+
+		PL_DELETE( textureCache.entries );
+		textureCache.entries    = entries;
+		textureCache.maxEntries = maxEntries;
+	}
+
+	InsertCacheEntry( textureCache.entries, textureCache.maxEntries, HashTexturePath( texture->path ), texture );
+	textureCache.numEntries++;
+}
+
+/****************************************
+ * LOADER THREADS
+ ****************************************/
+
+/* Images are decoded on a few loader threads, and then handed back to be
+ * uploaded on the main thread, where only so many bytes are uploaded each
+ * frame. Until then, the texture shows the same placeholder pattern as the
+ * fallback texture, so whoever asked for it can hold onto it right away. */
+
+#define TEXTURE_MAX_LOADER_THREADS 4
+
+typedef struct TextureLoadJob
+{
+	PLPath                 path;
+	PLGTexture            *texture;
+	PLGTextureFilter       filterMode;
+	PLImage               *image; /* set by the loader, or NULL if it failed */
+	struct TextureLoadJob *next;
+} TextureLoadJob;
+
+static SDL_Thread  *loaderThreads[ TEXTURE_MAX_LOADER_THREADS ];
+static unsigned int numLoaderThreads;
+static SDL_mutex   *loaderMutex;
+static SDL_sem     *loaderSemaphore;
+static SDL_atomic_t loaderShutdown;
+
+static TextureLoadJob *queuedHead, *queuedTail;
+static TextureLoadJob *loadedHead, *loadedTail;
+static unsigned int    numPendingLoads;
+
+static PLImage *placeholderImage;
+
+static PLConsoleVariable *asyncTexturesVar;
+static PLConsoleVariable *uploadBudgetVar;
+
+/* time spent on textures in the current frame, and the worst of them, see r.textureStats */
+static double frameTextureTime;
+static double worstFrameTextureTime;
+static size_t numBytesUploaded;
+
+static void PushJob( TextureLoadJob **head, TextureLoadJob **tail, TextureLoadJob *job )
+{
+	job->next = NULL;
+	if ( *tail != NULL )
+		( *tail )->next = job;
+	else
+		*head = job;
+	*tail = job;
+}
+
+static TextureLoadJob *PopJob( TextureLoadJob **head, TextureLoadJob **tail )
+{
+	TextureLoadJob *job = *head;
+	if ( job != NULL )
+	{
+		*head = job->next;
+		if ( *head == NULL )
+			*tail = NULL;
+	}
+
+	return job;
+}
+
+static int LoaderThread( void *userData )
+{
+	( void ) ( userData );
+
+	while ( true )
+	{
+		SDL_SemWait( loaderSemaphore );
+		if ( SDL_AtomicGet( &loaderShutdown ) )
+			break;
+
+		SDL_LockMutex( loaderMutex );
+		TextureLoadJob *job = PopJob( &queuedHead, &queuedTail );
+		SDL_UnlockMutex( loaderMutex );
+
+		if ( job == NULL )
+			continue;
+
+		job->image = PlLoadImage( job->path );
+
+		SDL_LockMutex( loaderMutex );
+		PushJob( &loadedHead, &loadedTail, job );
+		SDL_UnlockMutex( loaderMutex );
+	}
+
+	return 0;
+}
+
+static void FreeLoadJob( TextureLoadJob *job )
+{
+	if ( job->image != NULL )
+		PlDestroyImage( job->image );
+
+	PL_DELETE( job );
+}
+
+static void StartLoaderThreads( void )
+{
+	loaderMutex     = SDL_CreateMutex();
+	loaderSemaphore = SDL_CreateSemaphore( 0 );
+	if ( loaderMutex == NULL || loaderSemaphore == NULL )
+	{
+		PRINT_WARNING( "Failed to create texture loader primitives: %s\n", SDL_GetError() );
+		return;
+	}
+
+	/* leave a core for the main thread */
+	int numThreads = SDL_GetCPUCount() - 1;
+	if ( numThreads < 1 )
+		numThreads = 1;
+	else if ( numThreads > TEXTURE_MAX_LOADER_THREADS )
+		numThreads = TEXTURE_MAX_LOADER_THREADS;
+
+	SDL_AtomicSet( &loaderShutdown, 0 );
+	for ( int i = 0; i < numThreads; ++i )
+	{
+		if ( ( loaderThreads[ numLoaderThreads ] = SDL_CreateThread( LoaderThread, "TextureLoader", NULL ) ) == NULL )
+		{
+			PRINT_WARNING( "Failed to create texture loader thread: %s\n", SDL_GetError() );
+			break;
+		}
+
+		numLoaderThreads++;
+	}
+}
+
+static void StopLoaderThreads( void )
+{
+	SDL_AtomicSet( &loaderShutdown, 1 );
+	for ( unsigned int i = 0; i < numLoaderThreads; ++i )
+		SDL_SemPost( loaderSemaphore );
+	for ( unsigned int i = 0; i < numLoaderThreads; ++i )
+		SDL_WaitThread( loaderThreads[ i ], NULL );
+	numLoaderThreads = 0;
+
+	/* whatever's left is never going to get uploaded, so the placeholder stays */
+	TextureLoadJob *job;
+	while ( ( job = PopJob( &queuedHead, &queuedTail ) ) != NULL )
+		FreeLoadJob( job );
+	while ( ( job = PopJob( &loadedHead, &loadedTail ) ) != NULL )
+		FreeLoadJob( job );
+	numPendingLoads = 0;
+
+	SDL_DestroySemaphore( loaderSemaphore );
+	SDL_DestroyMutex( loaderMutex );
+	loaderSemaphore = NULL;
+	loaderMutex     = NULL;
+}
+
+/**
+ * Uploads whatever the loader threads have finished with, up until the
+ * byte budget for the frame is spent. At least one texture always goes
+ * up, so something bigger than the budget doesn't hold up the rest.
+ */
+void YnCore_Texture_UpdateLoads( void )
+{
+	double startTime = PlGetCurrentSeconds();
+
+	/* anything the loaders had to say about what they've done */
+	Console_FlushDeferredOutput();
+
+	size_t budget      = ( size_t ) ( ( uploadBudgetVar != NULL ) ? uploadBudgetVar->i_value : 4096 ) * 1024;
+	size_t numUploaded = 0;
+	while ( numPendingLoads > 0 )
+	{
+		SDL_LockMutex( loaderMutex );
+		TextureLoadJob *job = loadedHead;
+		if ( job != NULL && job->image != NULL && numUploaded > 0 &&
+		     numUploaded + PlGetImageSize( job->image->format, job->image->width, job->image->height ) > budget )
+			job = NULL;
+		else
+			PopJob( &loadedHead, &loadedTail );
+		SDL_UnlockMutex( loaderMutex );
+
+		if ( job == NULL )
+			break;
+
+		numPendingLoads--;
+
+		if ( job->image == NULL )
+		{
+			PRINT_WARNING( "Failed to load texture \"%s\"!\n", job->path );
+			FreeLoadJob( job );
+			continue;
+		}
+
+		/* mip levels aren't counted, but it's near enough */
+		size_t size = PlGetImageSize( job->image->format, job->image->width, job->image->height );
+
+		job->texture->filter = job->filterMode;
+		if ( !PlgUploadTextureImage( job->texture, job->image ) )
+			PRINT_WARNING( "Failed to upload texture \"%s\"!\nPL: %s\n", job->path, PlGetError() );
+
+		numUploaded += size;
+		FreeLoadJob( job );
+	}
+	numBytesUploaded += numUploaded;
+
+	/* anything loaded straight away since the last frame counts too */
+	frameTextureTime += PlGetCurrentSeconds() - startTime;
+	if ( frameTextureTime > worstFrameTextureTime )
+		worstFrameTextureTime = frameTextureTime;
+	frameTextureTime = 0.0;
+}
+
+static void TextureStatsCommand( unsigned int argc, char **argv )
+{
+	( void ) ( argc );
+	( void ) ( argv );
+
+	PRINT( "%u textures cached, %u waiting to be uploaded\n", textureCache.numEntries, numPendingLoads );
+	PRINT( "  uploaded:    %.2fMB\n", PlBytesToMegabytes( numBytesUploaded ) );
+	PRINT( "  worst frame: %.3fms\n", worstFrameTextureTime * 1000.0 );
+
+	worstFrameTextureTime = 0.0;
+	numBytesUploaded      = 0;
+}
+
+/****************************************
+ ****************************************/
+
 void RT_InitializeTextures( void )
 {
-	textures = PlCreateLinkedList();
+	asyncTexturesVar = PlRegisterConsoleVariable( "r.asyncTextures", "Decode textures on loader threads, showing a placeholder until they're ready.", "1", PL_VAR_BOOL, NULL, NULL, true );
+	uploadBudgetVar  = PlRegisterConsoleVariable( "r.textureUploadBudget", "Kilobytes of loaded textures that can be uploaded each frame.", "4096", PL_VAR_I32, NULL, NULL, true );
+	PlRegisterConsoleCommand( "r.textureStats", "Print out the state of the texture cache, and the worst frame spent on textures since last asked.", -1, TextureStatsCommand );
 
 	/* generate fallback texture */
 	static PLColour fallbackData[] = {
@@ -104,24 +436,30 @@ void RT_InitializeTextures( void )
 	};
 	fallbackTexture = GenerateTextureFromData( ( uint8_t * ) fallbackData, 2, 2, 4, false );
 
+	placeholderImage = PlCreateImage( ( uint8_t * ) fallbackData, 2, 2, 0, PL_COLOURFORMAT_RGBA, PL_IMAGEFORMAT_RGBA8 );
+	if ( placeholderImage == NULL )
+		PRINT_WARNING( "Failed to create placeholder image!\nPL: %s\n", PlGetError() );
+
 	/* register the standard image loaders, and our package image loader */
 	PlRegisterStandardImageLoaders( PL_IMAGE_FILEFORMAT_ALL );
-	PlRegisterImageLoader( "gfx", Image_LoadPackedImage );
+	PlRegisterImageLoader( "gfx", Common_Image_LoadPackedImage );
+
+	StartLoaderThreads();
 }
 
-static PLGTexture *GetTexture( const char *path )
+void RT_ShutdownTextures( void )
 {
-	PLLinkedListNode *node = PlGetFirstNode( textures );
-	while ( node != NULL )
-	{
-		PLGTexture *texture = PlGetLinkedListNodeUserData( node );
-		if ( pl_strcasecmp( path, texture->path ) == 0 )
-			return texture;
+	if ( loaderMutex != NULL )
+		StopLoaderThreads();
 
-		node = PlGetNextLinkedListNode( node );
+	if ( placeholderImage != NULL )
+	{
+		PlDestroyImage( placeholderImage );
+		placeholderImage = NULL;
 	}
 
-	return NULL;
+	PL_DELETE( textureCache.entries );
+	PL_ZERO_( textureCache );
 }
 
 PLGTexture *YnCore_LoadTexture( const char *path, PLGTextureFilter filterMode )
@@ -131,13 +469,67 @@ PLGTexture *YnCore_LoadTexture( const char *path, PLGTextureFilter filterMode )
 	if ( texture != NULL )
 		return texture;
 
+	double startTime = PlGetCurrentSeconds();
+
 	texture = PlgLoadTextureFromImage( path, filterMode );
+
+	frameTextureTime += PlGetCurrentSeconds() - startTime;
+
 	if ( texture == NULL )
 	{
 		PRINT_WARNING( "Failed to load texture \"%s\"!\nPL: %s\n", path, PlGetError() );
 		return fallbackTexture;
 	}
 
-	PlInsertLinkedListNode( textures, texture );
+	InsertTexture( texture );
+	return texture;
+}
+
+/**
+ * Same as YnCore_LoadTexture, but the image is loaded in the background;
+ * the texture returned shows a placeholder until it's been uploaded,
+ * see YnCore_Texture_UpdateLoads. If it fails, the placeholder stays.
+ */
+PLGTexture *YnCore_LoadTextureAsync( const char *path, PLGTextureFilter filterMode )
+{
+	PLGTexture *texture = GetTexture( path );
+	if ( texture != NULL )
+		return texture;
+
+	if ( numLoaderThreads == 0 || placeholderImage == NULL || ( asyncTexturesVar != NULL && !asyncTexturesVar->b_value ) )
+		return YnCore_LoadTexture( path, filterMode );
+
+	if ( !PlFileExists( path ) )
+	{
+		PRINT_WARNING( "Failed to find texture \"%s\"!\n", path );
+		return fallbackTexture;
+	}
+
+	texture = PlgCreateTexture();
+	if ( texture == NULL )
+	{
+		PRINT_WARNING( "Failed to create texture!\nPL: %s\n", PlGetError() );
+		return fallbackTexture;
+	}
+
+	texture->filter = PLG_TEXTURE_FILTER_NEAREST;
+	if ( !PlgUploadTextureImage( texture, placeholderImage ) )
+		PRINT_WARNING( "Failed to upload placeholder for \"%s\"!\nPL: %s\n", path, PlGetError() );
+
+	snprintf( texture->path, sizeof( texture->path ), "%s", path );
+	InsertTexture( texture );
+
+	TextureLoadJob *job = PL_NEW( TextureLoadJob );
+	snprintf( job->path, sizeof( job->path ), "%s", path );
+	job->texture    = texture;
+	job->filterMode = filterMode;
+
+	SDL_LockMutex( loaderMutex );
+	PushJob( &queuedHead, &queuedTail, job );
+	SDL_UnlockMutex( loaderMutex );
+	numPendingLoads++;
+
+	SDL_SemPost( loaderSemaphore );
+
 	return texture;
 }
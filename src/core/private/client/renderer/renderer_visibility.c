@@ -2,56 +2,297 @@
 // Copyright © 2020-2023 OldTimes Software, Mark E Sowden <hogsy@oldtimes-software.com>
 
 #include "core_private.h"
+#include "renderer.h"
 #include "world.h"
 #include "renderer_visibility.h"
 
-PLLinkedList *VIS_GetVisibleFaces( YNCoreCamera *camera, PLLinkedList *faces )
+/* Visible face sets are handed out as arrays of indices into the mesh's
+ * face table, allocated from a scratch arena that's reset at the start of
+ * each frame. Mirrors re-enter the visibility pass while the results for
+ * the outer sector are still in use, so nothing is handed back early. */
+
+#define VIS_ARENA_BLOCK_SIZE ( 64 * 1024 )
+
+typedef struct VISArenaBlock
 {
-	PLLinkedList     *visibleFaces = PlCreateLinkedList();
-	PLLinkedListNode *faceNode = PlGetFirstNode( faces );
-	while ( faceNode != NULL )
+	struct VISArenaBlock *next;
+	size_t size;
+	size_t used;
+} VISArenaBlock;
+
+static VISArenaBlock *arena = NULL;
+
+static bool cullFaces = true;
+
+static VISArenaBlock *CreateArenaBlock( size_t size, VISArenaBlock *next )
+{
+	VISArenaBlock *block = PlMAllocA( sizeof( VISArenaBlock ) + size );
+	block->next          = next;
+	block->size          = size;
+	block->used          = 0;
+	return block;
+}
+
+static void *ArenaAlloc( size_t size )
+{
+	size = ( size + ( sizeof( void * ) - 1 ) ) & ~( sizeof( void * ) - 1 );
+	if ( arena == NULL || arena->used + size > arena->size )
 	{
-		YNCoreWorldFace *face = PlGetLinkedListNodeUserData( faceNode );
-		if ( face->flags & WORLD_FACE_FLAG_SKIP )
+		size_t blockSize = ( arena != NULL ) ? arena->size * 2 : VIS_ARENA_BLOCK_SIZE;
+		if ( blockSize < size )
+			blockSize = size;
+
+		arena = CreateArenaBlock( blockSize, arena );
+	}
+
+	void *ptr = ( uint8_t * ) ( arena + 1 ) + arena->used;
+	arena->used += size;
+	return ptr;
+}
+
+/**
+ * Resets the arena, and picks up any settings that would
+ * otherwise get looked up for every face.
+ */
+void VIS_BeginFrame( void )
+{
+	if ( arena != NULL )
+	{
+		/* if we ran out of room last frame, swap the chain
+		 * for a single block that's big enough for the lot */
+		if ( arena->next != NULL )
 		{
-			faceNode = PlGetNextLinkedListNode( faceNode );
-			continue;
+			size_t size = 0;
+			while ( arena != NULL )
+			{
+				VISArenaBlock *next = arena->next;
+				size += arena->size;
+				PL_DELETE( arena );
+				arena = next;
+			}
+
+			arena = CreateArenaBlock( size, NULL );
 		}
 
-		PL_GET_CVAR( "r.cullMode", cullMode );
+		arena->used = 0;
+	}
 
-		// Check the face is actually visible
-		if ( cullMode->i_value > 0 && !YnCore_World_IsFaceVisible( face, camera ) )
+	PL_GET_CVAR( "r.cullMode", cullMode );
+	cullFaces = ( cullMode == NULL || cullMode->i_value > 0 );
+}
+
+/**
+ * Scratch memory for anything else that's gathered up along with the
+ * visible faces. Only valid until the next VIS_BeginFrame.
+ */
+void *VIS_Alloc( size_t size )
+{
+	return ArenaAlloc( size );
+}
+
+/**
+ * Returns the indices of the faces in the mesh that are visible to the
+ * given camera. The array is only valid until the next VIS_BeginFrame.
+ */
+unsigned int *VIS_GetVisibleFaces( YNCoreCamera *camera, const YNCoreWorldMesh *mesh, unsigned int *numVisible )
+{
+	*numVisible = 0;
+	if ( mesh->numFaces == 0 )
+		return NULL;
+
+	unsigned int    *visibleFaces = ArenaAlloc( sizeof( unsigned int ) * mesh->numFaces );
+	const uint8_t   *flags        = mesh->faceFlags;
+	PLCollisionAABB *bounds       = mesh->faceBounds;
+
+	/* walk the tree if we have one, so we can throw away
+	 * whole chunks of the mesh at once */
+	if ( cullFaces && mesh->faceTree.numNodes > 0 )
+	{
+		unsigned int numFound = YnCore_WorldMesh_QueryFacesInView( mesh, camera, visibleFaces, mesh->numFaces );
+		for ( unsigned int i = 0; i < numFound; ++i )
 		{
-			faceNode = PlGetNextLinkedListNode( faceNode );
-			continue;
+			if ( flags[ visibleFaces[ i ] ] & WORLD_FACE_FLAG_SKIP )
+				continue;
+
+			visibleFaces[ ( *numVisible )++ ] = visibleFaces[ i ];
 		}
 
-		PlInsertLinkedListNode( visibleFaces, face );
+		return visibleFaces;
+	}
+
+	for ( unsigned int i = 0; i < mesh->numFaces; ++i )
+	{
+		if ( flags[ i ] & WORLD_FACE_FLAG_SKIP )
+			continue;
+
+		// Check the face is actually visible
+		if ( cullFaces && !PlgIsBoxInsideView( camera->internal, &bounds[ i ] ) )
+			continue;
 
-		faceNode = PlGetNextLinkedListNode( faceNode );
+		visibleFaces[ ( *numVisible )++ ] = i;
 	}
 
 	return visibleFaces;
 }
 
-PLLinkedList *VIS_GetVisiblePortals( YNCoreCamera *camera, PLLinkedList *faces )
+/**
+ * Filters the given set of face indices down to just the portals.
+ */
+unsigned int *VIS_GetVisiblePortals( const YNCoreWorldMesh *mesh, const unsigned int *faces, unsigned int numFaces, unsigned int *numPortals )
+{
+	*numPortals = 0;
+	if ( numFaces == 0 )
+		return NULL;
+
+	unsigned int  *visiblePortals = ArenaAlloc( sizeof( unsigned int ) * numFaces );
+	const uint8_t *flags          = mesh->faceFlags;
+	for ( unsigned int i = 0; i < numFaces; ++i )
+	{
+		if ( !( flags[ faces[ i ] ] & ( WORLD_FACE_FLAG_MIRROR | WORLD_FACE_FLAG_PORTAL ) ) )
+			continue;
+
+		visiblePortals[ ( *numPortals )++ ] = faces[ i ];
+	}
+
+	return visiblePortals;
+}
+
+/****************************************
+ * BENCHMARK
+ ****************************************/
+
+#define VIS_BENCHMARK_DEFAULT_FACES 200000
+#define VIS_BENCHMARK_ITERATIONS    16
+#define VIS_BENCHMARK_EXTENT        4096.0f
+
+static float RandomRange( float min, float max )
+{
+	return min + ( ( float ) rand() / ( float ) RAND_MAX ) * ( max - min );
+}
+
+/**
+ * How culling used to work; a linked list in, a linked list out and
+ * the cvar fetched for every face. Kept around for comparison.
+ */
+static PLLinkedList *CullLinkedFaces( YNCoreCamera *camera, PLLinkedList *faces )
 {
-	PLLinkedList     *visiblePortals = PlCreateLinkedList();
-	PLLinkedListNode *faceNode = PlGetFirstNode( faces );
+	PLLinkedList     *visibleFaces = PlCreateLinkedList();
+	PLLinkedListNode *faceNode     = PlGetFirstNode( faces );
 	while ( faceNode != NULL )
 	{
 		YNCoreWorldFace *face = PlGetLinkedListNodeUserData( faceNode );
-		if ( !YnCore_World_IsFacePortal( face ) )
-		{
-			faceNode = PlGetNextLinkedListNode( faceNode );
+		faceNode              = PlGetNextLinkedListNode( faceNode );
+		if ( YnCore_WorldFace_GetFlags( face ) & WORLD_FACE_FLAG_SKIP )
+			continue;
+
+		PL_GET_CVAR( "r.cullMode", cullMode );
+		if ( cullMode->i_value > 0 && !YnCore_World_IsFaceVisible( face, camera ) )
 			continue;
+
+		PlInsertLinkedListNode( visibleFaces, face );
+	}
+
+	return visibleFaces;
+}
+
+/**
+ * Scatters a load of faces around a camera at the origin, and times
+ * how long it takes to cull them.
+ */
+void VIS_BenchmarkCommand( unsigned int argc, char **argv )
+{
+	unsigned int numFaces = VIS_BENCHMARK_DEFAULT_FACES;
+	if ( argc > 1 )
+	{
+		numFaces = strtoul( argv[ 1 ], NULL, 10 );
+		if ( numFaces == 0 )
+		{
+			PRINT_WARNING( "Invalid number of faces specified!\n" );
+			return;
 		}
+	}
+
+	YNCoreCamera *camera = YnCore_Camera_Create( "visBenchmark", &pl_vecOrigin3, &pl_vecOrigin3 );
+	PlgSetupCamera( camera->internal );
+
+	YNCoreWorldMesh mesh;
+	PL_ZERO_( mesh );
+	mesh.numFaces   = numFaces;
+	mesh.faceTable  = PL_NEW_( YNCoreWorldFace *, numFaces );
+	mesh.faceBounds = PL_NEW_( PLCollisionAABB, numFaces );
+	mesh.faceFlags  = PL_NEW_( uint8_t, numFaces );
+	mesh.faces      = PlCreateLinkedList();
 
-		PlInsertLinkedListNode( visiblePortals, face );
+	srand( 0 );
+	for ( unsigned int i = 0; i < numFaces; ++i )
+	{
+		PLVector3 centre = PLVector3( RandomRange( -VIS_BENCHMARK_EXTENT, VIS_BENCHMARK_EXTENT ),
+		                              RandomRange( -VIS_BENCHMARK_EXTENT, VIS_BENCHMARK_EXTENT ),
+		                              RandomRange( -VIS_BENCHMARK_EXTENT, VIS_BENCHMARK_EXTENT ) );
+		PLVector3 extent = PLVector3( RandomRange( 1.0f, 64.0f ), RandomRange( 1.0f, 64.0f ), RandomRange( 1.0f, 64.0f ) );
+
+		YNCoreWorldFace *face = PL_NEW( YNCoreWorldFace );
+		face->parentMesh      = &mesh;
+		face->index           = i;
 
-		faceNode = PlGetNextLinkedListNode( faceNode );
+		mesh.faceTable[ i ]       = face;
+		mesh.faceBounds[ i ].mins = PlSubtractVector3( centre, extent );
+		mesh.faceBounds[ i ].maxs = PlAddVector3( centre, extent );
+		PlInsertLinkedListNode( mesh.faces, face );
 	}
 
-	return visiblePortals;
+	unsigned int numLinkedVisible = 0;
+	double       startTime        = PlGetCurrentSeconds();
+	for ( unsigned int i = 0; i < VIS_BENCHMARK_ITERATIONS; ++i )
+	{
+		PLLinkedList *visibleFaces = CullLinkedFaces( camera, mesh.faces );
+		numLinkedVisible           = PlGetNumLinkedListNodes( visibleFaces );
+		PlDestroyLinkedList( visibleFaces );
+	}
+	double linkedTime = ( PlGetCurrentSeconds() - startTime ) / VIS_BENCHMARK_ITERATIONS;
+
+	unsigned int numPackedVisible = 0;
+	startTime                     = PlGetCurrentSeconds();
+	for ( unsigned int i = 0; i < VIS_BENCHMARK_ITERATIONS; ++i )
+	{
+		VIS_BeginFrame();
+		VIS_GetVisibleFaces( camera, &mesh, &numPackedVisible );
+	}
+	double packedTime = ( PlGetCurrentSeconds() - startTime ) / VIS_BENCHMARK_ITERATIONS;
+
+	CommonBVHBounds *treeBounds = PL_NEW_( CommonBVHBounds, numFaces );
+	for ( unsigned int i = 0; i < numFaces; ++i )
+	{
+		treeBounds[ i ].mins = mesh.faceBounds[ i ].mins;
+		treeBounds[ i ].maxs = mesh.faceBounds[ i ].maxs;
+	}
+	Common_BVH_Build( &mesh.faceTree, treeBounds, numFaces );
+	PL_DELETE( treeBounds );
+
+	unsigned int numTreeVisible = 0;
+	startTime                   = PlGetCurrentSeconds();
+	for ( unsigned int i = 0; i < VIS_BENCHMARK_ITERATIONS; ++i )
+	{
+		VIS_BeginFrame();
+		VIS_GetVisibleFaces( camera, &mesh, &numTreeVisible );
+	}
+	double treeTime = ( PlGetCurrentSeconds() - startTime ) / VIS_BENCHMARK_ITERATIONS;
+
+	PRINT( "Culled %u faces (%u visible):\n", numFaces, numPackedVisible );
+	PRINT( "  linked: %.3fms\n", linkedTime * 1000.0 );
+	PRINT( "  packed: %.3fms\n", packedTime * 1000.0 );
+	PRINT( "  tree:   %.3fms\n", treeTime * 1000.0 );
+	if ( numLinkedVisible != numPackedVisible || numLinkedVisible != numTreeVisible )
+		PRINT_WARNING( "Visible face count mismatch (%u vs %u vs %u)!\n", numLinkedVisible, numPackedVisible, numTreeVisible );
+
+	for ( unsigned int i = 0; i < numFaces; ++i )
+		PL_DELETE( mesh.faceTable[ i ] );
+
+	PlDestroyLinkedList( mesh.faces );
+	PL_DELETE( mesh.faceTable );
+	PL_DELETE( mesh.faceBounds );
+	PL_DELETE( mesh.faceFlags );
+	Common_BVH_Destroy( &mesh.faceTree );
+
+	YnCore_Camera_Destroy( camera );
 }
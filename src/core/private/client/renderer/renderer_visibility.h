@@ -3,5 +3,10 @@
 
 #pragma once
 
-PLLinkedList *VIS_GetVisibleFaces( YNCoreCamera *camera, PLLinkedList *faces );
-PLLinkedList *VIS_GetVisiblePortals( YNCoreCamera *camera, PLLinkedList *faces );
+void  VIS_BeginFrame( void );
+void *VIS_Alloc( size_t size );
+
+unsigned int *VIS_GetVisibleFaces( YNCoreCamera *camera, const YNCoreWorldMesh *mesh, unsigned int *numVisible );
+unsigned int *VIS_GetVisiblePortals( const YNCoreWorldMesh *mesh, const unsigned int *faces, unsigned int numFaces, unsigned int *numPortals );
+
+void VIS_BenchmarkCommand( unsigned int argc, char **argv );
@@ -3,9 +3,14 @@
 
 #include "core_private.h"
 #include "renderer.h"
+#include "renderer_particle.h"
 #include "world.h"
 #include "renderer_visibility.h"
+#include "renderer_occlusion.h"
 #include "legacy/actor.h"
+#include "game_interface.h"
+
+#include "common_sort.h"
 
 /****************************************
  * SKY
@@ -110,99 +115,70 @@ static void DrawSky( YNCoreWorld *world, YNCoreCamera *camera )
 /****************************************
  ****************************************/
 
-static void DrawFace( YNCoreWorldMesh *mesh, YNCoreWorldFace *face )
+static void DrawFaces( YNCoreWorldMesh *sectorBody, const unsigned int *visibleFaces, unsigned int numVisibleFaces, YNCoreLight *lights, unsigned int numLights, bool drawTransparent )
 {
-	/* Gee, this sure isn't efficient, is it?
-	 * In the long-term I want to store triangulated geom
-	 * on the GPU as chunks, but for now this seems to be
-	 * fast enough for what I need
-	 * */
-	unsigned int numTriangles;
-	unsigned int *indices  = YnCore_World_ConvertFaceToTriangles( face, &numTriangles );
-	unsigned int *curIndex = indices;
-	for ( unsigned int k = 0; k < numTriangles; ++k, curIndex += 3 )
-		PlgAddMeshTriangle( mesh->drawMesh, curIndex[ 0 ], curIndex[ 1 ], curIndex[ 2 ] );
-
-	PL_DELETE( indices );
-
-	g_gfxPerfStats.numFacesDrawn++;
-
-#if 0// draw face normal
-	PlgSetShaderProgram( defaultShaderPrograms[ RS_SHADER_DEFAULT_VERTEX ] );
-	PlgDrawLine( *PlGetMatrix( PL_MODELVIEW_MATRIX ), face->origin, PL_COLOUR_BLUE, PlAddVector3( face->origin, PlScaleVector3F( face->normal, 4.0f ) ), PL_COLOUR_BLUE );
-#endif
-}
+	if ( sectorBody->numBatches == 0 )
+		return;
 
-static void DrawFaces( YNCoreWorldMesh *sectorBody, PLLinkedList *visibleFaces, YNCoreLight *lights, unsigned int numLights, bool drawTransparent )
-{
-	unsigned int numBatches = sectorBody->numMaterials + 1;// Extra batch for fallback pass
-	for ( unsigned int i = 0; i < numBatches; ++i )
-	{
-		PlgClearMeshTriangles( sectorBody->drawMesh );
+	for ( unsigned int i = 0; i < sectorBody->numBatches; ++i )
+		sectorBody->batches[ i ].numVisibleFaces = 0;
 
-		YNCoreMaterial *material = ( i < sectorBody->numMaterials ) ? sectorBody->materials[ i ] : YnCore_GetFallbackMaterial();
-		if ( i < sectorBody->numMaterials && ( material == YnCore_GetFallbackMaterial() ) )
+	/* sort the visible faces into their batches */
+	for ( unsigned int i = 0; i < numVisibleFaces; ++i )
+	{
+		YNCoreWorldFace *face = sectorBody->faceTable[ visibleFaces[ i ] ];
+		if ( face->batchIndex >= sectorBody->numBatches )
 			continue;
 
-		PLLinkedListNode *faceNode = PlGetFirstNode( visibleFaces );
-		while ( faceNode != NULL )
-		{
-			YNCoreWorldFace *face = PlGetLinkedListNodeUserData( faceNode );
-			if ( material != face->material || ( YnCore_World_IsFacePortal( face ) && !drawTransparent ) )// for now, skip portals...
-			{
-				faceNode = PlGetNextLinkedListNode( faceNode );
-				continue;
-			}
-
-			DrawFace( sectorBody, face );
+		YNCoreWorldMeshBatch *batch = &sectorBody->batches[ face->batchIndex ];
+		if ( batch->isPortal && !drawTransparent )// for now, skip portals...
+			continue;
 
-			faceNode = PlGetNextLinkedListNode( faceNode );
-		}
+		batch->numVisibleFaces++;
+	}
 
-		if ( sectorBody->drawMesh->num_triangles == 0 )
+	/* batches are drawn whole, rather than rewriting their meshes
+	 * every time the set of visible faces changes */
+	for ( unsigned int i = 0; i < sectorBody->numBatches; ++i )
+	{
+		YNCoreWorldMeshBatch *batch = &sectorBody->batches[ i ];
+		if ( batch->numVisibleFaces == 0 )
 			continue;
 
-		YnCore_Material_DrawMesh( material, sectorBody->drawMesh, lights, 0 );
-	}
+		g_gfxPerfStats.numFacesDrawn += batch->numFaces;
+		g_gfxPerfStats.numIndicesSubmitted += batch->numIndices;
+		g_gfxPerfStats.numLightsSubmitted += numLights;
 
-#if 0
-	PlgSetShaderProgram( defaultShaderPrograms[ RS_SHADER_DEFAULT_VERTEX ] );
-	PlgDrawMeshNormals( sectorBody->drawMesh );
-#endif
+		YnCore_RenderQueue_Submit( batch->material, batch->drawMesh, &batch->origin, lights, numLights );
+	}
 }
 
 static void DrawSector( YNCoreWorld *world, YNCoreWorldSector *sector, YNCoreCamera *camera );
-static void DrawSectorBody( YNCoreWorldSector *sector, YNCoreWorldMesh *worldMesh, YNCoreCamera *camera )
+static void DrawSectorFaces( YNCoreWorld *world, YNCoreWorldSector *sector, YNCoreWorldMesh *worldMesh, const unsigned int *visibleFaces, unsigned int numVisibleFaces, YNCoreCamera *camera )
 {
-	if ( worldMesh == NULL )
-		return;
-
-	PLLinkedList *visibleFaces = VIS_GetVisibleFaces( camera, worldMesh->faces );
-	if ( PlGetNumLinkedListNodes( visibleFaces ) == 0 )
+	if ( numVisibleFaces == 0 )
 		return;
 
 	// Now check for portals - we'll draw these first
-	PLLinkedList *visiblePortals = VIS_GetVisiblePortals( camera, visibleFaces );
-	g_gfxPerfStats.numVisiblePortals += PlGetNumLinkedListNodes( visiblePortals );
+	unsigned int  numVisiblePortals;
+	unsigned int *visiblePortals = VIS_GetVisiblePortals( worldMesh, visibleFaces, numVisibleFaces, &numVisiblePortals );
+	g_gfxPerfStats.numVisiblePortals += numVisiblePortals;
 
 	unsigned int numLights;
-	YNCoreLight *lights = YnCore_WorldSector_GetVisibleLights( sector, &numLights );
+	YNCoreLight *lights = YnCore_WorldSector_GetVisibleLights( world, sector, camera, &numLights );
 
 	// Draw transparent surfaces
-	//DrawFaces( worldMesh, visiblePortals, lights, numLights, true );
+	//DrawFaces( worldMesh, visiblePortals, numVisiblePortals, lights, numLights, true );
 
-	PLLinkedListNode *faceNode = PlGetFirstNode( visiblePortals );
-	while ( faceNode != NULL )
+	for ( unsigned int i = 0; i < numVisiblePortals; ++i )
 	{
-		YNCoreWorldFace *face = PlGetLinkedListNodeUserData( faceNode );
+		YNCoreWorldFace *face = worldMesh->faceTable[ visiblePortals[ i ] ];
 		if ( face->isPortalClosed )
-		{
-			faceNode = PlGetNextLinkedListNode( faceNode );
 			continue;
-		}
 
-		face->flags |= WORLD_FACE_FLAG_SKIP;
-		if ( face->flags & WORLD_FACE_FLAG_MIRROR )
+		uint8_t flags = worldMesh->faceFlags[ visiblePortals[ i ] ];
+		YnCore_WorldMesh_SetFaceFlags( worldMesh, visiblePortals[ i ], flags | WORLD_FACE_FLAG_SKIP );
+		if ( flags & WORLD_FACE_FLAG_MIRROR )
 		{
 			/* in the case of a mirror, both the target and target face
 			 * are assumed to be the same as the mirror, so that keeps
@@ -247,7 +223,7 @@ static void DrawSectorBody( YNCoreWorldSector *sector, YNCoreWorldMesh *worldMes
 			// Override the matrix the above set for us
 			//PlgSetProjectionMatrix( PlGetMatrix( PL_PROJECTION_MATRIX ) );
 
-			DrawSector( NULL, sector, camera );
+			DrawSector( world, sector, camera );
 
 			PlPopMatrix();
 
@@ -256,28 +232,30 @@ static void DrawSectorBody( YNCoreWorldSector *sector, YNCoreWorldMesh *worldMes
 #else
 			PlMatrixMode( PL_MODELVIEW_MATRIX );
 
+			PLVector3 faceNormal = worldMesh->facePlanes[ visiblePortals[ i ] ].normal;
+
 			int x, y;
-			if ( ( fabsf( face->normal.x ) > fabsf( face->normal.y ) ) && ( fabsf( face->normal.x ) > fabsf( face->normal.z ) ) )
+			if ( ( fabsf( faceNormal.x ) > fabsf( faceNormal.y ) ) && ( fabsf( faceNormal.x ) > fabsf( faceNormal.z ) ) )
 			{
-				x = ( face->normal.x > 0.0 ) ? 1 : 2;
-				y = ( face->normal.x > 0.0 ) ? 2 : 1;
+				x = ( faceNormal.x > 0.0 ) ? 1 : 2;
+				y = ( faceNormal.x > 0.0 ) ? 2 : 1;
 			}
-			else if ( ( fabsf( face->normal.z ) > fabsf( face->normal.x ) ) && ( fabsf( face->normal.z ) > fabsf( face->normal.y ) ) )
+			else if ( ( fabsf( faceNormal.z ) > fabsf( faceNormal.x ) ) && ( fabsf( faceNormal.z ) > fabsf( faceNormal.y ) ) )
 			{
-				x = ( face->normal.z > 0.0 ) ? 0 : 1;
-				y = ( face->normal.z > 0.0 ) ? 1 : 0;
+				x = ( faceNormal.z > 0.0 ) ? 0 : 1;
+				y = ( faceNormal.z > 0.0 ) ? 1 : 0;
 			}
 			else
 			{
-				x = ( face->normal.y > 0.0 ) ? 2 : 0;
-				y = ( face->normal.y > 0.0 ) ? 0 : 2;
+				x = ( faceNormal.y > 0.0 ) ? 2 : 0;
+				y = ( faceNormal.y > 0.0 ) ? 0 : 2;
 			}
 
 			PlScaleMatrix( PlVector3( x == 0 ? -1.0f : 1.0f,
 			                          y == 0 ? -1.0f : 1.0f,
 			                          x == 0 && y == 0 ? -1.0f : 1.0f ) );
 
-			PLVector3 normal = PlInverseVector3( face->normal );
+			PLVector3 normal = PlInverseVector3( faceNormal );
 			PLVector3 angles = pl_vecOrigin3;
 			angles           = PlAddVector3( angles, PlQuaternionToEuler( &PlQuaternion( 1.0f, 0.0f, 0.0f, normal.x ) ) );
 			angles           = PlAddVector3( angles, PlQuaternionToEuler( &PlQuaternion( 0.0f, 1.0f, 0.0f, normal.y ) ) );
@@ -286,7 +264,7 @@ static void DrawSectorBody( YNCoreWorldSector *sector, YNCoreWorldMesh *worldMes
 			//PlRotateMatrix( angles.y, 0.0f, 1.0f, 0.0f );
 			//PlRotateMatrix( angles.z, 0.0f, 0.0f, 1.0f );
 
-			DrawSector( NULL, sector, camera );
+			DrawSector( world, sector, camera );
 
 			PlPopMatrix();
 #endif
@@ -296,25 +274,26 @@ static void DrawSectorBody( YNCoreWorldSector *sector, YNCoreWorldMesh *worldMes
 		}
 		else
 		{
-			/* otherwise, in the case of an actual portal, we'll need
-			 * to fetch the target sector and the target face...
-			 * if these aren't set appropriately, then, well... */
+			/* actual portals are handled up front, see YnCore_World_GetVisibleSectors,
+			 * so the sector on the other side gets drawn in its own right */
 		}
-		face->flags &= ~WORLD_FACE_FLAG_SKIP;
-
-		faceNode = PlGetNextLinkedListNode( faceNode );
+		YnCore_WorldMesh_SetFaceFlags( worldMesh, visiblePortals[ i ], flags & ~WORLD_FACE_FLAG_SKIP );
 	}
 
 	// Draw solid surfaces
-	DrawFaces( worldMesh, visibleFaces, lights, numLights, false );
+	DrawFaces( worldMesh, visibleFaces, numVisibleFaces, lights, numLights, false );
 	// Draw transparent surfaces
-	DrawFaces( worldMesh, visiblePortals, lights, numLights, true );
+	DrawFaces( worldMesh, visiblePortals, numVisiblePortals, lights, numLights, true );
+}
 
-	PlDestroyLinkedList( visiblePortals );
-	visiblePortals = NULL;
+static void DrawSectorBody( YNCoreWorld *world, YNCoreWorldSector *sector, YNCoreWorldMesh *worldMesh, YNCoreCamera *camera )
+{
+	if ( worldMesh == NULL )
+		return;
 
-	PlDestroyLinkedList( visibleFaces );
-	visibleFaces = NULL;
+	unsigned int  numVisibleFaces;
+	unsigned int *visibleFaces = VIS_GetVisibleFaces( camera, worldMesh, &numVisibleFaces );
+	DrawSectorFaces( world, sector, worldMesh, visibleFaces, numVisibleFaces, camera );
 }
 
 static void DrawSector( YNCoreWorld *world, YNCoreWorldSector *sector, YNCoreCamera *camera )
@@ -322,10 +301,262 @@ static void DrawSector( YNCoreWorld *world, YNCoreWorldSector *sector, YNCoreCam
 	if ( sector == NULL )
 		return;
 
-	DrawSectorBody( sector, sector->mesh, camera );
+	DrawSectorBody( world, sector, sector->mesh, camera );
 
 	Act_DrawActors( camera, sector );
 	YnCore_EntityManager_Draw( camera, sector );
+
+	PS_DrawBatches( camera );
+}
+
+/****************************************
+ * STATIC OBJECTS
+ ****************************************/
+
+/* Static objects tend to be the same few props dotted about, so rather
+ * than drawing each of them on its own, the visible ones are gathered up
+ * from every visible sector and grouped by mesh. Each group's batches are
+ * then submitted once, along with the transforms for the whole group. */
+
+static struct
+{
+	const YNCoreWorldObject **objects;
+	uint64_t                 *keys;
+	uint64_t                 *scratchKeys;
+	uint32_t                 *order;
+	uint32_t                 *scratchOrder;
+	PLMatrix4                *objectTransforms; /* in the order they were gathered */
+	PLMatrix4                *transforms;       /* and for the group being submitted */
+	unsigned int              numObjects;
+	unsigned int              maxObjects;
+} staticObjects;
+
+static PLMatrix4 GetObjectTransform( const SGTransform *transform )
+{
+	PLMatrix4 matrix = PlTranslateMatrix4( transform->translation );
+
+	/* no rotation provided is left as-is, rather than being collapsed */
+	const PLQuaternion *q      = &transform->rotation;
+	float               length = sqrtf( q->x * q->x + q->y * q->y + q->z * q->z + q->w * q->w );
+	if ( length > 1e-4f )
+	{
+		float w = q->w / length;
+		float s = sqrtf( 1.0f - w * w );
+		if ( s > 1e-4f )
+		{
+			PLVector3 axis = PLVector3( q->x / length / s, q->y / length / s, q->z / length / s );
+			matrix         = PlMultiplyMatrix4( matrix, PlRotateMatrix4( 2.0f * acosf( w ), &axis ) );
+		}
+	}
+
+	/* and the same goes for the scale */
+	PLVector3 scale = transform->scale;
+	if ( scale.x != 0.0f || scale.y != 0.0f || scale.z != 0.0f )
+		matrix = PlScaleMatrix4( matrix, scale );
+
+	return matrix;
+}
+
+/**
+ * Bounds of the mesh once it's been moved into place, which is the box
+ * around all eight of its transformed corners. Rather than transforming
+ * each corner, each axis of the result takes the smaller and larger of
+ * every term in the transform, which works out the same.
+ */
+static PLCollisionAABB GetObjectBounds( const YNCoreWorldMesh *mesh, const PLMatrix4 *transform )
+{
+	/* row-major, as with the occlusion buffer */
+	const float *m = ( const float * ) transform;
+
+	PLVector3   mins    = PlAddVector3( mesh->bounds.origin, mesh->bounds.mins );
+	PLVector3   maxs    = PlAddVector3( mesh->bounds.origin, mesh->bounds.maxs );
+	const float lo[ 3 ] = { mins.x, mins.y, mins.z };
+	const float hi[ 3 ] = { maxs.x, maxs.y, maxs.z };
+
+	float outMins[ 3 ], outMaxs[ 3 ];
+	for ( unsigned int i = 0; i < 3; ++i )
+	{
+		outMins[ i ] = outMaxs[ i ] = m[ i * 4 + 3 ];
+		for ( unsigned int j = 0; j < 3; ++j )
+		{
+			float a = m[ i * 4 + j ] * lo[ j ];
+			float b = m[ i * 4 + j ] * hi[ j ];
+			outMins[ i ] += ( a < b ) ? a : b;
+			outMaxs[ i ] += ( a < b ) ? b : a;
+		}
+	}
+
+	PLCollisionAABB bounds;
+	PL_ZERO_( bounds );
+	bounds.mins = PLVector3( outMins[ 0 ], outMins[ 1 ], outMins[ 2 ] );
+	bounds.maxs = PLVector3( outMaxs[ 0 ], outMaxs[ 1 ], outMaxs[ 2 ] );
+	return bounds;
+}
+
+static void GatherStaticObjects( YNCoreWorldSector *sector, YNCoreCamera *camera )
+{
+	for ( unsigned int i = 0; i < sector->numStaticObjects; ++i )
+	{
+		const YNCoreWorldObject *object = &sector->staticObjects[ i ];
+		if ( object->mesh == NULL || object->mesh->numBatches == 0 )
+			continue;
+
+		PLMatrix4       transform = GetObjectTransform( &object->transform );
+		PLCollisionAABB bounds    = GetObjectBounds( object->mesh, &transform );
+		if ( !PlgIsBoxInsideView( camera->internal, &bounds ) )
+			continue;
+
+		if ( !OCC_IsBoxVisible( &bounds ) )
+		{
+			g_gfxPerfStats.numOccludedObjects++;
+			continue;
+		}
+
+		if ( staticObjects.numObjects == staticObjects.maxObjects )
+		{
+			staticObjects.maxObjects       = ( staticObjects.maxObjects > 0 ) ? staticObjects.maxObjects * 2 : 64;
+			staticObjects.objects          = PlReAlloc( staticObjects.objects, sizeof( YNCoreWorldObject * ) * staticObjects.maxObjects, true );
+			staticObjects.keys             = PlReAlloc( staticObjects.keys, sizeof( uint64_t ) * staticObjects.maxObjects, true );
+			staticObjects.scratchKeys      = PlReAlloc( staticObjects.scratchKeys, sizeof( uint64_t ) * staticObjects.maxObjects, true );
+			staticObjects.order            = PlReAlloc( staticObjects.order, sizeof( uint32_t ) * staticObjects.maxObjects, true );
+			staticObjects.scratchOrder     = PlReAlloc( staticObjects.scratchOrder, sizeof( uint32_t ) * staticObjects.maxObjects, true );
+			staticObjects.transforms       = PlReAlloc( staticObjects.transforms, sizeof( PLMatrix4 ) * staticObjects.maxObjects, true );
+			staticObjects.objectTransforms = PlReAlloc( staticObjects.objectTransforms, sizeof( PLMatrix4 ) * staticObjects.maxObjects, true );
+		}
+
+		/* only need the same meshes to end up next to each other */
+		staticObjects.objects[ staticObjects.numObjects ]          = object;
+		staticObjects.keys[ staticObjects.numObjects ]             = ( uint64_t ) ( uintptr_t ) object->mesh;
+		staticObjects.order[ staticObjects.numObjects ]            = staticObjects.numObjects;
+		staticObjects.objectTransforms[ staticObjects.numObjects ] = transform;
+		staticObjects.numObjects++;
+	}
+}
+
+static void DrawStaticObjects( YNCoreCamera *camera )
+{
+	if ( staticObjects.numObjects == 0 )
+		return;
+
+	PL_GET_CVAR( "r.instancing", instancing );
+	bool useInstancing = ( instancing == NULL || instancing->b_value );
+
+	Common_RadixSort64( staticObjects.keys, staticObjects.order, staticObjects.scratchKeys, staticObjects.scratchOrder, staticObjects.numObjects );
+
+	const PLVector3 *viewOrigin = &camera->internal->position;
+	for ( unsigned int i = 0, j; i < staticObjects.numObjects; i = j )
+	{
+		YNCoreWorldMesh *mesh = staticObjects.objects[ staticObjects.order[ i ] ]->mesh;
+
+		/* the group is sorted by whichever instance is closest */
+		PLVector3 origin       = pl_vecOrigin3;
+		float     nearestDepth = -1.0f;
+		for ( j = i; j < staticObjects.numObjects && staticObjects.keys[ j ] == staticObjects.keys[ i ]; ++j )
+		{
+			const YNCoreWorldObject *object = staticObjects.objects[ staticObjects.order[ j ] ];
+			staticObjects.transforms[ j - i ] = staticObjects.objectTransforms[ staticObjects.order[ j ] ];
+
+			PLVector3 d     = PlSubtractVector3( object->transform.translation, *viewOrigin );
+			float     depth = d.x * d.x + d.y * d.y + d.z * d.z;
+			if ( nearestDepth < 0.0f || depth < nearestDepth )
+			{
+				nearestDepth = depth;
+				origin       = object->transform.translation;
+			}
+		}
+
+		unsigned int numInstances = j - i;
+		for ( unsigned int k = 0; k < mesh->numBatches; ++k )
+		{
+			YNCoreWorldMeshBatch *batch = &mesh->batches[ k ];
+			if ( batch->isPortal || batch->numFaces == 0 )
+				continue;
+
+			g_gfxPerfStats.numFacesDrawn += batch->numFaces * numInstances;
+			g_gfxPerfStats.numIndicesSubmitted += batch->numIndices * numInstances;
+
+			if ( useInstancing )
+			{
+				YnCore_RenderQueue_SubmitInstanced( batch->material, batch->drawMesh, staticObjects.transforms, numInstances, &origin, NULL, 0 );
+				continue;
+			}
+
+			for ( unsigned int l = 0; l < numInstances; ++l )
+			{
+				const PLVector3 *instanceOrigin = &staticObjects.objects[ staticObjects.order[ i + l ] ]->transform.translation;
+				YnCore_RenderQueue_SubmitInstanced( batch->material, batch->drawMesh, &staticObjects.transforms[ l ], 1, instanceOrigin, NULL, 0 );
+			}
+		}
+	}
+
+	staticObjects.numObjects = 0;
+}
+
+void YnCore_World_ShutdownStaticObjects( void )
+{
+	PL_DELETE( staticObjects.objects );
+	PL_DELETE( staticObjects.keys );
+	PL_DELETE( staticObjects.scratchKeys );
+	PL_DELETE( staticObjects.order );
+	PL_DELETE( staticObjects.scratchOrder );
+	PL_DELETE( staticObjects.transforms );
+	PL_DELETE( staticObjects.objectTransforms );
+	PL_ZERO_( staticObjects );
+}
+
+/**
+ * Queues up the surfaces of everything visible; the sector bodies and
+ * whatever static objects sit within them. Everything is frustum culled
+ * up front, so that the biggest of the faces that are left can be drawn
+ * as occluders before any of it is tested and submitted.
+ */
+static void DrawVisibleSectors( YNCoreWorld *world, YNCoreWorldSector **visibleSectors, unsigned int numVisibleSectors, YNCoreCamera *camera )
+{
+	PL_GET_CVAR( "world.drawSubMeshes", drawSubMeshes );
+	bool drawObjects = ( drawSubMeshes == NULL || drawSubMeshes->b_value );
+
+	unsigned int **sectorFaces    = VIS_Alloc( sizeof( unsigned int * ) * numVisibleSectors );
+	unsigned int  *numSectorFaces = VIS_Alloc( sizeof( unsigned int ) * numVisibleSectors );
+
+	bool useOcclusion = OCC_BeginFrame( camera );
+	for ( unsigned int i = 0; i < numVisibleSectors; ++i )
+	{
+		YNCoreWorldMesh *mesh = visibleSectors[ i ]->mesh;
+		if ( mesh == NULL )
+		{
+			sectorFaces[ i ]    = NULL;
+			numSectorFaces[ i ] = 0;
+			continue;
+		}
+
+		sectorFaces[ i ] = VIS_GetVisibleFaces( camera, mesh, &numSectorFaces[ i ] );
+		if ( useOcclusion )
+			OCC_AddOccluders( mesh, sectorFaces[ i ], numSectorFaces[ i ] );
+	}
+	OCC_DrawOccluders();
+
+	for ( unsigned int i = 0; i < numVisibleSectors; ++i )
+	{
+		YNCoreWorldSector *sector = visibleSectors[ i ];
+		if ( numSectorFaces[ i ] > 0 )
+		{
+			/* sectors that are entirely hidden don't need each face checked */
+			if ( OCC_IsBoxVisible( &sector->mesh->bounds ) )
+			{
+				numSectorFaces[ i ] = OCC_CullFaces( sector->mesh, sectorFaces[ i ], numSectorFaces[ i ] );
+				DrawSectorFaces( world, sector, sector->mesh, sectorFaces[ i ], numSectorFaces[ i ], camera );
+			}
+			else
+				g_gfxPerfStats.numOccludedFaces += numSectorFaces[ i ];
+		}
+
+		if ( drawObjects )
+			GatherStaticObjects( sector, camera );
+	}
+
+	DrawStaticObjects( camera );
+
+	OCC_EndFrame();
 }
 
 /**
@@ -415,16 +646,140 @@ void YnCore_World_Draw( YNCoreWorld *world, YNCoreWorldSector *originSector, YNC
 
 	YN_CORE_PROFILE_START( PROFILE_DRAW_WORLD );
 
+	/* stream in whatever's around the view */
+	world->streamOrigin = camera->internal->position;
+
 	PlMatrixMode( PL_MODELVIEW_MATRIX );
 	PlPushMatrix();
 	PlLoadIdentityMatrix();
 
+	VIS_BeginFrame();
+
 	DrawSky( world, camera );
 
-	PL_GET_CVAR( "world.drawSectorVolumes", drawSectorVolumes );
-	DrawSector( world, originSector, camera );
+	unsigned int        numVisibleSectors;
+	YNCoreWorldSector **visibleSectors = YnCore_World_GetVisibleSectors( world, originSector, camera, &numVisibleSectors );
+
+	/* world surfaces are queued up and sorted, and then actors and
+	 * entities follow, since they may draw translucent bits of their
+	 * own that need to go over the world */
+	YnCore_RenderQueue_Begin( &camera->internal->position );
+	DrawVisibleSectors( world, visibleSectors, numVisibleSectors, camera );
+	YnCore_RenderQueue_Flush();
+
+	for ( unsigned int i = 0; i < numVisibleSectors; ++i )
+	{
+		Act_DrawActors( camera, visibleSectors[ i ] );
+		YnCore_EntityManager_Draw( camera, visibleSectors[ i ] );
+	}
+
+	/* particles of every actor in view go out together */
+	PS_DrawBatches( camera );
+
+	g_gfxPerfStats.numVisibleSectors += numVisibleSectors;
 
 	PlPopMatrix();
 
 	YN_CORE_PROFILE_END( PROFILE_DRAW_WORLD );
 }
+
+/****************************************
+ * BENCHMARK
+ ****************************************/
+
+#define WORLD_BENCHMARK_DEFAULT_FRAMES 500
+
+/**
+ * Draws the current world's surfaces through the null backend, spinning
+ * the camera around the middle of the first sector, so we can see what
+ * it costs to produce a frame without a graphics context.
+ */
+void YnCore_World_BenchmarkCommand( unsigned int argc, char **argv )
+{
+	YNCoreWorld *world = Game_GetCurrentWorld();
+	if ( world == NULL || world->numSectors == 0 )
+	{
+		PRINT_WARNING( "No world loaded to benchmark!\n" );
+		return;
+	}
+
+	unsigned int numFrames = WORLD_BENCHMARK_DEFAULT_FRAMES;
+	if ( argc > 1 )
+	{
+		numFrames = strtoul( argv[ 1 ], NULL, 10 );
+		if ( numFrames == 0 )
+		{
+			PRINT_WARNING( "Invalid number of frames specified!\n" );
+			return;
+		}
+	}
+
+	float mins[ 3 ], maxs[ 3 ];
+	YnCore_WorldSector_GetExtents( &world->sectors[ 0 ], mins, maxs );
+
+	PLVector3     origin = PLVector3( ( mins[ 0 ] + maxs[ 0 ] ) * 0.5f, ( mins[ 1 ] + maxs[ 1 ] ) * 0.5f, ( mins[ 2 ] + maxs[ 2 ] ) * 0.5f );
+	YNCoreCamera *camera = YnCore_Camera_Create( "worldBenchmark", &origin, &pl_vecOrigin3 );
+
+	YNCoreWorldSector *originSector = YnCore_World_GetSectorByGlobalOrigin( world, &origin );
+	if ( originSector == NULL )
+		originSector = &world->sectors[ 0 ];
+
+	bool wasNullBackend = YnCore_CommandBuffer_SetNullBackend( true );
+	YnCore_CommandBuffer_ResetNullStats();
+
+	PlMatrixMode( PL_MODELVIEW_MATRIX );
+	PlPushMatrix();
+	PlLoadIdentityMatrix();
+
+	unsigned int numOccludedFaces   = g_gfxPerfStats.numOccludedFaces;
+	unsigned int numOccludedObjects = g_gfxPerfStats.numOccludedObjects;
+
+	unsigned int numDrawnSectors = 0;
+	double       startTime       = PlGetCurrentSeconds();
+	for ( unsigned int i = 0; i < numFrames; ++i )
+	{
+		YnCore_Camera_SetAngles( camera, &PLVector3( 0.0f, ( 360.0f / numFrames ) * i, 0.0f ) );
+		PlgSetupCamera( camera->internal );
+
+		VIS_BeginFrame();
+		YnCore_Material_UpdateFrameParameters();
+
+		unsigned int        numVisibleSectors;
+		YNCoreWorldSector **visibleSectors = YnCore_World_GetVisibleSectors( world, originSector, camera, &numVisibleSectors );
+
+		YnCore_RenderQueue_Begin( &camera->internal->position );
+		DrawVisibleSectors( world, visibleSectors, numVisibleSectors, camera );
+		YnCore_RenderQueue_Flush();
+
+		numDrawnSectors += numVisibleSectors;
+	}
+	double frameTime = ( PlGetCurrentSeconds() - startTime ) / numFrames;
+
+	numOccludedFaces   = g_gfxPerfStats.numOccludedFaces - numOccludedFaces;
+	numOccludedObjects = g_gfxPerfStats.numOccludedObjects - numOccludedObjects;
+
+	PlPopMatrix();
+
+	YnCore_CommandBuffer_SetNullBackend( wasNullBackend );
+
+	YNCoreCommandStats stats;
+	YnCore_CommandBuffer_GetNullStats( &stats );
+
+	unsigned int numCommands = 0;
+	for ( unsigned int i = 0; i < YN_CORE_MAX_RENDER_COMMANDS; ++i )
+		numCommands += stats.numCommands[ i ];
+
+	PRINT( "Drew %u frames (%.1f sectors per frame):\n", numFrames, ( double ) numDrawnSectors / numFrames );
+	PRINT( "  frame:    %.3fms\n", frameTime * 1000.0 );
+	PRINT( "  commands: %.1f per frame (%.1fKB)\n", ( double ) numCommands / numFrames, ( double ) stats.numBytes / numFrames / 1024.0 );
+	unsigned int numDrawCommands = stats.numCommands[ YN_CORE_RENDER_COMMAND_DRAW_MESH ] + stats.numCommands[ YN_CORE_RENDER_COMMAND_DRAW_MESH_INSTANCED ];
+	PRINT( "  draws:    %.1f per frame (from %.1f draw commands)\n", ( double ) stats.numDraws / numFrames, ( double ) numDrawCommands / numFrames );
+	PRINT( "  programs: %.1f per frame\n", ( double ) stats.numCommands[ YN_CORE_RENDER_COMMAND_BIND_PROGRAM ] / numFrames );
+	PRINT( "  textures: %.1f per frame\n", ( double ) stats.numCommands[ YN_CORE_RENDER_COMMAND_BIND_TEXTURE ] / numFrames );
+	PRINT( "  uniforms: %.1f per frame\n", ( double ) stats.numCommands[ YN_CORE_RENDER_COMMAND_SET_UNIFORM ] / numFrames );
+	PRINT( "  occluded: %.1f faces, %.1f objects per frame\n", ( double ) numOccludedFaces / numFrames, ( double ) numOccludedObjects / numFrames );
+	if ( stats.numInvalidCommands > 0 )
+		PRINT_WARNING( "%u invalid commands!\n", stats.numInvalidCommands );
+
+	YnCore_Camera_Destroy( camera );
+}
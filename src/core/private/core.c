@@ -92,6 +92,7 @@ bool YnCore_Initialize( const char *config )
 	YnCore_InitializeProfiler();
 	YnCore_InitializeScheduler();
 	YnCore_InitializeMemoryManager();
+	YnCore_FileSystem_EnablePackageBlobCache();
 	YnCore_InitializeNet();
 
 	YnCore_InitializeServer();
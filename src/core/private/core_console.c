@@ -3,6 +3,8 @@
 
 #include "core_private.h"
 
+#include <SDL2/SDL.h>
+
 #include <yin/node.h>
 
 #include "client/client_input.h"
@@ -30,7 +32,23 @@ static void ClearConsoleCommand( unsigned int argc, char **argv )
 	ClearOutputBuffer();
 }
 
-static void OutputCallback( int level, const char *message, PLColour colour )
+/* messages can turn up from the loader threads, but the buffer and
+ * shell are only touched from the main thread, so those are held
+ * onto until the main thread gets around to flushing them */
+typedef struct DeferredOutput
+{
+	int level;
+	char *message;
+	PLColour colour;
+	struct DeferredOutput *next;
+} DeferredOutput;
+
+static SDL_threadID mainThread;
+static SDL_mutex *deferredOutputMutex;
+static DeferredOutput *deferredOutputHead;
+static DeferredOutput *deferredOutputTail;
+
+static void PushOutput( int level, const char *message, PLColour colour )
 {
 	size_t l = strlen( message );
 	if ( l >= CONSOLE_BUFFER_MAX_LENGTH )
@@ -55,6 +73,57 @@ static void OutputCallback( int level, const char *message, PLColour colour )
 	YnCore_ShellInterface_PushMessage( level, message, &colour );
 }
 
+/**
+ * Pushes out anything that was printed from another thread. Needs
+ * to be called from the main thread once whatever was running on
+ * the other thread has completed.
+ */
+void Console_FlushDeferredOutput( void )
+{
+	if ( deferredOutputMutex == NULL )
+		return;
+
+	SDL_LockMutex( deferredOutputMutex );
+	DeferredOutput *output = deferredOutputHead;
+	deferredOutputHead = deferredOutputTail = NULL;
+	SDL_UnlockMutex( deferredOutputMutex );
+
+	while ( output != NULL )
+	{
+		DeferredOutput *next = output->next;
+		PushOutput( output->level, output->message, output->colour );
+		PL_DELETE( output->message );
+		PL_DELETE( output );
+		output = next;
+	}
+}
+
+static void OutputCallback( int level, const char *message, PLColour colour )
+{
+	if ( deferredOutputMutex != NULL && SDL_ThreadID() != mainThread )
+	{
+		DeferredOutput *output = PL_NEW( DeferredOutput );
+		output->level          = level;
+		output->colour         = colour;
+		output->message        = PL_NEW_( char, strlen( message ) + 1 );
+		strcpy( output->message, message );
+
+		SDL_LockMutex( deferredOutputMutex );
+		if ( deferredOutputTail != NULL )
+			deferredOutputTail->next = output;
+		else
+			deferredOutputHead = output;
+		deferredOutputTail = output;
+		SDL_UnlockMutex( deferredOutputMutex );
+		return;
+	}
+
+	/* keep things in order */
+	Console_FlushDeferredOutput();
+
+	PushOutput( level, message, colour );
+}
+
 /* CONSOLE COMMANDS */
 
 #define CMD_CALLBACK( NAME ) static void Cmd_##NAME( unsigned int argc, char **argv )
@@ -221,6 +290,9 @@ void Console_Print( ConsoleLogLevel level, const char *message, ... )
  */
 void YnCore_InitializeConsole( void )
 {
+	mainThread          = SDL_ThreadID();
+	deferredOutputMutex = SDL_CreateMutex();
+
 	PlSetConsoleOutputCallback( OutputCallback );
 
 	logLevels[ YINENGINE_LOG_ERROR ]       = PlAddLogLevel( "yin/error", PL_COLOUR_RED, true );
@@ -238,6 +310,11 @@ void YnCore_InitializeConsole( void )
 
 void YnCore_ShutdownConsole( void )
 {
+	Console_FlushDeferredOutput();
+
 	ClearOutputBuffer();
 	SaveUserConfig();
+
+	SDL_DestroyMutex( deferredOutputMutex );
+	deferredOutputMutex = NULL;
 }
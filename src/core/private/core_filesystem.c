@@ -4,6 +4,10 @@
 #include "core_private.h"
 #include "core_filesystem.h"
 
+#include <plcore/pl_hashtable.h>
+
+#include <SDL2/SDL.h>
+
 #include <yin/node.h>
 
 /****************************************
@@ -99,6 +103,65 @@ static void ParseAliases( YNNodeBranch *root )
 	}
 }
 
+/* decoded package data that's shared between aliased entries, keyed
+ * by the full blob id rather than a hash of it, so ids can't collide.
+ * Packages are read from the loader threads too, hence the lock.
+ * There's no budget or eviction here; every shared blob that's read
+ * stays resident until YnCore_FileSystem_ClearMountedLocations */
+static PLHashTable *packageBlobs     = NULL;
+static SDL_mutex   *packageBlobMutex = NULL;
+
+static CommonPkgBlob *GetCachedPackageBlob( const char *id )
+{
+	SDL_LockMutex( packageBlobMutex );
+	CommonPkgBlob *blob = NULL;
+	if ( packageBlobs != NULL )
+		blob = ( CommonPkgBlob * ) PlLookupHashTableUserData( packageBlobs, id, strlen( id ) );
+	SDL_UnlockMutex( packageBlobMutex );
+
+	return blob;
+}
+
+static void AddCachedPackageBlob( const char *id, CommonPkgBlob *blob )
+{
+	SDL_LockMutex( packageBlobMutex );
+	if ( packageBlobs == NULL )
+		packageBlobs = PlCreateHashTable();
+
+	/* two loaders can decode the same blob at once, in which case whoever
+	 * got here first wins, and it's no different to a hit */
+	if ( PlLookupHashTableUserData( packageBlobs, id, strlen( id ) ) != NULL )
+	{
+		SDL_UnlockMutex( packageBlobMutex );
+		Common_Pkg_DestroyBlob( blob );
+		return;
+	}
+
+	PlInsertHashTableNode( packageBlobs, id, strlen( id ), blob );
+	SDL_UnlockMutex( packageBlobMutex );
+}
+
+static void FlushPackageBlobs( void )
+{
+	SDL_LockMutex( packageBlobMutex );
+	if ( packageBlobs == NULL )
+	{
+		SDL_UnlockMutex( packageBlobMutex );
+		return;
+	}
+
+	PLHashTableNode *node = PlGetFirstHashTableNode( packageBlobs );
+	while ( node != NULL )
+	{
+		Common_Pkg_DestroyBlob( ( CommonPkgBlob * ) PlGetHashTableNodeUserData( node ) );
+		node = PlGetNextHashTableNode( packageBlobs, node );
+	}
+
+	PlDestroyHashTable( packageBlobs );
+	packageBlobs = NULL;
+	SDL_UnlockMutex( packageBlobMutex );
+}
+
 #define USER_CONFIG "user" YN_NODE_DEFAULT_EXTENSION
 static char configPath[ PL_SYSTEM_MAX_PATH ] = { '\0' };
 
@@ -217,8 +280,27 @@ void FileSystem_MountLocations( void )
 	}
 }
 
+/**
+ * Hooks the package loader up to our blob cache, so blobs
+ * shared by multiple package entries are only decoded once.
+ */
+void YnCore_FileSystem_EnablePackageBlobCache( void )
+{
+	if ( packageBlobMutex == NULL && ( packageBlobMutex = SDL_CreateMutex() ) == NULL )
+	{
+		PRINT_WARNING( "Failed to create package blob cache lock: %s\n", SDL_GetError() );
+		return;
+	}
+
+	Common_Pkg_SetBlobCacheInterface( GetCachedPackageBlob, AddCachedPackageBlob );
+}
+
 void YnCore_FileSystem_ClearMountedLocations( void )
 {
+	/* anything cached or marked as shared is only valid for the packages it came from */
+	FlushPackageBlobs();
+	Common_Pkg_ClearSharedBlobs();
+
 	for ( unsigned int i = 0; i < numMountedLocations; ++i )
 	{
 		if ( fileSystemMounts[ i ] == NULL )
@@ -12,3 +12,4 @@ void FileSystem_SetupConfig( YNNodeBranch *root );
 void YnCore_FileSystem_MountBaseLocations( void );
 void FileSystem_MountLocations( void );
 void YnCore_FileSystem_ClearMountedLocations( void );
+void YnCore_FileSystem_EnablePackageBlobCache( void );
@@ -28,7 +28,8 @@ typedef enum InputTarget
 static InputTarget inputTarget = INPUT_TARGET_MENU;
 static MenuState   menuState   = MENU_STATE_START;
 
-static YNCoreWorld *currentWorld = NULL;
+static YNCoreWorld        *currentWorld = NULL;
+static YNCoreWorldLoadJob *pendingWorld = NULL;
 
 static void SpawnWorldCommand( unsigned int argc, char **argv )
 {
@@ -59,9 +60,18 @@ void YnCore_InitializeGame( void )
 	globalGameErrorLog   = PlAddLogLevel( "game/error", PL_COLOUR_RED, true );
 
 	PlRegisterConsoleCommand( "world", "Load in and spawn the specified world.", 1, SpawnWorldCommand );
+	PlRegisterConsoleCommand( "world.benchmarkFaceLayout", "Time culling and plane collision against the old and packed face layouts, optionally specifying how many faces.", -1, YnCore_WorldMesh_BenchmarkFaceLayoutCommand );
+	PlRegisterConsoleCommand( "world.benchmarkFaceQueries", "Time spatial queries against a generated sector, optionally specifying how many faces.", -1, YnCore_WorldMesh_BenchmarkQueriesCommand );
+	PlRegisterConsoleCommand( "world.benchmarkActorCollision", "Time world collision for a crowd of actors in a generated sector, optionally specifying how many actors.", -1, Act_BenchmarkWorldCollisionCommand );
+	PlRegisterConsoleCommand( "world.benchmarkSectorLookup", "Time looking up sectors by point in a generated world, optionally specifying how many sectors.", -1, YnCore_World_BenchmarkSectorLookupCommand );
+	PlRegisterConsoleCommand( "world.computeVisibility", "Compute the visible sets for the current world, optionally saving it to the given path.", -1, YnCore_World_ComputeVisibilityCommand );
+	PlRegisterConsoleCommand( "world.testStreaming", "Load the specified world in the background while ticking and report the longest stall, optionally specifying how many ticks.", -1, YnCore_World_TestStreamingCommand );
+	PlRegisterConsoleCommand( "world.verifyVisibility", "Check the visible sets for the current world against ray casts, optionally specifying how many per sector pair.", -1, YnCore_World_VerifyVisibilityCommand );
 
 	PL_ZERO_( gameState );
 
+	YnCore_World_InitializeStreaming();
+
 	Lisp_Interface_Initialize();
 	Lisp_Interface_CompileScript( "test.lisp" );
 
@@ -93,6 +103,11 @@ void YnCore_ShutdownGame( void )
 
 	YnCore_EntityManager_Shutdown();
 	Lisp_Interface_Shutdown();
+
+	YnCore_World_CancelLoad( pendingWorld );
+	pendingWorld = NULL;
+
+	YnCore_World_ShutdownStreaming();
 }
 
 MenuState Game_GetMenuState( void )
@@ -100,8 +115,23 @@ MenuState Game_GetMenuState( void )
 	return menuState;
 }
 
+static void FinishSpawnWorld( YNCoreWorld *world );
+
 void Game_Tick( void )
 {
+	if ( pendingWorld != NULL && YnCore_World_IsLoadFinished( pendingWorld ) )
+	{
+		YNCoreWorld *world = YnCore_World_FinishLoad( pendingWorld );
+		pendingWorld       = NULL;
+		if ( world != NULL )
+			FinishSpawnWorld( world );
+		else
+			PRINT_WARNING( "Failed to load world, aborting game spawn!\n" );
+	}
+
+	if ( currentWorld != NULL )
+		YnCore_World_UpdateStreaming( currentWorld, &currentWorld->streamOrigin );
+
 	YnCore_EntityManager_Tick();
 
 	gameModeInterface->RequestCallbackMethod( GAMEMODE_REQUEST_TICK, NULL );
@@ -109,6 +139,9 @@ void Game_Tick( void )
 
 void Game_Disconnect( void )
 {
+	YnCore_World_CancelLoad( pendingWorld );
+	pendingWorld = NULL;
+
 	if ( currentWorld != NULL )
 	{
 		if ( currentWorld->isDirty )
@@ -136,6 +169,10 @@ void Game_SetupWorldProperties( YNCoreWorld *world )
 	}
 }
 
+/**
+ * The world is loaded in the background, and
+ * then spawned once it's ready, see Game_Tick.
+ */
 void Game_SpawnWorld( const char *worldPath )
 {
 	if ( currentWorld != NULL && strcmp( currentWorld->path, worldPath ) == 0 )
@@ -146,17 +183,17 @@ void Game_SpawnWorld( const char *worldPath )
 
 	Game_Disconnect();
 
-	YNCoreWorld *world = YnCore_World_Load( worldPath );
-	if ( world == NULL )
-	{
+	pendingWorld = YnCore_World_BeginLoad( worldPath );
+	if ( pendingWorld == NULL )
 		PRINT_WARNING( "Failed to load world, aborting game spawn!\n" );
-		return;
-	}
+}
 
+static void FinishSpawnWorld( YNCoreWorld *world )
+{
 	currentWorld = world;
 
 	/* HACK, if it's the menu, force menu mode!! */
-	const char *fileName = PlGetFileName( worldPath );
+	const char *fileName = PlGetFileName( world->path );
 	if ( strncmp( "menu", fileName, strlen( fileName ) - 5 ) == 0 )
 	{
 		menuState = MENU_STATE_START;
@@ -1,6 +0,0 @@
-/* SPDX-License-Identifier: LGPL-3.0-or-later */
-/* Copyright © 2020-2022 Mark E Sowden <hogsy@oldtimes-software.com> */
-
-#pragma once
-
-PLImage *Image_LoadPackedImage( PLFile *filePtr );
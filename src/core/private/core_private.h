@@ -125,6 +125,7 @@ void YnCore_ShutdownConsole( void );
 
 int  Console_GetLogLevel( ConsoleLogLevel level );
 void Console_Print( ConsoleLogLevel level, const char *message, ... );
+void Console_FlushDeferredOutput( void );
 
 void YnCore_RegisterConsoleCommands( bool isDedicated );
 void YnCore_RegisterConsoleVariables( bool isDedicated );
@@ -12,6 +12,7 @@ void Editor_Tick( void );
 void Editor_Draw( const YNCoreViewport *viewport );
 
 void Editor_Commands_Register( void );
+void Editor_Lightmapper_Register( void );
 
 void Editor_MaterialSelector_Initialize( void );
 void Editor_MaterialSelector_Shutdown( void );
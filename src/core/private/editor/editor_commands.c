@@ -123,6 +123,8 @@ void Editor_Commands_Register( void )
 	                          "Create a new mesh, either at the origin point or given location.",
 	                          3, CreateMeshCommand );
 
+	Editor_Lightmapper_Register();
+
 	PlRegisterConsoleCommand( "modelEditor",
 	                          "Enable/disable model editor.",
 	                          0, ModelEditorCommand );
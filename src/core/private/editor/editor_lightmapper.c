@@ -1,3 +1,81 @@
-//
-// Created by mark- on 19/04/2022.
-//
+// SPDX-License-Identifier: LGPL-3.0-or-later
+// Copyright © 2020-2023 OldTimes Software, Mark E Sowden <hogsy@oldtimes-software.com>
+
+#include <SDL2/SDL.h>
+
+#include <plcore/pl_timer.h>
+
+#include <yin/core_world.h>
+#include <yin/node.h>
+
+#include "core_private.h"
+#include "editor.h"
+
+#include "common_lightmap.h"
+
+/* Bakes run on every core by default. The console is blocked until it's done. */
+
+static void BakeLightmapsCommand( unsigned int argc, char **argv )
+{
+	if ( argc < 2 )
+	{
+		PRINT_WARNING( "Usage: %s <world> [threads]\n", argv[ 0 ] );
+		return;
+	}
+
+	PLPath worldPath;
+	snprintf( worldPath, sizeof( worldPath ), "worlds/%s/%s." YN_CORE_WORLD_EXTENSION, argv[ 1 ], argv[ 1 ] );
+
+	PLPath outPath;
+	if ( !Common_Lightmap_GetOutputPath( worldPath, outPath, sizeof( outPath ) ) )
+	{
+		PRINT_WARNING( "Invalid world path: %s\n", worldPath );
+		return;
+	}
+
+	int numThreads = ( argc > 2 ) ? atoi( argv[ 2 ] ) : SDL_GetCPUCount();
+	if ( numThreads < 1 )
+		numThreads = 1;
+	else if ( numThreads > CMN_LIGHTMAP_MAX_THREADS )
+		numThreads = CMN_LIGHTMAP_MAX_THREADS;
+
+	double startTime = PlGetCurrentSeconds();
+
+	CommonLightmapBaker baker;
+	Common_Lightmap_Setup( &baker, CMN_LIGHTMAP_DEFAULT_LUXEL_SIZE, CMN_LIGHTMAP_DEFAULT_ATLAS_SIZE );
+	if ( !Common_Lightmap_LoadWorld( &baker, worldPath ) || !Common_Lightmap_Prepare( &baker ) )
+	{
+		PRINT_WARNING( "Failed to set up lightmaps for %s!\n", worldPath );
+		Common_Lightmap_Destroy( &baker );
+		return;
+	}
+
+	PRINT( "Baking %u charts into %u atlases, with %u lights, on %d threads...\n",
+	       baker.numCharts, baker.numAtlases, baker.numLights, numThreads );
+
+	double bakeTime = PlGetCurrentSeconds();
+
+	uint64_t numRays = Common_LightmapBaker_BakeThreaded( &baker, ( unsigned int ) numThreads );
+
+	double endTime = PlGetCurrentSeconds();
+
+	YNNodeBranch *root = Common_Lightmap_Serialise( &baker );
+	if ( !YnNode_WriteFile( outPath, root, YN_NODE_FILE_BINARY ) )
+		PRINT_WARNING( "Failed to write lightmaps: %s\n", outPath );
+	else
+	{
+		double seconds = ( endTime > bakeTime ) ? endTime - bakeTime : 1e-6;
+		PRINT( "Wrote \"%s\" in %.2lfs (%llu rays, %.2lf Mrays/s)\n",
+		       outPath, PlGetCurrentSeconds() - startTime, ( unsigned long long ) numRays, ( ( double ) numRays / seconds ) / 1000000.0 );
+	}
+
+	YnNode_DestroyBranch( root );
+	Common_Lightmap_Destroy( &baker );
+}
+
+void Editor_Lightmapper_Register( void )
+{
+	PlRegisterConsoleCommand( "editor.bakeLightmaps",
+	                          "Bake lightmaps for the given world, optionally on the given number of threads.",
+	                          -1, BakeLightmapsCommand );
+}
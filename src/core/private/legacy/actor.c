@@ -273,23 +273,24 @@ void Act_DrawActors( YNCoreCamera *camera, YNCoreWorldSector *sector )
 			PLLinkedListNode *colliderNode = PlGetFirstNode( actor->geoColliders );
 			while ( colliderNode != NULL )
 			{
-				YNCoreWorldFace *face = PlGetLinkedListNodeUserData( colliderNode );
+				YNCoreWorldFace       *face   = PlGetLinkedListNodeUserData( colliderNode );
+				const PLCollisionAABB *bounds = YnCore_WorldFace_GetBounds( face );
 
-				PLCollisionPlane plane     = PlSetupCollisionPlane( face->bounds.absOrigin, face->normal );
+				PLCollisionPlane plane     = face->parentMesh->facePlanes[ face->index ];
 				PLCollision      collision = PlIsSphereIntersectingPlane( &PlSetupCollisionSphere( actor->position, 16.0f ), &plane );
 				if ( collision.penetration > 0.0f )
 				{
-					PlgDrawBoundingVolume( &face->bounds, PL_COLOUR_RED );
+					PlgDrawBoundingVolume( bounds, PL_COLOUR_RED );
 
 					YnCore_DrawAxesPivot( collision.contactPoint, plane.normal );
 
 					PLMatrix4 transform = PlMatrix4Identity();
-					PlgDrawSimpleLine( transform, face->bounds.absOrigin, PlAddVector3( face->bounds.absOrigin, PlScaleVector3F( plane.normal, 64.0f ) ), PLColour( 255, 255, 0, 255 ) );
+					PlgDrawSimpleLine( transform, bounds->absOrigin, PlAddVector3( bounds->absOrigin, PlScaleVector3F( plane.normal, 64.0f ) ), PLColour( 255, 255, 0, 255 ) );
 					PlgDrawSimpleLine( transform, actor->collisionVolume.origin, collision.contactPoint, PLColour( 0, 255, 0, 255 ) );
 				}
 				else
 				{
-					PlgDrawBoundingVolume( &face->bounds, PL_COLOUR_GREEN );
+					PlgDrawBoundingVolume( bounds, PL_COLOUR_GREEN );
 				}
 
 				colliderNode = PlGetNextLinkedListNode( colliderNode );
@@ -305,6 +306,50 @@ void Act_DrawActors( YNCoreCamera *camera, YNCoreWorldSector *sector )
 }
 
 #define GRAVITY 7.0f
+
+/**
+ * Pushes the actor out of the given face of the mesh if
+ * it's intersecting, and keeps track of it if so.
+ */
+static void Act_CollideWithFace( Actor *actor, const PLCollisionSphere *colSphere, const YNCoreWorldMesh *mesh, unsigned int faceIndex )
+{
+	if ( !PlIsAabbIntersecting( &actor->collisionVolume, &mesh->faceBounds[ faceIndex ] ) )
+	{
+		return;
+	}
+
+	/* now see if we're hitting anything */
+	PLCollision collision = PlIsSphereIntersectingPlane( colSphere, &mesh->facePlanes[ faceIndex ] );
+	if ( collision.penetration > 0.0f )
+	{
+		//printf( "penetration: %f\n", collision.penetration );
+		actor->position = PlAddVector3( actor->position, PlScaleVector3F( PlNormalizeVector3( collision.contactNormal ), collision.penetration / GRAVITY ) );
+
+		PLLinkedListNode *node = PlInsertLinkedListNode( actor->geoColliders, mesh->faceTable[ faceIndex ] );
+		if ( node == NULL )
+		{
+			PRINT_ERROR( "Failed to insert node into colliders list!\n" );
+		}
+	}
+}
+
+static PLCollisionSphere Act_GetCollisionSphere( const Actor *actor, const PLVector3 *nPos )
+{
+	PLVector3 absOrigin = PlGetAabbAbsOrigin( &actor->collisionVolume, *nPos );
+	return PlSetupCollisionSphere( absOrigin, 16.0f );
+}
+
+/**
+ * Runs through the mesh's packed face bounds and planes,
+ * pushing the actor out of anything it's intersecting.
+ */
+static void Act_CollideWithMesh( Actor *actor, const PLVector3 *nPos, const YNCoreWorldMesh *mesh )
+{
+	PLCollisionSphere colSphere = Act_GetCollisionSphere( actor, nPos );
+	for ( unsigned int i = 0; i < mesh->numFaces; ++i )
+		Act_CollideWithFace( actor, &colSphere, mesh, i );
+}
+
 void Act_TickActors( void *userData, double delta )
 {
 	PLLinkedListNode *index = PlGetFirstNode( actorList );
@@ -368,42 +413,10 @@ void Act_TickActors( void *userData, double delta )
 
 		/* and now check actor vs world collision */
 
-		/* first need to figure out what faces we're intersecting with */
-
 		PlDestroyLinkedListNodes( actor->geoColliders );
-		if ( actor->sector != NULL )
+		if ( actor->sector != NULL && actor->sector->mesh != NULL )
 		{
-			unsigned int numFaces;
-			YNCoreWorldFace **faces = YnCore_WorldSector_GetMeshFaces( actor->sector, &numFaces );
-			for ( unsigned int i = 0; i < numFaces; ++i )
-			{
-				if ( !PlIsAabbIntersecting( &actor->collisionVolume, &faces[ i ]->bounds ) )
-				{
-					continue;
-				}
-
-				/* convert the face into a plane */
-				PLCollisionPlane plane = PlSetupCollisionPlane( faces[ i ]->bounds.absOrigin, faces[ i ]->normal );
-
-				/* now see if we're hitting anything */
-				PLVector3         absOrigin = PlGetAabbAbsOrigin( &actor->collisionVolume, nPos );
-				PLCollisionSphere colSphere = PlSetupCollisionSphere( absOrigin, 16.0f );
-				PLCollision       collision = PlIsSphereIntersectingPlane( &colSphere, &plane );
-				if ( collision.penetration > 0.0f )
-				{
-					//printf( "penetration: %f\n", collision.penetration );
-					actor->position = PlAddVector3( actor->position, PlScaleVector3F( PlNormalizeVector3( collision.contactNormal ), collision.penetration / GRAVITY ) );
-
-					float d = PL_RAD2DEG( PlVector3Length( PlNormalizeVector3( collision.contactNormal ) ) );
-
-					PLLinkedListNode *node = PlInsertLinkedListNode( actor->geoColliders, &faces[ i ] );
-					if ( node == NULL )
-					{
-						PRINT_ERROR( "Failed to insert node into colliders list!\n" );
-					}
-				}
-			}
-			PL_DELETE( faces );
+			Act_CollideWithMesh( actor, &nPos, actor->sector->mesh );
 		}
 
 		if ( actor->setup.Tick != NULL )
@@ -431,3 +444,170 @@ Actor *Act_GetByTag( const char *tag, Actor *start )
 
 	return NULL;
 }
+
+/****************************************
+ * BENCHMARK
+ ****************************************/
+
+#define ACTOR_BENCHMARK_DEFAULT_ACTORS 1000
+#define ACTOR_BENCHMARK_TICKS          60
+#define ACTOR_BENCHMARK_GRID_SIZE      32
+#define ACTOR_BENCHMARK_TILE_SIZE      64.0f
+
+static float Act_BenchmarkRandom( float min, float max )
+{
+	return min + ( ( float ) rand() / ( float ) RAND_MAX ) * ( max - min );
+}
+
+/**
+ * How faces used to be gathered for a sector; a fresh copy
+ * of the mesh's face list for every actor, every tick.
+ */
+static YNCoreWorldFace **Act_BenchmarkCopyMeshFaces( const YNCoreWorldSector *sector, unsigned int *numFaces )
+{
+	*numFaces               = PlGetNumLinkedListNodes( sector->mesh->faces );
+	YNCoreWorldFace **faces = PL_NEW_( YNCoreWorldFace *, *numFaces );
+
+	PLLinkedListNode *faceNode = PlGetFirstNode( sector->mesh->faces );
+	for ( unsigned int i = 0; i < *numFaces; ++i )
+	{
+		faces[ i ] = ( YNCoreWorldFace * ) PlGetLinkedListNodeUserData( faceNode );
+		faceNode   = PlGetNextLinkedListNode( faceNode );
+	}
+
+	return faces;
+}
+
+static double Act_BenchmarkWorldCollision( Actor *actors, unsigned int numActors, const YNCoreWorldSector *sector, bool copyFaces, unsigned int *numAllocations )
+{
+	*numAllocations = 0;
+
+	double startTime = PlGetCurrentSeconds();
+	for ( unsigned int i = 0; i < ACTOR_BENCHMARK_TICKS; ++i )
+	{
+		for ( unsigned int j = 0; j < numActors; ++j )
+		{
+			Actor    *actor = &actors[ j ];
+			PLVector3 nPos  = actor->oldPosition;
+
+			PlDestroyLinkedListNodes( actor->geoColliders );
+
+			if ( copyFaces )
+			{
+				unsigned int      numFaces;
+				YNCoreWorldFace **faces = Act_BenchmarkCopyMeshFaces( sector, &numFaces );
+				( *numAllocations )++;
+
+				PLCollisionSphere colSphere = Act_GetCollisionSphere( actor, &nPos );
+				for ( unsigned int k = 0; k < numFaces; ++k )
+					Act_CollideWithFace( actor, &colSphere, sector->mesh, faces[ k ]->index );
+
+				PL_DELETE( faces );
+			}
+			else
+			{
+				Act_CollideWithMesh( actor, &nPos, sector->mesh );
+			}
+
+			*numAllocations += PlGetNumLinkedListNodes( actor->geoColliders );
+
+			/* put it back, so both runs see the same thing */
+			actor->position = actor->oldPosition;
+		}
+	}
+
+	return ( PlGetCurrentSeconds() - startTime ) / ACTOR_BENCHMARK_TICKS;
+}
+
+/**
+ * Drops a crowd of actors into a single generated sector, and times
+ * their world collision using a copy of the sector's faces per actor
+ * against using the mesh's own face table.
+ */
+void Act_BenchmarkWorldCollisionCommand( unsigned int argc, char **argv )
+{
+	unsigned int numActors = ACTOR_BENCHMARK_DEFAULT_ACTORS;
+	if ( argc > 1 )
+	{
+		numActors = strtoul( argv[ 1 ], NULL, 10 );
+		if ( numActors == 0 )
+		{
+			PRINT_WARNING( "Invalid number of actors specified!\n" );
+			return;
+		}
+	}
+
+	srand( 0 );
+
+	/* bumpy floor, made up of tiles */
+	static const unsigned int numFaces = ACTOR_BENCHMARK_GRID_SIZE * ACTOR_BENCHMARK_GRID_SIZE;
+	float                     extent   = ACTOR_BENCHMARK_GRID_SIZE * ACTOR_BENCHMARK_TILE_SIZE;
+
+	YNCoreWorldMesh mesh;
+	PL_ZERO_( mesh );
+	mesh.faces      = PlCreateLinkedList();
+	mesh.faceTable  = PL_NEW_( YNCoreWorldFace *, numFaces );
+	mesh.faceBounds = PL_NEW_( PLCollisionAABB, numFaces );
+	mesh.facePlanes = PL_NEW_( PLCollisionPlane, numFaces );
+	mesh.numFaces   = numFaces;
+
+	YNCoreWorldSector sector;
+	PL_ZERO_( sector );
+	sector.mesh = &mesh;
+
+	YNCoreWorldFace *faces = PL_NEW_( YNCoreWorldFace, numFaces );
+	for ( unsigned int i = 0; i < numFaces; ++i )
+	{
+		float x = ( i % ACTOR_BENCHMARK_GRID_SIZE ) * ACTOR_BENCHMARK_TILE_SIZE;
+		float z = ( i / ACTOR_BENCHMARK_GRID_SIZE ) * ACTOR_BENCHMARK_TILE_SIZE;
+		float y = Act_BenchmarkRandom( 0.0f, 8.0f );
+
+		YNCoreWorldFace *face = &faces[ i ];
+		face->parentMesh      = &mesh;
+		face->parentSector    = &sector;
+		face->index           = i;
+
+		PLCollisionAABB *bounds = &mesh.faceBounds[ i ];
+		bounds->mins            = PLVector3( x, y, z );
+		bounds->maxs            = PLVector3( x + ACTOR_BENCHMARK_TILE_SIZE, y + 8.0f, z + ACTOR_BENCHMARK_TILE_SIZE );
+		bounds->absOrigin       = PLVector3( x + ACTOR_BENCHMARK_TILE_SIZE / 2.0f, y + 4.0f, z + ACTOR_BENCHMARK_TILE_SIZE / 2.0f );
+
+		PLVector3 normal     = PlNormalizeVector3( PLVector3( Act_BenchmarkRandom( -0.1f, 0.1f ), 1.0f, Act_BenchmarkRandom( -0.1f, 0.1f ) ) );
+		mesh.facePlanes[ i ] = PlSetupCollisionPlane( bounds->absOrigin, normal );
+
+		PlInsertLinkedListNode( mesh.faces, face );
+		mesh.faceTable[ i ] = face;
+	}
+
+	Actor *actors = PL_NEW_( Actor, numActors );
+	for ( unsigned int i = 0; i < numActors; ++i )
+	{
+		Actor *actor                  = &actors[ i ];
+		actor->geoColliders           = PlCreateLinkedList();
+		actor->sector                 = &sector;
+		actor->collisionVolume.maxs   = PLVector3( 16.0f, 16.0f, 16.0f );
+		actor->collisionVolume.mins   = PLVector3( -16.0f, -16.0f, -16.0f );
+		actor->position               = PLVector3( Act_BenchmarkRandom( 0.0f, extent ), Act_BenchmarkRandom( 0.0f, 48.0f ), Act_BenchmarkRandom( 0.0f, extent ) );
+		actor->oldPosition            = actor->position;
+		actor->collisionVolume.origin = actor->position;
+	}
+
+	unsigned int numCopyAllocations, numCachedAllocations;
+	double       copyTime   = Act_BenchmarkWorldCollision( actors, numActors, &sector, true, &numCopyAllocations );
+	double       cachedTime = Act_BenchmarkWorldCollision( actors, numActors, &sector, false, &numCachedAllocations );
+
+	PRINT( "%u actors against %u faces, over %u ticks:\n", numActors, numFaces, ACTOR_BENCHMARK_TICKS );
+	PRINT( "copied faces: %.3fms per tick, %u allocations per tick\n", copyTime * 1000.0, numCopyAllocations / ACTOR_BENCHMARK_TICKS );
+	PRINT( "cached faces: %.3fms per tick, %u allocations per tick\n", cachedTime * 1000.0, numCachedAllocations / ACTOR_BENCHMARK_TICKS );
+
+	for ( unsigned int i = 0; i < numActors; ++i )
+		PlDestroyLinkedList( actors[ i ].geoColliders );
+
+	PL_DELETE( actors );
+
+	PlDestroyLinkedList( mesh.faces );
+	PL_DELETE( mesh.faceTable );
+	PL_DELETE( mesh.faceBounds );
+	PL_DELETE( mesh.facePlanes );
+	PL_DELETE( faces );
+}
@@ -125,5 +125,7 @@ PLVector3 Act_GetForward( const Actor *self );
 
 Actor *Act_GetByTag( const char *tag, Actor *start );
 
+void Act_BenchmarkWorldCollisionCommand( unsigned int argc, char **argv );
+
 /* generic monster functions */
 void Monster_Collide( struct Actor *self, struct Actor *other, float force );
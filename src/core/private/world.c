@@ -22,7 +22,7 @@ void YnCore_World_SetupGlobalDefaults( YNCoreWorld *world )
 
 YNCoreWorld *YnCore_World_Create( void )
 {
-	YNCoreWorld *world = PlMAllocA( sizeof( YNCoreWorld ) );
+	YNCoreWorld *world = PL_NEW( YNCoreWorld );
 
 	world->globalProperties = YnNode_PushBackObject( NULL, "properties" );
 	YnNode_PushBackF32Array( world->globalProperties, "ambience", ( const float * ) &WORLD_DEFAULT_AMBIENCE, 4 );
@@ -51,6 +51,11 @@ YNCoreWorld *YnCore_World_Load( const char *path )
 		YnCore_World_Destroy( world );
 		world = NULL;
 	}
+	else
+	{
+		YnCore_World_BuildSectorGrid( world );
+		YnCore_World_AssignSectorLights( world );
+	}
 
 	YnNode_DestroyBranch( node );
 
@@ -59,6 +64,13 @@ YNCoreWorld *YnCore_World_Load( const char *path )
 
 bool YnCore_World_Save( YNCoreWorld *world, const char *path )
 {
+	/* only some of the meshes are around at any time */
+	if ( world->isStreamed )
+	{
+		PRINT_WARNING( "Can't save a streamed world (%s), load it up front instead!\n", path );
+		return false;
+	}
+
 	world->lastSaveTime = time( NULL );
 
 	YNNodeBranch *root = YnNode_PushBackObject( NULL, "world" );
@@ -85,6 +97,7 @@ static void ClearSector( YNCoreWorldSector *sector )
 		YnCore_WorldMesh_Release( sector->staticObjects[ i ].mesh );
 
 	PlFree( sector->staticObjects );
+	PL_DELETE( sector->portals );
 
 	YnCore_WorldMesh_Release( sector->mesh );
 }
@@ -104,11 +117,17 @@ void YnCore_World_Destroy( YNCoreWorld *world )
 	if ( world == NULL )
 		return;
 
+	YnCore_World_DestroyStreaming( world );
+
 	for ( unsigned int i = 0; i < world->numSectors; ++i )
 		ClearSector( &world->sectors[ i ] );
 
 	PlFree( world->sectors );
 
+	YnCore_World_DestroySectorGrid( world );
+	YnCore_World_DestroyVisibility( world );
+	YnCore_World_DestroyLights( world );
+
 	unsigned int numMeshes = PlGetNumVectorArrayElements( world->meshes );
 	for ( unsigned int i = 0; i < numMeshes; ++i )
 		YnCore_WorldMesh_Release( ( YNCoreWorldMesh * ) PlGetVectorArrayElementAt( world->meshes, i ) );
@@ -119,20 +138,6 @@ void YnCore_World_Destroy( YNCoreWorld *world )
 	PlFree( world );
 }
 
-PLLinkedList *YnCore_World_GetLights( const YNCoreWorld *world )
-{
-	for ( unsigned int i = 0; i < world->numSectors; ++i )
-	{
-	}
-
-	return NULL;
-}
-
-PLLinkedList *YnCore_World_GetSectorLights( const YNCoreWorldSector *sector )
-{
-	return sector->lights;
-}
-
 void YnCore_World_SpawnEntities( YNCoreWorld *world )
 {
 	PLLinkedListNode *node = PlGetFirstNode( world->entities );
@@ -173,7 +178,7 @@ uint64_t YnCore_World_GetLastSaveTime( const YNCoreWorld *world )
  */
 PLVector3 YnCore_WorldFace_GetNormal( const YNCoreWorldFace *face )
 {
-	return face->normal;
+	return face->parentMesh->facePlanes[ face->index ].normal;
 }
 
 /**
@@ -181,7 +186,7 @@ PLVector3 YnCore_WorldFace_GetNormal( const YNCoreWorldFace *face )
  */
 PLVector3 YnCore_WorldFace_GetOrigin( const YNCoreWorldFace *face )
 {
-	return face->bounds.absOrigin;
+	return face->parentMesh->faceBounds[ face->index ].absOrigin;
 }
 
 /**
@@ -189,37 +194,35 @@ PLVector3 YnCore_WorldFace_GetOrigin( const YNCoreWorldFace *face )
  */
 uint8_t YnCore_WorldFace_GetFlags( const YNCoreWorldFace *face )
 {
-	return face->flags;
+	return face->parentMesh->faceFlags[ face->index ];
+}
+
+/**
+ * Fetch the bounds of the face in world-coordinates.
+ */
+const PLCollisionAABB *YnCore_WorldFace_GetBounds( const YNCoreWorldFace *face )
+{
+	return &face->parentMesh->faceBounds[ face->index ];
 }
 
 /****************************************
  * SECTOR
  ****************************************/
 
-YNCoreLight *YnCore_WorldSector_GetVisibleLights( YNCoreWorldSector *sector, unsigned int *numLights )
-{
-	// TODO: for now we're just going to return this static list...
-	static YNCoreLight lights[] = {
-	        {
-             .position = { 10.0f, 10.0f, 10.0f },
-             .colour   = { 1.0f, 0.0f, 0.0f, 16.0f },
-             .radius   = 16.0f,
-	         },
-	};
-
-	*numLights = PL_ARRAY_ELEMENTS( lights );
-	return lights;
-}
-
 /**
  * This crudely tries to determine the sector by an origin point.
  * Should only be used for vague lookup.
  */
 YNCoreWorldSector *YnCore_World_GetSectorByGlobalOrigin( YNCoreWorld *world, const PLVector3 *globalOrigin )
 {
-	for ( unsigned int i = 0; i < world->numSectors; ++i )
+	if ( world->sectorGridDirty )
+		YnCore_World_BuildSectorGrid( world );
+
+	unsigned int    numSectors;
+	const uint32_t *sectorIndices = YnCore_World_GetSectorGridCell( world, globalOrigin, &numSectors );
+	for ( unsigned int i = 0; i < numSectors; ++i )
 	{
-		YNCoreWorldSector *sector = &world->sectors[ i ];
+		YNCoreWorldSector *sector = &world->sectors[ sectorIndices[ i ] ];
 		if ( !PlIsPointIntersectingAabb( &sector->bounds, *globalOrigin ) )
 			continue;
 
@@ -243,7 +246,12 @@ YNCoreWorldMesh *YnCore_WorldSector_GetMesh( YNCoreWorldSector *sector )
 	return sector->mesh;
 }
 
-YNCoreWorldFace **YnCore_WorldSector_GetMeshFaces( YNCoreWorldSector *sector, uint32_t *numFaces )
+/**
+ * Returns the faces making up the sector's mesh. This is the mesh's own
+ * packed face table, so it's only rebuilt when the mesh changes and
+ * must not be freed or held onto past the mesh.
+ */
+YNCoreWorldFace *const *YnCore_WorldSector_GetMeshFaces( const YNCoreWorldSector *sector, uint32_t *numFaces )
 {
 	if ( sector->mesh == NULL )
 	{
@@ -251,89 +259,47 @@ YNCoreWorldFace **YnCore_WorldSector_GetMeshFaces( YNCoreWorldSector *sector, ui
 		return NULL;
 	}
 
-	*numFaces         = PlGetNumLinkedListNodes( sector->mesh->faces );
-	YNCoreWorldFace **faces = PL_NEW_( YNCoreWorldFace *, *numFaces );
-
-	PLLinkedListNode *faceNode = PlGetFirstNode( sector->mesh->faces );
-	for ( unsigned int i = 0; i < *numFaces; ++i )
-	{
-		faces[ i ] = ( YNCoreWorldFace * ) PlGetLinkedListNodeUserData( faceNode );
-		faceNode   = PlGetNextLinkedListNode( faceNode );
-	}
-
-	return faces;
+	*numFaces = sector->mesh->numFaces;
+	return sector->mesh->faceTable;
 }
 
-static YNCoreWorldSector **GetVisibleSectors( YNCoreWorld *world, YNCoreWorldSector *originSector, const YNCoreCamera *camera, unsigned int *numSectors )
+/**
+ * This is a little bit silly, but we're considering mirrors as a valid portal too...
+ */
+bool YnCore_World_IsFacePortal( const YNCoreWorldFace *face )
 {
-	PL_GET_CVAR( "world.drawSectors", drawSectors );
-	if ( drawSectors != NULL && !drawSectors->b_value )
-		return NULL;
-
-	YNCoreWorldSector **visibleSectors = PlCAllocA( world->numSectors, sizeof( YNCoreWorldSector * ) );
-
-	/* we'll assume the sector we're in is visible (seems like a safe assumption) */
-	*numSectors                     = 0;
-	visibleSectors[ *numSectors++ ] = originSector;
-
-	/* todo
-	 *  2. test whether or not player can see portal
-	 *  3. get portal destination, do 2. again but from portal
-	 */
-
-#if 0
-	WorldMesh *sectorMesh = originSector->mesh;
-	if ( sectorMesh != NULL )
-	{
-		for ( unsigned int i = 0; i < sectorMesh->numFaces; ++i )
-		{
-			if ( !( sectorMesh->faces[ i ].flags & WORLD_FACE_FLAG_PORTAL ) && !( sectorMesh->faces[ i ].flags & WORLD_FACE_FLAG_MIRROR ) )
-			{
-				continue;
-			}
-
-			if ( !PlgIsBoxInsideView( camera->internal, &sectorMesh->faces[ i ].bounds ) )
-			{
-				continue;
-			}
-		}
-	}
-#endif
-
-	return visibleSectors;
+	uint8_t flags = YnCore_WorldFace_GetFlags( face );
+	return ( ( flags & WORLD_FACE_FLAG_MIRROR ) || ( flags & WORLD_FACE_FLAG_PORTAL ) );
 }
 
-static YNCoreWorldMesh **GetVisibleSubMeshesForSector( YNCoreWorldSector *sector, const PLGCamera *camera, unsigned int *numMeshes )
+/**
+ * Points the sector's portal faces at the sectors they lead to, and the
+ * faces on the other side where those sectors have their mesh.
+ */
+void YnCore_World_LinkSectorPortals( YNCoreWorld *world, YNCoreWorldSector *sector )
 {
-	PL_GET_CVAR( "world.drawSubMeshes", drawSubMeshes );
-	if ( drawSubMeshes != NULL && !drawSubMeshes->b_value )
-		return NULL;
-
-	YNCoreWorldMesh **visibleMeshes = PlCAlloc( sector->numStaticObjects, sizeof( YNCoreWorldMesh * ), true );
+	YNCoreWorldMesh *mesh = sector->mesh;
+	if ( mesh == NULL )
+		return;
 
-	// Go through and generate a list of visible meshes within the sector
-	for ( unsigned int i = 0; i < sector->numStaticObjects; ++i )
+	for ( unsigned int i = 0; i < sector->numPortals; ++i )
 	{
-		PLCollisionAABB *bounds = &sector->staticObjects[ i ].mesh->bounds;
-		bounds->origin          = sector->staticObjects[ i ].transform.translation;
-		if ( !PlgIsBoxInsideView( camera, bounds ) )
+		const int32_t *portal = &sector->portals[ i * 3 ];
+		if ( portal[ 0 ] < 0 || ( uint32_t ) portal[ 0 ] >= mesh->numFaces )
+		{
+			PRINT_WARNING( "Invalid portal encountered for sector: %s!\n", sector->id );
 			continue;
+		}
 
-		visibleMeshes[ *numMeshes ] = sector->mesh;
-		numMeshes++;
-	}
-
-	// Shrink the array down before passing it back
-	visibleMeshes = PlReAlloc( visibleMeshes, sizeof( YNCoreWorldMesh * ) * *numMeshes, true );
-	return visibleMeshes;
-}
+		YNCoreWorldFace *face = mesh->faceTable[ portal[ 0 ] ];
+		face->targetSector    = &world->sectors[ portal[ 1 ] ];
 
-/**
- * This is a little bit silly, but we're considering mirrors as a valid portal too...
- */
-bool YnCore_World_IsFacePortal( const YNCoreWorldFace *face )
-{
-	return ( ( face->flags & WORLD_FACE_FLAG_MIRROR ) || ( face->flags & WORLD_FACE_FLAG_PORTAL ) );
+		const YNCoreWorldMesh *targetMesh = face->targetSector->mesh;
+		if ( targetMesh != NULL && portal[ 2 ] >= 0 && ( uint32_t ) portal[ 2 ] < targetMesh->numFaces )
+			face->targetSectorFace = targetMesh->faceTable[ portal[ 2 ] ];
+		else
+			face->targetSectorFace = NULL;
+	}
 }
 
 YNCoreWorldSector *YnCore_World_GetSectorByNum( YNCoreWorld *world, int sectorNum )
@@ -6,6 +6,10 @@
 #include <plcore/pl_physics.h>
 #include <plcore/pl_array_vector.h>
 
+#include "common_bvh.h"
+#include "common_light_cull.h"
+#include "common_pvs.h"
+
 #include "client/renderer/renderer_scenegraph.h"
 #include "entity/entity.h"
 
@@ -46,11 +50,14 @@ typedef struct YNCoreWorldSector YNCoreWorldSector;
 typedef struct YNCoreWorldFace YNCoreWorldFace;
 typedef struct YNCoreWorldMesh YNCoreWorldMesh;
 
+/**
+ * Everything about a face that culling and collision don't need to
+ * look at. The plane, bounds and flags are kept in the parent mesh's
+ * packed arrays instead, at the face's index; use the accessors
+ * (YnCore_WorldFace_GetNormal etc.) to get at them from a face.
+ */
 typedef struct YNCoreWorldFace
 {
-	PLVector3 normal;
-	PLVector3 origin;
-
 	struct YNCoreMaterial *material;
 	// todo: reduce the below to transform matrix???
 	float materialAngle;
@@ -60,17 +67,18 @@ typedef struct YNCoreWorldFace
 	unsigned int vertices[ WORLD_FACE_MAX_SIDES ];
 	uint8_t numVertices;
 
-	uint8_t flags; /* portal, mirror, skip etc. */
+	/* the batch the face's triangles were baked into; batches are
+	 * only ever drawn whole, once any of their faces are visible */
+	unsigned int batchIndex;
 
 	YNCoreWorldMesh *parentMesh;
 	YNCoreWorldSector *parentSector;
+	unsigned int index; /* into parentMesh's face arrays */
 
 	// if it's a portal
 	bool isPortalClosed;              // if true, we can't see through the portal
 	YNCoreWorldSector *targetSector;  // the sector this portal connects to
 	YNCoreWorldFace *targetSectorFace;// the 'door' on the other side
-
-	PLCollisionAABB bounds;
 } YNCoreWorldFace;
 
 typedef struct YNCoreWorldVertex
@@ -81,6 +89,25 @@ typedef struct YNCoreWorldVertex
 	PLColourF32 colour;
 } YNCoreWorldVertex;
 
+/**
+ * Faces sharing a material are triangulated once on load, and their
+ * triangles are kept in a static mesh. The mesh is never touched again
+ * after that, it's drawn whole whenever any of its faces are visible.
+ */
+typedef struct YNCoreWorldMeshBatch
+{
+	struct YNCoreMaterial *material;
+	bool isPortal;
+
+	unsigned int numFaces;
+	unsigned int numVisibleFaces;
+	unsigned int numIndices;
+
+	PLVector3 origin; /* centre of the batch's faces, for sorting */
+
+	PLGMesh *drawMesh;
+} YNCoreWorldMeshBatch;
+
 typedef struct YNCoreWorldMesh
 {
 	char id[ WORLD_PROP_TAG_LENGTH ];
@@ -96,7 +123,20 @@ typedef struct YNCoreWorldMesh
 
 	PLCollisionAABB bounds;
 
-	PLGMesh *drawMesh; /* what actually gets rendered */
+	/* the per-face data culling and collision walk, in the same order
+	 * as faces, so they can get through it without chasing nodes */
+	YNCoreWorldFace **faceTable;
+	PLCollisionAABB *faceBounds;
+	PLCollisionPlane *facePlanes;
+	uint8_t *faceFlags; /* portal, mirror, skip etc. */
+	unsigned int numFaces;
+
+	/* hierarchy over faceBounds, for spatial queries */
+	CommonBVH faceTree;
+
+	/* what actually gets rendered */
+	YNCoreWorldMeshBatch *batches;
+	unsigned int numBatches;
 
 	PLLinkedListNode *node;
 
@@ -106,6 +146,7 @@ typedef struct YNCoreWorldMesh
 typedef struct YNCoreWorldObject
 {
 	YNCoreWorldMesh *mesh; /* pointer to mesh in worldMeshes list */
+	int meshIndex;
 
 	SGTransform transform;
 
@@ -122,18 +163,62 @@ typedef struct YNCoreWorldSector
 	char id[ WORLD_PROP_TAG_LENGTH ];
 
 	YNCoreWorldMesh *mesh;
+	int meshIndex; /* into the world's mesh list, or -1 */
+
+	/* face, target sector and target face triples, kept around
+	 * so they can be linked up again as meshes come and go */
+	int32_t *portals;
+	unsigned int numPortals;
 
 	YNCoreWorldObject *staticObjects;
 	unsigned int numStaticObjects;
 
 	PLLinkedList *actors;// Actors currently in this sector
-	PLLinkedList *lights;// Lights in this sector
 
 	PLCollisionAABB bounds;
 } YNCoreWorldSector;
 
 #define YN_CORE_MAX_SKY_LAYERS 4
 
+/* see world_streaming.c */
+typedef enum YNCoreWorldStreamState
+{
+	WORLD_STREAM_UNLOADED,
+	WORLD_STREAM_PENDING,/* waiting on the loader thread */
+	WORLD_STREAM_LOADED,
+	WORLD_STREAM_FAILED,
+} YNCoreWorldStreamState;
+
+typedef struct YNCoreWorldStreamMesh
+{
+	PLPath path;
+	YNCoreWorldMesh *mesh;
+	YNCoreWorldStreamState state;
+	struct YNCoreWorldLoadJob *job;
+	size_t memorySize;
+	unsigned int lastNeededTick;
+	float distance;/* from the stream origin, as of lastNeededTick */
+} YNCoreWorldStreamMesh;
+
+typedef struct YNCoreWorldStreamStats
+{
+	unsigned int numLoads;
+	unsigned int numEvictions;
+	size_t residentBytes;
+	size_t peakResidentBytes;
+} YNCoreWorldStreamStats;
+
+/* see world_sector_grid.c */
+typedef struct YNCoreWorldSectorGrid
+{
+	float mins[ 3 ];
+	float maxs[ 3 ];
+	float invCellSize[ 3 ];
+	unsigned int dimensions[ 3 ];
+	uint32_t *cellOffsets;  /* where each cell starts in sectorIndices, plus one past the end */
+	uint32_t *sectorIndices;/* ascending within each cell */
+} YNCoreWorldSectorGrid;
+
 typedef struct YNCoreWorld
 {
 	PLPath path;
@@ -145,6 +230,22 @@ typedef struct YNCoreWorld
 	YNCoreWorldSector *sectors;
 	unsigned int numSectors;
 
+	YNCoreWorldSectorGrid sectorGrid;
+	bool sectorGridDirty;
+
+	/* potentially visible sectors from each sector, see world_visibility.c */
+	CommonPVS sectorVisibility;
+	uint32_t *visibleSectorBits; /* scratch for gathering visible sectors each frame */
+	YNCoreWorldSector **visibleSectors;
+
+	/* lights touching each sector, see world_lights.c */
+	struct YNCoreLight *lights;
+	CommonLightCullLight *lightVolumes;
+	unsigned int numLights;
+	unsigned int maxLights;
+	CommonLightCullTable sectorLights;
+	bool sectorLightsDirty;
+
 	PLColourF32 ambience;
 	PLColourF32 sunColour;
 	PLVector3 sunPosition;
@@ -161,6 +262,15 @@ typedef struct YNCoreWorld
 	/* additional generic properties */
 	struct YNNodeBranch *globalProperties;
 
+	/* when streamed, meshes are loaded in and out around
+	 * streamOrigin rather than all up front */
+	bool isStreamed;
+	YNCoreWorldStreamMesh *streamMeshes;
+	unsigned int numStreamMeshes;
+	PLVector3 streamOrigin;
+	unsigned int streamTick;
+	YNCoreWorldStreamStats streamStats;
+
 	uint64_t lastSaveTime;
 	bool isDirty;
 } YNCoreWorld;
@@ -178,13 +288,46 @@ YNCoreWorld *YnCore_WorldDeserialiser_Begin( YNNodeBranch *root, YNCoreWorld *ou
 
 YNCoreWorldMesh *YnCore_WorldDeserialiser_BeginMesh( YNNodeBranch *root, YNCoreWorldMesh *worldMesh );
 
-PLLinkedList *YnCore_World_GetLights( const YNCoreWorld *world );
-PLLinkedList *YnCore_World_GetSectorLights( const YNCoreWorldSector *sector );
+void YnCore_World_AddLight( YNCoreWorld *world, const struct YNCoreLight *light );
+const struct YNCoreLight *YnCore_World_GetLights( const YNCoreWorld *world, unsigned int *numLights );
+const uint32_t *YnCore_World_GetSectorLights( YNCoreWorld *world, const YNCoreWorldSector *sector, unsigned int *numLights );
+void YnCore_World_AssignSectorLights( YNCoreWorld *world );
+void YnCore_World_DestroyLights( YNCoreWorld *world );
+void YnCore_World_DeserialiseLights( YNCoreWorld *world, YNNodeBranch *root );
+void YnCore_World_SerialiseLights( const YNCoreWorld *world, YNNodeBranch *root );
 
 void YnCore_World_SpawnEntities( YNCoreWorld *world );
 
-bool YnCore_World_IsFaceVisible( YNCoreWorldFace *face, const YNCoreCamera *camera );
+bool YnCore_World_IsFaceVisible( const YNCoreWorldFace *face, const YNCoreCamera *camera );
+void YnCore_WorldMesh_SetFaceFlags( YNCoreWorldMesh *mesh, unsigned int faceIndex, uint8_t flags );
+unsigned int YnCore_WorldMesh_QueryFaces( const YNCoreWorldMesh *mesh, CommonBVHTestFunction test, void *user, uint32_t *faceIndices, unsigned int maxFaces );
+unsigned int YnCore_WorldMesh_QueryFacesInView( const YNCoreWorldMesh *mesh, const YNCoreCamera *camera, uint32_t *faceIndices, unsigned int maxFaces );
+void YnCore_WorldMesh_BenchmarkQueriesCommand( unsigned int argc, char **argv );
+void YnCore_WorldMesh_BenchmarkFaceLayoutCommand( unsigned int argc, char **argv );
 unsigned int *YnCore_World_ConvertFaceToTriangles( const YNCoreWorldFace *face, unsigned int *numTriangles );
 bool YnCore_World_IsFacePortal( const YNCoreWorldFace *face );
 
 YNCoreWorldSector *YnCore_World_GetSectorByNum( YNCoreWorld *world, int sectorNum );
+
+void YnCore_WorldSector_GetExtents( const YNCoreWorldSector *sector, float mins[ 3 ], float maxs[ 3 ] );
+void YnCore_World_BuildSectorGrid( YNCoreWorld *world );
+void YnCore_World_DestroySectorGrid( YNCoreWorld *world );
+const uint32_t *YnCore_World_GetSectorGridCell( const YNCoreWorld *world, const PLVector3 *point, unsigned int *numSectors );
+void YnCore_World_BenchmarkSectorLookupCommand( unsigned int argc, char **argv );
+
+bool YnCore_World_ComputeVisibility( YNCoreWorld *world );
+void YnCore_World_DestroyVisibility( YNCoreWorld *world );
+YNCoreWorldSector **YnCore_World_GetVisibleSectors( YNCoreWorld *world, YNCoreWorldSector *originSector, const YNCoreCamera *camera, unsigned int *numSectors );
+void YnCore_World_InitializeStreaming( void );
+void YnCore_World_ShutdownStreaming( void );
+void YnCore_World_LinkSectorPortals( YNCoreWorld *world, YNCoreWorldSector *sector );
+void YnCore_World_UpdateStreaming( YNCoreWorld *world, const PLVector3 *origin );
+void YnCore_World_DestroyStreaming( YNCoreWorld *world );
+void YnCore_World_TestStreamingCommand( unsigned int argc, char **argv );
+
+YNCoreWorldMesh *YnCore_WorldMesh_GetCached( const char *path );
+YNCoreWorldMesh *YnCore_WorldMesh_LoadFromNode( const char *path, YNNodeBranch *node );
+size_t YnCore_WorldMesh_GetMemoryUsage( const YNCoreWorldMesh *mesh );
+
+void YnCore_World_ComputeVisibilityCommand( unsigned int argc, char **argv );
+void YnCore_World_VerifyVisibilityCommand( unsigned int argc, char **argv );
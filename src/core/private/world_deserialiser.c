@@ -20,19 +20,36 @@ static void DeserializeIdentifierTag( YNNodeBranch *node, char *dest )
 	strncpy( dest, id, WORLD_PROP_TAG_LENGTH - 1 );
 }
 
+/**
+ * Streamed worlds attach their meshes later on, as they're loaded in.
+ */
+static YNCoreWorldMesh *GetMeshByIndex( YNCoreWorld *world, int meshIndex )
+{
+	if ( world->isStreamed || meshIndex < 0 || meshIndex >= PlGetNumVectorArrayElements( world->meshes ) )
+		return NULL;
+
+	return ( YNCoreWorldMesh * ) PlGetVectorArrayElementAt( world->meshes, meshIndex );
+}
+
+static bool IsMeshIndexValid( const YNCoreWorld *world, int meshIndex )
+{
+	unsigned int numMeshes = world->isStreamed ? world->numStreamMeshes : PlGetNumVectorArrayElements( world->meshes );
+	return ( meshIndex >= 0 && meshIndex < numMeshes );
+}
+
 static void DeserialiseSector( YNCoreWorld *world, YNNodeBranch *sectorNode, YNCoreWorldSector *sectorPtr )
 {
 	DeserializeIdentifierTag( sectorNode, sectorPtr->id );
 
-	unsigned int numMeshes = PlGetNumVectorArrayElements( world->meshes );
-	int          meshIndex = YnNode_GetI32ByName( sectorNode, "mesh", -1 );
-	if ( meshIndex >= 0 && meshIndex < numMeshes )
+	sectorPtr->meshIndex = YnNode_GetI32ByName( sectorNode, "mesh", -1 );
+	if ( IsMeshIndexValid( world, sectorPtr->meshIndex ) )
 	{
-		sectorPtr->mesh = ( YNCoreWorldMesh * ) PlGetVectorArrayElementAt( world->meshes, meshIndex );
+		sectorPtr->mesh = GetMeshByIndex( world, sectorPtr->meshIndex );
 	}
 	else
 	{
 		PRINT_WARNING( "Sector without valid body!\n" );
+		sectorPtr->meshIndex = -1;
 	}
 
 	YnNode_DS_DeserializeVector3( YnNode_GetChildByName( sectorNode, "boundsMin" ), &sectorPtr->bounds.mins );
@@ -53,14 +70,16 @@ static void DeserialiseSector( YNCoreWorld *world, YNNodeBranch *sectorNode, YNC
 				break;
 			}
 
-			meshIndex = YnNode_GetI32ByName( sectorNode, "mesh", -1 );
-			if ( meshIndex >= 0 && meshIndex < numMeshes )
+			int meshIndex = YnNode_GetI32ByName( c, "mesh", -1 );
+			if ( IsMeshIndexValid( world, meshIndex ) )
 			{
-				sectorPtr->staticObjects[ i ].mesh = ( YNCoreWorldMesh * ) PlGetVectorArrayElementAt( world->meshes, meshIndex );
+				sectorPtr->staticObjects[ i ].mesh      = GetMeshByIndex( world, meshIndex );
+				sectorPtr->staticObjects[ i ].meshIndex = meshIndex;
 			}
 			else
 			{
 				PRINT_WARNING( "Invalid mesh index encountered for static object!\n" );
+				sectorPtr->staticObjects[ i ].meshIndex = -1;
 			}
 
 			YnNode_DS_DeserializeVector3( YnNode_GetChildByName( c, "translation" ), &sectorPtr->staticObjects[ i ].transform.translation );
@@ -72,6 +91,75 @@ static void DeserialiseSector( YNCoreWorld *world, YNNodeBranch *sectorNode, YNC
 	}
 }
 
+/**
+ * Fetches the portals for each sector. They're linked up afterwards, see
+ * YnCore_World_LinkSectorPortals, since the sectors point to each other.
+ */
+static void DeserialiseSectorPortals( YNCoreWorld *world, YNNodeBranch *sectorNode, YNCoreWorldSector *sectorPtr )
+{
+	YNNodeBranch *portalList = YnNode_GetChildByName( sectorNode, "portals" );
+	if ( portalList == NULL || sectorPtr->meshIndex < 0 )
+		return;
+
+	unsigned int numValues = YnNode_GetNumOfChildren( portalList );
+	if ( numValues == 0 || ( numValues % 3 ) != 0 )
+	{
+		PRINT_WARNING( "Invalid portal list for sector: %s!\n", sectorPtr->id );
+		return;
+	}
+
+	int32_t *portals = PL_NEW_( int32_t, numValues );
+	if ( YnNode_GetI32Array( portalList, portals, numValues ) != YN_NODE_ERROR_SUCCESS )
+	{
+		PRINT_WARNING( "Failed to fetch portals for sector: %s!\n", sectorPtr->id );
+		PL_DELETE( portals );
+		return;
+	}
+
+	/* drop any that lead nowhere, so they don't need checking again */
+	unsigned int numPortals = 0;
+	for ( unsigned int i = 0; i < numValues; i += 3 )
+	{
+		if ( portals[ i ] < 0 || portals[ i + 1 ] < 0 || portals[ i + 1 ] >= world->numSectors )
+		{
+			PRINT_WARNING( "Invalid portal encountered for sector: %s!\n", sectorPtr->id );
+			continue;
+		}
+
+		memmove( &portals[ numPortals * 3 ], &portals[ i ], sizeof( int32_t ) * 3 );
+		numPortals++;
+	}
+
+	sectorPtr->portals    = portals;
+	sectorPtr->numPortals = numPortals;
+}
+
+/**
+ * Visibility is only used if every sector has it, otherwise
+ * it's assumed to be out of date.
+ */
+static void DeserialiseVisibility( YNCoreWorld *world, YNNodeBranch *sectorList )
+{
+	unsigned int numWords = CMN_PVS_NUM_WORDS( world->numSectors );
+	uint32_t    *bits     = PL_NEW_( uint32_t, numWords * world->numSectors );
+
+	YNNodeBranch *c = YnNode_GetFirstChild( sectorList );
+	for ( unsigned int i = 0; i < world->numSectors; ++i, c = YnNode_GetNextChild( c ) )
+	{
+		YNNodeBranch *visibleList = YnNode_GetChildByName( c, "visibleSectors" );
+		if ( visibleList == NULL || YnNode_GetNumOfChildren( visibleList ) != numWords ||
+		     YnNode_GetI32Array( visibleList, ( int32_t * ) &bits[ i * numWords ], numWords ) != YN_NODE_ERROR_SUCCESS )
+		{
+			PRINT( "No visibility for sector %u, skipping.\n", i );
+			PL_DELETE( bits );
+			return;
+		}
+	}
+
+	Common_PVS_Load( &world->sectorVisibility, bits, world->numSectors );
+	PL_DELETE( bits );
+}
+
 static void DeserialiseEntities( YNCoreWorld *world, YNNodeBranch *root )
 {
 	if ( root == NULL )
@@ -165,14 +253,19 @@ YNCoreWorld *YnCore_WorldDeserialiser_Begin( YNNodeBranch *root, YNCoreWorld *ou
 	}
 
 	DeserialiseEntities( out, YnNode_GetChildByName( root, "entities" ) );
+	YnCore_World_DeserialiseLights( out, YnNode_GetChildByName( root, "lights" ) );
 
 	YNNodeBranch *meshList = YnNode_GetChildByName( root, "meshes" );
 	if ( meshList != NULL )
 	{
 		unsigned int numEntries = YnNode_GetNumOfChildren( meshList );
-		out->meshes             = PlCreateVectorArray( numEntries );
+		if ( out->isStreamed )
+			out->streamMeshes = PL_NEW_( YNCoreWorldStreamMesh, numEntries );
+		else
+			out->meshes = PlCreateVectorArray( numEntries );
+
 		YNNodeBranch *c               = YnNode_GetFirstChild( meshList );
-		for ( unsigned int i = 0; i < numEntries; ++i )
+		for ( unsigned int i = 0; i < numEntries; ++i, c = YnNode_GetNextChild( c ) )
 		{
 			if ( c == NULL )
 			{
@@ -183,6 +276,13 @@ YNCoreWorld *YnCore_WorldDeserialiser_Begin( YNNodeBranch *root, YNCoreWorld *ou
 			PLPath path;
 			YnNode_GetStr( c, path, sizeof( path ) );
 
+			/* streamed meshes are only loaded once they're needed */
+			if ( out->isStreamed )
+			{
+				snprintf( out->streamMeshes[ out->numStreamMeshes++ ].path, sizeof( PLPath ), "%s", path );
+				continue;
+			}
+
 			YNCoreWorldMesh *mesh = YnCore_WorldMesh_Load( path );
 			if ( mesh == NULL )
 				continue;
@@ -191,7 +291,8 @@ YNCoreWorld *YnCore_WorldDeserialiser_Begin( YNNodeBranch *root, YNCoreWorld *ou
 		}
 
 		// Check if we need to downsize the meshes list...
-		PlShrinkVectorArray( out->meshes );
+		if ( !out->isStreamed )
+			PlShrinkVectorArray( out->meshes );
 	}
 
 	YNNodeBranch *sectorList = YnNode_GetChildByName( root, "sectors" );
@@ -210,7 +311,17 @@ YNCoreWorld *YnCore_WorldDeserialiser_Begin( YNNodeBranch *root, YNCoreWorld *ou
 			}
 
 			DeserialiseSector( out, c, &out->sectors[ i ] );
+			c = YnNode_GetNextChild( c );
 		}
+
+		c = YnNode_GetFirstChild( sectorList );
+		for ( unsigned int i = 0; i < out->numSectors; ++i, c = YnNode_GetNextChild( c ) )
+			DeserialiseSectorPortals( out, c, &out->sectors[ i ] );
+
+		for ( unsigned int i = 0; i < out->numSectors; ++i )
+			YnCore_World_LinkSectorPortals( out, &out->sectors[ i ] );
+
+		DeserialiseVisibility( out, sectorList );
 	}
 	else
 		PRINT_WARNING( "No sectors specified for world!\n" );
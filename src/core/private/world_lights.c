@@ -0,0 +1,169 @@
+// SPDX-License-Identifier: LGPL-3.0-or-later
+// Copyright © 2020-2023 OldTimes Software, Mark E Sowden <hogsy@oldtimes-software.com>
+
+#include <yin/node.h>
+
+#include "core_private.h"
+#include "world.h"
+
+#include "client/renderer/renderer.h"
+
+/* Each light is assigned to every sector its radius touches when the world
+ * is loaded (or whenever the lights or sector bounds change). When drawing a
+ * sector, its lights are then culled against the view and capped to the
+ * most important few, so we never push more than a pass can take. */
+
+static void GetLightVolume( const YNCoreLight *light, CommonLightCullLight *out )
+{
+	float brightest = light->colour.r;
+	brightest       = ( light->colour.g > brightest ) ? light->colour.g : brightest;
+	brightest       = ( light->colour.b > brightest ) ? light->colour.b : brightest;
+
+	out->origin    = light->position;
+	out->radius    = light->radius;
+	out->intensity = brightest * light->colour.a;
+}
+
+void YnCore_World_AddLight( YNCoreWorld *world, const YNCoreLight *light )
+{
+	if ( world->numLights == world->maxLights )
+	{
+		world->maxLights    = ( world->maxLights > 0 ) ? world->maxLights * 2 : 16;
+		world->lights       = PlReAlloc( world->lights, sizeof( YNCoreLight ) * world->maxLights, true );
+		world->lightVolumes = PlReAlloc( world->lightVolumes, sizeof( CommonLightCullLight ) * world->maxLights, true );
+	}
+
+	world->lights[ world->numLights ] = *light;
+	GetLightVolume( light, &world->lightVolumes[ world->numLights ] );
+	world->numLights++;
+
+	world->sectorLightsDirty = true;
+}
+
+const YNCoreLight *YnCore_World_GetLights( const YNCoreWorld *world, unsigned int *numLights )
+{
+	*numLights = world->numLights;
+	return world->lights;
+}
+
+void YnCore_World_DestroyLights( YNCoreWorld *world )
+{
+	Common_LightCull_Destroy( &world->sectorLights );
+
+	PL_DELETE( world->lights );
+	PL_DELETE( world->lightVolumes );
+	world->numLights = world->maxLights = 0;
+}
+
+/**
+ * (Re)builds the list of lights touching each sector.
+ */
+void YnCore_World_AssignSectorLights( YNCoreWorld *world )
+{
+	world->sectorLightsDirty = false;
+
+	CommonBVHBounds *bounds = PL_NEW_( CommonBVHBounds, world->numSectors + 1 );
+	for ( unsigned int i = 0; i < world->numSectors; ++i )
+	{
+		float mins[ 3 ], maxs[ 3 ];
+		YnCore_WorldSector_GetExtents( &world->sectors[ i ], mins, maxs );
+
+		bounds[ i ].mins = PLVector3( mins[ 0 ], mins[ 1 ], mins[ 2 ] );
+		bounds[ i ].maxs = PLVector3( maxs[ 0 ], maxs[ 1 ], maxs[ 2 ] );
+	}
+
+	Common_LightCull_Destroy( &world->sectorLights );
+	if ( !Common_LightCull_Assign( &world->sectorLights, world->lightVolumes, world->numLights, bounds, world->numSectors ) )
+		PRINT_WARNING( "Failed to assign lights to sectors!\n" );
+
+	PL_DELETE( bounds );
+}
+
+const uint32_t *YnCore_World_GetSectorLights( YNCoreWorld *world, const YNCoreWorldSector *sector, unsigned int *numLights )
+{
+	if ( world->sectorLightsDirty )
+		YnCore_World_AssignSectorLights( world );
+
+	return Common_LightCull_GetLights( &world->sectorLights, ( unsigned int ) ( sector - world->sectors ), numLights );
+}
+
+static bool IsLightInView( const CommonLightCullLight *light, void *user )
+{
+	const YNCoreCamera *camera = user;
+	return PlgIsSphereInsideView( camera->internal, &( PLCollisionSphere ){
+	                                                        .origin = light->origin,
+	                                                        .radius = light->radius } );
+}
+
+/**
+ * Returns the most important lights touching the sector that can
+ * be seen from the camera. The list is only valid until the next call.
+ */
+YNCoreLight *YnCore_WorldSector_GetVisibleLights( YNCoreWorld *world, YNCoreWorldSector *sector, YNCoreCamera *camera, unsigned int *numLights )
+{
+	static YNCoreLightArray visibleLights;
+
+	*numLights = 0;
+	if ( world == NULL )
+		return visibleLights;
+
+	unsigned int    numCandidates;
+	const uint32_t *candidates = YnCore_World_GetSectorLights( world, sector, &numCandidates );
+
+	uint32_t selected[ YN_CORE_MAX_LIGHTS_PER_PASS ];
+	*numLights = Common_LightCull_Select( world->lightVolumes, candidates, numCandidates, &camera->internal->position,
+	                                      IsLightInView, camera, selected, YN_CORE_MAX_LIGHTS_PER_PASS );
+	for ( unsigned int i = 0; i < *numLights; ++i )
+		visibleLights[ i ] = world->lights[ selected[ i ] ];
+
+	return visibleLights;
+}
+
+/****************************************
+ * SERIALISATION
+ ****************************************/
+
+void YnCore_World_DeserialiseLights( YNCoreWorld *world, YNNodeBranch *root )
+{
+	if ( root == NULL )
+		return;
+
+	for ( YNNodeBranch *c = YnNode_GetFirstChild( root ); c != NULL; c = YnNode_GetNextChild( c ) )
+	{
+		YNCoreLight light;
+		PL_ZERO_( light );
+		light.type   = ( YNCoreLightType ) YnNode_GetI32ByName( c, "type", YN_CORE_LIGHT_TYPE_OMNI );
+		light.colour = ( PLColourF32 ){ 1.0f, 1.0f, 1.0f, 1.0f };
+		light.radius = YnNode_GetF32ByName( c, "radius", 256.0f );
+		YnNode_DS_DeserializeVector3( YnNode_GetChildByName( c, "position" ), &light.position );
+		YnNode_DS_DeserializeVector3( YnNode_GetChildByName( c, "angles" ), &light.angles );
+		YnNode_DS_DeserializeColourF32( YnNode_GetChildByName( c, "colour" ), &light.colour );
+
+		if ( light.type >= YN_CORE_MAX_LIGHT_TYPES )
+		{
+			PRINT_WARNING( "Invalid light type (%d), defaulting to omni!\n", light.type );
+			light.type = YN_CORE_LIGHT_TYPE_OMNI;
+		}
+
+		YnCore_World_AddLight( world, &light );
+	}
+}
+
+void YnCore_World_SerialiseLights( const YNCoreWorld *world, YNNodeBranch *root )
+{
+	if ( world->numLights == 0 )
+		return;
+
+	YNNodeBranch *lightListNode = YnNode_PushBackObjectArray( root, "lights" );
+	for ( unsigned int i = 0; i < world->numLights; ++i )
+	{
+		const YNCoreLight *light = &world->lights[ i ];
+
+		YNNodeBranch *lightNode = YnNode_PushBackObject( lightListNode, NULL );
+		YnNode_PushBackI32( lightNode, "type", ( int32_t ) light->type );
+		NL_DS_SerializeVector3( lightNode, "position", &light->position );
+		NL_DS_SerializeVector3( lightNode, "angles", &light->angles );
+		NL_DS_SerializeColourF32( lightNode, "colour", &light->colour );
+		YnNode_PushBackF32( lightNode, "radius", light->radius );
+	}
+}
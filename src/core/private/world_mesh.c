@@ -3,6 +3,9 @@
 
 #include <yin/node.h>
 
+#include <limits.h>
+#include <math.h>
+
 #include "core_private.h"
 #include "world.h"
 
@@ -11,11 +14,10 @@
 
 #define WORLD_VERTEX_ELEMENTS 12// pos, norm, uv, colour
 
-bool YnCore_World_IsFaceVisible( YNCoreWorldFace *face, const YNCoreCamera *camera )
+bool YnCore_World_IsFaceVisible( const YNCoreWorldFace *face, const YNCoreCamera *camera )
 {
 	// Check the face is actually visible
-	face->bounds.origin = pl_vecOrigin3;
-	if ( !PlgIsBoxInsideView( camera->internal, &face->bounds ) )
+	if ( !PlgIsBoxInsideView( camera->internal, &face->parentMesh->faceBounds[ face->index ] ) )
 		return false;
 
 	return true;
@@ -42,12 +44,13 @@ unsigned int *YnCore_World_ConvertFaceToTriangles( const YNCoreWorldFace *face,
 	return indices;
 }
 
-static void GenerateFaceNormal( const YNCoreWorldMesh *mesh, YNCoreWorldFace *face )
+static PLVector3 GenerateFaceNormal( const YNCoreWorldMesh *mesh, const YNCoreWorldFace *face )
 {
+	PLVector3 normal = pl_vecOrigin3;
 	for ( unsigned int i = 0; i < face->numVertices; ++i )
-		face->normal = PlAddVector3( face->normal, mesh->vertices[ face->vertices[ i ] ].normal );
+		normal = PlAddVector3( normal, mesh->vertices[ face->vertices[ i ] ].normal );
 
-	face->normal = PlNormalizeVector3( face->normal );
+	return PlNormalizeVector3( normal );
 }
 
 static void DeserializeMaterials( YNNodeBranch *meshNode, YNCoreWorldMesh *meshPtr )
@@ -108,6 +111,14 @@ static void DeserializeFaces( YNNodeBranch *meshNode, YNCoreWorldMesh *worldMesh
 
 	unsigned int numFaces  = YnNode_GetNumOfChildren( facesList );
 	YNNodeBranch *faceNode = YnNode_GetFirstChild( facesList );
+	if ( numFaces == 0 )
+		return;
+
+	worldMesh->faceTable  = PL_NEW_( YNCoreWorldFace *, numFaces );
+	worldMesh->faceBounds = PL_NEW_( PLCollisionAABB, numFaces );
+	worldMesh->facePlanes = PL_NEW_( PLCollisionPlane, numFaces );
+	worldMesh->faceFlags  = PL_NEW_( uint8_t, numFaces );
+
 	for ( unsigned int i = 0; i < numFaces; ++i )
 	{
 		if ( faceNode == NULL )
@@ -141,9 +152,11 @@ static void DeserializeFaces( YNNodeBranch *meshNode, YNCoreWorldMesh *worldMesh
 				YnNode_GetUI32Array( n, face->vertices, face->numVertices );
 		}
 
-		face->flags = YnNode_GetI32ByName( faceNode, "flags", 0 );
+		face->parentMesh = worldMesh;
+		face->index      = worldMesh->numFaces++;
 
-		GenerateFaceNormal( worldMesh, face );
+		worldMesh->faceTable[ face->index ] = face;
+		worldMesh->faceFlags[ face->index ] = YnNode_GetI32ByName( faceNode, "flags", 0 );
 
 		PlInsertLinkedListNode( worldMesh->faces, face );
 
@@ -173,6 +186,9 @@ YNCoreWorldMesh *YnCore_WorldDeserialiser_BeginMesh( YNNodeBranch *root, YNCoreW
 	return worldMesh;
 }
 
+/**
+ * Works out the bounds and plane for each face from its vertices.
+ */
 static void GenerateBounds( YNCoreWorldMesh *mesh )
 {
 	PLVector3 *coords = PL_NEW_( PLVector3, mesh->numVertices );
@@ -182,21 +198,295 @@ static void GenerateBounds( YNCoreWorldMesh *mesh )
 	mesh->bounds = PlGenerateAabbFromCoords( coords, mesh->numVertices, true );
 	PL_DELETE( coords );
 
+	for ( unsigned int i = 0; i < mesh->numFaces; ++i )
+	{
+		const YNCoreWorldFace *face = mesh->faceTable[ i ];
+
+		PLVector3 faceCoords[ WORLD_FACE_MAX_SIDES ];
+		for ( unsigned int j = 0; j < face->numVertices; ++j )
+			faceCoords[ j ] = mesh->vertices[ face->vertices[ j ] ].position;
+
+		mesh->faceBounds[ i ]        = PlGenerateAabbFromCoords( faceCoords, face->numVertices, true );
+		mesh->faceBounds[ i ].origin = pl_vecOrigin3;
+
+		mesh->facePlanes[ i ] = PlSetupCollisionPlane( mesh->faceBounds[ i ].absOrigin, GenerateFaceNormal( mesh, face ) );
+	}
+}
+
+/**
+ * Updates the flags for the given face.
+ */
+void YnCore_WorldMesh_SetFaceFlags( YNCoreWorldMesh *mesh, unsigned int faceIndex, uint8_t flags )
+{
+	if ( faceIndex >= mesh->numFaces )
+		return;
+
+	mesh->faceFlags[ faceIndex ] = flags;
+}
+
+static bool DeserializeFaceTree( YNNodeBranch *treeNode, YNCoreWorldMesh *mesh, const CommonBVHBounds *bounds )
+{
+	YNNodeBranch *nodesList = YnNode_GetChildByName( treeNode, "nodes" );
+	YNNodeBranch *itemsList = YnNode_GetChildByName( treeNode, "items" );
+	if ( nodesList == NULL || itemsList == NULL )
+		return false;
+
+	unsigned int numNodeValues = YnNode_GetNumOfChildren( nodesList );
+	unsigned int numItems      = YnNode_GetNumOfChildren( itemsList );
+	if ( numItems != mesh->numFaces || numNodeValues == 0 || ( numNodeValues % 2 ) != 0 )
+	{
+		PRINT_WARNING( "Stored face tree doesn't match mesh: %s!\n", mesh->id );
+		return false;
+	}
+
+	int32_t *nodes = PL_NEW_( int32_t, numNodeValues );
+	int32_t *items = PL_NEW_( int32_t, numItems );
+
+	bool status = false;
+	if ( YnNode_GetI32Array( nodesList, nodes, numNodeValues ) == YN_NODE_ERROR_SUCCESS &&
+	     YnNode_GetI32Array( itemsList, items, numItems ) == YN_NODE_ERROR_SUCCESS )
+		status = Common_BVH_Load( &mesh->faceTree, ( uint32_t * ) nodes, numNodeValues / 2, ( uint32_t * ) items, bounds, numItems );
+
+	PL_DELETE( items );
+	PL_DELETE( nodes );
+
+	return status;
+}
+
+/**
+ * Sets up the hierarchy over the face bounds, using the layout stored
+ * with the mesh if there is one, otherwise building it from scratch.
+ */
+static void BuildFaceTree( YNCoreWorldMesh *mesh, YNNodeBranch *treeNode )
+{
+	if ( mesh->numFaces == 0 )
+		return;
+
+	CommonBVHBounds *bounds = PL_NEW_( CommonBVHBounds, mesh->numFaces );
+	for ( unsigned int i = 0; i < mesh->numFaces; ++i )
+	{
+		bounds[ i ].mins = mesh->faceBounds[ i ].mins;
+		bounds[ i ].maxs = mesh->faceBounds[ i ].maxs;
+	}
+
+	if ( treeNode == NULL || !DeserializeFaceTree( treeNode, mesh, bounds ) )
+	{
+		if ( !Common_BVH_Build( &mesh->faceTree, bounds, mesh->numFaces ) )
+			PRINT_WARNING( "Failed to build face tree for mesh: %s!\n", mesh->id );
+	}
+
+	PL_DELETE( bounds );
+}
+
+/**
+ * Writes out the indices of the faces whose bounds pass the given test.
+ */
+unsigned int YnCore_WorldMesh_QueryFaces( const YNCoreWorldMesh *mesh, CommonBVHTestFunction test, void *user, uint32_t *faceIndices, unsigned int maxFaces )
+{
+	return Common_BVH_Query( &mesh->faceTree, test, user, faceIndices, maxFaces );
+}
+
+static bool QueryViewTest( const CommonBVHBounds *bounds, void *user )
+{
+	PLCollisionAABB aabb = { .mins = bounds->mins, .maxs = bounds->maxs };
+	return PlgIsBoxInsideView( ( ( const YNCoreCamera * ) user )->internal, &aabb );
+}
+
+unsigned int YnCore_WorldMesh_QueryFacesInView( const YNCoreWorldMesh *mesh, const YNCoreCamera *camera, uint32_t *faceIndices, unsigned int maxFaces )
+{
+	return Common_BVH_Query( &mesh->faceTree, QueryViewTest, ( void * ) camera, faceIndices, maxFaces );
+}
+
+static unsigned int GetQueriedFaces( const YNCoreWorldMesh *mesh, const uint32_t *faceIndices, unsigned int numFound, YNCoreWorldFace **faces )
+{
+	for ( unsigned int i = 0; i < numFound; ++i )
+		faces[ i ] = mesh->faceTable[ faceIndices[ i ] ];
+
+	return numFound;
+}
+
+unsigned int YnCore_WorldMesh_GetFacesInView( const YNCoreWorldMesh *mesh, const YNCoreCamera *camera, YNCoreWorldFace **faces, uint32_t *faceIndices, unsigned int maxFaces )
+{
+	unsigned int numFound = YnCore_WorldMesh_QueryFacesInView( mesh, camera, faceIndices, maxFaces );
+	return GetQueriedFaces( mesh, faceIndices, numFound, faces );
+}
+
+unsigned int YnCore_WorldMesh_GetFacesInBounds( const YNCoreWorldMesh *mesh, const PLCollisionAABB *bounds, YNCoreWorldFace **faces, uint32_t *faceIndices, unsigned int maxFaces )
+{
+	CommonBVHBounds queryBounds;
+	queryBounds.mins = PlAddVector3( bounds->origin, bounds->mins );
+	queryBounds.maxs = PlAddVector3( bounds->origin, bounds->maxs );
+
+	unsigned int numFound = Common_BVH_QueryBounds( &mesh->faceTree, &queryBounds, faceIndices, maxFaces );
+	return GetQueriedFaces( mesh, faceIndices, numFound, faces );
+}
+
+unsigned int YnCore_WorldMesh_GetFacesInSphere( const YNCoreWorldMesh *mesh, const PLVector3 *origin, float radius, YNCoreWorldFace **faces, uint32_t *faceIndices, unsigned int maxFaces )
+{
+	unsigned int numFound = Common_BVH_QuerySphere( &mesh->faceTree, origin, radius, faceIndices, maxFaces );
+	return GetQueriedFaces( mesh, faceIndices, numFound, faces );
+}
+
+unsigned int YnCore_WorldMesh_GetFacesAlongRay( const YNCoreWorldMesh *mesh, const PLVector3 *origin, const PLVector3 *direction, float distance, YNCoreWorldFace **faces, uint32_t *faceIndices, unsigned int maxFaces )
+{
+	unsigned int numFound = Common_BVH_QueryRay( &mesh->faceTree, origin, direction, distance, faceIndices, maxFaces );
+	return GetQueriedFaces( mesh, faceIndices, numFound, faces );
+}
+
+static YNCoreWorldMeshBatch *GetFaceBatch( YNCoreWorldMesh *mesh, const YNCoreWorldFace *face )
+{
+	bool isPortal = YnCore_World_IsFacePortal( face );
+	for ( unsigned int i = 0; i < mesh->numBatches; ++i )
+	{
+		if ( mesh->batches[ i ].material == face->material && mesh->batches[ i ].isPortal == isPortal )
+			return &mesh->batches[ i ];
+	}
+
+	YNCoreWorldMeshBatch *batch = &mesh->batches[ mesh->numBatches++ ];
+	batch->material             = face->material;
+	batch->isPortal             = isPortal;
+	return batch;
+}
+
+/**
+ * Triangulates every face up front, and sorts the triangles into a static
+ * mesh per material. Portals get batches of their own, since they're drawn
+ * in a separate pass.
+ */
+static void BuildDrawBatches( YNCoreWorldMesh *mesh )
+{
+	unsigned int numFaces = PlGetNumLinkedListNodes( mesh->faces );
+	if ( numFaces == 0 )
+		return;
+
+	mesh->batches = PL_NEW_( YNCoreWorldMeshBatch, numFaces );
+
+	/* first pass figures out which batch each face belongs to, and how big each batch is */
 	PLLinkedListNode *faceNode = PlGetFirstNode( mesh->faces );
 	while ( faceNode != NULL )
 	{
 		YNCoreWorldFace *face = PlGetLinkedListNodeUserData( faceNode );
-		coords                = PL_NEW_( PLVector3, face->numVertices );
-		for ( unsigned int j = 0; j < face->numVertices; ++j )
-			coords[ j ] = mesh->vertices[ face->vertices[ j ] ].position;
+		faceNode              = PlGetNextLinkedListNode( faceNode );
 
-		face->bounds = PlGenerateAabbFromCoords( coords, face->numVertices, true );
-		PL_DELETE( coords );
+		/* faces without a material never get drawn */
+		face->batchIndex = UINT_MAX;
+		if ( face->material == NULL || face->numVertices < 3 )
+			continue;
 
-		face->origin = face->bounds.absOrigin;
+		YNCoreWorldMeshBatch *batch = GetFaceBatch( mesh, face );
+		face->batchIndex            = ( unsigned int ) ( batch - mesh->batches );
+		batch->numFaces++;
+		batch->numIndices += ( face->numVertices - 2 ) * 3;
+	}
 
-		faceNode = PlGetNextLinkedListNode( faceNode );
+	unsigned int maxIndices = 0;
+	for ( unsigned int i = 0; i < mesh->numBatches; ++i )
+	{
+		if ( mesh->batches[ i ].numIndices > maxIndices )
+			maxIndices = mesh->batches[ i ].numIndices;
+
+		/* reset this, so we can use it as a cursor below */
+		mesh->batches[ i ].numFaces = 0;
 	}
+
+	/* only needed while we fill in each batch's mesh */
+	unsigned int *batchIndices = PL_NEW_( unsigned int, maxIndices > 0 ? maxIndices : 1 );
+
+	/* each batch only carries the vertices it uses, so we need to remap */
+	unsigned int *vertexRemap   = PL_NEW_( unsigned int, mesh->numVertices );
+	unsigned int *batchVertices = PL_NEW_( unsigned int, mesh->numVertices );
+	for ( unsigned int i = 0; i < mesh->numBatches; ++i )
+	{
+		YNCoreWorldMeshBatch *batch = &mesh->batches[ i ];
+
+		for ( unsigned int j = 0; j < mesh->numVertices; ++j )
+			vertexRemap[ j ] = UINT_MAX;
+
+		PLVector3 mins = PLVector3( INFINITY, INFINITY, INFINITY );
+		PLVector3 maxs = PLVector3( -INFINITY, -INFINITY, -INFINITY );
+
+		unsigned int numBatchVertices = 0;
+		unsigned int numBatchIndices  = 0;
+		faceNode                      = PlGetFirstNode( mesh->faces );
+		while ( faceNode != NULL )
+		{
+			YNCoreWorldFace *face = PlGetLinkedListNodeUserData( faceNode );
+			faceNode              = PlGetNextLinkedListNode( faceNode );
+			if ( face->batchIndex != i )
+				continue;
+
+			const PLCollisionAABB *bounds = &mesh->faceBounds[ face->index ];
+			mins.x                        = ( bounds->mins.x < mins.x ) ? bounds->mins.x : mins.x;
+			mins.y                        = ( bounds->mins.y < mins.y ) ? bounds->mins.y : mins.y;
+			mins.z                        = ( bounds->mins.z < mins.z ) ? bounds->mins.z : mins.z;
+			maxs.x                        = ( bounds->maxs.x > maxs.x ) ? bounds->maxs.x : maxs.x;
+			maxs.y                        = ( bounds->maxs.y > maxs.y ) ? bounds->maxs.y : maxs.y;
+			maxs.z                        = ( bounds->maxs.z > maxs.z ) ? bounds->maxs.z : maxs.z;
+
+			unsigned int  numTriangles;
+			unsigned int *indices = YnCore_World_ConvertFaceToTriangles( face, &numTriangles );
+			for ( unsigned int k = 0; k < numTriangles * 3; ++k )
+			{
+				if ( indices[ k ] >= mesh->numVertices )
+				{
+					PRINT_WARNING( "Invalid vertex index for face in mesh: %s!\n", mesh->id );
+					indices[ k ] = 0;
+				}
+
+				if ( vertexRemap[ indices[ k ] ] == UINT_MAX )
+				{
+					batchVertices[ numBatchVertices ] = indices[ k ];
+					vertexRemap[ indices[ k ] ]       = numBatchVertices++;
+				}
+
+				batchIndices[ numBatchIndices + k ] = vertexRemap[ indices[ k ] ];
+			}
+			PL_DELETE( indices );
+
+			numBatchIndices += numTriangles * 3;
+			batch->numFaces++;
+		}
+		batch->numIndices = numBatchIndices;
+		batch->origin     = PLVector3( ( mins.x + maxs.x ) * 0.5f, ( mins.y + maxs.y ) * 0.5f, ( mins.z + maxs.z ) * 0.5f );
+
+		batch->drawMesh = PlgCreateMesh( PLG_MESH_TRIANGLES, PLG_DRAW_STATIC, numBatchIndices / 3, numBatchVertices );
+		if ( batch->drawMesh == NULL )
+			PRINT_ERROR( "Failed to create internal mesh for world mesh!\n" );
+
+		/* vertices are pushed in the order they were first referenced */
+		PLGMesh *drawMesh = batch->drawMesh;
+		for ( unsigned int j = 0; j < numBatchVertices; ++j )
+		{
+			const YNCoreWorldVertex *vertex = &mesh->vertices[ batchVertices[ j ] ];
+			PlgAddMeshVertex( drawMesh, vertex->position, vertex->normal, PlColourF32ToU8( &vertex->colour ), vertex->uv );
+		}
+
+		const unsigned int *index = batchIndices;
+		for ( unsigned int j = 0; j < numBatchIndices; j += 3, index += 3 )
+			PlgAddMeshTriangle( drawMesh, index[ 0 ], index[ 1 ], index[ 2 ] );
+
+		PlgGenerateVertexTangentBasis( drawMesh->vertices, drawMesh->num_verts );
+		PlgUploadMesh( drawMesh );
+	}
+
+	PL_DELETE( batchIndices );
+	PL_DELETE( batchVertices );
+	PL_DELETE( vertexRemap );
+}
+
+/**
+ * Frees everything that's generated from the faces' vertices on load.
+ */
+static void DestroyDerivedData( YNCoreWorldMesh *mesh )
+{
+	for ( unsigned int i = 0; i < mesh->numBatches; ++i )
+		PlgDestroyMesh( mesh->batches[ i ].drawMesh );
+
+	PL_DELETE( mesh->batches );
+	mesh->batches    = NULL;
+	mesh->numBatches = 0;
+
+	Common_BVH_Destroy( &mesh->faceTree );
 }
 
 /**
@@ -204,7 +494,12 @@ static void GenerateBounds( YNCoreWorldMesh *mesh )
  */
 void DestroyWorldMesh( YNCoreWorldMesh *mesh )
 {
-	PlgDestroyMesh( mesh->drawMesh );
+	DestroyDerivedData( mesh );
+
+	PL_DELETE( mesh->faceTable );
+	PL_DELETE( mesh->faceBounds );
+	PL_DELETE( mesh->facePlanes );
+	PL_DELETE( mesh->faceFlags );
 }
 
 YNCoreWorldMesh *YnCore_WorldMesh_Create( YNCoreWorld *parent )
@@ -221,16 +516,49 @@ YNCoreWorldMesh *YnCore_WorldMesh_Create( YNCoreWorld *parent )
 	return mesh;
 }
 
-YNCoreWorldMesh *YnCore_WorldMesh_Load( const char *path )
+/**
+ * Returns the mesh if it's already been loaded, adding a reference.
+ */
+YNCoreWorldMesh *YnCore_WorldMesh_GetCached( const char *path )
 {
-	// Check to see if it's cached already
 	YNCoreWorldMesh *worldMesh = MM_GetCachedData( path, MEM_CACHE_WORLD_MESH );
 	if ( worldMesh != NULL )
-	{
 		MemoryManager_AddReference( &worldMesh->mem );
-		return worldMesh;
+
+	return worldMesh;
+}
+
+/**
+ * Sets up the mesh from an already parsed node, this is the
+ * part of loading that has to happen on the main thread.
+ */
+YNCoreWorldMesh *YnCore_WorldMesh_LoadFromNode( const char *path, YNNodeBranch *node )
+{
+	YNCoreWorldMesh *worldMesh = YnCore_WorldMesh_Create( NULL );
+	if ( YnCore_WorldDeserialiser_BeginMesh( node, worldMesh ) == NULL )
+	{
+		YnCore_WorldMesh_Release( worldMesh );
+		return NULL;
 	}
 
+	GenerateBounds( worldMesh );
+
+	BuildFaceTree( worldMesh, YnNode_GetChildByName( node, "faceTree" ) );
+	BuildDrawBatches( worldMesh );
+
+	// If it loaded fine, be sure we start tracking it
+	MM_AddToCache( path, MEM_CACHE_WORLD_MESH, worldMesh );
+
+	return worldMesh;
+}
+
+YNCoreWorldMesh *YnCore_WorldMesh_Load( const char *path )
+{
+	// Check to see if it's cached already
+	YNCoreWorldMesh *worldMesh = YnCore_WorldMesh_GetCached( path );
+	if ( worldMesh != NULL )
+		return worldMesh;
+
 	YNNodeBranch *node = YnNode_LoadFile( path, "worldMesh" );
 	if ( node == NULL )
 	{
@@ -238,65 +566,412 @@ YNCoreWorldMesh *YnCore_WorldMesh_Load( const char *path )
 		return NULL;
 	}
 
-	worldMesh = YnCore_WorldMesh_Create( NULL );
-	if ( YnCore_WorldDeserialiser_BeginMesh( node, worldMesh ) == NULL )
+	worldMesh = YnCore_WorldMesh_LoadFromNode( path, node );
+
+	YnNode_DestroyBranch( node );
+
+	return worldMesh;
+}
+
+void YnCore_WorldMesh_Release( YNCoreWorldMesh *worldMesh )
+{
+	if ( worldMesh == NULL )
+		return;
+
+	MemoryManager_ReleaseReference( &worldMesh->mem );
+}
+
+/**
+ * Regenerates the face bounds and planes, face tree and draw batches
+ * after the mesh's vertices have been changed.
+ */
+void YnCore_WorldMesh_Rebuild( YNCoreWorldMesh *worldMesh )
+{
+	DestroyDerivedData( worldMesh );
+
+	GenerateBounds( worldMesh );
+
+	BuildFaceTree( worldMesh, NULL );
+	BuildDrawBatches( worldMesh );
+}
+
+/**
+ * Roughly how much the mesh is holding onto in system memory. Anything
+ * held by the materials or on the GPU isn't counted.
+ */
+size_t YnCore_WorldMesh_GetMemoryUsage( const YNCoreWorldMesh *mesh )
+{
+	size_t size = sizeof( YNCoreWorldMesh );
+	size += sizeof( YNCoreWorldVertex ) * mesh->maxVertices;
+	size += sizeof( YNCoreMaterial * ) * mesh->numMaterials;
+	size += ( sizeof( YNCoreWorldFace ) + sizeof( YNCoreWorldFace * ) +
+	          sizeof( PLCollisionAABB ) + sizeof( PLCollisionPlane ) + sizeof( uint8_t ) ) *
+	        mesh->numFaces;
+	size += sizeof( YNCoreWorldMeshBatch ) * mesh->numBatches;
+
+	size += sizeof( CommonBVHNode ) * mesh->faceTree.numNodes;
+	size += ( sizeof( uint32_t ) + sizeof( CommonBVHBounds ) ) * mesh->faceTree.numItems;
+
+	return size;
+}
+
+/****************************************
+ * BENCHMARK
+ ****************************************/
+
+#define WORLD_BENCHMARK_DEFAULT_FACES 250000
+#define WORLD_BENCHMARK_QUERIES       1000
+#define WORLD_BENCHMARK_TILE_SIZE     64.0f
+
+static float RandomRange( float min, float max )
+{
+	return min + ( ( float ) rand() / ( float ) RAND_MAX ) * ( max - min );
+}
+
+typedef struct BenchmarkQuery
+{
+	CommonBVHBounds bounds;
+	PLVector3 origin;
+	PLVector3 direction;
+	float radius;
+} BenchmarkQuery;
+
+static bool BenchmarkBoundsTest( const CommonBVHBounds *bounds, void *user )
+{
+	return Common_BVH_TestBounds( bounds, &( ( const BenchmarkQuery * ) user )->bounds );
+}
+
+static bool BenchmarkSphereTest( const CommonBVHBounds *bounds, void *user )
+{
+	const BenchmarkQuery *query = user;
+	return Common_BVH_TestSphere( bounds, &query->origin, query->radius );
+}
+
+static bool BenchmarkRayTest( const CommonBVHBounds *bounds, void *user )
+{
+	const BenchmarkQuery *query = user;
+	return Common_BVH_TestRay( bounds, &query->origin, &query->direction, query->radius );
+}
+
+/**
+ * Generates a big terrain-like sector, and times each kind of
+ * query against the face tree and against testing every face.
+ */
+void YnCore_WorldMesh_BenchmarkQueriesCommand( unsigned int argc, char **argv )
+{
+	unsigned int numFaces = WORLD_BENCHMARK_DEFAULT_FACES;
+	if ( argc > 1 )
 	{
-		YnCore_WorldMesh_Release( worldMesh );
-		worldMesh = NULL;
+		numFaces = strtoul( argv[ 1 ], NULL, 10 );
+		if ( numFaces == 0 )
+		{
+			PRINT_WARNING( "Invalid number of faces specified!\n" );
+			return;
+		}
 	}
 
-	YnNode_DestroyBranch( node );
+	unsigned int gridSize = ( unsigned int ) ceilf( sqrtf( ( float ) numFaces ) );
+	float        extent   = gridSize * WORLD_BENCHMARK_TILE_SIZE;
 
-	// If it loaded fine, be sure we start tracking it
-	if ( worldMesh != NULL )
+	srand( 0 );
+
+	CommonBVHBounds *bounds = PL_NEW_( CommonBVHBounds, numFaces );
+	for ( unsigned int i = 0; i < numFaces; ++i )
 	{
-		GenerateBounds( worldMesh );
+		float x = ( i % gridSize ) * WORLD_BENCHMARK_TILE_SIZE;
+		float z = ( i / gridSize ) * WORLD_BENCHMARK_TILE_SIZE;
+		float y = RandomRange( 0.0f, 256.0f );
 
-		worldMesh->drawMesh = PlgCreateMesh( PLG_MESH_TRIANGLES, PLG_DRAW_DYNAMIC, PlGetNumLinkedListNodes( worldMesh->faces ), worldMesh->numVertices );
-		if ( worldMesh->drawMesh == NULL )
-			PRINT_ERROR( "Failed to create internal mesh for world mesh!\n" );
+		bounds[ i ].mins = PLVector3( x, y, z );
+		bounds[ i ].maxs = PLVector3( x + WORLD_BENCHMARK_TILE_SIZE, y + RandomRange( 0.0f, 64.0f ), z + WORLD_BENCHMARK_TILE_SIZE );
+	}
+
+	CommonBVH tree;
+	PL_ZERO_( tree );
+
+	double startTime = PlGetCurrentSeconds();
+	Common_BVH_Build( &tree, bounds, numFaces );
+	PRINT( "Built tree over %u faces in %.3fms (%u nodes)\n", numFaces, ( PlGetCurrentSeconds() - startTime ) * 1000.0, tree.numNodes );
+
+	BenchmarkQuery *queries = PL_NEW_( BenchmarkQuery, WORLD_BENCHMARK_QUERIES );
+	for ( unsigned int i = 0; i < WORLD_BENCHMARK_QUERIES; ++i )
+	{
+		PLVector3 centre = PLVector3( RandomRange( 0.0f, extent ), RandomRange( 0.0f, 320.0f ), RandomRange( 0.0f, extent ) );
+		float     size   = RandomRange( 32.0f, 512.0f );
+
+		queries[ i ].bounds.mins = PLVector3( centre.x - size, centre.y - size, centre.z - size );
+		queries[ i ].bounds.maxs = PLVector3( centre.x + size, centre.y + size, centre.z + size );
+		queries[ i ].origin      = centre;
+		queries[ i ].direction   = PlNormalizeVector3( PLVector3( RandomRange( -1.0f, 1.0f ), RandomRange( -0.25f, 0.25f ), RandomRange( -1.0f, 1.0f ) ) );
+		queries[ i ].radius      = size;
+	}
 
-		// Push all the vertices to the mesh
-		for ( unsigned int i = 0; i < worldMesh->numVertices; ++i )
+	static const struct
+	{
+		const char *name;
+		CommonBVHTestFunction test;
+	} tests[] = {
+	        { "bounds", BenchmarkBoundsTest },
+	        { "sphere", BenchmarkSphereTest },
+	        { "ray", BenchmarkRayTest },
+	};
+
+	uint32_t *items = PL_NEW_( uint32_t, numFaces );
+	for ( unsigned int i = 0; i < PL_ARRAY_ELEMENTS( tests ); ++i )
+	{
+		unsigned int numTreeFound = 0;
+		startTime                 = PlGetCurrentSeconds();
+		for ( unsigned int j = 0; j < WORLD_BENCHMARK_QUERIES; ++j )
+			numTreeFound += Common_BVH_Query( &tree, tests[ i ].test, &queries[ j ], items, numFaces );
+		double treeTime = PlGetCurrentSeconds() - startTime;
+
+		unsigned int numBruteFound = 0;
+		startTime                  = PlGetCurrentSeconds();
+		for ( unsigned int j = 0; j < WORLD_BENCHMARK_QUERIES; ++j )
 		{
-			PlgAddMeshVertex( worldMesh->drawMesh,
-			                  worldMesh->vertices[ i ].position,
-			                  worldMesh->vertices[ i ].normal,
-			                  PlColourF32ToU8( &worldMesh->vertices[ i ].colour ),
-			                  worldMesh->vertices[ i ].uv );
+			for ( unsigned int k = 0; k < numFaces; ++k )
+			{
+				if ( tests[ i ].test( &bounds[ k ], &queries[ j ] ) )
+					items[ numBruteFound++ % numFaces ] = k;
+			}
 		}
+		double bruteTime = PlGetCurrentSeconds() - startTime;
 
-		PLLinkedListNode *faceNode = PlGetFirstNode( worldMesh->faces );
-		while ( faceNode != NULL )
-		{
-			YNCoreWorldFace *face = PlGetLinkedListNodeUserData( faceNode );
+		PRINT( "%s: tree %.0f queries/s, brute force %.0f queries/s (%u hits)\n", tests[ i ].name,
+		       WORLD_BENCHMARK_QUERIES / treeTime, WORLD_BENCHMARK_QUERIES / bruteTime, numTreeFound );
+		if ( numTreeFound != numBruteFound )
+			PRINT_WARNING( "Hit count mismatch (%u vs %u)!\n", numTreeFound, numBruteFound );
+	}
 
-			unsigned int numTriangles;
-			unsigned int *indices  = YnCore_World_ConvertFaceToTriangles( face, &numTriangles );
-			unsigned int *curIndex = indices;
-			for ( unsigned int k = 0; k < numTriangles; ++k, curIndex += 3 )
-				PlgAddMeshTriangle( worldMesh->drawMesh, curIndex[ 0 ], curIndex[ 1 ], curIndex[ 2 ] );
+	PL_DELETE( items );
+	PL_DELETE( queries );
+	PL_DELETE( bounds );
+	Common_BVH_Destroy( &tree );
+}
 
-			PL_DELETE( indices );
+#define WORLD_BENCHMARK_LAYOUT_DEFAULT_FACES 100000
+#define WORLD_BENCHMARK_LAYOUT_ITERATIONS    16
+#define WORLD_BENCHMARK_LAYOUT_SPHERES       256
+#define WORLD_BENCHMARK_LAYOUT_EXTENT        4096.0f
+
+/**
+ * How faces used to be laid out, with everything in the one struct
+ * and each one in its own allocation. Kept around for comparison.
+ */
+typedef struct BenchmarkLegacyFace
+{
+	PLVector3 normal;
+	PLVector3 origin;
 
-			g_gfxPerfStats.numFacesDrawn++;
+	struct YNCoreMaterial *material;
+	float materialAngle;
+	PLVector2 materialOffset;
+	PLVector2 materialScale;
 
-			faceNode = PlGetNextLinkedListNode( faceNode );
-		}
+	unsigned int vertices[ WORLD_FACE_MAX_SIDES ];
+	uint8_t numVertices;
+
+	uint8_t flags;
+
+	unsigned int batchIndex;
+	unsigned int firstIndex;
+	unsigned int numIndices;
+
+	YNCoreWorldMesh *parentMesh;
+	YNCoreWorldSector *parentSector;
 
-		PlgGenerateVertexTangentBasis( worldMesh->drawMesh->vertices, worldMesh->drawMesh->num_verts );
-		//PlgGenerateMeshTangentBasis( worldMesh->drawMesh );
+	bool isPortalClosed;
+	YNCoreWorldSector *targetSector;
+	YNCoreWorldFace *targetSectorFace;
 
-		MM_AddToCache( path, MEM_CACHE_WORLD_MESH, worldMesh );
+	PLCollisionAABB bounds;
+} BenchmarkLegacyFace;
+
+static unsigned int BenchmarkLegacyCulling( const YNCoreCamera *camera, PLLinkedList *faces )
+{
+	unsigned int      numVisible = 0;
+	PLLinkedListNode *faceNode   = PlGetFirstNode( faces );
+	while ( faceNode != NULL )
+	{
+		BenchmarkLegacyFace *face = PlGetLinkedListNodeUserData( faceNode );
+		faceNode                  = PlGetNextLinkedListNode( faceNode );
+		if ( face->flags & WORLD_FACE_FLAG_SKIP )
+			continue;
+
+		if ( PlgIsBoxInsideView( camera->internal, &face->bounds ) )
+			numVisible++;
 	}
 
-	return worldMesh;
+	return numVisible;
 }
 
-void YnCore_WorldMesh_Release( YNCoreWorldMesh *worldMesh )
+static unsigned int BenchmarkPackedCulling( const YNCoreCamera *camera, const YNCoreWorldMesh *mesh )
 {
-	if ( worldMesh == NULL )
-		return;
+	unsigned int numVisible = 0;
+	for ( unsigned int i = 0; i < mesh->numFaces; ++i )
+	{
+		if ( mesh->faceFlags[ i ] & WORLD_FACE_FLAG_SKIP )
+			continue;
 
-	MemoryManager_ReleaseReference( &worldMesh->mem );
+		if ( PlgIsBoxInsideView( camera->internal, &mesh->faceBounds[ i ] ) )
+			numVisible++;
+	}
+
+	return numVisible;
+}
+
+static unsigned int BenchmarkLegacyCollision( const PLCollisionSphere *sphere, const PLCollisionAABB *sphereBounds, PLLinkedList *faces )
+{
+	unsigned int      numHits  = 0;
+	PLLinkedListNode *faceNode = PlGetFirstNode( faces );
+	while ( faceNode != NULL )
+	{
+		BenchmarkLegacyFace *face = PlGetLinkedListNodeUserData( faceNode );
+		faceNode                  = PlGetNextLinkedListNode( faceNode );
+		if ( !PlIsAabbIntersecting( sphereBounds, &face->bounds ) )
+			continue;
+
+		PLCollisionPlane plane     = PlSetupCollisionPlane( face->bounds.absOrigin, face->normal );
+		PLCollision      collision = PlIsSphereIntersectingPlane( sphere, &plane );
+		if ( collision.penetration > 0.0f )
+			numHits++;
+	}
+
+	return numHits;
+}
+
+static unsigned int BenchmarkPackedCollision( const PLCollisionSphere *sphere, const PLCollisionAABB *sphereBounds, const YNCoreWorldMesh *mesh )
+{
+	unsigned int numHits = 0;
+	for ( unsigned int i = 0; i < mesh->numFaces; ++i )
+	{
+		if ( !PlIsAabbIntersecting( sphereBounds, &mesh->faceBounds[ i ] ) )
+			continue;
+
+		PLCollision collision = PlIsSphereIntersectingPlane( sphere, &mesh->facePlanes[ i ] );
+		if ( collision.penetration > 0.0f )
+			numHits++;
+	}
+
+	return numHits;
+}
+
+/**
+ * Scatters a load of faces around, both in the old layout and in the
+ * mesh's packed arrays, and times culling and plane collision for each.
+ */
+void YnCore_WorldMesh_BenchmarkFaceLayoutCommand( unsigned int argc, char **argv )
+{
+	unsigned int numFaces = WORLD_BENCHMARK_LAYOUT_DEFAULT_FACES;
+	if ( argc > 1 )
+	{
+		numFaces = strtoul( argv[ 1 ], NULL, 10 );
+		if ( numFaces == 0 )
+		{
+			PRINT_WARNING( "Invalid number of faces specified!\n" );
+			return;
+		}
+	}
+
+	YNCoreCamera *camera = YnCore_Camera_Create( "layoutBenchmark", &pl_vecOrigin3, &pl_vecOrigin3 );
+	PlgSetupCamera( camera->internal );
+
+	YNCoreWorldMesh mesh;
+	PL_ZERO_( mesh );
+	mesh.numFaces   = numFaces;
+	mesh.faceBounds = PL_NEW_( PLCollisionAABB, numFaces );
+	mesh.facePlanes = PL_NEW_( PLCollisionPlane, numFaces );
+	mesh.faceFlags  = PL_NEW_( uint8_t, numFaces );
+
+	PLLinkedList *legacyFaces = PlCreateLinkedList();
+
+	srand( 0 );
+	for ( unsigned int i = 0; i < numFaces; ++i )
+	{
+		PLVector3 centre = PLVector3( RandomRange( -WORLD_BENCHMARK_LAYOUT_EXTENT, WORLD_BENCHMARK_LAYOUT_EXTENT ),
+		                              RandomRange( -WORLD_BENCHMARK_LAYOUT_EXTENT, WORLD_BENCHMARK_LAYOUT_EXTENT ),
+		                              RandomRange( -WORLD_BENCHMARK_LAYOUT_EXTENT, WORLD_BENCHMARK_LAYOUT_EXTENT ) );
+		PLVector3 extent = PLVector3( RandomRange( 1.0f, 64.0f ), RandomRange( 1.0f, 64.0f ), RandomRange( 1.0f, 64.0f ) );
+		PLVector3 normal = PlNormalizeVector3( PLVector3( RandomRange( -1.0f, 1.0f ), RandomRange( -1.0f, 1.0f ), RandomRange( -1.0f, 1.0f ) ) );
+
+		BenchmarkLegacyFace *face = PL_NEW( BenchmarkLegacyFace );
+		face->bounds.mins         = PlSubtractVector3( centre, extent );
+		face->bounds.maxs         = PlAddVector3( centre, extent );
+		face->bounds.absOrigin    = centre;
+		face->normal              = normal;
+		face->origin              = centre;
+		face->flags               = ( rand() % 16 == 0 ) ? WORLD_FACE_FLAG_SKIP : 0;
+		PlInsertLinkedListNode( legacyFaces, face );
+
+		mesh.faceBounds[ i ] = face->bounds;
+		mesh.facePlanes[ i ] = PlSetupCollisionPlane( centre, normal );
+		mesh.faceFlags[ i ]  = face->flags;
+	}
+
+	/* culling */
+
+	unsigned int numLegacyVisible = 0;
+	double       startTime        = PlGetCurrentSeconds();
+	for ( unsigned int i = 0; i < WORLD_BENCHMARK_LAYOUT_ITERATIONS; ++i )
+		numLegacyVisible = BenchmarkLegacyCulling( camera, legacyFaces );
+	double legacyCullTime = PlGetCurrentSeconds() - startTime;
+
+	unsigned int numPackedVisible = 0;
+	startTime                     = PlGetCurrentSeconds();
+	for ( unsigned int i = 0; i < WORLD_BENCHMARK_LAYOUT_ITERATIONS; ++i )
+		numPackedVisible = BenchmarkPackedCulling( camera, &mesh );
+	double packedCullTime = PlGetCurrentSeconds() - startTime;
+
+	/* collision */
+
+	PLCollisionSphere *spheres      = PL_NEW_( PLCollisionSphere, WORLD_BENCHMARK_LAYOUT_SPHERES );
+	PLCollisionAABB   *sphereBounds = PL_NEW_( PLCollisionAABB, WORLD_BENCHMARK_LAYOUT_SPHERES );
+	for ( unsigned int i = 0; i < WORLD_BENCHMARK_LAYOUT_SPHERES; ++i )
+	{
+		PLVector3 origin = PLVector3( RandomRange( -WORLD_BENCHMARK_LAYOUT_EXTENT, WORLD_BENCHMARK_LAYOUT_EXTENT ),
+		                              RandomRange( -WORLD_BENCHMARK_LAYOUT_EXTENT, WORLD_BENCHMARK_LAYOUT_EXTENT ),
+		                              RandomRange( -WORLD_BENCHMARK_LAYOUT_EXTENT, WORLD_BENCHMARK_LAYOUT_EXTENT ) );
+		float radius = RandomRange( 16.0f, 256.0f );
+
+		spheres[ i ]      = PlSetupCollisionSphere( origin, radius );
+		sphereBounds[ i ] = PlSetupCollisionAABB( origin, PLVector3( -radius, -radius, -radius ), PLVector3( radius, radius, radius ) );
+	}
+
+	unsigned int numLegacyHits = 0;
+	startTime                  = PlGetCurrentSeconds();
+	for ( unsigned int i = 0; i < WORLD_BENCHMARK_LAYOUT_SPHERES; ++i )
+		numLegacyHits += BenchmarkLegacyCollision( &spheres[ i ], &sphereBounds[ i ], legacyFaces );
+	double legacyCollisionTime = PlGetCurrentSeconds() - startTime;
+
+	unsigned int numPackedHits = 0;
+	startTime                  = PlGetCurrentSeconds();
+	for ( unsigned int i = 0; i < WORLD_BENCHMARK_LAYOUT_SPHERES; ++i )
+		numPackedHits += BenchmarkPackedCollision( &spheres[ i ], &sphereBounds[ i ], &mesh );
+	double packedCollisionTime = PlGetCurrentSeconds() - startTime;
+
+	double numCulled = ( double ) numFaces * WORLD_BENCHMARK_LAYOUT_ITERATIONS;
+	double numTested = ( double ) numFaces * WORLD_BENCHMARK_LAYOUT_SPHERES;
+
+	PRINT( "Face layout over %u faces (%u visible, %u collisions):\n", numFaces, numPackedVisible, numPackedHits );
+	PRINT( "  culling:   legacy %.0f faces/s, packed %.0f faces/s\n", numCulled / legacyCullTime, numCulled / packedCullTime );
+	PRINT( "  collision: legacy %.0f faces/s, packed %.0f faces/s\n", numTested / legacyCollisionTime, numTested / packedCollisionTime );
+	if ( numLegacyVisible != numPackedVisible || numLegacyHits != numPackedHits )
+		PRINT_WARNING( "Result mismatch (%u vs %u visible, %u vs %u collisions)!\n", numLegacyVisible, numPackedVisible, numLegacyHits, numPackedHits );
+
+	PL_DELETE( sphereBounds );
+	PL_DELETE( spheres );
+
+	PLLinkedListNode *faceNode = PlGetFirstNode( legacyFaces );
+	while ( faceNode != NULL )
+	{
+		PL_DELETE( PlGetLinkedListNodeUserData( faceNode ) );
+		faceNode = PlGetNextLinkedListNode( faceNode );
+	}
+	PlDestroyLinkedList( legacyFaces );
+
+	PL_DELETE( mesh.faceBounds );
+	PL_DELETE( mesh.facePlanes );
+	PL_DELETE( mesh.faceFlags );
+
+	YnCore_Camera_Destroy( camera );
 }
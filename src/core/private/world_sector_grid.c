@@ -0,0 +1,291 @@
+// SPDX-License-Identifier: LGPL-3.0-or-later
+// Copyright © 2020-2023 OldTimes Software, Mark E Sowden <hogsy@oldtimes-software.com>
+
+#include <math.h>
+
+#include "core_private.h"
+#include "world.h"
+
+/* Sectors are bucketed by the cells of a uniform grid laid over the world,
+ * so finding the sector a point is in only means checking the handful
+ * that overlap its cell. Cells are sized after the average sector, and
+ * each cell's sectors are kept in ascending order, so the first to match
+ * is the same one a straight scan over every sector would find. */
+
+#define WORLD_SECTOR_GRID_MAX_DIMENSION 64
+#define WORLD_SECTOR_GRID_PADDING       1.0f
+
+/**
+ * Covers the bounds both with and without their origin applied,
+ * so we're conservative however the intersection test treats it.
+ */
+void YnCore_WorldSector_GetExtents( const YNCoreWorldSector *sector, float mins[ 3 ], float maxs[ 3 ] )
+{
+	const PLCollisionAABB *bounds = &sector->bounds;
+
+	const float origin[ 3 ]    = { bounds->origin.x, bounds->origin.y, bounds->origin.z };
+	const float boundsMin[ 3 ] = { bounds->mins.x, bounds->mins.y, bounds->mins.z };
+	const float boundsMax[ 3 ] = { bounds->maxs.x, bounds->maxs.y, bounds->maxs.z };
+	for ( unsigned int i = 0; i < 3; ++i )
+	{
+		mins[ i ] = ( origin[ i ] < 0.0f ) ? boundsMin[ i ] + origin[ i ] : boundsMin[ i ];
+		maxs[ i ] = ( origin[ i ] > 0.0f ) ? boundsMax[ i ] + origin[ i ] : boundsMax[ i ];
+	}
+}
+
+static unsigned int GetCellCoordinate( const YNCoreWorldSectorGrid *grid, unsigned int axis, float v )
+{
+	float f = ( v - grid->mins[ axis ] ) * grid->invCellSize[ axis ];
+	if ( f <= 0.0f )
+		return 0;
+
+	unsigned int c = ( unsigned int ) f;
+	return ( c < grid->dimensions[ axis ] ) ? c : grid->dimensions[ axis ] - 1;
+}
+
+void YnCore_World_DestroySectorGrid( YNCoreWorld *world )
+{
+	PL_DELETE( world->sectorGrid.cellOffsets );
+	PL_DELETE( world->sectorGrid.sectorIndices );
+	PL_ZERO_( world->sectorGrid );
+}
+
+/**
+ * (Re)builds the grid from the current sector bounds.
+ */
+void YnCore_World_BuildSectorGrid( YNCoreWorld *world )
+{
+	YnCore_World_DestroySectorGrid( world );
+
+	world->sectorGridDirty = false;
+	if ( world->numSectors == 0 )
+		return;
+
+	YNCoreWorldSectorGrid *grid = &world->sectorGrid;
+
+	float worldMins[ 3 ], worldMaxs[ 3 ];
+	float averageSize[ 3 ] = { 0.0f, 0.0f, 0.0f };
+	YnCore_WorldSector_GetExtents( &world->sectors[ 0 ], worldMins, worldMaxs );
+	for ( unsigned int i = 0; i < world->numSectors; ++i )
+	{
+		float mins[ 3 ], maxs[ 3 ];
+		YnCore_WorldSector_GetExtents( &world->sectors[ i ], mins, maxs );
+		for ( unsigned int j = 0; j < 3; ++j )
+		{
+			worldMins[ j ] = ( mins[ j ] < worldMins[ j ] ) ? mins[ j ] : worldMins[ j ];
+			worldMaxs[ j ] = ( maxs[ j ] > worldMaxs[ j ] ) ? maxs[ j ] : worldMaxs[ j ];
+			averageSize[ j ] += ( maxs[ j ] - mins[ j ] ) / ( float ) world->numSectors;
+		}
+	}
+
+	unsigned int numCells = 1;
+	for ( unsigned int i = 0; i < 3; ++i )
+	{
+		/* pad it out a little, so anything sitting on the
+		 * outer edge of a sector still lands in the grid */
+		grid->mins[ i ] = worldMins[ i ] - WORLD_SECTOR_GRID_PADDING;
+
+		float extent   = ( worldMaxs[ i ] + WORLD_SECTOR_GRID_PADDING ) - grid->mins[ i ];
+		float cellSize = extent / WORLD_SECTOR_GRID_MAX_DIMENSION;
+		if ( averageSize[ i ] > cellSize )
+			cellSize = averageSize[ i ];
+
+		grid->dimensions[ i ]  = ( unsigned int ) ceilf( extent / cellSize );
+		grid->dimensions[ i ]  = ( grid->dimensions[ i ] > 0 ) ? grid->dimensions[ i ] : 1;
+		grid->dimensions[ i ]  = ( grid->dimensions[ i ] < WORLD_SECTOR_GRID_MAX_DIMENSION ) ? grid->dimensions[ i ] : WORLD_SECTOR_GRID_MAX_DIMENSION;
+		grid->maxs[ i ]        = grid->mins[ i ] + extent;
+		grid->invCellSize[ i ] = grid->dimensions[ i ] / extent;
+		numCells *= grid->dimensions[ i ];
+	}
+
+	/* first pass counts how many sectors land in each cell, second fills them in */
+	grid->cellOffsets = PL_NEW_( uint32_t, numCells + 1 );
+	for ( unsigned int pass = 0; pass < 2; ++pass )
+	{
+		for ( unsigned int i = 0; i < world->numSectors; ++i )
+		{
+			float mins[ 3 ], maxs[ 3 ];
+			YnCore_WorldSector_GetExtents( &world->sectors[ i ], mins, maxs );
+
+			unsigned int lo[ 3 ], hi[ 3 ];
+			for ( unsigned int j = 0; j < 3; ++j )
+			{
+				lo[ j ] = GetCellCoordinate( grid, j, mins[ j ] );
+				hi[ j ] = GetCellCoordinate( grid, j, maxs[ j ] );
+			}
+
+			for ( unsigned int z = lo[ 2 ]; z <= hi[ 2 ]; ++z )
+			{
+				for ( unsigned int y = lo[ 1 ]; y <= hi[ 1 ]; ++y )
+				{
+					for ( unsigned int x = lo[ 0 ]; x <= hi[ 0 ]; ++x )
+					{
+						unsigned int cell = ( z * grid->dimensions[ 1 ] + y ) * grid->dimensions[ 0 ] + x;
+						if ( pass == 0 )
+							grid->cellOffsets[ cell + 1 ]++;
+						else
+							grid->sectorIndices[ grid->cellOffsets[ cell ]++ ] = i;
+					}
+				}
+			}
+		}
+
+		if ( pass == 0 )
+		{
+			for ( unsigned int i = 0; i < numCells; ++i )
+				grid->cellOffsets[ i + 1 ] += grid->cellOffsets[ i ];
+
+			grid->sectorIndices = PL_NEW_( uint32_t, grid->cellOffsets[ numCells ] );
+		}
+	}
+
+	/* filling in pushed each offset along to where the next cell starts */
+	for ( unsigned int i = numCells; i > 0; --i )
+		grid->cellOffsets[ i ] = grid->cellOffsets[ i - 1 ];
+	grid->cellOffsets[ 0 ] = 0;
+}
+
+/**
+ * Returns the sectors that overlap the cell containing the given point,
+ * or NULL if it's outside of the grid entirely.
+ */
+const uint32_t *YnCore_World_GetSectorGridCell( const YNCoreWorld *world, const PLVector3 *point, unsigned int *numSectors )
+{
+	*numSectors = 0;
+
+	const YNCoreWorldSectorGrid *grid = &world->sectorGrid;
+	if ( grid->cellOffsets == NULL )
+		return NULL;
+
+	const float p[ 3 ] = { point->x, point->y, point->z };
+	for ( unsigned int i = 0; i < 3; ++i )
+	{
+		if ( p[ i ] < grid->mins[ i ] || p[ i ] > grid->maxs[ i ] )
+			return NULL;
+	}
+
+	unsigned int cell = ( GetCellCoordinate( grid, 2, p[ 2 ] ) * grid->dimensions[ 1 ] + GetCellCoordinate( grid, 1, p[ 1 ] ) ) * grid->dimensions[ 0 ] + GetCellCoordinate( grid, 0, p[ 0 ] );
+
+	*numSectors = grid->cellOffsets[ cell + 1 ] - grid->cellOffsets[ cell ];
+	return &grid->sectorIndices[ grid->cellOffsets[ cell ] ];
+}
+
+/**
+ * Updates the bounds of the given sector. The grid and sector lights
+ * get rebuilt on the next lookup, so edits can be batched up.
+ */
+void YnCore_WorldSector_SetBounds( YNCoreWorld *world, YNCoreWorldSector *sector, const PLCollisionAABB *bounds )
+{
+	sector->bounds           = *bounds;
+	world->sectorGridDirty   = true;
+	world->sectorLightsDirty = true;
+}
+
+/****************************************
+ * BENCHMARK
+ ****************************************/
+
+#define WORLD_BENCHMARK_DEFAULT_SECTORS 4096
+#define WORLD_BENCHMARK_POINTS          1000000
+#define WORLD_BENCHMARK_SECTOR_SIZE     512.0f
+
+static float RandomRange( float min, float max )
+{
+	return min + ( ( float ) rand() / ( float ) RAND_MAX ) * ( max - min );
+}
+
+/**
+ * How sectors used to be looked up, kept around for comparison.
+ */
+static YNCoreWorldSector *GetSectorByScanning( YNCoreWorld *world, const PLVector3 *point )
+{
+	for ( unsigned int i = 0; i < world->numSectors; ++i )
+	{
+		if ( PlIsPointIntersectingAabb( &world->sectors[ i ].bounds, *point ) )
+			return &world->sectors[ i ];
+	}
+
+	return &world->sectors[ 0 ];
+}
+
+/**
+ * Lays out a load of rooms of varying sizes across a few floors,
+ * and times looking up the sector for random points among them.
+ */
+void YnCore_World_BenchmarkSectorLookupCommand( unsigned int argc, char **argv )
+{
+	unsigned int numSectors = WORLD_BENCHMARK_DEFAULT_SECTORS;
+	if ( argc > 1 )
+	{
+		numSectors = strtoul( argv[ 1 ], NULL, 10 );
+		if ( numSectors == 0 )
+		{
+			PRINT_WARNING( "Invalid number of sectors specified!\n" );
+			return;
+		}
+	}
+
+	YNCoreWorld *world = PL_NEW( YNCoreWorld );
+	world->numSectors  = numSectors;
+	world->sectors     = PL_NEW_( YNCoreWorldSector, numSectors );
+
+	srand( 0 );
+
+	unsigned int numFloors = 4;
+	unsigned int rowSize   = ( unsigned int ) ceilf( sqrtf( ( float ) numSectors / numFloors ) );
+	for ( unsigned int i = 0; i < numSectors; ++i )
+	{
+		unsigned int col   = i % rowSize;
+		unsigned int row   = ( i / rowSize ) % rowSize;
+		unsigned int level = i / ( rowSize * rowSize );
+
+		/* rooms are allowed to overlap their neighbours a little */
+		PLVector3 mins = PLVector3( col * WORLD_BENCHMARK_SECTOR_SIZE, level * WORLD_BENCHMARK_SECTOR_SIZE, row * WORLD_BENCHMARK_SECTOR_SIZE );
+		PLVector3 size = PLVector3( RandomRange( 0.5f, 1.25f ) * WORLD_BENCHMARK_SECTOR_SIZE,
+		                            RandomRange( 0.5f, 1.0f ) * WORLD_BENCHMARK_SECTOR_SIZE,
+		                            RandomRange( 0.5f, 1.25f ) * WORLD_BENCHMARK_SECTOR_SIZE );
+
+		world->sectors[ i ].bounds.mins = mins;
+		world->sectors[ i ].bounds.maxs = PlAddVector3( mins, size );
+	}
+
+	double startTime = PlGetCurrentSeconds();
+	YnCore_World_BuildSectorGrid( world );
+	PRINT( "Built sector grid in %.3fms (%ux%ux%u cells, %u entries)\n", ( PlGetCurrentSeconds() - startTime ) * 1000.0,
+	       world->sectorGrid.dimensions[ 0 ], world->sectorGrid.dimensions[ 1 ], world->sectorGrid.dimensions[ 2 ],
+	       world->sectorGrid.cellOffsets[ world->sectorGrid.dimensions[ 0 ] * world->sectorGrid.dimensions[ 1 ] * world->sectorGrid.dimensions[ 2 ] ] );
+
+	float      extent = rowSize * WORLD_BENCHMARK_SECTOR_SIZE * 1.1f;
+	PLVector3 *points = PL_NEW_( PLVector3, WORLD_BENCHMARK_POINTS );
+	for ( unsigned int i = 0; i < WORLD_BENCHMARK_POINTS; ++i )
+		points[ i ] = PLVector3( RandomRange( 0.0f, extent ), RandomRange( 0.0f, numFloors * WORLD_BENCHMARK_SECTOR_SIZE ), RandomRange( 0.0f, extent ) );
+
+	YNCoreWorldSector **results = PL_NEW_( YNCoreWorldSector *, WORLD_BENCHMARK_POINTS );
+
+	startTime = PlGetCurrentSeconds();
+	for ( unsigned int i = 0; i < WORLD_BENCHMARK_POINTS; ++i )
+		results[ i ] = YnCore_World_GetSectorByGlobalOrigin( world, &points[ i ] );
+	double gridTime = PlGetCurrentSeconds() - startTime;
+
+	unsigned int numMismatches = 0;
+	startTime                  = PlGetCurrentSeconds();
+	for ( unsigned int i = 0; i < WORLD_BENCHMARK_POINTS; ++i )
+	{
+		if ( GetSectorByScanning( world, &points[ i ] ) != results[ i ] )
+			numMismatches++;
+	}
+	double scanTime = PlGetCurrentSeconds() - startTime;
+
+	PRINT( "Looked up %u points against %u sectors:\n", WORLD_BENCHMARK_POINTS, numSectors );
+	PRINT( "  scan: %.3fms\n", scanTime * 1000.0 );
+	PRINT( "  grid: %.3fms\n", gridTime * 1000.0 );
+	if ( numMismatches > 0 )
+		PRINT_WARNING( "%u lookups didn't match!\n", numMismatches );
+
+	PL_DELETE( results );
+	PL_DELETE( points );
+
+	YnCore_World_DestroySectorGrid( world );
+	PL_DELETE( world->sectors );
+	PL_DELETE( world );
+}
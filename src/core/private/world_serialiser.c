@@ -15,8 +15,8 @@ static void SerialiseFace( const YNCoreWorldFace *face, const YNCoreWorldMesh *m
 	YnNode_PushBackF32( node, "materialAngle", face->materialAngle );
 	NL_DS_SerializeVector2( node, "materialOffset", &face->materialOffset );
 	NL_DS_SerializeVector2( node, "materialScale", &face->materialScale );
-	YnNode_PushBackI8( node, "flags", ( int8_t ) face->flags );
-	NL_DS_SerializeVector3( node, "normal", &face->normal );
+	YnNode_PushBackI8( node, "flags", ( int8_t ) mesh->faceFlags[ face->index ] );
+	NL_DS_SerializeVector3( node, "normal", &mesh->facePlanes[ face->index ].normal );
 }
 
 static void SerialiseFaces( const YNCoreWorldMesh *mesh, YNNodeBranch *root )
@@ -30,6 +30,27 @@ static void SerialiseFaces( const YNCoreWorldMesh *mesh, YNNodeBranch *root )
 #endif
 }
 
+static void SerialiseFaceTree( const YNCoreWorldMesh *mesh, YNNodeBranch *root )
+{
+	const CommonBVH *tree = &mesh->faceTree;
+	if ( tree->numNodes == 0 )
+		return;
+
+	/* only the layout is stored, bounds get recalculated on load */
+	int32_t *nodes = PL_NEW_( int32_t, tree->numNodes * 2 );
+	for ( unsigned int i = 0; i < tree->numNodes; ++i )
+	{
+		nodes[ i * 2 ]     = ( int32_t ) tree->nodes[ i ].offset;
+		nodes[ i * 2 + 1 ] = ( int32_t ) tree->nodes[ i ].numItems;
+	}
+
+	YNNodeBranch *treeNode = YnNode_PushBackObject( root, "faceTree" );
+	YnNode_PushBackI32Array( treeNode, "nodes", nodes, tree->numNodes * 2 );
+	YnNode_PushBackI32Array( treeNode, "items", ( const int32_t * ) tree->items, tree->numItems );
+
+	PL_DELETE( nodes );
+}
+
 static void SerialiseMesh( const YNCoreWorldMesh *mesh, YNNodeBranch *root, const char *name )
 {
 	YNNodeBranch *meshNode = YnNode_PushBackObject( root, name );
@@ -39,6 +60,7 @@ static void SerialiseMesh( const YNCoreWorldMesh *mesh, YNNodeBranch *root, cons
 	NL_DS_SerializeCollisionAABB( meshNode, "bounds", &mesh->bounds );
 
 	SerialiseFaces( mesh, meshNode );
+	SerialiseFaceTree( mesh, meshNode );
 }
 
 static void SerialiseMeshes( const YNCoreWorld *world, YNNodeBranch *root )
@@ -52,6 +74,50 @@ static void SerialiseMeshes( const YNCoreWorld *world, YNNodeBranch *root )
 	}
 }
 
+static int32_t GetFaceIndex( const YNCoreWorldMesh *mesh, const YNCoreWorldFace *face )
+{
+	if ( mesh == NULL || face == NULL )
+		return -1;
+
+	for ( unsigned int i = 0; i < mesh->numFaces; ++i )
+	{
+		if ( mesh->faceTable[ i ] == face )
+			return ( int32_t ) i;
+	}
+
+	return -1;
+}
+
+/**
+ * Portals are stored as a face, the sector it leads
+ * to and the face on the other side (or -1).
+ */
+static void SerialiseSectorPortals( const YNCoreWorld *world, const YNCoreWorldSector *sector, YNNodeBranch *root )
+{
+	const YNCoreWorldMesh *mesh = sector->mesh;
+	if ( mesh == NULL )
+		return;
+
+	int32_t     *portals    = PL_NEW_( int32_t, mesh->numFaces * 3 + 1 );
+	unsigned int numPortals = 0;
+	for ( unsigned int i = 0; i < mesh->numFaces; ++i )
+	{
+		const YNCoreWorldFace *face = mesh->faceTable[ i ];
+		if ( face->targetSector == NULL )
+			continue;
+
+		portals[ numPortals * 3 ]     = ( int32_t ) i;
+		portals[ numPortals * 3 + 1 ] = ( int32_t ) ( face->targetSector - world->sectors );
+		portals[ numPortals * 3 + 2 ] = GetFaceIndex( face->targetSector->mesh, face->targetSectorFace );
+		numPortals++;
+	}
+
+	if ( numPortals > 0 )
+		YnNode_PushBackI32Array( root, "portals", portals, numPortals * 3 );
+
+	PL_DELETE( portals );
+}
+
 static void SerialiseSectors( const YNCoreWorld *world, YNNodeBranch *root )
 {
 	YNNodeBranch *sectorListNode = YnNode_PushBackObjectArray( root, "sectors" );
@@ -66,6 +132,11 @@ static void SerialiseSectors( const YNCoreWorld *world, YNNodeBranch *root )
 			YnNode_PushBackString( sectorNode, "meshId", world->sectors[ i ].mesh->id );
 
 		NL_DS_SerializeCollisionAABB( sectorNode, "bounds", &world->sectors[ i ].bounds );
+
+		SerialiseSectorPortals( world, &world->sectors[ i ], sectorNode );
+
+		if ( world->sectorVisibility.numClusters == world->numSectors )
+			YnNode_PushBackI32Array( sectorNode, "visibleSectors", ( const int32_t * ) Common_PVS_GetRow( &world->sectorVisibility, i ), world->sectorVisibility.numWords );
 	}
 }
 
@@ -74,6 +145,7 @@ void YnCore_WorldSerialiser_Begin( const YNCoreWorld *world, YNNodeBranch *root
 	YnNode_PushBackI32( root, "version", YN_CORE_WORLD_VERSION );
 	YnNode_PushBackBranch( root, world->globalProperties );
 
+	YnCore_World_SerialiseLights( world, root );
 	SerialiseMeshes( world, root );
 	SerialiseSectors( world, root );
 }
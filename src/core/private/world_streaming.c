@@ -0,0 +1,660 @@
+// SPDX-License-Identifier: LGPL-3.0-or-later
+// Copyright © 2020-2023 OldTimes Software, Mark E Sowden <hogsy@oldtimes-software.com>
+
+#include <SDL2/SDL.h>
+
+#include <math.h>
+
+#include <yin/node.h>
+
+#include "core_private.h"
+#include "world.h"
+
+/* Node files are read and parsed on a loader thread, which is the bulk of
+ * the time spent loading, and then handed back to the main thread to be
+ * turned into a world or mesh, since that's where materials and draw
+ * meshes have to be set up.
+ *
+ * Worlds loaded this way only fetch the list of meshes up front. Each tick,
+ * the meshes for sectors within range of the stream origin are requested,
+ * nearest first, and those that have finished loading are finalised within
+ * a time budget. When over the memory budget, meshes that haven't been
+ * needed for the longest are dropped again. */
+
+#define WORLD_STREAM_MAX_PENDING 4
+
+/****************************************
+ * LOADER THREAD
+ ****************************************/
+
+enum
+{
+	WORLD_LOAD_JOB_QUEUED,
+	WORLD_LOAD_JOB_DONE,
+	WORLD_LOAD_JOB_CANCELLED,
+};
+
+/**
+ * Whichever of the loader or the owner gets there second, when
+ * the job is either done or cancelled, is the one that frees it.
+ */
+typedef struct YNCoreWorldLoadJob
+{
+	PLPath path;
+	char objectType[ 32 ];
+	YNNodeBranch *result;
+	SDL_atomic_t state;
+	struct YNCoreWorldLoadJob *next;
+} YNCoreWorldLoadJob;
+
+static SDL_Thread *loaderThread;
+static SDL_mutex *loaderMutex;
+static SDL_sem *loaderSemaphore;
+static SDL_atomic_t loaderShutdown;
+static YNCoreWorldLoadJob *loaderQueueHead;
+static YNCoreWorldLoadJob *loaderQueueTail;
+
+static void FreeLoadJob( YNCoreWorldLoadJob *job )
+{
+	if ( job->result != NULL )
+		YnNode_DestroyBranch( job->result );
+
+	PL_DELETE( job );
+}
+
+static int LoaderThread( void *userData )
+{
+	( void ) ( userData );
+
+	while ( true )
+	{
+		SDL_SemWait( loaderSemaphore );
+		if ( SDL_AtomicGet( &loaderShutdown ) )
+			break;
+
+		SDL_LockMutex( loaderMutex );
+		YNCoreWorldLoadJob *job = loaderQueueHead;
+		if ( job != NULL )
+		{
+			loaderQueueHead = job->next;
+			if ( loaderQueueHead == NULL )
+				loaderQueueTail = NULL;
+		}
+		SDL_UnlockMutex( loaderMutex );
+
+		if ( job == NULL )
+			continue;
+
+		/* no point loading it if nobody wants it anymore */
+		if ( SDL_AtomicGet( &job->state ) != WORLD_LOAD_JOB_CANCELLED )
+			job->result = YnNode_LoadFile( job->path, job->objectType );
+
+		if ( !SDL_AtomicCAS( &job->state, WORLD_LOAD_JOB_QUEUED, WORLD_LOAD_JOB_DONE ) )
+			FreeLoadJob( job );
+	}
+
+	return 0;
+}
+
+static YNCoreWorldLoadJob *PushLoadJob( const char *path, const char *objectType )
+{
+	if ( loaderThread == NULL )
+	{
+		PRINT_WARNING( "Loader thread isn't running, can't load: %s\n", path );
+		return NULL;
+	}
+
+	YNCoreWorldLoadJob *job = PL_NEW( YNCoreWorldLoadJob );
+	snprintf( job->path, sizeof( job->path ), "%s", path );
+	snprintf( job->objectType, sizeof( job->objectType ), "%s", objectType );
+	SDL_AtomicSet( &job->state, WORLD_LOAD_JOB_QUEUED );
+
+	SDL_LockMutex( loaderMutex );
+	if ( loaderQueueTail != NULL )
+		loaderQueueTail->next = job;
+	else
+		loaderQueueHead = job;
+	loaderQueueTail = job;
+	SDL_UnlockMutex( loaderMutex );
+
+	SDL_SemPost( loaderSemaphore );
+
+	return job;
+}
+
+static bool IsLoadJobDone( const YNCoreWorldLoadJob *job )
+{
+	return ( SDL_AtomicGet( ( SDL_atomic_t * ) &job->state ) == WORLD_LOAD_JOB_DONE );
+}
+
+/**
+ * Takes the parsed node from a job that's done, and frees the job.
+ */
+static YNNodeBranch *TakeLoadJobResult( YNCoreWorldLoadJob *job )
+{
+	assert( IsLoadJobDone( job ) );
+
+	YNNodeBranch *result = job->result;
+	job->result          = NULL;
+	FreeLoadJob( job );
+
+	return result;
+}
+
+static void CancelLoadJob( YNCoreWorldLoadJob *job )
+{
+	if ( !SDL_AtomicCAS( &job->state, WORLD_LOAD_JOB_QUEUED, WORLD_LOAD_JOB_CANCELLED ) )
+		FreeLoadJob( job );
+}
+
+static PLConsoleVariable *streamRadius;
+static PLConsoleVariable *streamBudget;
+static PLConsoleVariable *streamFinaliseTime;
+
+void YnCore_World_InitializeStreaming( void )
+{
+	streamRadius       = PlRegisterConsoleVariable( "world.streamRadius", "Distance from the view that sector meshes are loaded within.", "4096", PL_VAR_F32, NULL, NULL, true );
+	streamBudget       = PlRegisterConsoleVariable( "world.streamBudget", "Memory, in megabytes, that streamed meshes can use before they're dropped.", "256", PL_VAR_I32, NULL, NULL, true );
+	streamFinaliseTime = PlRegisterConsoleVariable( "world.streamFinaliseTime", "Milliseconds per tick that can be spent finishing streamed meshes.", "4", PL_VAR_F32, NULL, NULL, true );
+
+	loaderMutex     = SDL_CreateMutex();
+	loaderSemaphore = SDL_CreateSemaphore( 0 );
+	if ( loaderMutex == NULL || loaderSemaphore == NULL )
+	{
+		PRINT_WARNING( "Failed to create loader thread primitives: %s\n", SDL_GetError() );
+		return;
+	}
+
+	SDL_AtomicSet( &loaderShutdown, 0 );
+	if ( ( loaderThread = SDL_CreateThread( LoaderThread, "WorldLoader", NULL ) ) == NULL )
+		PRINT_WARNING( "Failed to create loader thread: %s\n", SDL_GetError() );
+}
+
+void YnCore_World_ShutdownStreaming( void )
+{
+	if ( loaderThread != NULL )
+	{
+		SDL_AtomicSet( &loaderShutdown, 1 );
+		SDL_SemPost( loaderSemaphore );
+		SDL_WaitThread( loaderThread, NULL );
+		loaderThread = NULL;
+	}
+
+	/* anything left over never gets loaded, but its owner might still be waiting on it */
+	YNCoreWorldLoadJob *job = loaderQueueHead;
+	while ( job != NULL )
+	{
+		YNCoreWorldLoadJob *next = job->next;
+		if ( !SDL_AtomicCAS( &job->state, WORLD_LOAD_JOB_QUEUED, WORLD_LOAD_JOB_DONE ) )
+			FreeLoadJob( job );
+
+		job = next;
+	}
+	loaderQueueHead = loaderQueueTail = NULL;
+
+	SDL_DestroySemaphore( loaderSemaphore );
+	SDL_DestroyMutex( loaderMutex );
+	loaderSemaphore = NULL;
+	loaderMutex     = NULL;
+}
+
+/****************************************
+ * WORLD
+ ****************************************/
+
+YNCoreWorldLoadJob *YnCore_World_BeginLoad( const char *path )
+{
+	return PushLoadJob( path, "world" );
+}
+
+bool YnCore_World_IsLoadFinished( const YNCoreWorldLoadJob *job )
+{
+	return IsLoadJobDone( job );
+}
+
+/**
+ * Creates the world from the parsed node, once the job is finished.
+ * The job is freed either way, and the world is set up for streaming.
+ */
+YNCoreWorld *YnCore_World_FinishLoad( YNCoreWorldLoadJob *job )
+{
+	PLPath path;
+	snprintf( path, sizeof( path ), "%s", job->path );
+
+	/* anything the loader had to say about it */
+	Console_FlushDeferredOutput();
+
+	YNNodeBranch *node = TakeLoadJobResult( job );
+	if ( node == NULL )
+	{
+		PRINT_WARNING( "Failed to load world: %s\n", path );
+		return NULL;
+	}
+
+	YNCoreWorld *world = YnCore_World_Create();
+	snprintf( world->path, sizeof( world->path ), "%s", path );
+	world->isStreamed = true;
+	if ( YnCore_WorldDeserialiser_Begin( node, world ) == NULL )
+	{
+		YnCore_World_Destroy( world );
+		world = NULL;
+	}
+	else
+	{
+		YnCore_World_BuildSectorGrid( world );
+		YnCore_World_AssignSectorLights( world );
+	}
+
+	YnNode_DestroyBranch( node );
+
+	return world;
+}
+
+void YnCore_World_CancelLoad( YNCoreWorldLoadJob *job )
+{
+	if ( job == NULL )
+		return;
+
+	CancelLoadJob( job );
+}
+
+/****************************************
+ * STREAMING
+ ****************************************/
+
+static bool IsSectorAffected( const YNCoreWorld *world, const YNCoreWorldSector *sector, int meshIndex )
+{
+	if ( sector->meshIndex == meshIndex )
+		return true;
+
+	for ( unsigned int i = 0; i < sector->numPortals; ++i )
+	{
+		if ( world->sectors[ sector->portals[ i * 3 + 1 ] ].meshIndex == meshIndex )
+			return true;
+	}
+
+	return false;
+}
+
+/**
+ * Relinks the portals of any sector using the mesh,
+ * or leading into a sector that does.
+ */
+static void RelinkSectors( YNCoreWorld *world, int meshIndex )
+{
+	for ( unsigned int i = 0; i < world->numSectors; ++i )
+	{
+		if ( IsSectorAffected( world, &world->sectors[ i ], meshIndex ) )
+			YnCore_World_LinkSectorPortals( world, &world->sectors[ i ] );
+	}
+}
+
+/**
+ * Clears the links from the sector's portal faces, so the mesh
+ * isn't left pointing into the world once it's dropped.
+ */
+static void UnlinkSectorPortals( YNCoreWorldSector *sector )
+{
+	for ( unsigned int i = 0; i < sector->numPortals; ++i )
+	{
+		/* anything negative wraps around, and is skipped along with the rest */
+		unsigned int faceIndex = ( unsigned int ) sector->portals[ i * 3 ];
+		if ( faceIndex >= sector->mesh->numFaces )
+			continue;
+
+		sector->mesh->faceTable[ faceIndex ]->targetSector     = NULL;
+		sector->mesh->faceTable[ faceIndex ]->targetSectorFace = NULL;
+	}
+}
+
+static void SetStreamedMesh( YNCoreWorld *world, int meshIndex, YNCoreWorldMesh *mesh )
+{
+	for ( unsigned int i = 0; i < world->numSectors; ++i )
+	{
+		YNCoreWorldSector *sector = &world->sectors[ i ];
+		if ( sector->meshIndex == meshIndex )
+		{
+			if ( sector->mesh != NULL )
+				UnlinkSectorPortals( sector );
+
+			sector->mesh = mesh;
+		}
+
+		for ( unsigned int j = 0; j < sector->numStaticObjects; ++j )
+		{
+			if ( sector->staticObjects[ j ].meshIndex == meshIndex )
+				sector->staticObjects[ j ].mesh = mesh;
+		}
+	}
+
+	RelinkSectors( world, meshIndex );
+}
+
+static void AttachStreamedMesh( YNCoreWorld *world, unsigned int meshIndex, YNCoreWorldMesh *mesh )
+{
+	YNCoreWorldStreamMesh *streamMesh = &world->streamMeshes[ meshIndex ];
+	if ( mesh == NULL )
+	{
+		PRINT_WARNING( "Failed to load world mesh: %s\n", streamMesh->path );
+		streamMesh->state = WORLD_STREAM_FAILED;
+		return;
+	}
+
+	streamMesh->mesh       = mesh;
+	streamMesh->state      = WORLD_STREAM_LOADED;
+	streamMesh->memorySize = YnCore_WorldMesh_GetMemoryUsage( mesh );
+
+	world->streamStats.numLoads++;
+	world->streamStats.residentBytes += streamMesh->memorySize;
+	if ( world->streamStats.residentBytes > world->streamStats.peakResidentBytes )
+		world->streamStats.peakResidentBytes = world->streamStats.residentBytes;
+
+	SetStreamedMesh( world, ( int ) meshIndex, mesh );
+}
+
+static void EvictStreamedMesh( YNCoreWorld *world, unsigned int meshIndex )
+{
+	YNCoreWorldStreamMesh *streamMesh = &world->streamMeshes[ meshIndex ];
+	SetStreamedMesh( world, ( int ) meshIndex, NULL );
+
+	/* it's left to the memory manager, so if it's needed again soon it's still cached */
+	YnCore_WorldMesh_Release( streamMesh->mesh );
+	streamMesh->mesh  = NULL;
+	streamMesh->state = WORLD_STREAM_UNLOADED;
+
+	world->streamStats.numEvictions++;
+	world->streamStats.residentBytes -= streamMesh->memorySize;
+}
+
+static float GetDistanceToBounds( const PLCollisionAABB *bounds, const PLVector3 *origin )
+{
+	const float point[ 3 ] = { origin->x, origin->y, origin->z };
+	const float mins[ 3 ]  = { bounds->origin.x + bounds->mins.x, bounds->origin.y + bounds->mins.y, bounds->origin.z + bounds->mins.z };
+	const float maxs[ 3 ]  = { bounds->origin.x + bounds->maxs.x, bounds->origin.y + bounds->maxs.y, bounds->origin.z + bounds->maxs.z };
+
+	float distance = 0.0f;
+	for ( unsigned int i = 0; i < 3; ++i )
+	{
+		float d = 0.0f;
+		if ( point[ i ] < mins[ i ] )
+			d = mins[ i ] - point[ i ];
+		else if ( point[ i ] > maxs[ i ] )
+			d = point[ i ] - maxs[ i ];
+
+		distance += d * d;
+	}
+
+	return sqrtf( distance );
+}
+
+static void MarkNeeded( YNCoreWorld *world, int meshIndex, float distance )
+{
+	if ( meshIndex < 0 )
+		return;
+
+	YNCoreWorldStreamMesh *streamMesh = &world->streamMeshes[ meshIndex ];
+	if ( streamMesh->lastNeededTick != world->streamTick || distance < streamMesh->distance )
+		streamMesh->distance = distance;
+
+	streamMesh->lastNeededTick = world->streamTick;
+}
+
+static const YNCoreWorldStreamMesh *sortStreamMeshes;
+static int CompareStreamMeshDistance( const void *a, const void *b )
+{
+	float da = sortStreamMeshes[ *( const unsigned int * ) a ].distance;
+	float db = sortStreamMeshes[ *( const unsigned int * ) b ].distance;
+	return ( da > db ) - ( da < db );
+}
+
+static void RequestNeededMeshes( YNCoreWorld *world )
+{
+	unsigned int  numRequests = 0, numPending = 0;
+	unsigned int *requests    = PL_NEW_( unsigned int, world->numStreamMeshes + 1 );
+	for ( unsigned int i = 0; i < world->numStreamMeshes; ++i )
+	{
+		const YNCoreWorldStreamMesh *streamMesh = &world->streamMeshes[ i ];
+		if ( streamMesh->state == WORLD_STREAM_PENDING )
+			numPending++;
+		else if ( streamMesh->state == WORLD_STREAM_UNLOADED && streamMesh->lastNeededTick == world->streamTick )
+			requests[ numRequests++ ] = i;
+	}
+
+	sortStreamMeshes = world->streamMeshes;
+	qsort( requests, numRequests, sizeof( unsigned int ), CompareStreamMeshDistance );
+
+	for ( unsigned int i = 0; i < numRequests; ++i )
+	{
+		YNCoreWorldStreamMesh *streamMesh = &world->streamMeshes[ requests[ i ] ];
+
+		/* might still be around from before */
+		YNCoreWorldMesh *mesh = YnCore_WorldMesh_GetCached( streamMesh->path );
+		if ( mesh != NULL )
+		{
+			AttachStreamedMesh( world, requests[ i ], mesh );
+			continue;
+		}
+
+		if ( numPending >= WORLD_STREAM_MAX_PENDING )
+			continue;
+
+		if ( ( streamMesh->job = PushLoadJob( streamMesh->path, "worldMesh" ) ) == NULL )
+		{
+			streamMesh->state = WORLD_STREAM_FAILED;
+			continue;
+		}
+
+		streamMesh->state = WORLD_STREAM_PENDING;
+		numPending++;
+	}
+
+	PL_DELETE( requests );
+}
+
+/**
+ * Finishes off the meshes the loader is done with, until we're out of
+ * time for this tick, though always at least one so we don't stall.
+ */
+static void FinaliseLoadedMeshes( YNCoreWorld *world )
+{
+	/* print out anything the loader had to say about what it's done */
+	Console_FlushDeferredOutput();
+
+	double endTime = PlGetCurrentSeconds() + ( streamFinaliseTime != NULL ? streamFinaliseTime->f_value : 4.0 ) / 1000.0;
+	for ( unsigned int i = 0; i < world->numStreamMeshes; ++i )
+	{
+		YNCoreWorldStreamMesh *streamMesh = &world->streamMeshes[ i ];
+		if ( streamMesh->state != WORLD_STREAM_PENDING || !IsLoadJobDone( streamMesh->job ) )
+			continue;
+
+		YNNodeBranch *node = TakeLoadJobResult( streamMesh->job );
+		streamMesh->job    = NULL;
+
+		/* in case it was loaded elsewhere in the meantime */
+		YNCoreWorldMesh *mesh = YnCore_WorldMesh_GetCached( streamMesh->path );
+		if ( mesh == NULL && node != NULL )
+			mesh = YnCore_WorldMesh_LoadFromNode( streamMesh->path, node );
+
+		if ( node != NULL )
+			YnNode_DestroyBranch( node );
+
+		AttachStreamedMesh( world, i, mesh );
+
+		if ( PlGetCurrentSeconds() >= endTime )
+			break;
+	}
+}
+
+/**
+ * Drops whichever meshes haven't been needed for the
+ * longest, until we're back within the budget.
+ */
+static void EvictUnneededMeshes( YNCoreWorld *world )
+{
+	size_t budget = ( size_t ) ( streamBudget != NULL ? streamBudget->i_value : 256 ) * 1024 * 1024;
+	while ( world->streamStats.residentBytes > budget )
+	{
+		int oldest = -1;
+		for ( unsigned int i = 0; i < world->numStreamMeshes; ++i )
+		{
+			const YNCoreWorldStreamMesh *streamMesh = &world->streamMeshes[ i ];
+			if ( streamMesh->state != WORLD_STREAM_LOADED || streamMesh->lastNeededTick == world->streamTick )
+				continue;
+
+			if ( oldest == -1 || streamMesh->lastNeededTick < world->streamMeshes[ oldest ].lastNeededTick )
+				oldest = ( int ) i;
+		}
+
+		/* everything that's loaded is still needed */
+		if ( oldest == -1 )
+			break;
+
+		EvictStreamedMesh( world, oldest );
+	}
+}
+
+/**
+ * Loads in the meshes for the sectors around the given origin,
+ * and drops those further away if we're over budget.
+ */
+void YnCore_World_UpdateStreaming( YNCoreWorld *world, const PLVector3 *origin )
+{
+	if ( world == NULL || !world->isStreamed )
+		return;
+
+	world->streamTick++;
+
+	float radius = ( streamRadius != NULL ) ? streamRadius->f_value : 4096.0f;
+	for ( unsigned int i = 0; i < world->numSectors; ++i )
+	{
+		const YNCoreWorldSector *sector = &world->sectors[ i ];
+
+		float distance = GetDistanceToBounds( &sector->bounds, origin );
+		if ( distance > radius )
+			continue;
+
+		MarkNeeded( world, sector->meshIndex, distance );
+		for ( unsigned int j = 0; j < sector->numStaticObjects; ++j )
+			MarkNeeded( world, sector->staticObjects[ j ].meshIndex, distance );
+	}
+
+	FinaliseLoadedMeshes( world );
+	RequestNeededMeshes( world );
+	EvictUnneededMeshes( world );
+}
+
+void YnCore_World_DestroyStreaming( YNCoreWorld *world )
+{
+	if ( !world->isStreamed )
+		return;
+
+	for ( unsigned int i = 0; i < world->numStreamMeshes; ++i )
+	{
+		YNCoreWorldStreamMesh *streamMesh = &world->streamMeshes[ i ];
+		if ( streamMesh->state == WORLD_STREAM_PENDING )
+			CancelLoadJob( streamMesh->job );
+		else if ( streamMesh->state == WORLD_STREAM_LOADED )
+			EvictStreamedMesh( world, i );
+	}
+
+	PL_DELETE( world->streamMeshes );
+	world->streamMeshes    = NULL;
+	world->numStreamMeshes = 0;
+	world->isStreamed      = false;
+}
+
+/****************************************
+ * TEST
+ ****************************************/
+
+#define WORLD_STREAM_TEST_TICKS   600
+#define WORLD_STREAM_TEST_TICK_MS 16.0
+
+/**
+ * Loads the given world in the background while ticking, sweeping the
+ * stream origin across it once it's up, and reports the longest any one
+ * tick spent on the main thread, against loading it all up front.
+ */
+void YnCore_World_TestStreamingCommand( unsigned int argc, char **argv )
+{
+	if ( argc < 2 )
+	{
+		PRINT_WARNING( "Please specify a world to load!\n" );
+		return;
+	}
+
+	unsigned int numTicks = WORLD_STREAM_TEST_TICKS;
+	if ( argc > 2 )
+	{
+		numTicks = strtoul( argv[ 2 ], NULL, 10 );
+		if ( numTicks == 0 )
+			numTicks = WORLD_STREAM_TEST_TICKS;
+	}
+
+	PLPath path;
+	snprintf( path, sizeof( path ), "worlds/%s/%s." YN_CORE_WORLD_EXTENSION, argv[ 1 ], argv[ 1 ] );
+
+	YNCoreWorldLoadJob *job = YnCore_World_BeginLoad( path );
+	if ( job == NULL )
+		return;
+
+	YNCoreWorld *world      = NULL;
+	unsigned int loadedTick = 0;
+	PLVector3    mins = pl_vecOrigin3, maxs = pl_vecOrigin3;
+	double       worstStall = 0.0, totalStall = 0.0;
+	for ( unsigned int i = 0; i < numTicks; ++i )
+	{
+		double startTime = PlGetCurrentSeconds();
+		if ( world == NULL )
+		{
+			if ( YnCore_World_IsLoadFinished( job ) )
+			{
+				world = YnCore_World_FinishLoad( job );
+				job   = NULL;
+				if ( world == NULL )
+					return;
+
+				loadedTick = i;
+				mins       = PLVector3( world->sectorGrid.mins[ 0 ], world->sectorGrid.mins[ 1 ], world->sectorGrid.mins[ 2 ] );
+				maxs       = PLVector3( world->sectorGrid.maxs[ 0 ], world->sectorGrid.maxs[ 1 ], world->sectorGrid.maxs[ 2 ] );
+			}
+		}
+		else
+		{
+			float     t      = ( float ) ( i - loadedTick ) / ( float ) ( numTicks - loadedTick );
+			PLVector3 origin = PlAddVector3( mins, PlScaleVector3F( PlSubtractVector3( maxs, mins ), t ) );
+			YnCore_World_UpdateStreaming( world, &origin );
+		}
+
+		double stall = ( PlGetCurrentSeconds() - startTime ) * 1000.0;
+		totalStall += stall;
+		if ( stall > worstStall )
+			worstStall = stall;
+
+		if ( stall < WORLD_STREAM_TEST_TICK_MS )
+			SDL_Delay( ( Uint32 ) ( WORLD_STREAM_TEST_TICK_MS - stall ) );
+	}
+
+	if ( world == NULL )
+	{
+		PRINT_WARNING( "World didn't finish loading within %u ticks!\n", numTicks );
+		YnCore_World_CancelLoad( job );
+		return;
+	}
+
+	PRINT( "Streamed %s, loaded on tick %u of %u\n", path, loadedTick, numTicks );
+	PRINT( "Longest main thread stall: %.3fms (average %.3fms)\n", worstStall, totalStall / numTicks );
+	PRINT( "Meshes: %u/%u loaded, %u evicted, %.2fMB peak\n",
+	       world->streamStats.numLoads, world->numStreamMeshes, world->streamStats.numEvictions,
+	       world->streamStats.peakResidentBytes / ( 1024.0 * 1024.0 ) );
+
+	YnCore_World_Destroy( world );
+	MemoryManager_FlushUnreferencedResources();
+
+	double startTime = PlGetCurrentSeconds();
+	world            = YnCore_World_Load( path );
+	PRINT( "Loading it up front stalls for %.3fms\n", ( PlGetCurrentSeconds() - startTime ) * 1000.0 );
+
+	YnCore_World_Destroy( world );
+	MemoryManager_FlushUnreferencedResources();
+}
@@ -0,0 +1,566 @@
+// SPDX-License-Identifier: LGPL-3.0-or-later
+// Copyright © 2020-2023 OldTimes Software, Mark E Sowden <hogsy@oldtimes-software.com>
+
+#include <math.h>
+
+#include "core_private.h"
+#include "game_interface.h"
+#include "world.h"
+
+#include "client/renderer/renderer.h"
+
+/* Which sectors can be seen from where is worked out in two steps. The
+ * potentially visible set for each sector is computed offline by following
+ * the portals out of it (see common_pvs.c) and stored with the world. At
+ * runtime, the portals leading out of the camera's sector are then clipped
+ * against the view, and each one that's still visible narrows the view
+ * down further for the sector beyond it. */
+
+#define WORLD_MAX_PORTAL_DEPTH 32
+
+static PLVector3 GetSectorCentre( const YNCoreWorldSector *sector )
+{
+	const PLCollisionAABB *bounds = &sector->bounds;
+	return PLVector3( bounds->origin.x + ( bounds->mins.x + bounds->maxs.x ) * 0.5f,
+	                  bounds->origin.y + ( bounds->mins.y + bounds->maxs.y ) * 0.5f,
+	                  bounds->origin.z + ( bounds->mins.z + bounds->maxs.z ) * 0.5f );
+}
+
+static unsigned int GetPortalPoints( const YNCoreWorldMesh *mesh, const YNCoreWorldFace *face, PLVector3 *points )
+{
+	for ( unsigned int i = 0; i < face->numVertices; ++i )
+		points[ i ] = mesh->vertices[ face->vertices[ i ] ].position;
+
+	return face->numVertices;
+}
+
+/**
+ * Works out the plane for a portal, facing into the sector it leads to.
+ * The face normals can't be relied on for this, since there's nothing
+ * saying which way round a portal face has been built.
+ */
+static bool GetPortalPlane( const YNCoreWorldSector *sector, const YNCoreWorldFace *face, const PLVector3 *points, unsigned int numPoints, CommonPVSPlane *plane )
+{
+	PLVector3 normal = pl_vecOrigin3;
+	PLVector3 centre = pl_vecOrigin3;
+	for ( unsigned int i = 0; i < numPoints; ++i )
+	{
+		const PLVector3 *a = &points[ i ];
+		const PLVector3 *b = &points[ ( i + 1 ) % numPoints ];
+		normal.x += ( a->y - b->y ) * ( a->z + b->z );
+		normal.y += ( a->z - b->z ) * ( a->x + b->x );
+		normal.z += ( a->x - b->x ) * ( a->y + b->y );
+		centre = PlAddVector3( centre, *a );
+	}
+
+	if ( PlVector3Length( normal ) < 1e-6f )
+		return false;
+
+	plane->normal   = PlNormalizeVector3( normal );
+	centre          = PlScaleVector3F( centre, 1.0f / ( float ) numPoints );
+	plane->distance = PlVector3DotProduct( plane->normal, centre );
+
+	/* prefer the side this sector's on, and fall back to the other */
+	PLVector3 from = GetSectorCentre( sector );
+	float     d    = PlVector3DotProduct( plane->normal, from ) - plane->distance;
+	if ( fabsf( d ) < CMN_PVS_EPSILON )
+	{
+		PLVector3 to = GetSectorCentre( face->targetSector );
+		d            = -( PlVector3DotProduct( plane->normal, to ) - plane->distance );
+	}
+
+	if ( d > 0.0f )
+	{
+		plane->normal   = PlInverseVector3( plane->normal );
+		plane->distance = -plane->distance;
+	}
+
+	return true;
+}
+
+static bool IsPortalOpen( const YNCoreWorldMesh *mesh, unsigned int faceIndex )
+{
+	const YNCoreWorldFace *face = mesh->faceTable[ faceIndex ];
+	return ( mesh->faceFlags[ faceIndex ] & WORLD_FACE_FLAG_PORTAL ) && face->targetSector != NULL && !face->isPortalClosed;
+}
+
+void YnCore_World_DestroyVisibility( YNCoreWorld *world )
+{
+	Common_PVS_Destroy( &world->sectorVisibility );
+
+	PL_DELETE( world->visibleSectorBits );
+	world->visibleSectorBits = NULL;
+	PL_DELETE( world->visibleSectors );
+	world->visibleSectors = NULL;
+}
+
+/****************************************
+ * OFFLINE
+ ****************************************/
+
+/**
+ * Computes the potentially visible set for every sector in the world,
+ * from its portals. Closed portals are still counted, given they can
+ * be opened after the fact.
+ */
+bool YnCore_World_ComputeVisibility( YNCoreWorld *world )
+{
+	if ( world->numSectors == 0 )
+		return false;
+
+	/* needs every sector's portals, which we won't have */
+	if ( world->isStreamed )
+	{
+		PRINT_WARNING( "Can't compute visibility for a streamed world, load it up front instead!\n" );
+		return false;
+	}
+
+	unsigned int numPortals = 0, numPoints = 0;
+	for ( unsigned int i = 0; i < world->numSectors; ++i )
+	{
+		const YNCoreWorldMesh *mesh = world->sectors[ i ].mesh;
+		if ( mesh == NULL )
+			continue;
+
+		for ( unsigned int j = 0; j < mesh->numFaces; ++j )
+		{
+			if ( !( mesh->faceFlags[ j ] & WORLD_FACE_FLAG_PORTAL ) || mesh->faceTable[ j ]->targetSector == NULL )
+				continue;
+
+			/* if there's no face on the other side, we'll need to go back through this one */
+			numPortals += ( mesh->faceTable[ j ]->targetSectorFace == NULL ) ? 2 : 1;
+			numPoints += mesh->faceTable[ j ]->numVertices;
+		}
+	}
+
+	CommonPVSPortal *portals = PL_NEW_( CommonPVSPortal, numPortals + 1 );
+	PLVector3       *points  = PL_NEW_( PLVector3, numPoints + 1 );
+
+	unsigned int portalIndex = 0;
+	PLVector3   *point       = points;
+	for ( unsigned int i = 0; i < world->numSectors; ++i )
+	{
+		const YNCoreWorldSector *sector = &world->sectors[ i ];
+		const YNCoreWorldMesh   *mesh   = sector->mesh;
+		if ( mesh == NULL )
+			continue;
+
+		for ( unsigned int j = 0; j < mesh->numFaces; ++j )
+		{
+			const YNCoreWorldFace *face = mesh->faceTable[ j ];
+			if ( !( mesh->faceFlags[ j ] & WORLD_FACE_FLAG_PORTAL ) || face->targetSector == NULL )
+				continue;
+
+			unsigned int   numFacePoints = GetPortalPoints( mesh, face, point );
+			CommonPVSPlane plane;
+			if ( !GetPortalPlane( sector, face, point, numFacePoints, &plane ) )
+			{
+				PRINT_WARNING( "Skipping degenerate portal in sector %u!\n", i );
+				continue;
+			}
+
+			CommonPVSPortal *portal = &portals[ portalIndex++ ];
+			portal->points          = point;
+			portal->numPoints       = numFacePoints;
+			portal->normal          = plane.normal;
+			portal->from            = i;
+			portal->to              = ( uint32_t ) ( face->targetSector - world->sectors );
+
+			if ( face->targetSectorFace == NULL )
+			{
+				CommonPVSPortal *back = &portals[ portalIndex++ ];
+				*back                 = *portal;
+				back->normal          = PlInverseVector3( plane.normal );
+				back->from            = portal->to;
+				back->to              = portal->from;
+			}
+
+			point += numFacePoints;
+		}
+	}
+
+	Common_PVS_Destroy( &world->sectorVisibility );
+
+	double startTime = PlGetCurrentSeconds();
+	bool   status    = Common_PVS_Compute( &world->sectorVisibility, portals, portalIndex, world->numSectors );
+	if ( status )
+	{
+		unsigned int numVisible = 0;
+		for ( unsigned int i = 0; i < world->numSectors; ++i )
+			numVisible += Common_PVS_GetNumVisible( &world->sectorVisibility, i );
+
+		PRINT( "Computed visibility for %u sectors through %u portals in %.2fms (%.1f visible on average)\n",
+		       world->numSectors, portalIndex, ( PlGetCurrentSeconds() - startTime ) * 1000.0,
+		       ( float ) numVisible / ( float ) world->numSectors );
+
+		world->isDirty = true;
+	}
+	else
+		PRINT_WARNING( "Failed to compute visibility for world!\n" );
+
+	PL_DELETE( points );
+	PL_DELETE( portals );
+
+	return status;
+}
+
+/**
+ * Computes visibility for the current world, and
+ * optionally saves it out to the given path.
+ */
+void YnCore_World_ComputeVisibilityCommand( unsigned int argc, char **argv )
+{
+	YNCoreWorld *world = Game_GetCurrentWorld();
+	if ( world == NULL )
+	{
+		PRINT_WARNING( "No world loaded!\n" );
+		return;
+	}
+
+	if ( !YnCore_World_ComputeVisibility( world ) )
+		return;
+
+	if ( argc > 1 )
+		YnCore_World_Save( world, argv[ 1 ] );
+}
+
+/****************************************
+ * RUNTIME
+ ****************************************/
+
+typedef struct PortalFlow
+{
+	YNCoreWorld        *world;
+	const YNCoreCamera *camera;
+	PLVector3           eye;
+	const uint32_t     *potentiallyVisible;
+
+	const YNCoreWorldSector *path[ WORLD_MAX_PORTAL_DEPTH ];
+	CommonPVSPlane           frustums[ WORLD_MAX_PORTAL_DEPTH ][ CMN_PVS_MAX_WINDING_POINTS ];
+
+	YNCoreWorldSector **sectors;
+	unsigned int        numSectors;
+} PortalFlow;
+
+static void AddVisibleSector( PortalFlow *flow, YNCoreWorldSector *sector )
+{
+	unsigned int index = sector - flow->world->sectors;
+	uint32_t    *word  = &flow->world->visibleSectorBits[ index / 32 ];
+	if ( *word & ( 1U << ( index % 32 ) ) )
+		return;
+
+	*word |= ( 1U << ( index % 32 ) );
+	flow->sectors[ flow->numSectors++ ] = sector;
+}
+
+/**
+ * Builds planes from the eye through each edge of the winding,
+ * facing inwards, so anything outside of them can't be seen
+ * through it.
+ */
+static unsigned int SetupPortalFrustum( const PortalFlow *flow, const CommonPVSWinding *winding, CommonPVSPlane *planes )
+{
+	PLVector3 centre = pl_vecOrigin3;
+	for ( unsigned int i = 0; i < winding->numPoints; ++i )
+		centre = PlAddVector3( centre, winding->points[ i ] );
+	centre = PlScaleVector3F( centre, 1.0f / ( float ) winding->numPoints );
+
+	unsigned int numPlanes = 0;
+	for ( unsigned int i = 0; i < winding->numPoints; ++i )
+	{
+		CommonPVSPlane *plane = &planes[ numPlanes ];
+		if ( !Common_PVS_MakePlane( plane, &flow->eye, &winding->points[ i ], &winding->points[ ( i + 1 ) % winding->numPoints ] ) )
+			continue;
+
+		float d = PlVector3DotProduct( plane->normal, centre ) - plane->distance;
+		if ( fabsf( d ) < CMN_PVS_EPSILON )
+			continue;
+
+		if ( d < 0.0f )
+		{
+			plane->normal   = PlInverseVector3( plane->normal );
+			plane->distance = -plane->distance;
+		}
+
+		numPlanes++;
+	}
+
+	return numPlanes;
+}
+
+static void FlowThroughSector( PortalFlow *flow, YNCoreWorldSector *sector, const CommonPVSPlane *frustum, unsigned int numPlanes, unsigned int depth )
+{
+	const YNCoreWorldMesh *mesh = sector->mesh;
+	if ( mesh == NULL || depth >= WORLD_MAX_PORTAL_DEPTH )
+		return;
+
+	flow->path[ depth ] = sector;
+
+	for ( unsigned int i = 0; i < mesh->numFaces; ++i )
+	{
+		if ( !IsPortalOpen( mesh, i ) )
+			continue;
+
+		YNCoreWorldFace   *face   = mesh->faceTable[ i ];
+		YNCoreWorldSector *target = face->targetSector;
+		if ( flow->potentiallyVisible != NULL )
+		{
+			unsigned int index = target - flow->world->sectors;
+			if ( !( flow->potentiallyVisible[ index / 32 ] & ( 1U << ( index % 32 ) ) ) )
+				continue;
+		}
+
+		bool onPath = false;
+		for ( unsigned int j = 0; j <= depth && !onPath; ++j )
+			onPath = ( flow->path[ j ] == target );
+		if ( onPath )
+			continue;
+
+		if ( !PlgIsBoxInsideView( flow->camera->internal, &mesh->faceBounds[ i ] ) )
+			continue;
+
+		CommonPVSWinding winding;
+		winding.numPoints = GetPortalPoints( mesh, face, winding.points );
+
+		CommonPVSPlane plane;
+		if ( !GetPortalPlane( sector, face, winding.points, winding.numPoints, &plane ) )
+			continue;
+
+		/* can't see through it from behind */
+		float eyeDistance = PlVector3DotProduct( plane.normal, flow->eye ) - plane.distance;
+		if ( eyeDistance > CMN_PVS_EPSILON )
+			continue;
+
+		bool isVisible = true;
+		for ( unsigned int j = 0; j < numPlanes && isVisible; ++j )
+			isVisible = Common_PVS_ClipWinding( &winding, &frustum[ j ] );
+		if ( !isVisible )
+			continue;
+
+		AddVisibleSector( flow, target );
+
+		/* if we're stood in the doorway, there's no narrowing it down */
+		if ( eyeDistance > -1.0f )
+		{
+			FlowThroughSector( flow, target, frustum, numPlanes, depth + 1 );
+			continue;
+		}
+
+		CommonPVSPlane *nextFrustum   = flow->frustums[ depth ];
+		unsigned int    numNextPlanes = SetupPortalFrustum( flow, &winding, nextFrustum );
+		FlowThroughSector( flow, target, nextFrustum, numNextPlanes, depth + 1 );
+	}
+}
+
+/**
+ * Returns the sectors that can be seen from the camera, starting with
+ * the one it's in. The array belongs to the world, and is only valid
+ * until this is next called.
+ */
+YNCoreWorldSector **YnCore_World_GetVisibleSectors( YNCoreWorld *world, YNCoreWorldSector *originSector, const YNCoreCamera *camera, unsigned int *numSectors )
+{
+	*numSectors = 0;
+	if ( originSector == NULL || world->numSectors == 0 )
+		return NULL;
+
+	PL_GET_CVAR( "world.drawSectors", drawSectors );
+	if ( drawSectors != NULL && !drawSectors->b_value )
+		return NULL;
+
+	if ( world->visibleSectors == NULL )
+	{
+		world->visibleSectors    = PL_NEW_( YNCoreWorldSector *, world->numSectors );
+		world->visibleSectorBits = PL_NEW_( uint32_t, CMN_PVS_NUM_WORDS( world->numSectors ) );
+	}
+
+	memset( world->visibleSectorBits, 0, sizeof( uint32_t ) * CMN_PVS_NUM_WORDS( world->numSectors ) );
+
+	/* the frustums take up a fair bit of room, so keep them off the stack */
+	static PortalFlow flow;
+	flow.world              = world;
+	flow.camera             = camera;
+	flow.eye                = camera->internal->position;
+	flow.potentiallyVisible = Common_PVS_GetRow( &world->sectorVisibility, originSector - world->sectors );
+	flow.sectors            = world->visibleSectors;
+	flow.numSectors         = 0;
+
+	/* we'll assume the sector we're in is visible (seems like a safe assumption) */
+	AddVisibleSector( &flow, originSector );
+	FlowThroughSector( &flow, originSector, NULL, 0, 0 );
+
+	*numSectors = flow.numSectors;
+	return flow.sectors;
+}
+
+/****************************************
+ * VERIFICATION
+ ****************************************/
+
+#define WORLD_VERIFY_DEFAULT_SAMPLES 64
+#define WORLD_VERIFY_MAX_ATTEMPTS    32
+
+static float RandomRange( float min, float max )
+{
+	return min + ( ( float ) rand() / ( float ) RAND_MAX ) * ( max - min );
+}
+
+/**
+ * Picks a random point that actually falls within the sector,
+ * rather than one of the sectors overlapping it.
+ */
+static bool GetRandomPointInSector( YNCoreWorld *world, YNCoreWorldSector *sector, PLVector3 *point )
+{
+	PLVector3 mins = PlAddVector3( sector->bounds.origin, sector->bounds.mins );
+	PLVector3 maxs = PlAddVector3( sector->bounds.origin, sector->bounds.maxs );
+	for ( unsigned int i = 0; i < WORLD_VERIFY_MAX_ATTEMPTS; ++i )
+	{
+		*point = PLVector3( RandomRange( mins.x, maxs.x ), RandomRange( mins.y, maxs.y ), RandomRange( mins.z, maxs.z ) );
+		if ( YnCore_World_GetSectorByGlobalOrigin( world, point ) == sector )
+			return true;
+	}
+
+	return false;
+}
+
+static bool IntersectTriangle( const PLVector3 *start, const PLVector3 *direction, const PLVector3 *a, const PLVector3 *b, const PLVector3 *c )
+{
+	PLVector3 edge0 = PlSubtractVector3( *b, *a );
+	PLVector3 edge1 = PlSubtractVector3( *c, *a );
+	PLVector3 p     = PlVector3CrossProduct( *direction, edge1 );
+
+	float det = PlVector3DotProduct( edge0, p );
+	if ( fabsf( det ) < 1e-8f )
+		return false;
+
+	float     invDet = 1.0f / det;
+	PLVector3 s      = PlSubtractVector3( *start, *a );
+	float     u      = PlVector3DotProduct( s, p ) * invDet;
+	if ( u < 0.0f || u > 1.0f )
+		return false;
+
+	PLVector3 q = PlVector3CrossProduct( s, edge0 );
+	float     v = PlVector3DotProduct( *direction, q ) * invDet;
+	if ( v < 0.0f || u + v > 1.0f )
+		return false;
+
+	float t = PlVector3DotProduct( edge1, q ) * invDet;
+	return ( t > 0.0f && t < 1.0f );
+}
+
+/**
+ * Checks whether anything other than an open portal lies
+ * between the two points.
+ */
+static bool IsSegmentBlocked( YNCoreWorld *world, const PLVector3 *start, const PLVector3 *end, uint32_t *faceIndices )
+{
+	PLVector3 direction = PlSubtractVector3( *end, *start );
+	for ( unsigned int i = 0; i < world->numSectors; ++i )
+	{
+		YNCoreWorldMesh *mesh = world->sectors[ i ].mesh;
+		if ( mesh == NULL || mesh->faceTree.numNodes == 0 )
+			continue;
+
+		unsigned int numFaces = Common_BVH_QueryRay( &mesh->faceTree, start, &direction, 1.0f, faceIndices, mesh->numFaces );
+		for ( unsigned int j = 0; j < numFaces; ++j )
+		{
+			unsigned int faceIndex = faceIndices[ j ];
+			if ( IsPortalOpen( mesh, faceIndex ) )
+				continue;
+
+			const YNCoreWorldFace *face = mesh->faceTable[ faceIndex ];
+			for ( unsigned int k = 1; k + 1 < face->numVertices; ++k )
+			{
+				if ( IntersectTriangle( start, &direction,
+				                        &mesh->vertices[ face->vertices[ 0 ] ].position,
+				                        &mesh->vertices[ face->vertices[ k ] ].position,
+				                        &mesh->vertices[ face->vertices[ k + 1 ] ].position ) )
+					return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+/**
+ * Casts rays between random points in every pair of sectors, and checks
+ * that any pair with a clear line between them is in the visible set.
+ */
+void YnCore_World_VerifyVisibilityCommand( unsigned int argc, char **argv )
+{
+	YNCoreWorld *world = Game_GetCurrentWorld();
+	if ( world == NULL )
+	{
+		PRINT_WARNING( "No world loaded!\n" );
+		return;
+	}
+
+	if ( world->sectorVisibility.numClusters != world->numSectors )
+	{
+		PRINT_WARNING( "World has no visibility data, run world.computeVisibility first!\n" );
+		return;
+	}
+
+	unsigned int numSamples = WORLD_VERIFY_DEFAULT_SAMPLES;
+	if ( argc > 1 )
+	{
+		numSamples = strtoul( argv[ 1 ], NULL, 10 );
+		if ( numSamples == 0 )
+		{
+			PRINT_WARNING( "Invalid number of samples specified!\n" );
+			return;
+		}
+	}
+
+	/* enough for a query against any one of the sectors */
+	unsigned int maxFaces = 1;
+	for ( unsigned int i = 0; i < world->numSectors; ++i )
+	{
+		if ( world->sectors[ i ].mesh != NULL && world->sectors[ i ].mesh->numFaces > maxFaces )
+			maxFaces = world->sectors[ i ].mesh->numFaces;
+	}
+
+	uint32_t *faceIndices = PL_NEW_( uint32_t, maxFaces );
+
+	srand( 0 );
+
+	unsigned int numMissing = 0, numRayVisible = 0, numPotentiallyVisible = 0;
+	for ( unsigned int i = 0; i < world->numSectors; ++i )
+	{
+		numPotentiallyVisible += Common_PVS_GetNumVisible( &world->sectorVisibility, i );
+		for ( unsigned int j = 0; j < world->numSectors; ++j )
+		{
+			if ( i == j )
+			{
+				numRayVisible++;
+				continue;
+			}
+
+			for ( unsigned int k = 0; k < numSamples; ++k )
+			{
+				PLVector3 start, end;
+				if ( !GetRandomPointInSector( world, &world->sectors[ i ], &start ) ||
+				     !GetRandomPointInSector( world, &world->sectors[ j ], &end ) )
+					break;
+
+				if ( IsSegmentBlocked( world, &start, &end, faceIndices ) )
+					continue;
+
+				numRayVisible++;
+				if ( !Common_PVS_IsVisible( &world->sectorVisibility, i, j ) )
+				{
+					PRINT_WARNING( "Sector %u can see sector %u, but it's not in the visible set!\n", i, j );
+					numMissing++;
+				}
+				break;
+			}
+		}
+	}
+
+	PL_DELETE( faceIndices );
+
+	PRINT( "Verified visibility for %u sectors with %u samples per pair:\n", world->numSectors, numSamples );
+	PRINT( "  ray visible:         %u\n", numRayVisible );
+	PRINT( "  potentially visible: %u\n", numPotentiallyVisible );
+	PRINT( "  missing:             %u\n", numMissing );
+}
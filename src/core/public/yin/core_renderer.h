@@ -8,6 +8,8 @@
 typedef struct YNCoreCamera YNCoreCamera;
 typedef struct YNCoreViewport YNCoreViewport;
 typedef struct YNCoreLight YNCoreLight;
+
+#define YN_CORE_MAX_LIGHTS_PER_PASS 8
 typedef struct YNCoreTexture YNCoreTexture;
 typedef struct YNCoreMaterial YNCoreMaterial;
 
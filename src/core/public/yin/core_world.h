@@ -32,6 +32,17 @@ typedef struct YNCoreWorld YNCoreWorld;
 YNCoreWorld *YnCore_World_Create( void );
 YNCoreWorld *YnCore_World_Load( const char *path );
 
+/**
+ * Loads the world in the background instead, only the final step
+ * has to happen on the main thread. The meshes for the world are then
+ * streamed in and out as needed, see YnCore_World_UpdateStreaming.
+ */
+typedef struct YNCoreWorldLoadJob YNCoreWorldLoadJob;
+YNCoreWorldLoadJob *YnCore_World_BeginLoad( const char *path );
+bool YnCore_World_IsLoadFinished( const YNCoreWorldLoadJob *job );
+YNCoreWorld *YnCore_World_FinishLoad( YNCoreWorldLoadJob *job );
+void YnCore_World_CancelLoad( YNCoreWorldLoadJob *job );
+
 /**
  * Attempts to save the given world to the destination.
  * On success, returns true but false otherwise.
@@ -58,6 +69,14 @@ const char *YnCore_World_GetPath( const YNCoreWorld *world );
 YNCoreWorldMesh *YnCore_WorldMesh_Create( YNCoreWorld *parent );
 YNCoreWorldMesh *YnCore_WorldMesh_Load( const char *path );
 void YnCore_WorldMesh_Release( YNCoreWorldMesh *worldMesh );
+void YnCore_WorldMesh_Rebuild( YNCoreWorldMesh *worldMesh );
+
+/* each of these writes out up to maxFaces faces whose bounds pass, and returns how many it wrote;
+ * faceIndices is the caller's scratch, and needs room for maxFaces too */
+unsigned int YnCore_WorldMesh_GetFacesInView( const YNCoreWorldMesh *mesh, const YNCoreCamera *camera, YNCoreWorldFace **faces, uint32_t *faceIndices, unsigned int maxFaces );
+unsigned int YnCore_WorldMesh_GetFacesInBounds( const YNCoreWorldMesh *mesh, const PLCollisionAABB *bounds, YNCoreWorldFace **faces, uint32_t *faceIndices, unsigned int maxFaces );
+unsigned int YnCore_WorldMesh_GetFacesInSphere( const YNCoreWorldMesh *mesh, const PLVector3 *origin, float radius, YNCoreWorldFace **faces, uint32_t *faceIndices, unsigned int maxFaces );
+unsigned int YnCore_WorldMesh_GetFacesAlongRay( const YNCoreWorldMesh *mesh, const PLVector3 *origin, const PLVector3 *direction, float distance, YNCoreWorldFace **faces, uint32_t *faceIndices, unsigned int maxFaces );
 
 /* Face */
 
@@ -68,8 +87,9 @@ const PLCollisionAABB *YnCore_WorldFace_GetBounds( const YNCoreWorldFace *face )
 
 /* Sector */
 
-struct YNCoreLight *YnCore_WorldSector_GetVisibleLights( YNCoreWorldSector *sector, unsigned int *numLights );
+struct YNCoreLight *YnCore_WorldSector_GetVisibleLights( YNCoreWorld *world, YNCoreWorldSector *sector, YNCoreCamera *camera, unsigned int *numLights );
 YNCoreWorldMesh *YnCore_WorldSector_GetMesh( YNCoreWorldSector *sector );
-YNCoreWorldFace **YnCore_WorldSector_GetMeshFaces( YNCoreWorldSector *sector, uint32_t *numFaces );
+YNCoreWorldFace *const *YnCore_WorldSector_GetMeshFaces( const YNCoreWorldSector *sector, uint32_t *numFaces );
+void YnCore_WorldSector_SetBounds( YNCoreWorld *world, YNCoreWorldSector *sector, const PLCollisionAABB *bounds );
 
 PL_EXTERN_C_END
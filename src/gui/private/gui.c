@@ -129,6 +129,9 @@ void GUI_Initialize( void )
 {
 	PL_ZERO_( guiState );
 
+	guiState.cacheEnabled = true;
+	PlRegisterConsoleVariable( "gui.cache", "Only draw the GUI, and any cached panels in it, again when something in them has changed.", "1", PL_VAR_BOOL, &guiState.cacheEnabled, NULL, false );
+
 	guiLogLevels[ GUI_LOGLEVEL_DEFAULT ] = PlAddLogLevel( "gui", PL_COLOUR_LIGHT_CORAL, true );
 	guiLogLevels[ GUI_LOGLEVEL_WARNING ] = PlAddLogLevel( "gui/warning", PL_COLOUR_YELLOW, true );
 	guiLogLevels[ GUI_LOGLEVEL_ERROR ] = PlAddLogLevel( "gui/error", PL_COLOUR_DARK_RED, true );
@@ -4,6 +4,7 @@
 #include <plcore/pl_console.h>
 
 #include "gui_private.h"
+#include "gui_panel.h"
 
 /****************************************
  * GUI DRAW API
@@ -27,6 +28,11 @@ typedef struct GUICanvas
 	bool            filter;
 	int             width;
 	int             height;
+
+	PLLinkedList *batches;// queued up to be drawn into the canvas
+
+	const GUIPanel *panel;  // what was last drawn into it
+	bool            isValid;// false if it needs to be drawn again, regardless of the panel
 } GUICanvas;
 
 GUICanvas *GUI_CreateCanvas( int width, int height )
@@ -36,15 +42,21 @@ GUICanvas *GUI_CreateCanvas( int width, int height )
 	canvas->height    = height;
 	canvas->buffer    = PlgCreateFrameBuffer( canvas->width, canvas->height, PLG_BUFFER_COLOUR | PLG_BUFFER_DEPTH );
 	canvas->texture   = PlgGetFrameBufferTextureAttachment( canvas->buffer, PLG_BUFFER_COLOUR, PLG_TEXTURE_FILTER_LINEAR );
+	canvas->batches   = PlCreateLinkedList();
 	return canvas;
 }
 
+static void CleanupBatchQueue( GUICanvas *canvas, bool destroyAll );
+
 void GUI_DestroyCanvas( GUICanvas *canvas )
 {
 	if ( canvas == NULL )
 	{
 		return;
 	}
+	CleanupBatchQueue( canvas, true );
+	PlDestroyLinkedList( canvas->batches );
+
 	PlgDestroyTexture( canvas->texture );
 	PlgDestroyFrameBuffer( canvas->buffer );
 	PL_DELETE( canvas );
@@ -57,6 +69,10 @@ void GUI_SetCanvasSize( GUICanvas *canvas, int width, int height )
 		return;
 	}
 
+	canvas->width   = width;
+	canvas->height  = height;
+	canvas->isValid = false;
+
 	PlgSetFrameBufferSize( canvas->buffer, canvas->width, canvas->height );
 	if ( canvas->texture != NULL )
 	{
@@ -87,14 +103,10 @@ PLGTexture *GUI_GetCanvasTexture( GUICanvas *canvas )
 
 static PLGCamera *camera;
 
-static PLLinkedList *batches;
-
-static bool hasBegun = false;
+static GUICanvas *currentCanvas;// the one batches are currently being queued up for
 
 void GUI_Draw_Initialize( void )
 {
-	batches = PlCreateLinkedList();
-
 	camera       = PlgCreateCamera();
 	camera->mode = PLG_CAMERA_MODE_ORTHOGRAPHIC;
 	camera->near = 0.0f;
@@ -107,7 +119,9 @@ void GUI_Draw_Shutdown( void )
 
 PLGMesh *GUI_Draw_GetBatchQueueMesh( PLGTexture *texture )
 {
-	PLLinkedListNode *node = PlGetFirstNode( batches );
+	assert( currentCanvas != NULL );
+
+	PLLinkedListNode *node = PlGetFirstNode( currentCanvas->batches );
 	while ( node != NULL )
 	{
 		GUIDrawBatch *drawBatch = PlGetLinkedListNodeUserData( node );
@@ -123,17 +137,17 @@ PLGMesh *GUI_Draw_GetBatchQueueMesh( PLGTexture *texture )
 	GUIDrawBatch *drawBatch = PL_NEW( GUIDrawBatch );
 	drawBatch->mesh         = PlgCreateMesh( PLG_MESH_TRIANGLES, PLG_DRAW_DYNAMIC, 256, 256 );
 	drawBatch->texture      = texture;
-	PlInsertLinkedListNode( batches, drawBatch );
+	PlInsertLinkedListNode( currentCanvas->batches, drawBatch );
 	return drawBatch->mesh;
 }
 
-static void CleanupBatchQueue( void )
+static void CleanupBatchQueue( GUICanvas *canvas, bool destroyAll )
 {
-	PLLinkedListNode *node = PlGetFirstNode( batches );
+	PLLinkedListNode *node = PlGetFirstNode( canvas->batches );
 	while ( node != NULL )
 	{
 		GUIDrawBatch *drawBatch = PlGetLinkedListNodeUserData( node );
-		if ( drawBatch->mesh->num_triangles == 0 )
+		if ( destroyAll || drawBatch->mesh->num_triangles == 0 )
 		{
 			PlgDestroyMesh( drawBatch->mesh );
 
@@ -148,40 +162,46 @@ static void CleanupBatchQueue( void )
 		PlgClearMesh( drawBatch->mesh );
 		node = PlGetNextLinkedListNode( node );
 	}
-
-	guiState.lastNumTriangles = guiState.numTriangles;
-	guiState.numTriangles     = 0;
-	guiState.lastNumBatches   = guiState.numBatches;
-	guiState.numBatches       = 0;
 }
 
-void GUI_Draw( GUICanvas *canvas, GUIPanel *root )
+/**
+ * Queues up the panel and everything beneath it, and then draws it all
+ * into the given canvas. Any cached panels come across along the way
+ * are brought up to date first.
+ */
+static void DrawPanelToCanvas( GUICanvas *canvas, GUIPanel *panel, int x, int y )
 {
+	GUICanvas *oldCanvas = currentCanvas;
+	currentCanvas        = canvas;
+
+	CleanupBatchQueue( canvas, false );
+
 	// save old state
 	int ox, oy, ow, oh;
 	PlgGetViewport( &ox, &oy, &ow, &oh );
 	PLMatrix4 oldViewMatrix = PlgGetViewMatrix();
 
-	PlgSetViewport( 0, 0, canvas->width, canvas->height );
+	PlMatrixMode( PL_MODELVIEW_MATRIX );
+	PlPushMatrix();
 
-	CleanupBatchQueue();
+	PlLoadIdentityMatrix();
 
-	PlgBindFrameBuffer( canvas->buffer, PLG_FRAMEBUFFER_DRAW );
+	GUI_Panel_DrawContents( panel );
 
-	PlgSetupCamera( camera );
-	PlgClearBuffers( PLG_BUFFER_COLOUR | PLG_BUFFER_DEPTH );
+	/* panels are positioned absolutely, so shift it back into the corner */
+	PlTranslateMatrix( PLVector3( ( float ) -x, ( float ) -y, 0.0f ) );
 
-	PlMatrixMode( PL_MODELVIEW_MATRIX );
-	PlPushMatrix();
+	PlgSetViewport( 0, 0, canvas->width, canvas->height );
 
-	PlLoadIdentityMatrix();
+	PlgBindFrameBuffer( canvas->buffer, PLG_FRAMEBUFFER_DRAW );
 
-	GUI_Panel_Draw( root );
+	PlgSetupCamera( camera );
+	PlgClearBuffers( PLG_BUFFER_COLOUR | PLG_BUFFER_DEPTH );
 
 	PLGShaderProgram *program = PlgGetCurrentShaderProgram();
 	PlgSetShaderUniformValue( program, "pl_model", PlGetMatrix( PL_MODELVIEW_MATRIX ), false );
 
-	PLLinkedListNode *node = PlGetFirstNode( batches );
+	PLLinkedListNode *node = PlGetFirstNode( canvas->batches );
 	while ( node != NULL )
 	{
 		GUIDrawBatch *drawBatch = PlGetLinkedListNodeUserData( node );
@@ -205,6 +225,79 @@ void GUI_Draw( GUICanvas *canvas, GUIPanel *root )
 	PlgSetViewMatrix( &oldViewMatrix );
 	PlgSetViewport( ox, oy, ow, oh );
 
+	canvas->panel   = panel;
+	canvas->isValid = true;
+	panel->isDirty  = false;
+
+	guiState.numCacheUpdates++;
+
+	currentCanvas = oldCanvas;
+}
+
+/**
+ * Draws the panel into its own canvas, if anything has changed since
+ * the last time, and then queues up the canvas in place of it.
+ */
+void GUI_Draw_CachedPanel( GUIPanel *panel )
+{
+	if ( panel->cache == NULL )
+		panel->cache = GUI_CreateCanvas( panel->w, panel->h );
+	else
+		GUI_SetCanvasSize( panel->cache, panel->w, panel->h );
+
+	int x, y;
+	GUI_Panel_GetAbsolutePosition( panel, &x, &y );
+
+	if ( panel->isDirty || !panel->cache->isValid )
+		DrawPanelToCanvas( panel->cache, panel, x, y );
+	else
+		guiState.numCacheHits++;
+
+	PLGMesh *mesh = GUI_Draw_GetBatchQueueMesh( panel->cache->texture );
+	GUI_Draw_CanvasRectangle( mesh, x, y, panel->w, panel->h, panel->z );
+}
+
+/**
+ * Returns what it took to draw the GUI the last time round.
+ */
+void GUI_GetDrawStats( GUIDrawStats *stats )
+{
+	stats->numBatches      = guiState.numBatches;
+	stats->numTriangles    = guiState.numTriangles;
+	stats->numCacheHits    = guiState.numCacheHits;
+	stats->numCacheUpdates = guiState.numCacheUpdates;
+}
+
+/**
+ * Switches caching of canvases on/off, returning whether it was enabled before.
+ */
+bool GUI_SetCaching( bool enable )
+{
+	bool wasEnabled       = guiState.cacheEnabled;
+	guiState.cacheEnabled = enable;
+	return wasEnabled;
+}
+
+void GUI_Draw( GUICanvas *canvas, GUIPanel *root )
+{
+	guiState.lastNumTriangles    = guiState.numTriangles;
+	guiState.numTriangles        = 0;
+	guiState.lastNumBatches      = guiState.numBatches;
+	guiState.numBatches          = 0;
+	guiState.lastNumCacheHits    = guiState.numCacheHits;
+	guiState.numCacheHits        = 0;
+	guiState.lastNumCacheUpdates = guiState.numCacheUpdates;
+	guiState.numCacheUpdates     = 0;
+
+	/* nothing's changed, so what was drawn last time still stands */
+	if ( guiState.cacheEnabled && canvas->isValid && canvas->panel == root && !root->isDirty )
+	{
+		guiState.numCacheHits++;
+		return;
+	}
+
+	DrawPanelToCanvas( canvas, root, 0, 0 );
+
 	//printf( "%d tris, %d batches\n", guiState.numTriangles, guiState.numBatches );
 }
 
@@ -239,3 +332,20 @@ void GUI_Draw_Quad( PLGMesh *mesh, GUIVector2 tl, GUIVector2 tr, GUIVector2 ll,
 	PlgAddMeshTriangle( mesh, vertices[ 0 ], vertices[ 1 ], vertices[ 2 ] );
 	PlgAddMeshTriangle( mesh, vertices[ 1 ], vertices[ 3 ], vertices[ 2 ] );
 }
+
+/**
+ * Textured rectangle showing the whole of a canvas.
+ */
+void GUI_Draw_CanvasRectangle( PLGMesh *mesh, int x, int y, int w, int h, int z )
+{
+	/* canvases are upside down */
+	unsigned int vertices[] = {
+	        PlgAddMeshVertex( mesh, PLVector3( x, y, z ), pl_vecOrigin3, PL_COLOUR_WHITE, PLVector2( 0.0f, 1.0f ) ),
+	        PlgAddMeshVertex( mesh, PLVector3( x, y + h, z ), pl_vecOrigin3, PL_COLOUR_WHITE, PLVector2( 0.0f, 0.0f ) ),
+	        PlgAddMeshVertex( mesh, PLVector3( x + w, y, z ), pl_vecOrigin3, PL_COLOUR_WHITE, PLVector2( 1.0f, 1.0f ) ),
+	        PlgAddMeshVertex( mesh, PLVector3( x + w, y + h, z ), pl_vecOrigin3, PL_COLOUR_WHITE, PLVector2( 1.0f, 0.0f ) ),
+	};
+
+	PlgAddMeshTriangle( mesh, vertices[ 0 ], vertices[ 1 ], vertices[ 2 ] );
+	PlgAddMeshTriangle( mesh, vertices[ 1 ], vertices[ 3 ], vertices[ 2 ] );
+}
@@ -93,6 +93,7 @@ GUIPanel *GUI_Panel_Create( GUIPanel *parent, int x, int y, int w, int h, GUIPan
 
 	self->isDrawing = true;
 	self->isVisible = true;
+	self->isDirty   = true;
 
 	if ( parent == NULL )
 		return self;
@@ -100,6 +101,8 @@ GUIPanel *GUI_Panel_Create( GUIPanel *parent, int x, int y, int w, int h, GUIPan
 	self->parent = parent;
 	self->node   = PlInsertLinkedListNode( parent->children, self );
 
+	GUI_Panel_MarkDirty( parent );
+
 	return self;
 }
 
@@ -114,17 +117,24 @@ void GUI_Panel_Destroy( GUIPanel *self )
 
 	/* be sure to remove us from the parent */
 	if ( self->parent != NULL )
+	{
+		GUI_Panel_MarkDirty( self->parent );
 		PlDestroyLinkedListNode( self->node );
+	}
 
 	/* and now cull all our children */
 	PLLinkedListNode *childNode = PlGetFirstNode( self->children );
 	while ( childNode != NULL )
 	{
+		/* the child takes its node with it */
+		PLLinkedListNode *nextNode = PlGetNextLinkedListNode( childNode );
 		GUI_Panel_Destroy( PlGetLinkedListNodeUserData( childNode ) );
-		childNode = PlGetNextLinkedListNode( childNode );
+		childNode = nextNode;
 	}
 	PlDestroyLinkedList( self->children );
 
+	GUI_DestroyCanvas( self->cache );
+
 	PL_DELETE( self );
 }
 
@@ -133,7 +143,55 @@ void GUI_Panel_Destroy( GUIPanel *self )
  */
 void GUI_Panel_SetStyleSheet( GUIPanel *self, const GUIStyleSheet *styleSheet )
 {
+	if ( self->styleSheet == styleSheet )
+		return;
+
 	self->styleSheet = styleSheet;
+	GUI_Panel_MarkDirty( self );
+}
+
+/**
+ * Flags the panel as needing to be drawn again, along with everything
+ * it's in. Anything that changes how a panel looks outside of the
+ * setters here, such as in a tick callback, needs to call this.
+ */
+void GUI_Panel_MarkDirty( GUIPanel *self )
+{
+	/* all the way up, as a panel that wasn't drawn last time may
+	 * still be dirty from before */
+	for ( GUIPanel *panel = self; panel != NULL; panel = panel->parent )
+		panel->isDirty = true;
+}
+
+/**
+ * Flags whatever the panel is drawn into as needing to be drawn again,
+ * for changes that don't affect the panel's own contents, such as
+ * where it is.
+ */
+static void MarkParentDirty( GUIPanel *self )
+{
+	GUI_Panel_MarkDirty( ( self->parent != NULL ) ? self->parent : self );
+}
+
+/**
+ * Cached panels are drawn along with their children into a canvas of
+ * their own, which is then only drawn again when something in them
+ * changes. Worth it for anything large that rarely changes. Anything
+ * outside of the panel's bounds is cut off.
+ */
+void GUI_Panel_SetCached( GUIPanel *self, bool flag )
+{
+	if ( self->isCached == flag )
+		return;
+
+	self->isCached = flag;
+	if ( !flag )
+	{
+		GUI_DestroyCanvas( self->cache );
+		self->cache = NULL;
+	}
+
+	MarkParentDirty( self );
 }
 
 void GUI_Panel_Draw( GUIPanel *self )
@@ -141,6 +199,32 @@ void GUI_Panel_Draw( GUIPanel *self )
 	if ( !self->isDrawing )
 		return;
 
+	if ( self->isCached && guiState.cacheEnabled )
+	{
+		GUI_Draw_CachedPanel( self );
+		return;
+	}
+
+	/* it's drawn along with everything else, so the canvas will be out of date */
+	if ( self->cache != NULL )
+	{
+		GUI_DestroyCanvas( self->cache );
+		self->cache = NULL;
+	}
+
+	GUI_Panel_DrawContents( self );
+}
+
+/**
+ * Queues up the panel and its children, ignoring whether it's cached.
+ */
+void GUI_Panel_DrawContents( GUIPanel *self )
+{
+	if ( !self->isDrawing )
+		return;
+
+	self->isDirty = false;
+
 	PlgSetTexture( NULL, 0 );
 
 	GUI_Panel_DrawBackground( self );
@@ -214,10 +298,17 @@ void GUI_Panel_Tick( GUIPanel *self )
 		return;
 
 	// Make sure the cursor is always updated/drawn last
-	if ( self->cursor != NULL )
+	if ( self->cursor != NULL && PlGetNextLinkedListNode( self->cursor->node ) != NULL )
+	{
 		PlMoveLinkedListNodeToBack( self->cursor->node );
+		GUI_Panel_MarkDirty( self );
+	}
 
-	self->isDrawing = self->isVisible;
+	if ( self->isDrawing != self->isVisible )
+	{
+		self->isDrawing = self->isVisible;
+		MarkParentDirty( self );
+	}
 
 	bool override;
 	if ( self->Tick != NULL )
@@ -239,7 +330,11 @@ void GUI_Panel_Tick( GUIPanel *self )
 
 void GUI_Panel_SetBackgroundColour( GUIPanel *self, const PLColour *colour )
 {
+	if ( memcmp( &self->backgroundColour, colour, sizeof( PLColour ) ) == 0 )
+		return;
+
 	self->backgroundColour = *colour;
+	GUI_Panel_MarkDirty( self );
 }
 
 PLColour GUI_Panel_GetBackgroundColour( GUIPanel *self )
@@ -249,12 +344,20 @@ PLColour GUI_Panel_GetBackgroundColour( GUIPanel *self )
 
 void GUI_Panel_SetBorder( GUIPanel *self, GUIPanelBorder border )
 {
+	if ( self->border == border )
+		return;
+
 	self->border = border;
+	GUI_Panel_MarkDirty( self );
 }
 
 void GUI_Panel_SetBackground( GUIPanel *self, GUIPanelBackground background )
 {
+	if ( self->background == background )
+		return;
+
 	self->background = background;
+	GUI_Panel_MarkDirty( self );
 }
 
 GUIPanel *GUI_Panel_GetParent( GUIPanel *self )
@@ -315,9 +418,15 @@ void GUI_Panel_SetPosition( GUIPanel *self, int x, int y )
 		if ( y < cy ) y = cy;
 	}
 
+	if ( self->x == x && self->y == y )
+		return;
+
 	self->x = x;
 	self->y = y;
 
+	/* everything in it stays where it was relative to it, so only what it's in needs updating */
+	MarkParentDirty( self );
+
 #if 0// Don't really think this is necessary? Given children are relative to parent
 	/* and now be sure that all the children get updated */
 	PLLinkedListNode *childNode = PlGetFirstNode( self->children );
@@ -351,8 +460,12 @@ void GUI_Panel_GetContentSize( GUIPanel *self, int *w, int *h )
 
 void GUI_Panel_SetSize( GUIPanel *self, int w, int h )
 {
+	if ( self->w == w && self->h == h )
+		return;
+
 	self->w = w;
 	self->h = h;
+	GUI_Panel_MarkDirty( self );
 	// todo: recurse over children?
 }
 
@@ -405,5 +518,9 @@ bool GUI_Panel_HandleKeyboardEvent( GUIPanel *self, int button, bool buttonUp )
 
 void GUI_Panel_SetVisible( GUIPanel *self, bool flag )
 {
+	if ( self->isVisible == flag )
+		return;
+
 	self->isVisible = flag;
+	MarkParentDirty( self );
 }
@@ -22,6 +22,10 @@ typedef struct GUIPanel
 	int  w, h;
 	bool isDrawing;// Flag on whether the panel is actually in view
 	bool isVisible;// User flag, specifying if the panel should show or not
+	bool isDirty;  // Something in or beneath the panel has changed since it was last drawn
+	bool isCached; // Panel and its children are drawn into their own canvas, and only redrawn when dirty
+
+	GUICanvas *cache;
 
 	int z;
 
@@ -16,8 +16,12 @@ typedef struct GUIState
 	GUIVector2 mousePos, mouseOldPos;
 	PLVector2  mouseWheel, mouseOldWheel;
 
-	unsigned int numBatches, lastNumBatches;    // number of batches this frame
-	unsigned int numTriangles, lastNumTriangles;// number of triangles drawn this frame
+	unsigned int numBatches, lastNumBatches;          // number of batches this frame
+	unsigned int numTriangles, lastNumTriangles;      // number of triangles drawn this frame
+	unsigned int numCacheHits, lastNumCacheHits;      // number of canvases reused as they were this frame
+	unsigned int numCacheUpdates, lastNumCacheUpdates;// number of canvases that had to be redrawn this frame
+
+	bool cacheEnabled;
 } GUIState;
 extern GUIState guiState;
 
@@ -121,3 +125,7 @@ void     GUI_Draw_Shutdown( void );
 PLGMesh *GUI_Draw_GetBatchQueueMesh( PLGTexture *texture );
 void     GUI_Draw_FilledRectangle( PLGMesh *mesh, int x, int y, int w, int h, int z, const PLColour *colour );
 void     GUI_Draw_Quad( PLGMesh *mesh, GUIVector2 tl, GUIVector2 tr, GUIVector2 ll, GUIVector2 lr, int z, const PLColourF32 *colour );
+void     GUI_Draw_CanvasRectangle( PLGMesh *mesh, int x, int y, int w, int h, int z );
+void     GUI_Draw_CachedPanel( GUIPanel *panel );
+
+void GUI_Panel_DrawContents( GUIPanel *self );
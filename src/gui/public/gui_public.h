@@ -44,6 +44,17 @@ const GUIStyleSheet *GUI_GetActiveStyleSheet( void );
 void GUI_Tick( GUIPanel *root );
 void GUI_Draw( GUICanvas *canvas, GUIPanel *root );
 
+typedef struct GUIDrawStats
+{
+	unsigned int numBatches;
+	unsigned int numTriangles;
+	unsigned int numCacheHits;   // canvases that were reused as they were
+	unsigned int numCacheUpdates;// canvases that had to be drawn again
+} GUIDrawStats;
+
+void GUI_GetDrawStats( GUIDrawStats *stats );
+bool GUI_SetCaching( bool enable );
+
 typedef enum GUIMouseButton
 {
 	GUI_MOUSE_BUTTON_LEFT,
@@ -111,6 +122,9 @@ bool GUI_Panel_HandleKeyboardEvent( GUIPanel *self, int button, bool buttonUp );
 
 void GUI_Panel_SetVisible( GUIPanel *self, bool flag );
 
+void GUI_Panel_SetCached( GUIPanel *self, bool flag );
+void GUI_Panel_MarkDirty( GUIPanel *self );
+
 /****************************************
  * Cursor
  ****************************************/
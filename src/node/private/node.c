@@ -46,8 +46,8 @@ static const char *StringForPropertyType( YNNodePropertyType propertyType )
 	return propToStr[ propertyType ];
 }
 
-static char *nlErrorMsg            = NULL;
-static YNNodeErrorCode nlErrorType = YN_NODE_ERROR_SUCCESS;
+static NL_THREAD_LOCAL char *nlErrorMsg            = NULL;
+static NL_THREAD_LOCAL YNNodeErrorCode nlErrorType = YN_NODE_ERROR_SUCCESS;
 static void ClearErrorMessage( void )
 {
 	PlFree( nlErrorMsg );
@@ -857,7 +857,7 @@ YNNodeBranch *YnNode_LoadFile( const char *path, const char *objectType )
 /******************************************/
 /** Serialisation **/
 
-static unsigned int sDepth; /* serialisation depth */
+static NL_THREAD_LOCAL unsigned int sDepth; /* serialisation depth */
 
 static void WriteLine( FILE *file, const char *string, bool tabify )
 {
@@ -22,7 +22,7 @@ typedef struct PreProcessorContext
 	unsigned int      numMacros;
 } PreProcessorContext;
 
-static PreProcessorContext ctx;
+static NL_THREAD_LOCAL PreProcessorContext ctx;
 
 static const PreProcessorMacro *GetPreprocessorMacroByName( const char *name )
 {
@@ -31,6 +31,13 @@ extern int nodeLogLevelPrint;
 extern int nodeLogLevelWarn;
 #define Warning( FORMAT, ... ) PlLogMessage( nodeLogLevelWarn, "WARNING: " FORMAT, ##__VA_ARGS__ )
 
+/* parser state is kept per-thread, so files can be loaded in the background */
+#if defined( _MSC_VER )
+#	define NL_THREAD_LOCAL __declspec( thread )
+#else
+#	define NL_THREAD_LOCAL _Thread_local
+#endif
+
 /* upper limits used for the parser */
 #define NL_MAX_NAME_LENGTH   256
 #define NL_MAX_STRING_LENGTH 256
@@ -3,7 +3,9 @@
 
 #include <plcore/pl_image.h>
 
-#include "engine/public/yin_format_gfx.h"
+#include <math.h>
+
+#include "common/public/common_format_gfx.h"
 
 #include "pkgman.h"
 #include "txc_dxtn.h"
@@ -13,61 +15,26 @@
  * - if there are two colours that aren't discernably different, pack them together (optional)
  */
 
-static uint8_t PackImage_GetNumChannels( uint8_t channelFlags )
-{
-	uint8_t numChannels = 0;
-	if ( channelFlags & PGFX_CHANNEL_RED ) numChannels++;
-	if ( channelFlags & PGFX_CHANNEL_GREEN ) numChannels++;
-	if ( channelFlags & PGFX_CHANNEL_BLUE ) numChannels++;
-	if ( channelFlags & PGFX_CHANNEL_ALPHA ) numChannels++;
-	return numChannels;
-}
-
-static void PackImage_WriteHeader( FILE *filePtr, uint8_t format, uint8_t channels, uint16_t width, uint16_t height, uint16_t numBlocks )
+static void PackImage_WriteHeader( FILE *filePtr, uint8_t format, uint8_t numLevels, uint16_t width, uint16_t height )
 {
 	/* make sure we're at the start */
 	fseek( filePtr, 0, SEEK_SET );
 
 	fwrite( GFX_IDENTIFIER, sizeof( char ), 4, filePtr );
 	fwrite( &format, sizeof( uint8_t ), 1, filePtr );
-	if ( format == PGFX_FORMAT_CLUSTER )
-	{
-		fwrite( &channels, sizeof( uint8_t ), 1, filePtr );
-		fwrite( &numBlocks, sizeof( uint16_t ), 1, filePtr ); /* if this returns 0, it means there's just plain data */
-	}
+	fwrite( &numLevels, sizeof( uint8_t ), 1, filePtr );
 	fwrite( &width, sizeof( uint16_t ), 1, filePtr );
 	fwrite( &height, sizeof( uint16_t ), 1, filePtr );
 }
 
-static void PackImage_WriteBlock( FILE *filePtr, const uint8_t *colour, uint8_t channelFlags, uint8_t numChannels, const uint8_t *srcBuffer, uint32_t srcPixelSize )
+static void PackImage_WriteBlock( FILE *filePtr, const uint8_t *colour, const uint32_t *pixelOffsets, uint16_t numBlockPixels, uint32_t srcPixelSize )
 {
 	/* figure out how many channels we need for this block */
 	uint8_t blockChannelFlags = 0;
-	for ( unsigned int i = 0; i < numChannels; ++i )
-	{
-		/* hackity hack, figure out how many channels we're actually using */
-		if ( colour[ i ] > 0 && i < 3 )
-		{
-			uint8_t specificChannel = 0;
-			if ( i == 0 )
-			{
-				specificChannel = PGFX_CHANNEL_RED;
-			}
-			else if ( i == 1 )
-			{
-				specificChannel = PGFX_CHANNEL_GREEN;
-			}
-			else if ( i == 2 )
-			{
-				specificChannel = PGFX_CHANNEL_BLUE;
-			}
-			blockChannelFlags |= specificChannel;
-		}
-		else if ( colour[ i ] != 255 && i == 3 )
-		{
-			blockChannelFlags |= PGFX_CHANNEL_ALPHA;
-		}
-	}
+	if ( colour[ 0 ] > 0 ) blockChannelFlags |= PGFX_CHANNEL_RED;
+	if ( colour[ 1 ] > 0 ) blockChannelFlags |= PGFX_CHANNEL_GREEN;
+	if ( colour[ 2 ] > 0 ) blockChannelFlags |= PGFX_CHANNEL_BLUE;
+	if ( colour[ 3 ] != 255 ) blockChannelFlags |= PGFX_CHANNEL_ALPHA;
 
 	fputc( blockChannelFlags, filePtr );
 	if ( blockChannelFlags & PGFX_CHANNEL_RED ) { fputc( colour[ 0 ], filePtr ); }
@@ -75,151 +42,89 @@ static void PackImage_WriteBlock( FILE *filePtr, const uint8_t *colour, uint8_t
 	if ( blockChannelFlags & PGFX_CHANNEL_BLUE ) { fputc( colour[ 2 ], filePtr ); }
 	if ( blockChannelFlags & PGFX_CHANNEL_ALPHA ) { fputc( colour[ 3 ], filePtr ); }
 
-	/* now figure out how many pixels there are that we need in this block */
-	uint16_t  numBlockPixels = 0;
-	uint32_t *pixelOffsets   = malloc( sizeof( uint32_t ) * srcPixelSize );
-	for ( uint32_t i = 0; i < srcPixelSize; ++i )
-	{
-		uint8_t srcColour[ 4 ];
-		memcpy( srcColour, srcBuffer, sizeof( uint8_t ) * numChannels );
-
-		bool rgba[ 4 ] = { true, true, true, true };
-		for ( uint8_t j = 0; j < numChannels; ++j )
-		{
-			rgba[ j ] = ( srcColour[ j ] == colour[ j ] );
-		}
-
-		srcBuffer += numChannels;
-
-		if ( !( rgba[ 0 ] && rgba[ 1 ] && rgba[ 2 ] && rgba[ 3 ] ) )
-		{
-			continue;
-		}
-
-		pixelOffsets[ numBlockPixels++ ] = i;
-	}
-
 	if ( numBlockPixels == 0 )
 	{
 		Error( "Invalid pixel block, num pixels returned as 0!\n" );
 	}
 
-	/* and write out the pixel offsets */
+	/* and write out the pixel offsets, at whatever size the loader expects */
 	fwrite( &numBlockPixels, sizeof( uint16_t ), 1, filePtr );
-	if ( srcPixelSize < UINT8_MAX )
+	for ( uint16_t i = 0; i < numBlockPixels; ++i )
 	{
-		fwrite( pixelOffsets, sizeof( uint8_t ), numBlockPixels, filePtr );
-	}
-	else if ( srcPixelSize < UINT16_MAX )
-	{
-		fwrite( pixelOffsets, sizeof( uint16_t ), numBlockPixels, filePtr );
-	}
-	else
-	{
-		fwrite( pixelOffsets, sizeof( uint32_t ), numBlockPixels, filePtr );
+		if ( srcPixelSize < UINT8_MAX )
+		{
+			uint8_t offset = ( uint8_t ) pixelOffsets[ i ];
+			fwrite( &offset, sizeof( uint8_t ), 1, filePtr );
+		}
+		else if ( srcPixelSize < UINT16_MAX )
+		{
+			uint16_t offset = ( uint16_t ) pixelOffsets[ i ];
+			fwrite( &offset, sizeof( uint16_t ), 1, filePtr );
+		}
+		else
+		{
+			fwrite( &pixelOffsets[ i ], sizeof( uint32_t ), 1, filePtr );
+		}
 	}
-
-	free( pixelOffsets );
 }
 
-static void PackImage_WriteCluster( FILE *filePtr, const PLImage *image )
+/**
+ * Each block can only cover UINT16_MAX pixels, so colours used more often
+ * than that are split across several blocks. Returns how many colours we
+ * can have while leaving room for that within the block limit.
+ */
+unsigned int PackImage_GetMaxClusterColours( unsigned int numPixels )
 {
-	/* figure out how many channels the image is using */
-	uint8_t channels = 0;
-	switch ( image->format )
-	{
-		default:
-			Error( "Unhandled pixel format for \"%s\"!\n", image->path );
-		case PL_IMAGEFORMAT_RGBA8:
-			channels |= PGFX_CHANNEL_ALPHA;
-		case PL_IMAGEFORMAT_RGB8:
-			channels |= PGFX_CHANNEL_RED | PGFX_CHANNEL_GREEN | PGFX_CHANNEL_BLUE;
-			break;
-	}
-
-	uint8_t numChannels = GetNumChannels( channels );
+	return UINT16_MAX - ( numPixels / UINT16_MAX + 1 );
+}
 
-	Print( "Checking number of unique pixels in \"%s\"...\n", image->path );
+static void PackImage_WriteClusterLevel( FILE *filePtr, const char *path, const uint8_t *pixels, unsigned int width, unsigned int height, uint8_t numChannels )
+{
+	Print( "Checking number of unique pixels in \"%s\" (%ux%u)...\n", path, width, height );
 
-	unsigned int imagePixelSize = image->width * image->height;
+	unsigned int imagePixelSize = width * height;
 
 	/* figure out how many unique colours there are
 	 * so we know how many blocks there should be */
-	const uint8_t *pixelPos       = image->data[ 0 ];
-	uint8_t *      colourBuffer   = calloc( image->size, sizeof( uint8_t ) );
-	uint16_t       numColours     = 0;
-	uint8_t        outputChannels = 0;
-	for ( unsigned int i = 0; i < imagePixelSize; ++i )
-	{
-		/* copy the initial colour to kick us off */
-		if ( numColours == 0 )
-		{
-			memcpy( &colourBuffer[ numColours * numChannels ], pixelPos, numChannels );
-			numColours++;
-			continue;
-		}
+	PackImagePalette *palette = PackImage_BuildPalette( pixels, imagePixelSize, numChannels, PackImage_GetMaxClusterColours( imagePixelSize ) );
 
-		/* check whether or not the colour is already in the table */
-		bool rgba[ 4 ] = { true, true, true, true };
-		for ( unsigned int j = 0; j < numColours; ++j )
-		{
-			for ( unsigned int k = 0; k < numChannels; ++k )
-			{
-				rgba[ k ] = ( colourBuffer[ j * numChannels + k ] == pixelPos[ k ] );
+	Print( "Found %u unique pixels\n", palette->numUniqueColours );
+	if ( palette->numColours != palette->numUniqueColours )
+		Print( "Quantised down to %u colours\n", palette->numColours );
 
-				/* hackity hack, figure out how many channels we're actually using */
-				/* todo: refer back to a table to ensure we're setting the correct channels here */
-				if ( colourBuffer[ j * numChannels + k ] > 0 && k < 3 )
-				{
-					uint8_t specificChannel = 0;
-					if ( k == 0 )
-					{
-						specificChannel = PGFX_CHANNEL_RED;
-					}
-					else if ( k == 1 )
-					{
-						specificChannel = PGFX_CHANNEL_GREEN;
-					}
-					else if ( k == 2 )
-					{
-						specificChannel = PGFX_CHANNEL_BLUE;
-					}
-					outputChannels |= specificChannel;
-				}
-				else if ( colourBuffer[ j * numChannels + k ] != 255 && k == 3 )
-				{
-					outputChannels |= PGFX_CHANNEL_ALPHA;
-				}
-			}
-
-			if ( rgba[ 0 ] && rgba[ 1 ] && rgba[ 2 ] && rgba[ 3 ] )
-			{
-				break;
-			}
-		}
-
-		/* colours didn't match, so it's a new unique pixel! */
-		if ( !( rgba[ 0 ] && rgba[ 1 ] && rgba[ 2 ] && rgba[ 3 ] ) )
-		{
-			memcpy( &colourBuffer[ numColours * numChannels ], pixelPos, numChannels );
-			numColours++;
-		}
+	double psnr = PackImage_CalculatePSNR( palette, pixels, numChannels );
+	if ( !isinf( psnr ) )
+		Print( "Quantised with a PSNR of %.2fdB\n", psnr );
 
-		pixelPos += numChannels;
+	/* figure out which channels we're actually using */
+	uint8_t  outputChannels = 0;
+	uint32_t numBlocks      = 0;
+	for ( unsigned int i = 0; i < palette->numColours; ++i )
+	{
+		uint8_t colour[ 4 ];
+		PackImage_GetPaletteColour( palette, i, colour );
+		if ( colour[ 0 ] > 0 ) outputChannels |= PGFX_CHANNEL_RED;
+		if ( colour[ 1 ] > 0 ) outputChannels |= PGFX_CHANNEL_GREEN;
+		if ( colour[ 2 ] > 0 ) outputChannels |= PGFX_CHANNEL_BLUE;
+		if ( colour[ 3 ] != 255 ) outputChannels |= PGFX_CHANNEL_ALPHA;
+
+		numBlocks += ( palette->counts[ i ] + UINT16_MAX - 1 ) / UINT16_MAX;
 	}
 
-	Print( "Found %d unique pixels\n", numColours );
+	if ( numBlocks > UINT16_MAX )
+		Error( "Too many blocks for \"%s\" (%u)!\n", path, numBlocks );
 
-	uint16_t numBlocks = numColours;
-	Print( "ChFl. %d, BlNum. %d, W. %d, H. %d\n", outputChannels, numBlocks, image->width, image->height );
+	Print( "ChFl. %d, BlNum. %u, W. %u, H. %u\n", outputChannels, numBlocks, width, height );
 
-	/* go ahead and write out the header */
-	PackImage_WriteHeader( filePtr, PGFX_FORMAT_CLUSTER, outputChannels, image->width, image->height, numBlocks );
+	/* go ahead and write out the level header */
+	uint16_t levelBlocks = ( uint16_t ) numBlocks;
+	fputc( outputChannels, filePtr );
+	fwrite( &levelBlocks, sizeof( uint16_t ), 1, filePtr ); /* if this is 0, it means there's just plain data */
 
 	if ( numBlocks == 0 )
 	{
 		/* no blocks, so just go straight to the data */
-		pixelPos = image->data[ 0 ];
+		const uint8_t *pixelPos = pixels;
 		for ( unsigned int i = 0; i < imagePixelSize; ++i )
 		{
 			/* write out each channel we're using */
@@ -232,78 +137,329 @@ static void PackImage_WriteCluster( FILE *filePtr, const PLImage *image )
 	}
 	else
 	{
-		for ( unsigned int i = 0; i < numColours; ++i )
+		/* bucket the pixel offsets by colour in one pass, rather than
+		 * scanning the whole image again for every block */
+		uint32_t *colourStarts = malloc( sizeof( uint32_t ) * ( palette->numColours + 1 ) );
+		colourStarts[ 0 ]      = 0;
+		for ( unsigned int i = 0; i < palette->numColours; ++i )
+		{
+			colourStarts[ i + 1 ] = colourStarts[ i ] + palette->counts[ i ];
+		}
+
+		uint32_t *pixelOffsets = malloc( sizeof( uint32_t ) * imagePixelSize );
+		uint32_t *cursors      = malloc( sizeof( uint32_t ) * palette->numColours );
+		memcpy( cursors, colourStarts, sizeof( uint32_t ) * palette->numColours );
+		for ( uint32_t i = 0; i < imagePixelSize; ++i )
+		{
+			pixelOffsets[ cursors[ palette->pixelIndices[ i ] ]++ ] = i;
+		}
+		free( cursors );
+
+		for ( unsigned int i = 0; i < palette->numColours; ++i )
+		{
+			uint8_t colour[ 4 ];
+			PackImage_GetPaletteColour( palette, i, colour );
+
+			for ( uint32_t j = colourStarts[ i ]; j < colourStarts[ i + 1 ]; j += UINT16_MAX )
+			{
+				uint32_t numBlockPixels = colourStarts[ i + 1 ] - j;
+				if ( numBlockPixels > UINT16_MAX )
+				{
+					numBlockPixels = UINT16_MAX;
+				}
+
+				PackImage_WriteBlock( filePtr, colour, &pixelOffsets[ j ], ( uint16_t ) numBlockPixels, imagePixelSize );
+			}
+		}
+
+		free( pixelOffsets );
+		free( colourStarts );
+	}
+
+	PackImage_DestroyPalette( palette );
+}
+
+/**
+ * Returns a copy of the top level of the image with the requested
+ * number of channels, which the mip chain is then built from.
+ */
+static uint8_t *PackImage_GetSourcePixels( const PLImage *image, uint8_t numChannels )
+{
+	uint8_t srcChannels;
+	switch ( image->format )
+	{
+		case PL_IMAGEFORMAT_RGBA8:
+			srcChannels = 4;
+			break;
+		case PL_IMAGEFORMAT_RGB8:
+			srcChannels = 3;
+			break;
+		default:
+			Error( "Unhandled pixel format for \"%s\"!\n", image->path );
+	}
+
+	unsigned int numPixels = image->width * image->height;
+	uint8_t     *pixels    = malloc( numPixels * numChannels );
+	for ( unsigned int i = 0; i < numPixels; ++i )
+	{
+		const uint8_t *src = &image->data[ 0 ][ i * srcChannels ];
+		uint8_t       *dst = &pixels[ i * numChannels ];
+		dst[ 0 ]           = src[ 0 ];
+		dst[ 1 ]           = src[ 1 ];
+		dst[ 2 ]           = src[ 2 ];
+		if ( numChannels == 4 )
 		{
-			PackImage_WriteBlock( filePtr, &colourBuffer[ i * numChannels ], outputChannels, numChannels, image->data[ 0 ], imagePixelSize );
+			dst[ 3 ] = ( srcChannels == 4 ) ? src[ 3 ] : 255;
 		}
 	}
 
-	free( colourBuffer );
+	return pixels;
+}
+
+static void PackImage_WriteCompressedLevel( FILE *filePtr, const uint8_t *pixels, unsigned int width, unsigned int height, uint8_t destFormat )
+{
+	/* convert our format to the GL equivalent */
+	GLenum        glFormat;
+	PLImageFormat plFormat;
+	GLint         dstRowStride;
+	switch ( destFormat )
+	{
+		case PGFX_FORMAT_DXT3:
+			glFormat     = GL_COMPRESSED_RGBA_S3TC_DXT3_EXT;
+			plFormat     = PL_IMAGEFORMAT_RGBA_DXT3;
+			dstRowStride = ( ( width + 3 ) / 4 ) * 16;
+			break;
+		case PGFX_FORMAT_DXT1:
+			glFormat     = GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+			plFormat     = PL_IMAGEFORMAT_RGB_DXT1;
+			dstRowStride = ( ( width + 3 ) / 4 ) * 8;
+			break;
+		case PGFX_FORMAT_DXT1_ALPHA:
+			glFormat     = GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
+			plFormat     = PL_IMAGEFORMAT_RGBA_DXT1;
+			dstRowStride = ( ( width + 3 ) / 4 ) * 8;
+			break;
+		case PGFX_FORMAT_DXT5:
+			glFormat     = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+			plFormat     = PL_IMAGEFORMAT_RGBA_DXT5;
+			dstRowStride = ( ( width + 3 ) / 4 ) * 16;
+			break;
+		default:
+			Error( "Unsupported compression type!\n" );
+	}
+
+	size_t   dstSize = PlGetImageSize( plFormat, width, height );
+	uint8_t *dstBuf  = calloc( dstSize, 1 );
+
+	tx_compress_dxtn( 4, width, height, pixels, glFormat, dstBuf, dstRowStride );
+
+	fwrite( dstBuf, sizeof( uint8_t ), dstSize, filePtr );
+
+	free( dstBuf );
 }
 
-void PackImage_Write( const char *path, const PLImage *image, uint8_t destFormat )
+void PackImage_Write( const char *path, const PLImage *image, uint8_t destFormat, bool isLinear )
 {
 	if ( image->width >= INT16_MAX || image->height >= INT16_MAX )
 	{
 		Error( "Image is too large, maximum size is %dx%d!\n", INT16_MAX, INT16_MAX );
 	}
 
+	/* the compressor always wants rgba, otherwise keep whatever we were given */
+	uint8_t numChannels = 4;
+	if ( destFormat == PGFX_FORMAT_CLUSTER && image->format == PL_IMAGEFORMAT_RGB8 )
+	{
+		numChannels = 3;
+	}
+
+	unsigned int numLevels = PackImage_GetNumMipLevels( image->width, image->height );
+	if ( numLevels > GFX_MAX_LEVELS )
+	{
+		numLevels = GFX_MAX_LEVELS;
+	}
+
+	uint8_t *pixels = PackImage_GetSourcePixels( image, numChannels );
+
 	FILE *filePtr = fopen( path, "wb" );
 	if ( filePtr == NULL )
 	{
 		Error( "Failed to open \"%s\" for writing!\n", path );
 	}
 
-	if ( destFormat == PGFX_FORMAT_CLUSTER )
-	{
-		PackImage_WriteCluster( filePtr, image );
-	}
-	else
+	PackImage_WriteHeader( filePtr, destFormat, ( uint8_t ) numLevels, ( uint16_t ) image->width, ( uint16_t ) image->height );
+
+	/* each level is filtered from the one above, and written as we go */
+	unsigned int width  = image->width;
+	unsigned int height = image->height;
+	for ( unsigned int i = 0; i < numLevels; ++i )
 	{
-		/* convert our format to the GL equivalent */
-		GLenum        glFormat;
-		PLImageFormat plFormat;
-		GLint         dstRowStride;
-		switch ( destFormat )
+		if ( destFormat == PGFX_FORMAT_CLUSTER )
+		{
+			PackImage_WriteClusterLevel( filePtr, image->path, pixels, width, height, numChannels );
+		}
+		else
+		{
+			PackImage_WriteCompressedLevel( filePtr, pixels, width, height, destFormat );
+		}
+
+		if ( i + 1 < numLevels )
 		{
-			case PGFX_FORMAT_DXT3:
-				glFormat     = GL_COMPRESSED_RGBA_S3TC_DXT3_EXT;
-				plFormat     = PL_IMAGEFORMAT_RGBA_DXT3;
-				dstRowStride = ( ( image->width + 3 ) / 4 ) * 16;
-				break;
-			case PGFX_FORMAT_DXT1:
-				glFormat     = GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
-				plFormat     = PL_IMAGEFORMAT_RGB_DXT1;
-				dstRowStride = ( ( image->width + 3 ) / 4 ) * 8;
-				break;
-			case PGFX_FORMAT_DXT1_ALPHA:
-				glFormat     = GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
-				plFormat     = PL_IMAGEFORMAT_RGBA_DXT1;
-				dstRowStride = ( ( image->width + 3 ) / 4 ) * 8;
-				break;
-			case PGFX_FORMAT_DXT5:
-				glFormat     = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
-				plFormat     = PL_IMAGEFORMAT_RGBA_DXT5;
-				dstRowStride = ( ( image->width + 3 ) / 4 ) * 16;
-				break;
-			default:
-				Error( "Unsupported compression type!\n" );
+			unsigned int nextWidth, nextHeight;
+			uint8_t     *nextPixels = PackImage_GenerateMipLevel( pixels, width, height, numChannels, isLinear, &nextWidth, &nextHeight );
+			free( pixels );
+			pixels = nextPixels;
+			width  = nextWidth;
+			height = nextHeight;
 		}
+	}
+
+	free( pixels );
+
+	fclose( filePtr );
+
+	Print( "Wrote \"%s\" (%u levels)\n", path, numLevels );
+}
 
-		PackImage_WriteHeader( filePtr, destFormat, 0, image->width, image->height, 0 );
+static void BenchmarkCompressionFormat( const char *description, GLenum glFormat, PLImageFormat plFormat, unsigned int blockSize,
+                                        const uint8_t *pixels, unsigned int width, unsigned int height )
+{
+	GLint    dstRowStride = ( ( width + 3 ) / 4 ) * blockSize;
+	size_t   dstSize      = PlGetImageSize( plFormat, width, height );
+	uint8_t *refBuf       = calloc( dstSize, 1 );
+	uint8_t *dstBuf       = calloc( dstSize, 1 );
 
-		size_t   dstSize = PlGetImageSize( plFormat, image->width, image->height );
-		uint8_t *dstBuf  = calloc( dstSize, 1 );
+	double megapixels = ( ( double ) width * height ) / 1000000.0;
 
-		//unsigned int srcComps = image->colour_format == PL_COLOURFORMAT_RGB ? 3 : 4;
-		tx_compress_dxtn( 4, image->width, image->height, image->data[ 0 ], glFormat, dstBuf, dstRowStride );
+	tx_compress_dxtn_set_reference( GL_TRUE );
+	double startTime = PlGetCurrentSeconds();
+	tx_compress_dxtn( 4, width, height, pixels, glFormat, refBuf, dstRowStride );
+	double refTime = PlGetCurrentSeconds() - startTime;
 
-		fwrite( dstBuf, sizeof( uint8_t ), dstSize, filePtr );
+	tx_compress_dxtn_set_reference( GL_FALSE );
+	startTime       = PlGetCurrentSeconds();
+	tx_compress_dxtn( 4, width, height, pixels, glFormat, dstBuf, dstRowStride );
+	double fastTime = PlGetCurrentSeconds() - startTime;
 
-		free( dstBuf );
+	if ( memcmp( refBuf, dstBuf, dstSize ) != 0 )
+	{
+		Error( "%s output doesn't match the reference!\n", description );
 	}
 
-	fclose( filePtr );
+	Print( "%s: reference %.2fMP/s, fast %.2fMP/s (%.1fx)\n", description,
+	       megapixels / refTime, megapixels / fastTime, refTime / fastTime );
+
+	free( dstBuf );
+	free( refBuf );
+}
+
+void PackImage_BenchmarkCompression( unsigned int width, unsigned int height )
+{
+	Print( "Benchmarking DXT compression (%ux%u)...\n", width, height );
+
+	uint8_t *pixels = malloc( width * height * 4 );
+	PackImage_GenerateBenchmarkImage( pixels, width, height );
+
+	BenchmarkCompressionFormat( "DXT1", GL_COMPRESSED_RGB_S3TC_DXT1_EXT, PL_IMAGEFORMAT_RGB_DXT1, 8, pixels, width, height );
+	BenchmarkCompressionFormat( "DXT5", GL_COMPRESSED_RGBA_S3TC_DXT5_EXT, PL_IMAGEFORMAT_RGBA_DXT5, 16, pixels, width, height );
+
+	free( pixels );
+}
+
+#define BENCHMARK_LOAD_ITERATIONS 8
+
+static PLImage *LoadBenchmarkImage( const char *path, size_t *fileSize )
+{
+	PLFile *file = PlOpenFile( path, false );
+	if ( file == NULL )
+	{
+		Error( "Failed to open \"%s\"!\nPL: %s\n", path, PlGetError() );
+	}
+
+	*fileSize       = PlGetFileSize( file );
+	PLImage *loaded = Common_Image_LoadPackedImage( file );
+	PlCloseFile( file );
+	if ( loaded == NULL )
+	{
+		Error( "Failed to load \"%s\"!\n", path );
+	}
+
+	return loaded;
+}
+
+static double TimeBenchmarkLoading( const char *path, size_t *fileSize )
+{
+	double startTime = PlGetCurrentSeconds();
+	for ( unsigned int i = 0; i < BENCHMARK_LOAD_ITERATIONS; ++i )
+	{
+		PlDestroyImage( LoadBenchmarkImage( path, fileSize ) );
+	}
+
+	return PlGetCurrentSeconds() - startTime;
+}
+
+/**
+ * Writes out the benchmark image in each packed format, and then
+ * measures how quickly it can be read back in again, with both the
+ * original per-byte decoder and the current one.
+ */
+void PackImage_BenchmarkLoading( unsigned int width, unsigned int height )
+{
+	Print( "Benchmarking packed image loading (%ux%u)...\n", width, height );
+
+	uint8_t *pixels = malloc( width * height * 4 );
+	PackImage_GenerateBenchmarkImage( pixels, width, height );
+
+	PLImage *image = PlCreateImage( pixels, width, height, 0, PL_COLOURFORMAT_RGBA, PL_IMAGEFORMAT_RGBA8 );
+	if ( image == NULL )
+	{
+		Error( "Failed to create benchmark image!\nPL: %s\n", PlGetError() );
+	}
+
+	static const struct
+	{
+		const char *description;
+		uint8_t     format;
+	} formats[] = {
+	        {"Cluster", PGFX_FORMAT_CLUSTER},
+	        { "DXT1",   PGFX_FORMAT_DXT1   },
+	        { "DXT5",   PGFX_FORMAT_DXT5   },
+	};
+	for ( unsigned int i = 0; i < PL_ARRAY_ELEMENTS( formats ); ++i )
+	{
+		PLPath path;
+		snprintf( path, sizeof( path ), "benchmark_%s.gfx", formats[ i ].description );
+		PackImage_Write( path, image, formats[ i ].format, false );
+
+		size_t fileSize;
+
+		/* make sure both decoders agree before timing them */
+		Common_Image_SetReferenceDecoder( true );
+		PLImage *reference = LoadBenchmarkImage( path, &fileSize );
+		Common_Image_SetReferenceDecoder( false );
+		PLImage *loaded = LoadBenchmarkImage( path, &fileSize );
+		for ( unsigned int j = 0; j < loaded->levels; ++j )
+		{
+			size_t size = PlGetImageSize( loaded->format, ( width >> j ) > 0 ? ( width >> j ) : 1, ( height >> j ) > 0 ? ( height >> j ) : 1 );
+			if ( loaded->levels != reference->levels || memcmp( loaded->data[ j ], reference->data[ j ], size ) != 0 )
+			{
+				Error( "%s level %u doesn't match the reference decoder!\n", formats[ i ].description, j );
+			}
+		}
+		PlDestroyImage( loaded );
+		PlDestroyImage( reference );
+
+		Common_Image_SetReferenceDecoder( true );
+		double refTime = TimeBenchmarkLoading( path, &fileSize );
+		Common_Image_SetReferenceDecoder( false );
+		double fastTime = TimeBenchmarkLoading( path, &fileSize );
+
+		double megabytes = ( ( double ) fileSize * BENCHMARK_LOAD_ITERATIONS ) / 1000000.0;
+		Print( "%s: reference %.2fMB/s, fast %.2fMB/s (%.1fx, %lu bytes)\n", formats[ i ].description,
+		       megabytes / refTime, megabytes / fastTime, refTime / fastTime, ( unsigned long ) fileSize );
+
+		remove( path );
+	}
 
-	Print( "Wrote \"%s\"\n", path );
+	PlDestroyImage( image );
+	free( pixels );
 }
@@ -0,0 +1,193 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* Copyright © 2020-2023 Mark E Sowden <hogsy@oldtimes-software.com> */
+
+#include <math.h>
+
+#include "pkgman.h"
+
+/* Mip chain generation for packed images.
+ *
+ * Filtering is done in linear space, since averaging sRGB values directly
+ * darkens every level, and colour is weighted by alpha so that fully
+ * transparent pixels don't bleed into their neighbours.
+ *
+ * Neither applies to textures that aren't colour, such as normal maps,
+ * so those are flagged as linear and every channel is averaged as-is. */
+
+#define MAX_FILTER_TAPS 4
+
+static float srgbToLinear[ 256 ];
+static float byteToFloat[ 256 ];
+
+static void InitializeGammaTable( void )
+{
+	static bool initialized = false;
+	if ( initialized )
+		return;
+
+	for ( unsigned int i = 0; i < 256; ++i )
+	{
+		float c          = ( float ) i / 255.0f;
+		byteToFloat[ i ] = c;
+		if ( c <= 0.04045f )
+			srgbToLinear[ i ] = c / 12.92f;
+		else
+			srgbToLinear[ i ] = powf( ( c + 0.055f ) / 1.055f, 2.4f );
+	}
+
+	initialized = true;
+}
+
+static uint8_t LinearToSRGB( float c )
+{
+	if ( c <= 0.0f )
+		return 0;
+	else if ( c >= 1.0f )
+		return 255;
+
+	if ( c <= 0.0031308f )
+		c *= 12.92f;
+	else
+		c = 1.055f * powf( c, 1.0f / 2.4f ) - 0.055f;
+
+	return ( uint8_t ) ( c * 255.0f + 0.5f );
+}
+
+static uint8_t FloatToByte( float c )
+{
+	if ( c <= 0.0f )
+		return 0;
+	else if ( c >= 1.0f )
+		return 255;
+
+	return ( uint8_t ) ( c * 255.0f + 0.5f );
+}
+
+typedef struct FilterTaps
+{
+	unsigned int numTaps;
+	unsigned int offsets[ MAX_FILTER_TAPS ];
+	float        weights[ MAX_FILTER_TAPS ];
+} FilterTaps;
+
+/**
+ * Works out which source texels, and how much of each, fall under the
+ * given destination texel. For even sizes this is just a 2-tap box, but
+ * odd sizes pick up a partial third texel so the edges aren't lost.
+ */
+static void CalculateFilterTaps( FilterTaps *taps, unsigned int dstIndex, unsigned int srcSize, unsigned int dstSize )
+{
+	float scale = ( float ) srcSize / ( float ) dstSize;
+	float start = dstIndex * scale;
+	float end   = start + scale;
+
+	taps->numTaps = 0;
+	for ( unsigned int i = ( unsigned int ) start; i < srcSize && ( float ) i < end; ++i )
+	{
+		float lo = ( ( float ) i > start ) ? ( float ) i : start;
+		float hi = ( ( float ) ( i + 1 ) < end ) ? ( float ) ( i + 1 ) : end;
+		if ( hi <= lo || taps->numTaps >= MAX_FILTER_TAPS )
+			continue;
+
+		taps->offsets[ taps->numTaps ] = i;
+		taps->weights[ taps->numTaps ] = ( hi - lo ) / scale;
+		taps->numTaps++;
+	}
+}
+
+unsigned int PackImage_GetNumMipLevels( unsigned int width, unsigned int height )
+{
+	unsigned int numLevels = 1;
+	while ( width > 1 || height > 1 )
+	{
+		width  = ( width > 1 ) ? width >> 1 : 1;
+		height = ( height > 1 ) ? height >> 1 : 1;
+		numLevels++;
+	}
+
+	return numLevels;
+}
+
+/**
+ * Produces the next level down from the given pixels, halving each
+ * dimension down to a minimum of 1. If isLinear is set, the pixels
+ * aren't treated as colour. Returned buffer should be freed.
+ */
+uint8_t *PackImage_GenerateMipLevel( const uint8_t *src, unsigned int srcWidth, unsigned int srcHeight, uint8_t numChannels,
+                                     bool isLinear, unsigned int *dstWidth, unsigned int *dstHeight )
+{
+	InitializeGammaTable();
+
+	const float *toLinear = isLinear ? byteToFloat : srgbToLinear;
+
+	unsigned int w = ( srcWidth > 1 ) ? srcWidth >> 1 : 1;
+	unsigned int h = ( srcHeight > 1 ) ? srcHeight >> 1 : 1;
+
+	uint8_t *dst = malloc( w * h * numChannels );
+	if ( dst == NULL )
+	{
+		Error( "Failed to allocate mip level (%ux%u)!\n", w, h );
+	}
+
+	FilterTaps *columnTaps = malloc( sizeof( FilterTaps ) * w );
+	for ( unsigned int x = 0; x < w; ++x )
+	{
+		CalculateFilterTaps( &columnTaps[ x ], x, srcWidth, w );
+	}
+
+	bool hasAlpha = ( numChannels == 4 );
+	for ( unsigned int y = 0; y < h; ++y )
+	{
+		FilterTaps rowTaps;
+		CalculateFilterTaps( &rowTaps, y, srcHeight, h );
+
+		for ( unsigned int x = 0; x < w; ++x )
+		{
+			const FilterTaps *colTaps = &columnTaps[ x ];
+
+			float colour[ 3 ] = { 0.0f, 0.0f, 0.0f };
+			float plain[ 3 ]  = { 0.0f, 0.0f, 0.0f };
+			float alpha       = 0.0f;
+			for ( unsigned int ty = 0; ty < rowTaps.numTaps; ++ty )
+			{
+				const uint8_t *row = &src[ rowTaps.offsets[ ty ] * srcWidth * numChannels ];
+				for ( unsigned int tx = 0; tx < colTaps->numTaps; ++tx )
+				{
+					const uint8_t *pixel  = &row[ colTaps->offsets[ tx ] * numChannels ];
+					float          weight = rowTaps.weights[ ty ] * colTaps->weights[ tx ];
+					float          a      = hasAlpha ? byteToFloat[ pixel[ 3 ] ] * weight : weight;
+					for ( unsigned int c = 0; c < 3; ++c )
+					{
+						float l = toLinear[ pixel[ c ] ];
+						colour[ c ] += l * a;
+						plain[ c ] += l * weight;
+					}
+					alpha += a;
+				}
+			}
+
+			uint8_t *out = &dst[ ( y * w + x ) * numChannels ];
+			for ( unsigned int c = 0; c < 3; ++c )
+			{
+				/* if everything under us was transparent, there's nothing
+				 * to weight by, so fall back to a plain average */
+				if ( isLinear )
+					out[ c ] = FloatToByte( plain[ c ] );
+				else
+					out[ c ] = LinearToSRGB( ( alpha > 0.0f ) ? colour[ c ] / alpha : plain[ c ] );
+			}
+
+			if ( hasAlpha )
+			{
+				out[ 3 ] = ( uint8_t ) ( alpha * 255.0f + 0.5f );
+			}
+		}
+	}
+
+	free( columnTaps );
+
+	*dstWidth  = w;
+	*dstHeight = h;
+
+	return dst;
+}
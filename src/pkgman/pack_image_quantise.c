@@ -0,0 +1,639 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* Copyright © 2020-2022 Mark E Sowden <hogsy@oldtimes-software.com> */
+
+#include <plcore/pl_image.h>
+
+#include <math.h>
+
+#include "pkgman.h"
+
+/* Palette generation for cluster images.
+ * Unique colours are gathered via an open-addressed hash set. If there are
+ * more than the destination can store, the palette is reduced with median-cut
+ * and each colour is then mapped onto its nearest entry via a k-d tree. */
+
+#define PACK_COLOUR( R, G, B, A ) ( ( uint32_t ) ( R ) | ( ( uint32_t ) ( G ) << 8 ) | ( ( uint32_t ) ( B ) << 16 ) | ( ( uint32_t ) ( A ) << 24 ) )
+#define COLOUR_CHANNEL( COLOUR, CHANNEL ) ( ( ( COLOUR ) >> ( ( CHANNEL ) * 8 ) ) & 0xFF )
+
+/****************************************
+ * Colour Set
+ ****************************************/
+
+#define COLOUR_SET_EMPTY UINT32_MAX
+
+typedef struct ColourSet
+{
+	uint32_t *keys;
+	uint32_t *indices;   /* COLOUR_SET_EMPTY if the slot is unused */
+	uint32_t  capacity;  /* always a power of two */
+	uint32_t  numEntries;
+} ColourSet;
+
+static uint32_t HashColour( uint32_t colour )
+{
+	colour ^= colour >> 16;
+	colour *= 0x7FEB352DU;
+	colour ^= colour >> 15;
+	colour *= 0x846CA68BU;
+	colour ^= colour >> 16;
+	return colour;
+}
+
+static void ColourSet_Setup( ColourSet *set, uint32_t capacity )
+{
+	set->capacity   = capacity;
+	set->numEntries = 0;
+	set->keys       = PlMAllocA( sizeof( uint32_t ) * capacity );
+	set->indices    = PlMAllocA( sizeof( uint32_t ) * capacity );
+	memset( set->indices, 0xFF, sizeof( uint32_t ) * capacity );
+}
+
+static void ColourSet_Clear( ColourSet *set )
+{
+	PL_DELETE( set->keys );
+	PL_DELETE( set->indices );
+}
+
+static uint32_t *ColourSet_FindSlot( ColourSet *set, uint32_t colour )
+{
+	uint32_t mask = set->capacity - 1;
+	uint32_t slot = HashColour( colour ) & mask;
+	while ( set->indices[ slot ] != COLOUR_SET_EMPTY && set->keys[ slot ] != colour )
+		slot = ( slot + 1 ) & mask;
+
+	return &set->indices[ slot ];
+}
+
+static void ColourSet_Grow( ColourSet *set )
+{
+	ColourSet oldSet = *set;
+	ColourSet_Setup( set, oldSet.capacity * 2 );
+	for ( uint32_t i = 0; i < oldSet.capacity; ++i )
+	{
+		if ( oldSet.indices[ i ] == COLOUR_SET_EMPTY )
+			continue;
+
+		uint32_t *slot                   = ColourSet_FindSlot( set, oldSet.keys[ i ] );
+		set->keys[ slot - set->indices ] = oldSet.keys[ i ];
+		*slot                            = oldSet.indices[ i ];
+	}
+	set->numEntries = oldSet.numEntries;
+
+	ColourSet_Clear( &oldSet );
+}
+
+/**
+ * Returns the index of the given colour if it's already in the set,
+ * otherwise inserts it with the provided index and returns that.
+ */
+static uint32_t ColourSet_Insert( ColourSet *set, uint32_t colour, uint32_t index )
+{
+	/* keep the load factor under a half */
+	if ( ( set->numEntries + 1 ) * 2 > set->capacity )
+		ColourSet_Grow( set );
+
+	uint32_t *slot = ColourSet_FindSlot( set, colour );
+	if ( *slot != COLOUR_SET_EMPTY )
+		return *slot;
+
+	set->keys[ slot - set->indices ] = colour;
+	*slot                            = index;
+	set->numEntries++;
+	return index;
+}
+
+/****************************************
+ * Median Cut
+ ****************************************/
+
+typedef struct ColourBox
+{
+	uint32_t start;
+	uint32_t numColours;
+	uint64_t weight;  /* total number of pixels in the box */
+	uint8_t  channel; /* channel with the largest range */
+	uint8_t  range;
+} ColourBox;
+
+static void ColourBox_Update( ColourBox *box, const uint32_t *colours, const uint32_t *counts, const uint32_t *order, uint8_t numChannels )
+{
+	uint8_t min[ 4 ] = { 255, 255, 255, 255 };
+	uint8_t max[ 4 ] = { 0, 0, 0, 0 };
+
+	box->weight = 0;
+	for ( uint32_t i = box->start; i < box->start + box->numColours; ++i )
+	{
+		uint32_t colour = colours[ order[ i ] ];
+		for ( uint8_t j = 0; j < numChannels; ++j )
+		{
+			uint8_t c = COLOUR_CHANNEL( colour, j );
+			if ( c < min[ j ] ) min[ j ] = c;
+			if ( c > max[ j ] ) max[ j ] = c;
+		}
+		box->weight += counts[ order[ i ] ];
+	}
+
+	box->channel = 0;
+	box->range   = 0;
+	for ( uint8_t j = 0; j < numChannels; ++j )
+	{
+		if ( max[ j ] < min[ j ] || ( max[ j ] - min[ j ] ) <= box->range )
+			continue;
+
+		box->channel = j;
+		box->range   = max[ j ] - min[ j ];
+	}
+}
+
+static uint64_t ColourBox_GetScore( const ColourBox *box )
+{
+	return ( uint64_t ) box->range * box->weight;
+}
+
+/* binary max-heap of boxes, ordered by score */
+
+static void BoxHeap_Push( ColourBox *heap, uint32_t *numBoxes, const ColourBox *box )
+{
+	uint32_t i = ( *numBoxes )++;
+	heap[ i ]  = *box;
+	while ( i > 0 )
+	{
+		uint32_t parent = ( i - 1 ) / 2;
+		if ( ColourBox_GetScore( &heap[ parent ] ) >= ColourBox_GetScore( &heap[ i ] ) )
+			break;
+
+		ColourBox tmp  = heap[ parent ];
+		heap[ parent ] = heap[ i ];
+		heap[ i ]      = tmp;
+		i              = parent;
+	}
+}
+
+static ColourBox BoxHeap_Pop( ColourBox *heap, uint32_t *numBoxes )
+{
+	ColourBox top = heap[ 0 ];
+	heap[ 0 ]     = heap[ --( *numBoxes ) ];
+
+	uint32_t i = 0;
+	for ( ;; )
+	{
+		uint32_t left    = i * 2 + 1;
+		uint32_t right   = left + 1;
+		uint32_t largest = i;
+		if ( left < *numBoxes && ColourBox_GetScore( &heap[ left ] ) > ColourBox_GetScore( &heap[ largest ] ) )
+			largest = left;
+		if ( right < *numBoxes && ColourBox_GetScore( &heap[ right ] ) > ColourBox_GetScore( &heap[ largest ] ) )
+			largest = right;
+		if ( largest == i )
+			break;
+
+		ColourBox tmp   = heap[ largest ];
+		heap[ largest ] = heap[ i ];
+		heap[ i ]       = tmp;
+		i               = largest;
+	}
+
+	return top;
+}
+
+/**
+ * Sorts the colours within the box along its widest channel,
+ * using a counting sort since the keys are only a byte.
+ */
+static void ColourBox_Sort( const ColourBox *box, const uint32_t *colours, uint32_t *order, uint32_t *scratch )
+{
+	uint32_t offsets[ 257 ];
+	memset( offsets, 0, sizeof( offsets ) );
+
+	uint32_t *boxOrder = &order[ box->start ];
+	for ( uint32_t i = 0; i < box->numColours; ++i )
+		offsets[ COLOUR_CHANNEL( colours[ boxOrder[ i ] ], box->channel ) + 1 ]++;
+	for ( unsigned int i = 1; i < 257; ++i )
+		offsets[ i ] += offsets[ i - 1 ];
+	for ( uint32_t i = 0; i < box->numColours; ++i )
+		scratch[ offsets[ COLOUR_CHANNEL( colours[ boxOrder[ i ] ], box->channel ) ]++ ] = boxOrder[ i ];
+
+	memcpy( boxOrder, scratch, sizeof( uint32_t ) * box->numColours );
+}
+
+static unsigned int MedianCut( const uint32_t *colours, const uint32_t *counts, uint32_t numColours, uint8_t numChannels,
+                               unsigned int maxColours, uint32_t *palette )
+{
+	uint32_t  *order   = PlMAllocA( sizeof( uint32_t ) * numColours );
+	uint32_t  *scratch = PlMAllocA( sizeof( uint32_t ) * numColours );
+	ColourBox *heap    = PlMAllocA( sizeof( ColourBox ) * maxColours );
+	for ( uint32_t i = 0; i < numColours; ++i )
+		order[ i ] = i;
+
+	uint32_t  numBoxes = 0;
+	ColourBox box      = { .start = 0, .numColours = numColours };
+	ColourBox_Update( &box, colours, counts, order, numChannels );
+	BoxHeap_Push( heap, &numBoxes, &box );
+
+	while ( numBoxes < maxColours && ColourBox_GetScore( &heap[ 0 ] ) > 0 )
+	{
+		box = BoxHeap_Pop( heap, &numBoxes );
+		ColourBox_Sort( &box, colours, order, scratch );
+
+		/* split at the weighted median, making sure neither side is empty */
+		uint64_t halfWeight = box.weight / 2;
+		uint64_t weight     = 0;
+		uint32_t split      = 1;
+		for ( ; split < box.numColours - 1; ++split )
+		{
+			weight += counts[ order[ box.start + split - 1 ] ];
+			if ( weight >= halfWeight )
+				break;
+		}
+
+		ColourBox lower = { .start = box.start, .numColours = split };
+		ColourBox upper = { .start = box.start + split, .numColours = box.numColours - split };
+		ColourBox_Update( &lower, colours, counts, order, numChannels );
+		ColourBox_Update( &upper, colours, counts, order, numChannels );
+		BoxHeap_Push( heap, &numBoxes, &lower );
+		BoxHeap_Push( heap, &numBoxes, &upper );
+	}
+
+	/* each palette entry is the weighted average of its box */
+	for ( uint32_t i = 0; i < numBoxes; ++i )
+	{
+		uint64_t sum[ 4 ] = { 0, 0, 0, 0 };
+		for ( uint32_t j = heap[ i ].start; j < heap[ i ].start + heap[ i ].numColours; ++j )
+		{
+			for ( uint8_t k = 0; k < numChannels; ++k )
+				sum[ k ] += ( uint64_t ) COLOUR_CHANNEL( colours[ order[ j ] ], k ) * counts[ order[ j ] ];
+		}
+
+		uint8_t  rgba[ 4 ] = { 0, 0, 0, 255 };
+		uint64_t w         = heap[ i ].weight;
+		for ( uint8_t k = 0; k < numChannels; ++k )
+			rgba[ k ] = ( uint8_t ) ( ( sum[ k ] + w / 2 ) / w );
+
+		palette[ i ] = PACK_COLOUR( rgba[ 0 ], rgba[ 1 ], rgba[ 2 ], rgba[ 3 ] );
+	}
+
+	PL_DELETE( heap );
+	PL_DELETE( scratch );
+	PL_DELETE( order );
+
+	return numBoxes;
+}
+
+/****************************************
+ * Nearest Colour (k-d tree)
+ ****************************************/
+
+typedef struct ColourTree
+{
+	const uint32_t *palette;
+	uint32_t       *nodes; /* implicit tree, median of each range is the node */
+	uint32_t       *scratch;
+	uint8_t        *axes;
+	uint32_t        numNodes;
+	uint8_t         numChannels;
+} ColourTree;
+
+/**
+ * Sorts the given range of nodes along an axis; the keys are only
+ * a byte, so a counting sort is quicker than anything fancier.
+ */
+static void ColourTree_Sort( ColourTree *tree, uint32_t lo, uint32_t hi, uint8_t axis )
+{
+	uint32_t offsets[ 257 ];
+	memset( offsets, 0, sizeof( offsets ) );
+
+	for ( uint32_t i = lo; i < hi; ++i )
+		offsets[ COLOUR_CHANNEL( tree->palette[ tree->nodes[ i ] ], axis ) + 1 ]++;
+	for ( unsigned int i = 1; i < 257; ++i )
+		offsets[ i ] += offsets[ i - 1 ];
+	for ( uint32_t i = lo; i < hi; ++i )
+		tree->scratch[ offsets[ COLOUR_CHANNEL( tree->palette[ tree->nodes[ i ] ], axis ) ]++ ] = tree->nodes[ i ];
+
+	memcpy( &tree->nodes[ lo ], tree->scratch, sizeof( uint32_t ) * ( hi - lo ) );
+}
+
+static void ColourTree_Build( ColourTree *tree, uint32_t lo, uint32_t hi )
+{
+	if ( hi <= lo )
+		return;
+
+	/* split along whichever channel has the largest spread */
+	uint8_t min[ 4 ] = { 255, 255, 255, 255 };
+	uint8_t max[ 4 ] = { 0, 0, 0, 0 };
+	for ( uint32_t i = lo; i < hi; ++i )
+	{
+		for ( uint8_t j = 0; j < tree->numChannels; ++j )
+		{
+			uint8_t c = COLOUR_CHANNEL( tree->palette[ tree->nodes[ i ] ], j );
+			if ( c < min[ j ] ) min[ j ] = c;
+			if ( c > max[ j ] ) max[ j ] = c;
+		}
+	}
+
+	uint8_t axis = 0;
+	for ( uint8_t j = 1; j < tree->numChannels; ++j )
+	{
+		if ( ( max[ j ] - min[ j ] ) > ( max[ axis ] - min[ axis ] ) )
+			axis = j;
+	}
+
+	uint32_t mid = lo + ( hi - lo ) / 2;
+	ColourTree_Sort( tree, lo, hi, axis );
+	tree->axes[ mid ] = axis;
+
+	ColourTree_Build( tree, lo, mid );
+	ColourTree_Build( tree, mid + 1, hi );
+}
+
+static void ColourTree_Search( const ColourTree *tree, uint32_t lo, uint32_t hi, uint32_t colour, uint32_t *bestIndex, uint32_t *bestDistance )
+{
+	if ( hi <= lo )
+		return;
+
+	uint32_t mid   = lo + ( hi - lo ) / 2;
+	uint32_t entry = tree->palette[ tree->nodes[ mid ] ];
+
+	uint32_t distance = 0;
+	for ( uint8_t j = 0; j < tree->numChannels; ++j )
+	{
+		int d = ( int ) COLOUR_CHANNEL( colour, j ) - ( int ) COLOUR_CHANNEL( entry, j );
+		distance += ( uint32_t ) ( d * d );
+	}
+	if ( distance < *bestDistance )
+	{
+		*bestDistance = distance;
+		*bestIndex    = tree->nodes[ mid ];
+	}
+
+	uint8_t axis  = tree->axes[ mid ];
+	int     delta = ( int ) COLOUR_CHANNEL( colour, axis ) - ( int ) COLOUR_CHANNEL( entry, axis );
+	if ( delta < 0 )
+	{
+		ColourTree_Search( tree, lo, mid, colour, bestIndex, bestDistance );
+		if ( ( uint32_t ) ( delta * delta ) < *bestDistance )
+			ColourTree_Search( tree, mid + 1, hi, colour, bestIndex, bestDistance );
+	}
+	else
+	{
+		ColourTree_Search( tree, mid + 1, hi, colour, bestIndex, bestDistance );
+		if ( ( uint32_t ) ( delta * delta ) < *bestDistance )
+			ColourTree_Search( tree, lo, mid, colour, bestIndex, bestDistance );
+	}
+}
+
+static uint32_t ColourTree_FindNearest( const ColourTree *tree, uint32_t colour )
+{
+	uint32_t bestIndex    = 0;
+	uint32_t bestDistance = UINT32_MAX;
+	ColourTree_Search( tree, 0, tree->numNodes, colour, &bestIndex, &bestDistance );
+	return bestIndex;
+}
+
+/****************************************
+ ****************************************/
+
+/**
+ * Generates a palette for the given pixels, along with the palette
+ * index for each pixel. If there are more unique colours than
+ * maxColours, the palette is quantised down to fit.
+ */
+PackImagePalette *PackImage_BuildPalette( const uint8_t *pixels, unsigned int numPixels, uint8_t numChannels, unsigned int maxColours )
+{
+	PackImagePalette *palette = PL_NEW( PackImagePalette );
+	palette->numPixels        = numPixels;
+	palette->pixelIndices     = PlMAllocA( sizeof( uint32_t ) * numPixels );
+
+	uint32_t maxUnique = 256;
+	palette->colours   = PlMAllocA( sizeof( uint32_t ) * maxUnique );
+	palette->counts    = PlMAllocA( sizeof( uint32_t ) * maxUnique );
+
+	ColourSet set;
+	ColourSet_Setup( &set, 1024 );
+
+	const uint8_t *pixelPos = pixels;
+	for ( unsigned int i = 0; i < numPixels; ++i, pixelPos += numChannels )
+	{
+		uint32_t colour = PACK_COLOUR( pixelPos[ 0 ], pixelPos[ 1 ], pixelPos[ 2 ], ( numChannels > 3 ) ? pixelPos[ 3 ] : 255 );
+		uint32_t index  = ColourSet_Insert( &set, colour, palette->numColours );
+		if ( index == palette->numColours )
+		{
+			if ( palette->numColours == maxUnique )
+			{
+				maxUnique *= 2;
+				palette->colours = PlReAllocA( palette->colours, sizeof( uint32_t ) * maxUnique );
+				palette->counts  = PlReAllocA( palette->counts, sizeof( uint32_t ) * maxUnique );
+			}
+
+			palette->colours[ index ] = colour;
+			palette->counts[ index ]  = 0;
+			palette->numColours++;
+		}
+
+		palette->counts[ index ]++;
+		palette->pixelIndices[ i ] = index;
+	}
+
+	ColourSet_Clear( &set );
+
+	palette->numUniqueColours = palette->numColours;
+	if ( palette->numColours <= maxColours )
+		return palette;
+
+	Print( "Quantising %u colours down to %u...\n", palette->numColours, maxColours );
+
+	uint32_t    *quantised    = PlMAllocA( sizeof( uint32_t ) * maxColours );
+	unsigned int numQuantised = MedianCut( palette->colours, palette->counts, palette->numColours, numChannels, maxColours, quantised );
+
+	/* map every unique colour onto its nearest palette entry */
+	ColourTree tree;
+	tree.palette     = quantised;
+	tree.numNodes    = numQuantised;
+	tree.numChannels = numChannels;
+	tree.nodes       = PlMAllocA( sizeof( uint32_t ) * numQuantised );
+	tree.scratch     = PlMAllocA( sizeof( uint32_t ) * numQuantised );
+	tree.axes        = PlMAllocA( sizeof( uint8_t ) * numQuantised );
+	for ( uint32_t i = 0; i < numQuantised; ++i )
+		tree.nodes[ i ] = i;
+
+	ColourTree_Build( &tree, 0, numQuantised );
+
+	uint32_t *remap = PlMAllocA( sizeof( uint32_t ) * palette->numColours );
+	for ( uint32_t i = 0; i < palette->numColours; ++i )
+		remap[ i ] = ColourTree_FindNearest( &tree, palette->colours[ i ] );
+
+	PL_DELETE( tree.axes );
+	PL_DELETE( tree.scratch );
+	PL_DELETE( tree.nodes );
+
+	/* now recount, dropping any entries nothing ended up using */
+	uint32_t *counts = PlCAllocA( numQuantised, sizeof( uint32_t ) );
+	for ( unsigned int i = 0; i < numPixels; ++i )
+		counts[ remap[ palette->pixelIndices[ i ] ] ]++;
+
+	uint32_t *compact   = PlMAllocA( sizeof( uint32_t ) * numQuantised );
+	uint32_t  numActive = 0;
+	for ( uint32_t i = 0; i < numQuantised; ++i )
+	{
+		compact[ i ] = numActive;
+		if ( counts[ i ] == 0 )
+			continue;
+
+		quantised[ numActive ] = quantised[ i ];
+		counts[ numActive ]    = counts[ i ];
+		numActive++;
+	}
+
+	for ( unsigned int i = 0; i < numPixels; ++i )
+		palette->pixelIndices[ i ] = compact[ remap[ palette->pixelIndices[ i ] ] ];
+
+	PL_DELETE( compact );
+	PL_DELETE( remap );
+
+	PL_DELETE( palette->colours );
+	PL_DELETE( palette->counts );
+	palette->colours    = quantised;
+	palette->counts     = counts;
+	palette->numColours = numActive;
+
+	return palette;
+}
+
+void PackImage_DestroyPalette( PackImagePalette *palette )
+{
+	if ( palette == NULL )
+		return;
+
+	PL_DELETE( palette->pixelIndices );
+	PL_DELETE( palette->colours );
+	PL_DELETE( palette->counts );
+	PL_DELETE( palette );
+}
+
+void PackImage_GetPaletteColour( const PackImagePalette *palette, unsigned int index, uint8_t *rgba )
+{
+	uint32_t colour = palette->colours[ index ];
+	for ( uint8_t i = 0; i < 4; ++i )
+		rgba[ i ] = COLOUR_CHANNEL( colour, i );
+}
+
+/**
+ * Peak signal-to-noise ratio of the palettised image against the
+ * original pixels, in decibels. Returns INFINITY if it's lossless.
+ */
+double PackImage_CalculatePSNR( const PackImagePalette *palette, const uint8_t *pixels, uint8_t numChannels )
+{
+	uint64_t sumSquaredError = 0;
+	for ( unsigned int i = 0; i < palette->numPixels; ++i, pixels += numChannels )
+	{
+		uint32_t colour = palette->colours[ palette->pixelIndices[ i ] ];
+		for ( uint8_t j = 0; j < numChannels; ++j )
+		{
+			int d = ( int ) pixels[ j ] - ( int ) COLOUR_CHANNEL( colour, j );
+			sumSquaredError += ( uint64_t ) ( d * d );
+		}
+	}
+
+	if ( sumSquaredError == 0 )
+		return INFINITY;
+
+	double mse = ( double ) sumSquaredError / ( ( double ) palette->numPixels * numChannels );
+	return 10.0 * log10( ( 255.0 * 255.0 ) / mse );
+}
+
+/****************************************
+ * Benchmark
+ ****************************************/
+
+/**
+ * The previous approach, linearly searching the palette for every pixel.
+ * Only kept around so we have something to compare against.
+ */
+static unsigned int CountUniqueColoursLinear( const uint8_t *pixels, unsigned int numPixels, uint8_t numChannels )
+{
+	uint32_t    *colours    = PlMAllocA( sizeof( uint32_t ) * numPixels );
+	unsigned int numColours = 0;
+	for ( unsigned int i = 0; i < numPixels; ++i, pixels += numChannels )
+	{
+		uint32_t     colour = PACK_COLOUR( pixels[ 0 ], pixels[ 1 ], pixels[ 2 ], ( numChannels > 3 ) ? pixels[ 3 ] : 255 );
+		unsigned int j;
+		for ( j = 0; j < numColours; ++j )
+		{
+			if ( colours[ j ] == colour )
+				break;
+		}
+
+		if ( j == numColours )
+			colours[ numColours++ ] = colour;
+	}
+
+	PL_DELETE( colours );
+	return numColours;
+}
+
+static uint8_t ClampByte( int v )
+{
+	return ( uint8_t ) ( v < 0 ? 0 : ( v > 255 ? 255 : v ) );
+}
+
+void PackImage_GenerateBenchmarkImage( uint8_t *pixels, unsigned int width, unsigned int height )
+{
+	/* smooth gradients with some noise on top, so we end up with lots of unique colours */
+	uint32_t seed = 0x12345678;
+	for ( unsigned int y = 0; y < height; ++y )
+	{
+		for ( unsigned int x = 0; x < width; ++x, pixels += 4 )
+		{
+			seed = seed * 1664525U + 1013904223U;
+			int noise = ( int ) ( ( seed >> 24 ) & 15 ) - 8;
+
+			pixels[ 0 ] = ClampByte( ( int ) ( ( x * 255 ) / width ) + noise );
+			pixels[ 1 ] = ClampByte( ( int ) ( ( y * 255 ) / height ) - noise );
+			pixels[ 2 ] = ClampByte( ( int ) ( ( ( x + y ) * 127 ) / ( width + height ) ) + noise );
+			pixels[ 3 ] = 255;
+		}
+	}
+}
+
+void PackImage_Benchmark( unsigned int width, unsigned int height )
+{
+	Print( "Benchmarking cluster palette generation (%ux%u)...\n", width, height );
+
+	unsigned int numPixels = width * height;
+	uint8_t     *pixels    = PlMAllocA( numPixels * 4 );
+	PackImage_GenerateBenchmarkImage( pixels, width, height );
+
+	/* the linear search falls over on large images, so only give it a small slice */
+	unsigned int numLinearPixels = ( numPixels < 256 * 256 ) ? numPixels : 256 * 256;
+	double       startTime       = PlGetCurrentSeconds();
+	unsigned int numLinear       = CountUniqueColoursLinear( pixels, numLinearPixels, 4 );
+	double       linearTime      = PlGetCurrentSeconds() - startTime;
+
+	startTime                       = PlGetCurrentSeconds();
+	PackImagePalette *slicePalette  = PackImage_BuildPalette( pixels, numLinearPixels, 4, UINT32_MAX );
+	double            hashSliceTime = PlGetCurrentSeconds() - startTime;
+	if ( slicePalette->numColours != numLinear )
+		Error( "Unique colour count mismatch (%u vs %u)!\n", slicePalette->numColours, numLinear );
+	PackImage_DestroyPalette( slicePalette );
+
+	Print( "Unique colours (%u pixels, %u colours): linear %.3fms, hashed %.3fms (%.1fx)\n",
+	       numLinearPixels, numLinear, linearTime * 1000.0, hashSliceTime * 1000.0,
+	       hashSliceTime > 0.0 ? linearTime / hashSliceTime : 0.0 );
+
+	startTime                  = PlGetCurrentSeconds();
+	PackImagePalette *palette  = PackImage_BuildPalette( pixels, numPixels, 4, PackImage_GetMaxClusterColours( numPixels ) );
+	double            fullTime = PlGetCurrentSeconds() - startTime;
+
+	Print( "Full image (%u pixels): %u colours in %.3fms, PSNR %.2fdB\n",
+	       numPixels, palette->numColours, fullTime * 1000.0, PackImage_CalculatePSNR( palette, pixels, 4 ) );
+
+	startTime                      = PlGetCurrentSeconds();
+	PackImagePalette *smallPalette = PackImage_BuildPalette( pixels, numPixels, 4, 256 );
+	fullTime                       = PlGetCurrentSeconds() - startTime;
+
+	Print( "Full image, 256 colours: %.3fms, PSNR %.2fdB\n",
+	       fullTime * 1000.0, PackImage_CalculatePSNR( smallPalette, pixels, 4 ) );
+
+	PackImage_DestroyPalette( smallPalette );
+	PackImage_DestroyPalette( palette );
+	PL_DELETE( pixels );
+}
@@ -4,9 +4,11 @@
 #include <plcore/pl.h>
 #include <plcore/pl_filesystem.h>
 #include <plcore/pl_image.h>
+#include <plcore/pl_hashtable.h>
 #include <plmodel/plm.h>
 
 #include "node/public/node.h"
+#include "common/public/common_format_gfx.h"
 
 #include "pkgman.h"
 #include "parser.h"
@@ -15,6 +17,48 @@
 
 static unsigned int numFiles = 0;
 
+/* used for deduplicating identical file contents */
+typedef struct PackedBlob
+{
+	PLPath       loadPath;   /* where the original data came from, for verification */
+	unsigned int index;      /* index of the entry that owns the stored data */
+	size_t       storedSize; /* bytes the data took up in the package */
+} PackedBlob;
+typedef struct PackedBlobKey
+{
+	uint64_t hash;
+	uint64_t size;
+} PackedBlobKey;
+static PLHashTable *packedBlobs     = NULL;
+static unsigned int numAliasedFiles = 0;
+static size_t       numBytesSaved   = 0;
+
+static uint64_t HashData( const uint8_t *buf, size_t size )
+{
+	/* FNV-1a */
+	uint64_t hash = 14695981039346656037ULL;
+	for ( size_t i = 0; i < size; ++i )
+	{
+		hash ^= buf[ i ];
+		hash *= 1099511628211ULL;
+	}
+
+	return hash;
+}
+
+static bool CompareFileData( const char *path, const void *buf, size_t size )
+{
+	PLFile *file = PlOpenFile( path, true );
+	if ( file == NULL )
+		return false;
+
+	bool match = ( PlGetFileSize( file ) == size && memcmp( PlGetFileData( file ), buf, size ) == 0 );
+
+	PlCloseFile( file );
+
+	return match;
+}
+
 //static FILE *fileOutPtr = NULL;
 static char outputPath[ 32 ] = { '\0' };
 
@@ -103,7 +147,45 @@ void Pkg_AddFile( FILE *pack, const char *path )
 	if ( inFile == NULL )
 		Error( "Failed to add file \"%s\"!\nPL: %s\n", loadPath, PlGetError() );
 
-	Common_Pkg_AddData( pack, packPath, PlGetFileData( inFile ), PlGetFileSize( inFile ) );
+	const uint8_t *data = PlGetFileData( inFile );
+	size_t         size = PlGetFileSize( inFile );
+
+	/* if we've already stored identical data, just point to that instead */
+	if ( packedBlobs == NULL )
+		packedBlobs = PlCreateHashTable();
+
+	PackedBlobKey key;
+	PL_ZERO_( key );
+	key.hash = HashData( data, size );
+	key.size = size;
+
+	PackedBlob *blob = PlLookupHashTableUserData( packedBlobs, &key, sizeof( PackedBlobKey ) );
+	if ( blob != NULL && size > 0 && CompareFileData( blob->loadPath, data, size ) )
+	{
+		Print( "Aliasing \"%s\" to entry %u\n", packPath, blob->index );
+
+		long offset = ftell( pack );
+		Common_Pkg_AddAlias( pack, packPath, size, blob->index );
+		size_t aliasSize = ( size_t ) ( ftell( pack ) - offset );
+
+		numAliasedFiles++;
+		numBytesSaved += ( blob->storedSize > aliasSize ) ? ( blob->storedSize - aliasSize ) : 0;
+	}
+	else
+	{
+		long offset = ftell( pack );
+		Common_Pkg_AddData( pack, packPath, data, size );
+
+		if ( blob == NULL && size > 0 )
+		{
+			blob             = PL_NEW( PackedBlob );
+			blob->index      = numFiles;
+			blob->storedSize = ( size_t ) ( ftell( pack ) - offset );
+			snprintf( blob->loadPath, sizeof( blob->loadPath ), "%s", loadPath );
+			PlInsertHashTableNode( packedBlobs, &key, sizeof( PackedBlobKey ), blob );
+		}
+	}
+
 	numFiles++;
 
 	PlCloseFile( inFile );
@@ -185,6 +267,73 @@ static const char *CMD_AddModel( const char *buf )
 	return buf;
 }
 
+static const char *CMD_AddImage( const char *buf )
+{
+	const char *lineEnd = P_SkipLine( buf );
+
+	PLPath filePath;
+	buf = P_ReadString( buf, filePath, sizeof( filePath ) );
+	if ( buf == NULL )
+		Error( "Failed to read image path!\n" );
+
+	char formatName[ 16 ];
+	buf = P_ReadString( buf, formatName, sizeof( formatName ) );
+	if ( buf == NULL )
+		Error( "Failed to read image format!\n" );
+
+	/* anything that isn't colour, e.g. normal maps, should be flagged
+	 * as linear so its mips aren't gamma corrected or alpha weighted */
+	bool isLinear = false;
+	if ( buf < lineEnd && strncmp( buf, "linear", 6 ) == 0 )
+	{
+		isLinear = true;
+		buf      = P_SkipLine( buf );
+	}
+
+	static const struct
+	{
+		const char *name;
+		uint8_t     format;
+	} formats[] = {
+	        {"cluster", PGFX_FORMAT_CLUSTER   },
+	        { "dxt1",   PGFX_FORMAT_DXT1      },
+	        { "dxt1a",  PGFX_FORMAT_DXT1_ALPHA},
+	        { "dxt3",   PGFX_FORMAT_DXT3      },
+	        { "dxt5",   PGFX_FORMAT_DXT5      },
+	};
+	unsigned int i;
+	for ( i = 0; i < PL_ARRAY_ELEMENTS( formats ); ++i )
+	{
+		if ( pl_strcasecmp( formatName, formats[ i ].name ) == 0 )
+			break;
+	}
+	if ( i >= PL_ARRAY_ELEMENTS( formats ) )
+		Error( "Unknown image format \"%s\" for \"%s\"!\n", formatName, filePath );
+
+	Print( "Converting image: %s\n", filePath );
+
+	PLImage *image = PlLoadImage( filePath );
+	if ( image == NULL )
+		Error( "Failed to load image: %s\nPL: %s\n", filePath, PlGetError() );
+
+	/* write the packed image alongside the original, and pack that instead */
+	PLPath outPath;
+	snprintf( outPath, sizeof( outPath ), "%s", filePath );
+	const char *extension = PlGetFileExtension( filePath );
+	if ( extension != NULL && *extension != '\0' )
+		outPath[ strlen( filePath ) - strlen( extension ) ] = '\0';
+	else
+		strcat( outPath, "." );
+	strcat( outPath, "gfx" );
+
+	PackImage_Write( outPath, image, formats[ i ].format, isLinear );
+	PlDestroyImage( image );
+
+	Pkg_AddFile( fileOutPtr, outPath );
+
+	return buf;
+}
+
 static void        PKG_ParseScript( const char *buffer, size_t length );
 static void        PKG_LoadParseScript( const char *path );
 static const char *CMD_Include( const char *buf )
@@ -212,6 +361,7 @@ static void PKG_ParseScript( const char *buffer, size_t length )
 	                { "dir ",     CMD_AddDirectory     }, /* dir <path> <extension> */
 	                { "add ",     CMD_AddFile          }, /* add <path> */
 	                { "model ",   CMD_AddModel         }, /* cmodel <path> <material-path> */
+	                { "image ",   CMD_AddImage         }, /* image <path> <cluster/dxt1/dxt1a/dxt3/dxt5> [linear] */
 	                { "include ", CMD_Include          }, /* include <path> */
     };
 
@@ -272,6 +422,14 @@ int main( int argc, char **argv )
 	PlmRegisterModelLoader( "smd", MDL_SMD_LoadFile );
 
 	Print( "Package Manager\nCopyright (C) 2020-2022 Mark E Sowden <markelswo@gmail.com>\n" );
+	if ( PlHasCommandLineArgument( "-benchmark" ) )
+	{
+		PackImage_Benchmark( 2048, 2048 );
+		PackImage_BenchmarkCompression( 4096, 4096 );
+		PackImage_BenchmarkLoading( 2048, 2048 );
+		return EXIT_SUCCESS;
+	}
+
 	if ( argc < 2 )
 	{
 		Print( "Please provide a package script!\nExample: pkgman myscript.txt\n" );
@@ -285,6 +443,7 @@ int main( int argc, char **argv )
 	Common_Pkg_WriteHeader( fileOutPtr, numFiles );
 	fclose( fileOutPtr );
 
+	Print( "Packed %u files, %u aliased (%lu bytes saved)\n", numFiles, numAliasedFiles, ( unsigned long ) numBytesSaved );
 	Print( "Done!\n" );
 }
 #endif
@@ -31,4 +31,30 @@ NLNode   *MDL_ConvertPlatformModelToNodeModel( const PLMModel *model );
 PLMModel *MDL_SMD_LoadFile( const char *path );
 
 /* pack_image.c */
-void PackImage_Write( const char *path, const PLImage *image, uint8_t destFormat );
+void         PackImage_Write( const char *path, const PLImage *image, uint8_t destFormat, bool isLinear );
+unsigned int PackImage_GetMaxClusterColours( unsigned int numPixels );
+void         PackImage_BenchmarkCompression( unsigned int width, unsigned int height );
+void         PackImage_BenchmarkLoading( unsigned int width, unsigned int height );
+
+/* pack_image_mipmap.c */
+unsigned int PackImage_GetNumMipLevels( unsigned int width, unsigned int height );
+uint8_t     *PackImage_GenerateMipLevel( const uint8_t *src, unsigned int srcWidth, unsigned int srcHeight, uint8_t numChannels,
+                                         bool isLinear, unsigned int *dstWidth, unsigned int *dstHeight );
+
+/* pack_image_quantise.c */
+typedef struct PackImagePalette
+{
+	uint32_t    *colours;          /* packed rgba */
+	uint32_t    *counts;           /* number of pixels using each colour */
+	unsigned int numColours;
+	unsigned int numUniqueColours; /* in the source, before any quantisation */
+	uint32_t    *pixelIndices;     /* palette index for each pixel */
+	unsigned int numPixels;
+} PackImagePalette;
+
+PackImagePalette *PackImage_BuildPalette( const uint8_t *pixels, unsigned int numPixels, uint8_t numChannels, unsigned int maxColours );
+void              PackImage_DestroyPalette( PackImagePalette *palette );
+void              PackImage_GetPaletteColour( const PackImagePalette *palette, unsigned int index, uint8_t *rgba );
+double            PackImage_CalculatePSNR( const PackImagePalette *palette, const uint8_t *pixels, uint8_t numChannels );
+void              PackImage_Benchmark( unsigned int width, unsigned int height );
+void              PackImage_GenerateBenchmarkImage( uint8_t *pixels, unsigned int width, unsigned int height );
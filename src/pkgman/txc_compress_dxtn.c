@@ -26,6 +26,15 @@
 #include <stdlib.h>
 #include "txc_dxtn.h"
 
+#if defined( __SSE2__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 )
+#define TXC_USE_SSE2
+#include <emmintrin.h>
+#endif
+#if defined( TXC_USE_SSE2 ) && ( defined( __GNUC__ ) || defined( __clang__ ) )
+#define TXC_USE_AVX2
+#include <immintrin.h>
+#endif
+
 /* weights used for error function, basically weights (unsquared 2/4/1) according to rgb->luminance conversion
    not sure if this really reflects visual perception */
 #define REDWEIGHT   4
@@ -34,6 +43,171 @@
 
 #define ALPHACUT 127
 
+/* when set, blocks are compressed one at a time on the calling thread with the
+   plain C colour search, which is what the vectorised paths are tested against */
+static GLboolean referencemode = GL_FALSE;
+
+void tx_compress_dxtn_set_reference( GLboolean reference )
+{
+	referencemode = reference;
+}
+
+/* find the closest of the first numcolors entries of cv for every pixel in the
+   block, using the weighted distance metric. ties go to the lowest index. */
+static void findbestcolorsscalar( GLubyte srccolors[ 4 ][ 4 ][ 4 ], GLubyte cv[ 4 ][ 4 ], GLint numcolors,
+                                  GLint numxpixels, GLint numypixels, GLubyte enc[ 16 ], GLuint error[ 16 ] )
+{
+	GLint  i, j, colors, colordist;
+	GLuint pixerror, pixerrorbest;
+
+	for ( j = 0; j < numypixels; j++ )
+	{
+		for ( i = 0; i < numxpixels; i++ )
+		{
+			pixerrorbest = 0xffffffff;
+			for ( colors = 0; colors < numcolors; colors++ )
+			{
+				colordist = srccolors[ j ][ i ][ 0 ] - cv[ colors ][ 0 ];
+				pixerror  = colordist * colordist * REDWEIGHT;
+				colordist = srccolors[ j ][ i ][ 1 ] - cv[ colors ][ 1 ];
+				pixerror += colordist * colordist * GREENWEIGHT;
+				colordist = srccolors[ j ][ i ][ 2 ] - cv[ colors ][ 2 ];
+				pixerror += colordist * colordist * BLUEWEIGHT;
+				if ( pixerror < pixerrorbest )
+				{
+					pixerrorbest       = pixerror;
+					enc[ j * 4 + i ]   = colors;
+				}
+			}
+			error[ j * 4 + i ] = pixerrorbest;
+		}
+	}
+}
+
+#if defined( TXC_USE_SSE2 )
+/* each pixel sits in a 32-bit lane with its channel in the low 16 bits, so the
+   weighted square can be done with 16-bit multiplies and a madd, keeping this
+   to plain SSE2; the results are identical to the scalar version */
+static void findbestcolorssse2( GLubyte srccolors[ 4 ][ 4 ][ 4 ], GLubyte cv[ 4 ][ 4 ], GLint numcolors,
+                                GLubyte enc[ 16 ], GLuint error[ 16 ] )
+{
+	const __m128i bytemask = _mm_set1_epi32( 0xff );
+	const __m128i redw     = _mm_set1_epi32( REDWEIGHT );
+	const __m128i greenw   = _mm_set1_epi32( GREENWEIGHT );
+	const __m128i bluew    = _mm_set1_epi32( BLUEWEIGHT );
+	GLint         j, colors;
+
+	for ( j = 0; j < 4; j++ )
+	{
+		__m128i pixels = _mm_loadu_si128( ( const __m128i * ) srccolors[ j ] );
+		__m128i red    = _mm_and_si128( pixels, bytemask );
+		__m128i green  = _mm_and_si128( _mm_srli_epi32( pixels, 8 ), bytemask );
+		__m128i blue   = _mm_and_si128( _mm_srli_epi32( pixels, 16 ), bytemask );
+		__m128i best   = _mm_set1_epi32( 0x7fffffff );
+		__m128i bestenc = _mm_setzero_si128();
+
+		for ( colors = 0; colors < numcolors; colors++ )
+		{
+			__m128i dr  = _mm_sub_epi16( red, _mm_set1_epi32( cv[ colors ][ 0 ] ) );
+			__m128i dg  = _mm_sub_epi16( green, _mm_set1_epi32( cv[ colors ][ 1 ] ) );
+			__m128i db  = _mm_sub_epi16( blue, _mm_set1_epi32( cv[ colors ][ 2 ] ) );
+			__m128i err = _mm_madd_epi16( _mm_mullo_epi16( dr, redw ), dr );
+			err         = _mm_add_epi32( err, _mm_madd_epi16( _mm_mullo_epi16( dg, greenw ), dg ) );
+			err         = _mm_add_epi32( err, _mm_madd_epi16( _mm_mullo_epi16( db, bluew ), db ) );
+
+			__m128i better = _mm_cmplt_epi32( err, best );
+			best           = _mm_or_si128( _mm_and_si128( better, err ), _mm_andnot_si128( better, best ) );
+			bestenc        = _mm_or_si128( _mm_and_si128( better, _mm_set1_epi32( colors ) ), _mm_andnot_si128( better, bestenc ) );
+		}
+
+		GLuint encs[ 4 ];
+		_mm_storeu_si128( ( __m128i * ) &error[ j * 4 ], best );
+		_mm_storeu_si128( ( __m128i * ) encs, bestenc );
+		enc[ j * 4 + 0 ] = ( GLubyte ) encs[ 0 ];
+		enc[ j * 4 + 1 ] = ( GLubyte ) encs[ 1 ];
+		enc[ j * 4 + 2 ] = ( GLubyte ) encs[ 2 ];
+		enc[ j * 4 + 3 ] = ( GLubyte ) encs[ 3 ];
+	}
+}
+#endif
+
+#if defined( TXC_USE_AVX2 )
+/* same as the sse2 path, but two rows at a time */
+__attribute__( ( target( "avx2" ) ) ) static void findbestcolorsavx2( GLubyte srccolors[ 4 ][ 4 ][ 4 ], GLubyte cv[ 4 ][ 4 ], GLint numcolors,
+                                                                    GLubyte enc[ 16 ], GLuint error[ 16 ] )
+{
+	const __m256i bytemask = _mm256_set1_epi32( 0xff );
+	const __m256i redw     = _mm256_set1_epi32( REDWEIGHT );
+	const __m256i greenw   = _mm256_set1_epi32( GREENWEIGHT );
+	const __m256i bluew    = _mm256_set1_epi32( BLUEWEIGHT );
+	GLint         j, colors;
+
+	for ( j = 0; j < 4; j += 2 )
+	{
+		__m256i pixels  = _mm256_loadu_si256( ( const __m256i * ) srccolors[ j ] );
+		__m256i red     = _mm256_and_si256( pixels, bytemask );
+		__m256i green   = _mm256_and_si256( _mm256_srli_epi32( pixels, 8 ), bytemask );
+		__m256i blue    = _mm256_and_si256( _mm256_srli_epi32( pixels, 16 ), bytemask );
+		__m256i best    = _mm256_set1_epi32( 0x7fffffff );
+		__m256i bestenc = _mm256_setzero_si256();
+
+		for ( colors = 0; colors < numcolors; colors++ )
+		{
+			__m256i dr  = _mm256_sub_epi16( red, _mm256_set1_epi32( cv[ colors ][ 0 ] ) );
+			__m256i dg  = _mm256_sub_epi16( green, _mm256_set1_epi32( cv[ colors ][ 1 ] ) );
+			__m256i db  = _mm256_sub_epi16( blue, _mm256_set1_epi32( cv[ colors ][ 2 ] ) );
+			__m256i err = _mm256_madd_epi16( _mm256_mullo_epi16( dr, redw ), dr );
+			err         = _mm256_add_epi32( err, _mm256_madd_epi16( _mm256_mullo_epi16( dg, greenw ), dg ) );
+			err         = _mm256_add_epi32( err, _mm256_madd_epi16( _mm256_mullo_epi16( db, bluew ), db ) );
+
+			__m256i better = _mm256_cmpgt_epi32( best, err );
+			best           = _mm256_blendv_epi8( best, err, better );
+			bestenc        = _mm256_blendv_epi8( bestenc, _mm256_set1_epi32( colors ), better );
+		}
+
+		GLuint encs[ 8 ];
+		GLint  k;
+		_mm256_storeu_si256( ( __m256i * ) &error[ j * 4 ], best );
+		_mm256_storeu_si256( ( __m256i * ) encs, bestenc );
+		for ( k = 0; k < 8; k++ )
+			enc[ j * 4 + k ] = ( GLubyte ) encs[ k ];
+	}
+}
+
+static GLboolean hasavx2( void )
+{
+	static int supported = -1;
+	if ( supported < 0 )
+	{
+		__builtin_cpu_init();
+		supported = __builtin_cpu_supports( "avx2" ) ? 1 : 0;
+	}
+	return supported ? GL_TRUE : GL_FALSE;
+}
+#endif
+
+static void findbestcolors( GLubyte srccolors[ 4 ][ 4 ][ 4 ], GLubyte cv[ 4 ][ 4 ], GLint numcolors,
+                            GLint numxpixels, GLint numypixels, GLubyte enc[ 16 ], GLuint error[ 16 ] )
+{
+	/* the vector paths only deal with complete blocks */
+	if ( !referencemode && numxpixels == 4 && numypixels == 4 )
+	{
+#if defined( TXC_USE_AVX2 )
+		if ( hasavx2() )
+		{
+			findbestcolorsavx2( srccolors, cv, numcolors, enc, error );
+			return;
+		}
+#endif
+#if defined( TXC_USE_SSE2 )
+		findbestcolorssse2( srccolors, cv, numcolors, enc, error );
+		return;
+#endif
+	}
+
+	findbestcolorsscalar( srccolors, cv, numcolors, numxpixels, numypixels, enc, error );
+}
+
 static void fancybasecolorsearch( GLubyte *blkaddr, GLubyte srccolors[ 4 ][ 4 ][ 4 ], GLubyte *bestcolor[ 2 ],
                                   GLint numxpixels, GLint numypixels, GLint type, GLboolean haveAlpha )
 {
@@ -42,9 +216,10 @@ static void fancybasecolorsearch( GLubyte *blkaddr, GLubyte srccolors[ 4 ][ 4 ][
 	/* TODO could also try to find a better encoding for the 3-color-encoding type, this really should be done
       if it's rgba_dxt1 and we have alpha in the block, currently even values which will be mapped to black
       due to their alpha value will influence the result */
-	GLint   i, j, colors, z;
-	GLuint  pixerror, pixerrorred, pixerrorgreen, pixerrorblue, pixerrorbest;
-	GLint   colordist, blockerrlin[ 2 ][ 3 ];
+	GLint   i, j, z;
+	GLint   blockerrlin[ 2 ][ 3 ];
+	GLubyte bestenc[ 16 ];
+	GLuint  besterror[ 16 ];
 	GLubyte nrcolor[ 2 ];
 	GLint   pixerrorcolorbest[ 3 ];
 	GLubyte enc = 0;
@@ -91,31 +266,16 @@ static void fancybasecolorsearch( GLubyte *blkaddr, GLubyte srccolors[ 4 ][ 4 ][
 	nrcolor[ 0 ] = 0;
 	nrcolor[ 1 ] = 0;
 
+	findbestcolors( srccolors, cv, 4, numxpixels, numypixels, bestenc, besterror );
+
 	for ( j = 0; j < numypixels; j++ )
 	{
 		for ( i = 0; i < numxpixels; i++ )
 		{
-			pixerrorbest = 0xffffffff;
-			for ( colors = 0; colors < 4; colors++ )
-			{
-				colordist   = srccolors[ j ][ i ][ 0 ] - ( cv[ colors ][ 0 ] );
-				pixerror    = colordist * colordist * REDWEIGHT;
-				pixerrorred = colordist;
-				colordist   = srccolors[ j ][ i ][ 1 ] - ( cv[ colors ][ 1 ] );
-				pixerror += colordist * colordist * GREENWEIGHT;
-				pixerrorgreen = colordist;
-				colordist     = srccolors[ j ][ i ][ 2 ] - ( cv[ colors ][ 2 ] );
-				pixerror += colordist * colordist * BLUEWEIGHT;
-				pixerrorblue = colordist;
-				if ( pixerror < pixerrorbest )
-				{
-					enc                    = colors;
-					pixerrorbest           = pixerror;
-					pixerrorcolorbest[ 0 ] = pixerrorred;
-					pixerrorcolorbest[ 1 ] = pixerrorgreen;
-					pixerrorcolorbest[ 2 ] = pixerrorblue;
-				}
-			}
+			enc                    = bestenc[ j * 4 + i ];
+			pixerrorcolorbest[ 0 ] = srccolors[ j ][ i ][ 0 ] - cv[ enc ][ 0 ];
+			pixerrorcolorbest[ 1 ] = srccolors[ j ][ i ][ 1 ] - cv[ enc ][ 1 ];
+			pixerrorcolorbest[ 2 ] = srccolors[ j ][ i ][ 2 ] - cv[ enc ][ 2 ];
 			if ( enc == 0 )
 			{
 				for ( z = 0; z < 3; z++ )
@@ -271,9 +431,10 @@ static void storedxtencodedblock( GLubyte *blkaddr, GLubyte srccolors[ 4 ][ 4 ][
 {
 	/* use same luminance-weighted distance metric to determine encoding as for finding the base colors */
 
-	GLint    i, j, colors;
-	GLuint   testerror, testerror2, pixerror, pixerrorbest;
-	GLint    colordist;
+	GLint    i, j;
+	GLuint   testerror, testerror2, pixerrorbest;
+	GLubyte  bestenc[ 16 ];
+	GLuint   besterror[ 16 ];
 	GLushort color0, color1, tempcolor;
 	GLuint   bits = 0, bits2 = 0;
 	GLubyte *colorptr;
@@ -309,27 +470,13 @@ static void storedxtencodedblock( GLubyte *blkaddr, GLubyte srccolors[ 4 ][ 4 ][
 	}
 
 	testerror = 0;
+	findbestcolors( srccolors, cv, 4, numxpixels, numypixels, bestenc, besterror );
 	for ( j = 0; j < numypixels; j++ )
 	{
 		for ( i = 0; i < numxpixels; i++ )
 		{
-			pixerrorbest = 0xffffffff;
-			for ( colors = 0; colors < 4; colors++ )
-			{
-				colordist = srccolors[ j ][ i ][ 0 ] - cv[ colors ][ 0 ];
-				pixerror  = colordist * colordist * REDWEIGHT;
-				colordist = srccolors[ j ][ i ][ 1 ] - cv[ colors ][ 1 ];
-				pixerror += colordist * colordist * GREENWEIGHT;
-				colordist = srccolors[ j ][ i ][ 2 ] - cv[ colors ][ 2 ];
-				pixerror += colordist * colordist * BLUEWEIGHT;
-				if ( pixerror < pixerrorbest )
-				{
-					pixerrorbest = pixerror;
-					enc          = colors;
-				}
-			}
-			testerror += pixerrorbest;
-			bits |= enc << ( 2 * ( j * 4 + i ) );
+			testerror += besterror[ j * 4 + i ];
+			bits |= bestenc[ j * 4 + i ] << ( 2 * ( j * 4 + i ) );
 		}
 	}
 	/* some hw might disagree but actually decoding should always use 4-color encoding
@@ -346,11 +493,11 @@ static void storedxtencodedblock( GLubyte *blkaddr, GLubyte srccolors[ 4 ][ 4 ][
 			cv[ 3 ][ i ] = 0;
 		}
 		testerror2 = 0;
+		findbestcolors( srccolors, cv, 3, numxpixels, numypixels, bestenc, besterror );
 		for ( j = 0; j < numypixels; j++ )
 		{
 			for ( i = 0; i < numxpixels; i++ )
 			{
-				pixerrorbest = 0xffffffff;
 				if ( ( type == GL_COMPRESSED_RGBA_S3TC_DXT1_EXT ) && ( srccolors[ j ][ i ][ 3 ] <= ALPHACUT ) )
 				{
 					enc          = 3;
@@ -358,24 +505,10 @@ static void storedxtencodedblock( GLubyte *blkaddr, GLubyte srccolors[ 4 ][ 4 ][
 				}
 				else
 				{
-					/* we're calculating the same what we have done already for colors 0-1 above... */
-					for ( colors = 0; colors < 3; colors++ )
-					{
-						colordist = srccolors[ j ][ i ][ 0 ] - cv[ colors ][ 0 ];
-						pixerror  = colordist * colordist * REDWEIGHT;
-						colordist = srccolors[ j ][ i ][ 1 ] - cv[ colors ][ 1 ];
-						pixerror += colordist * colordist * GREENWEIGHT;
-						colordist = srccolors[ j ][ i ][ 2 ] - cv[ colors ][ 2 ];
-						pixerror += colordist * colordist * BLUEWEIGHT;
-						if ( pixerror < pixerrorbest )
-						{
-							pixerrorbest = pixerror;
-							/* need to exchange colors later */
-							if ( colors > 1 ) enc = colors;
-							else
-								enc = colors ^ 1;
-						}
-					}
+					/* need to exchange colors later */
+					enc          = bestenc[ j * 4 + i ];
+					enc          = ( enc > 1 ) ? enc : ( enc ^ 1 );
+					pixerrorbest = besterror[ j * 4 + i ];
 				}
 				testerror2 += pixerrorbest;
 				bits2 |= enc << ( 2 * ( j * 4 + i ) );
@@ -890,15 +1023,58 @@ static void extractsrccolors( GLubyte srcpixels[ 4 ][ 4 ][ 4 ], const GLchan *sr
 }
 
 
-void tx_compress_dxtn( GLint srccomps, GLint width, GLint height, const GLubyte *srcPixData,
-                       GLenum destFormat, GLubyte *dest, GLint dstRowStride )
+static void compressdxtnrow( GLint srccomps, GLint width, GLint height, const GLubyte *srcPixData,
+                             GLenum destFormat, GLubyte *blkaddr, GLint j )
 {
-	GLubyte *     blkaddr = dest;
 	GLubyte       srcpixels[ 4 ][ 4 ][ 4 ];
-	const GLchan *srcaddr = srcPixData;
+	const GLchan *srcaddr;
 	GLint         numxpixels, numypixels;
-	GLint         i, j;
-	GLint         dstRowDiff;
+	GLint         i;
+
+	if ( height > j + 3 ) numypixels = 4;
+	else
+		numypixels = height - j;
+	srcaddr = srcPixData + j * width * srccomps;
+	for ( i = 0; i < width; i += 4 )
+	{
+		if ( width > i + 3 ) numxpixels = 4;
+		else
+			numxpixels = width - i;
+		extractsrccolors( srcpixels, srcaddr, width, numxpixels, numypixels, srccomps );
+		switch ( destFormat )
+		{
+			case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+			case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
+				encodedxtcolorblockfaster( blkaddr, srcpixels, numxpixels, numypixels, destFormat );
+				blkaddr += 8;
+				break;
+			case GL_COMPRESSED_RGBA_S3TC_DXT3_EXT:
+				*blkaddr++ = ( srcpixels[ 0 ][ 0 ][ 3 ] >> 4 ) | ( srcpixels[ 0 ][ 1 ][ 3 ] & 0xf0 );
+				*blkaddr++ = ( srcpixels[ 0 ][ 2 ][ 3 ] >> 4 ) | ( srcpixels[ 0 ][ 3 ][ 3 ] & 0xf0 );
+				*blkaddr++ = ( srcpixels[ 1 ][ 0 ][ 3 ] >> 4 ) | ( srcpixels[ 1 ][ 1 ][ 3 ] & 0xf0 );
+				*blkaddr++ = ( srcpixels[ 1 ][ 2 ][ 3 ] >> 4 ) | ( srcpixels[ 1 ][ 3 ][ 3 ] & 0xf0 );
+				*blkaddr++ = ( srcpixels[ 2 ][ 0 ][ 3 ] >> 4 ) | ( srcpixels[ 2 ][ 1 ][ 3 ] & 0xf0 );
+				*blkaddr++ = ( srcpixels[ 2 ][ 2 ][ 3 ] >> 4 ) | ( srcpixels[ 2 ][ 3 ][ 3 ] & 0xf0 );
+				*blkaddr++ = ( srcpixels[ 3 ][ 0 ][ 3 ] >> 4 ) | ( srcpixels[ 3 ][ 1 ][ 3 ] & 0xf0 );
+				*blkaddr++ = ( srcpixels[ 3 ][ 2 ][ 3 ] >> 4 ) | ( srcpixels[ 3 ][ 3 ][ 3 ] & 0xf0 );
+				encodedxtcolorblockfaster( blkaddr, srcpixels, numxpixels, numypixels, destFormat );
+				blkaddr += 8;
+				break;
+			case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+				encodedxt5alpha( blkaddr, srcpixels, numxpixels, numypixels );
+				encodedxtcolorblockfaster( blkaddr + 8, srcpixels, numxpixels, numypixels, destFormat );
+				blkaddr += 16;
+				break;
+		}
+		srcaddr += srccomps * numxpixels;
+	}
+}
+
+void tx_compress_dxtn( GLint srccomps, GLint width, GLint height, const GLubyte *srcPixData,
+                       GLenum destFormat, GLubyte *dest, GLint dstRowStride )
+{
+	GLint dstRowDiff, blocksize;
+	GLint row, numrows, rowpitch;
 
 	switch ( destFormat )
 	{
@@ -906,84 +1082,27 @@ void tx_compress_dxtn( GLint srccomps, GLint width, GLint height, const GLubyte
 		case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
 			/* hmm we used to get called without dstRowStride... */
 			dstRowDiff = dstRowStride >= ( width * 2 ) ? dstRowStride - ( ( ( width + 3 ) & ~3 ) * 2 ) : 0;
-			/*      fprintf(stderr, "dxt1 tex width %d tex height %d dstRowStride %d\n",
-              width, height, dstRowStride); */
-			for ( j = 0; j < height; j += 4 )
-			{
-				if ( height > j + 3 ) numypixels = 4;
-				else
-					numypixels = height - j;
-				srcaddr = srcPixData + j * width * srccomps;
-				for ( i = 0; i < width; i += 4 )
-				{
-					if ( width > i + 3 ) numxpixels = 4;
-					else
-						numxpixels = width - i;
-					extractsrccolors( srcpixels, srcaddr, width, numxpixels, numypixels, srccomps );
-					encodedxtcolorblockfaster( blkaddr, srcpixels, numxpixels, numypixels, destFormat );
-					srcaddr += srccomps * numxpixels;
-					blkaddr += 8;
-				}
-				blkaddr += dstRowDiff;
-			}
+			blocksize  = 8;
 			break;
 		case GL_COMPRESSED_RGBA_S3TC_DXT3_EXT:
-			dstRowDiff = dstRowStride >= ( width * 4 ) ? dstRowStride - ( ( ( width + 3 ) & ~3 ) * 4 ) : 0;
-			/*      fprintf(stderr, "dxt3 tex width %d tex height %d dstRowStride %d\n",
-              width, height, dstRowStride); */
-			for ( j = 0; j < height; j += 4 )
-			{
-				if ( height > j + 3 ) numypixels = 4;
-				else
-					numypixels = height - j;
-				srcaddr = srcPixData + j * width * srccomps;
-				for ( i = 0; i < width; i += 4 )
-				{
-					if ( width > i + 3 ) numxpixels = 4;
-					else
-						numxpixels = width - i;
-					extractsrccolors( srcpixels, srcaddr, width, numxpixels, numypixels, srccomps );
-					*blkaddr++ = ( srcpixels[ 0 ][ 0 ][ 3 ] >> 4 ) | ( srcpixels[ 0 ][ 1 ][ 3 ] & 0xf0 );
-					*blkaddr++ = ( srcpixels[ 0 ][ 2 ][ 3 ] >> 4 ) | ( srcpixels[ 0 ][ 3 ][ 3 ] & 0xf0 );
-					*blkaddr++ = ( srcpixels[ 1 ][ 0 ][ 3 ] >> 4 ) | ( srcpixels[ 1 ][ 1 ][ 3 ] & 0xf0 );
-					*blkaddr++ = ( srcpixels[ 1 ][ 2 ][ 3 ] >> 4 ) | ( srcpixels[ 1 ][ 3 ][ 3 ] & 0xf0 );
-					*blkaddr++ = ( srcpixels[ 2 ][ 0 ][ 3 ] >> 4 ) | ( srcpixels[ 2 ][ 1 ][ 3 ] & 0xf0 );
-					*blkaddr++ = ( srcpixels[ 2 ][ 2 ][ 3 ] >> 4 ) | ( srcpixels[ 2 ][ 3 ][ 3 ] & 0xf0 );
-					*blkaddr++ = ( srcpixels[ 3 ][ 0 ][ 3 ] >> 4 ) | ( srcpixels[ 3 ][ 1 ][ 3 ] & 0xf0 );
-					*blkaddr++ = ( srcpixels[ 3 ][ 2 ][ 3 ] >> 4 ) | ( srcpixels[ 3 ][ 3 ][ 3 ] & 0xf0 );
-					encodedxtcolorblockfaster( blkaddr, srcpixels, numxpixels, numypixels, destFormat );
-					srcaddr += srccomps * numxpixels;
-					blkaddr += 8;
-				}
-				blkaddr += dstRowDiff;
-			}
-			break;
 		case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
 			dstRowDiff = dstRowStride >= ( width * 4 ) ? dstRowStride - ( ( ( width + 3 ) & ~3 ) * 4 ) : 0;
-			/*      fprintf(stderr, "dxt5 tex width %d tex height %d dstRowStride %d\n",
-              width, height, dstRowStride); */
-			for ( j = 0; j < height; j += 4 )
-			{
-				if ( height > j + 3 ) numypixels = 4;
-				else
-					numypixels = height - j;
-				srcaddr = srcPixData + j * width * srccomps;
-				for ( i = 0; i < width; i += 4 )
-				{
-					if ( width > i + 3 ) numxpixels = 4;
-					else
-						numxpixels = width - i;
-					extractsrccolors( srcpixels, srcaddr, width, numxpixels, numypixels, srccomps );
-					encodedxt5alpha( blkaddr, srcpixels, numxpixels, numypixels );
-					encodedxtcolorblockfaster( blkaddr + 8, srcpixels, numxpixels, numypixels, destFormat );
-					srcaddr += srccomps * numxpixels;
-					blkaddr += 16;
-				}
-				blkaddr += dstRowDiff;
-			}
+			blocksize  = 16;
 			break;
 		default:
 			fprintf( stderr, "libdxtn: Bad dstFormat %d in tx_compress_dxtn\n", destFormat );
 			return;
 	}
+
+	/* every row of blocks is independent, so they're spread across threads
+	   unless we've been asked for the reference behaviour */
+	numrows  = ( height + 3 ) / 4;
+	rowpitch = ( ( width + 3 ) / 4 ) * blocksize + dstRowDiff;
+#if defined( _OPENMP )
+#pragma omp parallel for schedule( dynamic ) if ( !referencemode )
+#endif
+	for ( row = 0; row < numrows; row++ )
+	{
+		compressdxtnrow( srccomps, width, height, srcPixData, destFormat, dest + row * rowpitch, row * 4 );
+	}
 }
@@ -64,5 +64,6 @@ void fetch_2d_texel_rgba_dxt5( GLint srcRowStride, const GLubyte *pixdata,
 void tx_compress_dxtn( GLint srccomps, GLint width, GLint height,
                        const GLubyte *srcPixData, GLenum destformat,
                        GLubyte *dest, GLint dstRowStride );
+void tx_compress_dxtn_set_reference( GLboolean reference );
 
 #endif /* _TXC_DXTN_H */
@@ -0,0 +1,228 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* Copyright © 2020-2023 Mark E Sowden <hogsy@oldtimes-software.com> */
+
+#include "common_bvh.h"
+
+#define BVH_TEST_NUM_BOXES   5000
+#define BVH_TEST_NUM_QUERIES 200
+#define BVH_TEST_EXTENT      1024.0f
+
+static uint32_t bvhTestSeed;
+
+static float bvh_random( float min, float max )
+{
+	bvhTestSeed = bvhTestSeed * 1664525u + 1013904223u;
+	return min + ( ( float ) ( bvhTestSeed >> 8 ) / ( float ) ( 1u << 24 ) ) * ( max - min );
+}
+
+static PLVector3 bvh_random_point( void )
+{
+	return PLVector3( bvh_random( -BVH_TEST_EXTENT, BVH_TEST_EXTENT ),
+	                  bvh_random( -BVH_TEST_EXTENT, BVH_TEST_EXTENT ),
+	                  bvh_random( -BVH_TEST_EXTENT, BVH_TEST_EXTENT ) );
+}
+
+static int bvh_compare_items( const void *a, const void *b )
+{
+	uint32_t x = *( const uint32_t * ) a;
+	uint32_t y = *( const uint32_t * ) b;
+	return ( x > y ) - ( x < y );
+}
+
+/* stand-in for a view frustum, which is just a set of half-spaces */
+typedef struct BVHTestPlanes
+{
+	PLVector3 normals[ 4 ];
+	float     distances[ 4 ];
+} BVHTestPlanes;
+
+static bool bvh_planes_test( const CommonBVHBounds *bounds, void *user )
+{
+	const BVHTestPlanes *planes = user;
+	for ( unsigned int i = 0; i < 4; ++i )
+	{
+		const PLVector3 *n = &planes->normals[ i ];
+		PLVector3        p = PLVector3( n->x >= 0.0f ? bounds->maxs.x : bounds->mins.x,
+		                                n->y >= 0.0f ? bounds->maxs.y : bounds->mins.y,
+		                                n->z >= 0.0f ? bounds->maxs.z : bounds->mins.z );
+		if ( n->x * p.x + n->y * p.y + n->z * p.z + planes->distances[ i ] < 0.0f )
+			return false;
+	}
+
+	return true;
+}
+
+/**
+ * Runs the query against both the tree and every box,
+ * and checks the two agree on what passed.
+ */
+static uint8_t bvh_compare( const CommonBVH *bvh, const CommonBVHBounds *boxes, CommonBVHTestFunction test, void *user,
+                            uint32_t *treeItems, uint32_t *bruteItems, const char *name )
+{
+	unsigned int numTree = Common_BVH_Query( bvh, test, user, treeItems, BVH_TEST_NUM_BOXES );
+
+	unsigned int numBrute = 0;
+	for ( unsigned int i = 0; i < BVH_TEST_NUM_BOXES; ++i )
+	{
+		if ( test( &boxes[ i ], user ) )
+			bruteItems[ numBrute++ ] = i;
+	}
+
+	if ( numTree != numBrute )
+	{
+		printf( "%s query returned %u items, expected %u!\n", name, numTree, numBrute );
+		return TEST_RETURN_FAILURE;
+	}
+
+	qsort( treeItems, numTree, sizeof( uint32_t ), bvh_compare_items );
+	if ( memcmp( treeItems, bruteItems, sizeof( uint32_t ) * numTree ) != 0 )
+	{
+		printf( "%s query returned the wrong items!\n", name );
+		return TEST_RETURN_FAILURE;
+	}
+
+	return TEST_RETURN_SUCCESS;
+}
+
+static bool bvh_bounds_test( const CommonBVHBounds *bounds, void *user )
+{
+	return Common_BVH_TestBounds( bounds, user );
+}
+
+typedef struct BVHTestSphere
+{
+	PLVector3 origin;
+	float     radius;
+} BVHTestSphere;
+
+static bool bvh_sphere_test( const CommonBVHBounds *bounds, void *user )
+{
+	const BVHTestSphere *sphere = user;
+	return Common_BVH_TestSphere( bounds, &sphere->origin, sphere->radius );
+}
+
+typedef struct BVHTestRay
+{
+	PLVector3 origin;
+	PLVector3 direction;
+	float     distance;
+} BVHTestRay;
+
+static bool bvh_ray_test( const CommonBVHBounds *bounds, void *user )
+{
+	const BVHTestRay *ray = user;
+	return Common_BVH_TestRay( bounds, &ray->origin, &ray->direction, ray->distance );
+}
+
+static uint8_t bvh_run_queries( const CommonBVH *bvh, const CommonBVHBounds *boxes, uint32_t *treeItems, uint32_t *bruteItems )
+{
+	for ( unsigned int i = 0; i < BVH_TEST_NUM_QUERIES; ++i )
+	{
+		PLVector3       centre = bvh_random_point();
+		float           size   = bvh_random( 1.0f, 256.0f );
+		CommonBVHBounds bounds = {
+		        PLVector3( centre.x - size, centre.y - size, centre.z - size ),
+		        PLVector3( centre.x + size, centre.y + size, centre.z + size ) };
+		if ( bvh_compare( bvh, boxes, bvh_bounds_test, &bounds, treeItems, bruteItems, "bounds" ) != TEST_RETURN_SUCCESS )
+			return TEST_RETURN_FAILURE;
+
+		BVHTestSphere sphere = { bvh_random_point(), bvh_random( 1.0f, 256.0f ) };
+		if ( bvh_compare( bvh, boxes, bvh_sphere_test, &sphere, treeItems, bruteItems, "sphere" ) != TEST_RETURN_SUCCESS )
+			return TEST_RETURN_FAILURE;
+
+		/* include some axis-aligned rays, since they take a different path */
+		BVHTestRay ray = { bvh_random_point(), PLVector3( bvh_random( -1.0f, 1.0f ), bvh_random( -1.0f, 1.0f ), bvh_random( -1.0f, 1.0f ) ), bvh_random( 1.0f, 4096.0f ) };
+		if ( i % 4 == 0 )
+			ray.direction = PLVector3( 0.0f, ( i % 8 == 0 ) ? 1.0f : -1.0f, 0.0f );
+		if ( bvh_compare( bvh, boxes, bvh_ray_test, &ray, treeItems, bruteItems, "ray" ) != TEST_RETURN_SUCCESS )
+			return TEST_RETURN_FAILURE;
+
+		BVHTestPlanes planes;
+		for ( unsigned int j = 0; j < 4; ++j )
+		{
+			planes.normals[ j ]   = PLVector3( bvh_random( -1.0f, 1.0f ), bvh_random( -1.0f, 1.0f ), bvh_random( -1.0f, 1.0f ) );
+			planes.distances[ j ] = bvh_random( -256.0f, 512.0f );
+		}
+		if ( bvh_compare( bvh, boxes, bvh_planes_test, &planes, treeItems, bruteItems, "planes" ) != TEST_RETURN_SUCCESS )
+			return TEST_RETURN_FAILURE;
+	}
+
+	return TEST_RETURN_SUCCESS;
+}
+
+FUNC_TEST( bvh0 )
+
+bvhTestSeed = 12345;
+
+CommonBVHBounds *boxes = malloc( sizeof( CommonBVHBounds ) * BVH_TEST_NUM_BOXES );
+for ( unsigned int i = 0; i < BVH_TEST_NUM_BOXES; ++i )
+{
+	PLVector3 centre = bvh_random_point();
+	PLVector3 extent = PLVector3( bvh_random( 0.0f, 32.0f ), bvh_random( 0.0f, 32.0f ), bvh_random( 0.0f, 32.0f ) );
+
+	/* throw in some duplicates, so there's nothing to split on */
+	if ( i > 0 && i % 100 == 0 )
+	{
+		boxes[ i ] = boxes[ i - 1 ];
+		continue;
+	}
+
+	boxes[ i ].mins = PLVector3( centre.x - extent.x, centre.y - extent.y, centre.z - extent.z );
+	boxes[ i ].maxs = PLVector3( centre.x + extent.x, centre.y + extent.y, centre.z + extent.z );
+}
+
+uint32_t *treeItems  = malloc( sizeof( uint32_t ) * BVH_TEST_NUM_BOXES );
+uint32_t *bruteItems = malloc( sizeof( uint32_t ) * BVH_TEST_NUM_BOXES );
+
+CommonBVH bvh;
+memset( &bvh, 0, sizeof( CommonBVH ) );
+
+uint8_t ret = TEST_RETURN_FAILURE;
+if ( !Common_BVH_Build( &bvh, boxes, BVH_TEST_NUM_BOXES ) )
+	printf( "Failed to build bvh!\n" );
+else if ( ( ret = bvh_run_queries( &bvh, boxes, treeItems, bruteItems ) ) != TEST_RETURN_SUCCESS )
+	printf( "Failed on built tree\n" );
+else
+{
+	/* now make sure the stored layout comes back the same */
+	uint32_t *nodes = malloc( sizeof( uint32_t ) * 2 * bvh.numNodes );
+	for ( unsigned int i = 0; i < bvh.numNodes; ++i )
+	{
+		nodes[ i * 2 ]     = bvh.nodes[ i ].offset;
+		nodes[ i * 2 + 1 ] = bvh.nodes[ i ].numItems;
+	}
+
+	CommonBVH loaded;
+	memset( &loaded, 0, sizeof( CommonBVH ) );
+	if ( !Common_BVH_Load( &loaded, nodes, bvh.numNodes, bvh.items, boxes, BVH_TEST_NUM_BOXES ) )
+	{
+		printf( "Failed to load bvh!\n" );
+		ret = TEST_RETURN_FAILURE;
+	}
+	else if ( ( ret = bvh_run_queries( &loaded, boxes, treeItems, bruteItems ) ) != TEST_RETURN_SUCCESS )
+		printf( "Failed on loaded tree\n" );
+
+	/* and that a broken one gets rejected */
+	if ( ret == TEST_RETURN_SUCCESS )
+	{
+		nodes[ 0 ] = bvh.numNodes;
+		if ( Common_BVH_Load( &loaded, nodes, bvh.numNodes, bvh.items, boxes, BVH_TEST_NUM_BOXES ) )
+		{
+			printf( "Loaded an invalid bvh!\n" );
+			ret = TEST_RETURN_FAILURE;
+		}
+	}
+
+	Common_BVH_Destroy( &loaded );
+	free( nodes );
+}
+
+Common_BVH_Destroy( &bvh );
+free( bruteItems );
+free( treeItems );
+free( boxes );
+
+if ( ret != TEST_RETURN_SUCCESS )
+	return ret;
+
+FUNC_TEST_END()
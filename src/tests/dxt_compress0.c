@@ -0,0 +1,86 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* Copyright © 2020-2023 Mark E Sowden <hogsy@oldtimes-software.com> */
+
+#include "../pkgman/txc_dxtn.h"
+
+/* odd sizes, so the partial blocks along the edges are covered as well
+ * as the complete ones the vector paths deal with */
+#define DXT_TEST_WIDTH  133
+#define DXT_TEST_HEIGHT 71
+
+static uint32_t dxtTestSeed;
+
+static uint8_t dxt_random( void )
+{
+	dxtTestSeed = dxtTestSeed * 1664525u + 1013904223u;
+	return ( uint8_t ) ( dxtTestSeed >> 24 );
+}
+
+static bool dxt_compare_format( const char *description, GLenum format, unsigned int blockSize, const uint8_t *pixels )
+{
+	GLint    dstRowStride = ( ( DXT_TEST_WIDTH + 3 ) / 4 ) * blockSize;
+	size_t   dstSize      = ( size_t ) dstRowStride * ( ( DXT_TEST_HEIGHT + 3 ) / 4 );
+	uint8_t *refBuf       = calloc( dstSize, 1 );
+	uint8_t *dstBuf       = calloc( dstSize, 1 );
+
+	tx_compress_dxtn_set_reference( GL_TRUE );
+	tx_compress_dxtn( 4, DXT_TEST_WIDTH, DXT_TEST_HEIGHT, pixels, format, refBuf, dstRowStride );
+	tx_compress_dxtn_set_reference( GL_FALSE );
+	tx_compress_dxtn( 4, DXT_TEST_WIDTH, DXT_TEST_HEIGHT, pixels, format, dstBuf, dstRowStride );
+
+	bool status = true;
+	for ( size_t i = 0; i < dstSize; ++i )
+	{
+		if ( refBuf[ i ] != dstBuf[ i ] )
+		{
+			printf( "%s block %lu doesn't match the reference!\n", description, ( unsigned long ) ( i / blockSize ) );
+			status = false;
+			break;
+		}
+	}
+
+	free( dstBuf );
+	free( refBuf );
+
+	return status;
+}
+
+FUNC_TEST( dxt_compress0 )
+
+dxtTestSeed = 1234;
+
+/* gradients with a bit of noise, plus some flat blocks and hard alpha
+ * edges, so every path through the endpoint search gets some use */
+uint8_t *pixels = malloc( DXT_TEST_WIDTH * DXT_TEST_HEIGHT * 4 );
+for ( unsigned int y = 0; y < DXT_TEST_HEIGHT; ++y )
+{
+	for ( unsigned int x = 0; x < DXT_TEST_WIDTH; ++x )
+	{
+		uint8_t *pixel = &pixels[ ( y * DXT_TEST_WIDTH + x ) * 4 ];
+		if ( ( ( x / 4 ) + ( y / 4 ) ) % 7 == 0 )
+		{
+			pixel[ 0 ] = pixel[ 1 ] = pixel[ 2 ] = 128;
+			pixel[ 3 ]                          = 255;
+			continue;
+		}
+
+		pixel[ 0 ] = ( uint8_t ) ( x * 255 / DXT_TEST_WIDTH + ( dxt_random() & 15 ) );
+		pixel[ 1 ] = ( uint8_t ) ( y * 255 / DXT_TEST_HEIGHT + ( dxt_random() & 15 ) );
+		pixel[ 2 ] = dxt_random();
+		pixel[ 3 ] = ( x % 9 < 2 ) ? 0 : ( uint8_t ) ( 255 - ( x ^ y ) );
+	}
+}
+
+uint8_t ret = TEST_RETURN_SUCCESS;
+if ( !dxt_compare_format( "DXT1", GL_COMPRESSED_RGB_S3TC_DXT1_EXT, 8, pixels ) ||
+     !dxt_compare_format( "DXT1A", GL_COMPRESSED_RGBA_S3TC_DXT1_EXT, 8, pixels ) ||
+     !dxt_compare_format( "DXT3", GL_COMPRESSED_RGBA_S3TC_DXT3_EXT, 16, pixels ) ||
+     !dxt_compare_format( "DXT5", GL_COMPRESSED_RGBA_S3TC_DXT5_EXT, 16, pixels ) )
+	ret = TEST_RETURN_FAILURE;
+
+free( pixels );
+
+if ( ret != TEST_RETURN_SUCCESS )
+	return ret;
+
+FUNC_TEST_END()
@@ -0,0 +1,167 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* Copyright © 2020-2023 Mark E Sowden <hogsy@oldtimes-software.com> */
+
+#include "common_light_cull.h"
+
+#define LIGHT_CULL_TEST_NUM_LIGHTS 4000
+#define LIGHT_CULL_TEST_GROUPS_X   8
+#define LIGHT_CULL_TEST_GROUPS_Y   8
+#define LIGHT_CULL_TEST_GROUPS_Z   4
+#define LIGHT_CULL_TEST_NUM_GROUPS ( LIGHT_CULL_TEST_GROUPS_X * LIGHT_CULL_TEST_GROUPS_Y * LIGHT_CULL_TEST_GROUPS_Z )
+#define LIGHT_CULL_TEST_GROUP_SIZE 128.0f
+#define LIGHT_CULL_TEST_MAX_SELECT 8
+
+static uint32_t lightCullTestSeed;
+
+static float light_cull_random( float min, float max )
+{
+	lightCullTestSeed = lightCullTestSeed * 1664525u + 1013904223u;
+	return min + ( ( float ) ( lightCullTestSeed >> 8 ) / ( float ) ( 1u << 24 ) ) * ( max - min );
+}
+
+/* stand-in for a view frustum, only lets through lights that reach past a plane */
+static bool light_cull_test( const CommonLightCullLight *light, void *user )
+{
+	return light->origin.x + light->radius >= *( const float * ) user;
+}
+
+FUNC_TEST( light_cull0 )
+
+lightCullTestSeed = 9876;
+
+/* groups are a grid of boxes, jittered a little so some overlap and some have gaps */
+CommonBVHBounds *groups = calloc( LIGHT_CULL_TEST_NUM_GROUPS, sizeof( CommonBVHBounds ) );
+for ( unsigned int i = 0; i < LIGHT_CULL_TEST_NUM_GROUPS; ++i )
+{
+	float x = ( float ) ( i % LIGHT_CULL_TEST_GROUPS_X ) * LIGHT_CULL_TEST_GROUP_SIZE;
+	float y = ( float ) ( ( i / LIGHT_CULL_TEST_GROUPS_X ) % LIGHT_CULL_TEST_GROUPS_Y ) * LIGHT_CULL_TEST_GROUP_SIZE;
+	float z = ( float ) ( i / ( LIGHT_CULL_TEST_GROUPS_X * LIGHT_CULL_TEST_GROUPS_Y ) ) * LIGHT_CULL_TEST_GROUP_SIZE;
+
+	groups[ i ].mins = PLVector3( x + light_cull_random( -8.0f, 8.0f ), y + light_cull_random( -8.0f, 8.0f ), z + light_cull_random( -8.0f, 8.0f ) );
+	groups[ i ].maxs = PLVector3( x + LIGHT_CULL_TEST_GROUP_SIZE + light_cull_random( -8.0f, 8.0f ),
+	                              y + LIGHT_CULL_TEST_GROUP_SIZE + light_cull_random( -8.0f, 8.0f ),
+	                              z + LIGHT_CULL_TEST_GROUP_SIZE + light_cull_random( -8.0f, 8.0f ) );
+}
+
+CommonLightCullLight *lights = calloc( LIGHT_CULL_TEST_NUM_LIGHTS, sizeof( CommonLightCullLight ) );
+for ( unsigned int i = 0; i < LIGHT_CULL_TEST_NUM_LIGHTS; ++i )
+{
+	lights[ i ].origin    = PLVector3( light_cull_random( -64.0f, LIGHT_CULL_TEST_GROUPS_X * LIGHT_CULL_TEST_GROUP_SIZE + 64.0f ),
+	                                   light_cull_random( -64.0f, LIGHT_CULL_TEST_GROUPS_Y * LIGHT_CULL_TEST_GROUP_SIZE + 64.0f ),
+	                                   light_cull_random( -64.0f, LIGHT_CULL_TEST_GROUPS_Z * LIGHT_CULL_TEST_GROUP_SIZE + 64.0f ) );
+	lights[ i ].radius    = light_cull_random( 4.0f, 256.0f );
+	lights[ i ].intensity = light_cull_random( 0.1f, 4.0f );
+}
+
+CommonLightCullTable table;
+if ( !Common_LightCull_Assign( &table, lights, LIGHT_CULL_TEST_NUM_LIGHTS, groups, LIGHT_CULL_TEST_NUM_GROUPS ) )
+{
+	printf( "Failed to assign lights!\n" );
+	free( lights );
+	free( groups );
+	return TEST_RETURN_FAILURE;
+}
+
+/* every group should have exactly the lights a brute force check finds, in order */
+uint8_t ret = TEST_RETURN_SUCCESS;
+for ( unsigned int i = 0; i < LIGHT_CULL_TEST_NUM_GROUPS && ret == TEST_RETURN_SUCCESS; ++i )
+{
+	unsigned int    numAssigned;
+	const uint32_t *assigned = Common_LightCull_GetLights( &table, i, &numAssigned );
+
+	unsigned int numExpected = 0;
+	for ( unsigned int j = 0; j < LIGHT_CULL_TEST_NUM_LIGHTS; ++j )
+	{
+		if ( !Common_BVH_TestSphere( &groups[ i ], &lights[ j ].origin, lights[ j ].radius ) )
+			continue;
+
+		if ( numExpected >= numAssigned || assigned[ numExpected ] != j )
+		{
+			printf( "Group %u is missing light %u!\n", i, j );
+			ret = TEST_RETURN_FAILURE;
+			break;
+		}
+
+		numExpected++;
+	}
+
+	if ( ret == TEST_RETURN_SUCCESS && numExpected != numAssigned )
+	{
+		printf( "Group %u has %u lights, expected %u!\n", i, numAssigned, numExpected );
+		ret = TEST_RETURN_FAILURE;
+	}
+}
+
+/* and the selection should be the same as sorting everything that passes */
+for ( unsigned int i = 0; i < LIGHT_CULL_TEST_NUM_GROUPS && ret == TEST_RETURN_SUCCESS; ++i )
+{
+	unsigned int    numCandidates;
+	const uint32_t *candidates = Common_LightCull_GetLights( &table, i, &numCandidates );
+
+	PLVector3 viewOrigin = PLVector3( ( groups[ i ].mins.x + groups[ i ].maxs.x ) * 0.5f,
+	                                  ( groups[ i ].mins.y + groups[ i ].maxs.y ) * 0.5f,
+	                                  ( groups[ i ].mins.z + groups[ i ].maxs.z ) * 0.5f );
+	float     plane      = viewOrigin.x;
+
+	uint32_t     selected[ LIGHT_CULL_TEST_MAX_SELECT ];
+	unsigned int numSelected = Common_LightCull_Select( lights, candidates, numCandidates, &viewOrigin, light_cull_test, &plane, selected, LIGHT_CULL_TEST_MAX_SELECT );
+
+	uint32_t     expected[ LIGHT_CULL_TEST_MAX_SELECT ];
+	unsigned int numExpected = 0;
+	for ( unsigned int j = 0; j < numCandidates; ++j )
+	{
+		const CommonLightCullLight *light = &lights[ candidates[ j ] ];
+		if ( !light_cull_test( light, &plane ) )
+			continue;
+
+		/* candidates are ascending, so only a higher score gets to go before */
+		float        score = Common_LightCull_GetImportance( light, &viewOrigin );
+		unsigned int k     = 0;
+		while ( k < numExpected && Common_LightCull_GetImportance( &lights[ expected[ k ] ], &viewOrigin ) >= score )
+			k++;
+
+		if ( k >= LIGHT_CULL_TEST_MAX_SELECT )
+			continue;
+
+		if ( numExpected < LIGHT_CULL_TEST_MAX_SELECT )
+			numExpected++;
+
+		memmove( &expected[ k + 1 ], &expected[ k ], sizeof( uint32_t ) * ( numExpected - k - 1 ) );
+		expected[ k ] = candidates[ j ];
+	}
+
+	if ( numSelected != numExpected || memcmp( selected, expected, sizeof( uint32_t ) * numSelected ) != 0 )
+	{
+		printf( "Selection for group %u doesn't match!\n", i );
+		ret = TEST_RETURN_FAILURE;
+	}
+}
+
+/* a group with lights assigned, viewed from within one of them, always has something to draw with */
+for ( unsigned int i = 0; i < LIGHT_CULL_TEST_NUM_GROUPS && ret == TEST_RETURN_SUCCESS; ++i )
+{
+	unsigned int    numCandidates;
+	const uint32_t *candidates = Common_LightCull_GetLights( &table, i, &numCandidates );
+	if ( numCandidates == 0 )
+		continue;
+
+	const PLVector3 *viewOrigin = &lights[ candidates[ 0 ] ].origin;
+	float            plane      = viewOrigin->x;
+
+	uint32_t     selected[ LIGHT_CULL_TEST_MAX_SELECT ];
+	unsigned int numSelected = Common_LightCull_Select( lights, candidates, numCandidates, viewOrigin, light_cull_test, &plane, selected, LIGHT_CULL_TEST_MAX_SELECT );
+	if ( numSelected == 0 )
+	{
+		printf( "Group %u has %u lights assigned, but none were selected!\n", i, numCandidates );
+		ret = TEST_RETURN_FAILURE;
+	}
+}
+
+Common_LightCull_Destroy( &table );
+free( lights );
+free( groups );
+
+if ( ret != TEST_RETURN_SUCCESS )
+	return ret;
+
+FUNC_TEST_END()
@@ -0,0 +1,138 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* Copyright © 2020-2023 Mark E Sowden <hogsy@oldtimes-software.com> */
+
+#include "common_lightmap.h"
+
+/* a floor with a small roof over one corner of it, and a light above */
+#define LIGHTMAP_TEST_FLOOR_SIZE 256.0f
+#define LIGHTMAP_TEST_ROOF_SIZE  64.0f
+#define LIGHTMAP_TEST_ROOF_SPLIT 8
+
+static const float *lightmap_get_luxel( const CommonLightmapBaker *baker, const CommonLightmapChart *chart, const PLVector3 *point )
+{
+	PLVector3 d = PLVector3( point->x - chart->origin.x, point->y - chart->origin.y, point->z - chart->origin.z );
+
+	float sLength = chart->sAxis.x * chart->sAxis.x + chart->sAxis.y * chart->sAxis.y + chart->sAxis.z * chart->sAxis.z;
+	float tLength = chart->tAxis.x * chart->tAxis.x + chart->tAxis.y * chart->tAxis.y + chart->tAxis.z * chart->tAxis.z;
+	int   x       = ( int ) floorf( ( d.x * chart->sAxis.x + d.y * chart->sAxis.y + d.z * chart->sAxis.z ) / sLength );
+	int   y       = ( int ) floorf( ( d.x * chart->tAxis.x + d.y * chart->tAxis.y + d.z * chart->tAxis.z ) / tLength );
+	if ( x < 0 || y < 0 || ( unsigned int ) x >= chart->width || ( unsigned int ) y >= chart->height )
+		return NULL;
+
+	const CommonLightmapAtlas *atlas = &baker->atlases[ chart->atlas ];
+	return &atlas->luxels[ ( ( chart->y + y ) * atlas->size + chart->x + x ) * 3 ];
+}
+
+FUNC_TEST( lightmap0 )
+
+CommonLightmapBaker baker;
+Common_Lightmap_Setup( &baker, 8.0f, 128 );
+
+const PLVector3 floor[ 4 ] = {
+        PLVector3( 0.0f, 0.0f, 0.0f ),
+        PLVector3( LIGHTMAP_TEST_FLOOR_SIZE, 0.0f, 0.0f ),
+        PLVector3( LIGHTMAP_TEST_FLOOR_SIZE, LIGHTMAP_TEST_FLOOR_SIZE, 0.0f ),
+        PLVector3( 0.0f, LIGHTMAP_TEST_FLOOR_SIZE, 0.0f ),
+};
+Common_Lightmap_AddSurface( &baker, floor, 4, 0, 0 );
+
+/* split up, so there's plenty of charts to pack */
+float step = LIGHTMAP_TEST_ROOF_SIZE / LIGHTMAP_TEST_ROOF_SPLIT;
+for ( unsigned int y = 0; y < LIGHTMAP_TEST_ROOF_SPLIT; ++y )
+{
+	for ( unsigned int x = 0; x < LIGHTMAP_TEST_ROOF_SPLIT; ++x )
+	{
+		const PLVector3 roof[ 4 ] = {
+		        PLVector3( x * step, y * step, 32.0f ),
+		        PLVector3( x * step, ( y + 1 ) * step, 32.0f ),
+		        PLVector3( ( x + 1 ) * step, ( y + 1 ) * step, 32.0f ),
+		        PLVector3( ( x + 1 ) * step, y * step, 32.0f ),
+		};
+		Common_Lightmap_AddSurface( &baker, roof, 4, 0, 1 + y * LIGHTMAP_TEST_ROOF_SPLIT + x );
+	}
+}
+
+CommonLightmapLight light;
+light.position = PLVector3( 32.0f, 32.0f, 128.0f );
+light.colour   = PLVector3( 1.0f, 1.0f, 1.0f );
+light.radius   = 1024.0f;
+Common_Lightmap_AddLight( &baker, &light );
+
+baker.ambience = PLVector3( 0.1f, 0.1f, 0.1f );
+
+if ( !Common_Lightmap_Prepare( &baker ) )
+{
+	printf( "Failed to prepare lightmaps!\n" );
+	Common_Lightmap_Destroy( &baker );
+	return TEST_RETURN_FAILURE;
+}
+
+uint8_t ret = TEST_RETURN_SUCCESS;
+
+/* charts have to fit in their atlas, and not overlap each other */
+for ( unsigned int i = 0; i < baker.numCharts && ret == TEST_RETURN_SUCCESS; ++i )
+{
+	const CommonLightmapChart *a = &baker.charts[ i ];
+	if ( a->atlas >= baker.numAtlases || a->x + a->width > baker.atlasSize || a->y + a->height > baker.atlasSize )
+	{
+		printf( "Chart %u is outside of its atlas!\n", i );
+		ret = TEST_RETURN_FAILURE;
+		break;
+	}
+
+	for ( unsigned int j = i + 1; j < baker.numCharts; ++j )
+	{
+		const CommonLightmapChart *b = &baker.charts[ j ];
+		if ( a->atlas == b->atlas &&
+		     a->x < b->x + b->width && b->x < a->x + a->width &&
+		     a->y < b->y + b->height && b->y < a->y + a->height )
+		{
+			printf( "Charts %u and %u overlap!\n", i, j );
+			ret = TEST_RETURN_FAILURE;
+			break;
+		}
+	}
+}
+
+uint64_t numRays = 0;
+for ( unsigned int i = 0; i < baker.numCharts; ++i )
+	numRays += Common_Lightmap_BakeChart( &baker, i );
+
+if ( ret == TEST_RETURN_SUCCESS && numRays == 0 )
+{
+	printf( "No rays were traced!\n" );
+	ret = TEST_RETURN_FAILURE;
+}
+
+const CommonLightmapChart *floorChart = NULL;
+for ( unsigned int i = 0; i < baker.numCharts; ++i )
+{
+	if ( baker.charts[ i ].face == 0 )
+		floorChart = &baker.charts[ i ];
+}
+
+if ( ret == TEST_RETURN_SUCCESS )
+{
+	const PLVector3 shadowedPoint = PLVector3( 32.0f, 32.0f, 0.0f );
+	const PLVector3 litPoint      = PLVector3( 160.0f, 160.0f, 0.0f );
+
+	const float *shadowed = lightmap_get_luxel( &baker, floorChart, &shadowedPoint );
+	const float *lit      = lightmap_get_luxel( &baker, floorChart, &litPoint );
+	if ( shadowed == NULL || lit == NULL )
+	{
+		printf( "Failed to find luxels on the floor!\n" );
+		ret = TEST_RETURN_FAILURE;
+	}
+	else if ( fabsf( shadowed[ 0 ] - baker.ambience.x ) > 1e-4f || lit[ 0 ] <= shadowed[ 0 ] + 0.1f )
+	{
+		printf( "Unexpected lighting, shadowed %f, lit %f!\n", shadowed[ 0 ], lit[ 0 ] );
+		ret = TEST_RETURN_FAILURE;
+	}
+}
+
+Common_Lightmap_Destroy( &baker );
+
+if ( ret != TEST_RETURN_SUCCESS )
+	return ret;
+
+FUNC_TEST_END()
@@ -0,0 +1,140 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* Copyright © 2020-2023 Mark E Sowden <hogsy@oldtimes-software.com> */
+
+#include "common_occlusion.h"
+
+#define OCCLUSION_TEST_WIDTH         123 /* deliberately not a multiple of four */
+#define OCCLUSION_TEST_HEIGHT        61
+#define OCCLUSION_TEST_NUM_TRIANGLES 200
+
+/* looking down +z with a 90 degree view, so w is just z */
+static const float occlusion_viewProjection[ 16 ] = {
+        1.0f, 0.0f, 0.0f, 0.0f,
+        0.0f, 1.0f, 0.0f, 0.0f,
+        0.0f, 0.0f, 1.0f, 0.0f,
+        0.0f, 0.0f, 1.0f, 0.0f,
+};
+
+static void occlusion_add_quad( CommonOcclusionBuffer *buffer, PLVector3 a, PLVector3 b, PLVector3 c, PLVector3 d )
+{
+	Common_OcclusionBuffer_AddTriangle( buffer, &a, &b, &c );
+	Common_OcclusionBuffer_AddTriangle( buffer, &a, &c, &d );
+}
+
+static bool occlusion_test_box( const CommonOcclusionBuffer *buffer, float x0, float y0, float z0, float x1, float y1, float z1 )
+{
+	CommonBVHBounds bounds;
+	bounds.mins = PLVector3( x0, y0, z0 );
+	bounds.maxs = PLVector3( x1, y1, z1 );
+	return Common_OcclusionBuffer_TestBounds( buffer, &bounds );
+}
+
+static float occlusion_random( uint32_t *state )
+{
+	*state = *state * 1664525u + 1013904223u;
+	return ( float ) ( *state >> 8 ) / 16777216.0f;
+}
+
+FUNC_TEST( occlusion0 )
+
+CommonOcclusionBuffer simd, scalar;
+if ( !Common_OcclusionBuffer_Create( &simd, OCCLUSION_TEST_WIDTH, OCCLUSION_TEST_HEIGHT ) ||
+     !Common_OcclusionBuffer_Create( &scalar, OCCLUSION_TEST_WIDTH, OCCLUSION_TEST_HEIGHT ) )
+{
+	printf( "Failed to create buffers!\n" );
+	return TEST_RETURN_FAILURE;
+}
+
+uint8_t ret = TEST_RETURN_SUCCESS;
+if ( simd.width % 4 != 0 || simd.width < OCCLUSION_TEST_WIDTH )
+{
+	printf( "Buffer is %u wide, expected a multiple of four!\n", simd.width );
+	ret = TEST_RETURN_FAILURE;
+}
+
+/* with nothing drawn, nothing is hidden */
+Common_OcclusionBuffer_Begin( &simd, occlusion_viewProjection );
+Common_OcclusionBuffer_DrawRows( &simd, 0, simd.height );
+if ( !occlusion_test_box( &simd, -10.0f, -10.0f, 200.0f, 10.0f, 10.0f, 220.0f ) )
+{
+	printf( "Box was hidden by an empty buffer!\n" );
+	ret = TEST_RETURN_FAILURE;
+}
+
+/* a wall across the middle of the view, and a floor that runs back behind the camera */
+occlusion_add_quad( &simd, PLVector3( -50.0f, -50.0f, 100.0f ), PLVector3( 50.0f, -50.0f, 100.0f ),
+                    PLVector3( 50.0f, 50.0f, 100.0f ), PLVector3( -50.0f, 50.0f, 100.0f ) );
+occlusion_add_quad( &simd, PLVector3( -1000.0f, -10.0f, -100.0f ), PLVector3( 1000.0f, -10.0f, -100.0f ),
+                    PLVector3( 1000.0f, -10.0f, 1000.0f ), PLVector3( -1000.0f, -10.0f, 1000.0f ) );
+Common_OcclusionBuffer_DrawRows( &simd, 0, simd.height );
+
+static const struct
+{
+	float       bounds[ 6 ];
+	bool        visible;
+	const char *description;
+} boxes[] = {
+        {{ -10.0f, -10.0f, 200.0f, 10.0f, 10.0f, 220.0f },   false, "behind the wall"     },
+        { { -10.0f, -10.0f, 50.0f, 10.0f, 10.0f, 60.0f },    true,  "in front of the wall"},
+        { { 150.0f, 20.0f, 200.0f, 170.0f, 40.0f, 220.0f },  true,  "beside the wall"     },
+        { { -50.0f, -50.0f, 100.0f, 50.0f, 50.0f, 100.0f },  true,  "the wall itself"     },
+        { { -10.0f, -10.0f, -20.0f, 10.0f, 10.0f, 20.0f },   true,  "around the camera"   },
+        { { 150.0f, -40.0f, 200.0f, 170.0f, -30.0f, 220.0f }, false, "under the floor"     },
+};
+for ( unsigned int i = 0; i < PL_ARRAY_ELEMENTS( boxes ); ++i )
+{
+	const float *b = boxes[ i ].bounds;
+	if ( occlusion_test_box( &simd, b[ 0 ], b[ 1 ], b[ 2 ], b[ 3 ], b[ 4 ], b[ 5 ] ) != boxes[ i ].visible )
+	{
+		printf( "Box %s should be %s!\n", boxes[ i ].description, boxes[ i ].visible ? "visible" : "hidden" );
+		ret = TEST_RETURN_FAILURE;
+	}
+}
+
+/* a mess of triangles, some through the near plane and some off screen, drawn
+ * in uneven bands as they would be split between threads, should come out the
+ * same as the scalar version drawing the whole lot at once */
+Common_OcclusionBuffer_Begin( &simd, occlusion_viewProjection );
+Common_OcclusionBuffer_Begin( &scalar, occlusion_viewProjection );
+
+uint32_t random = 1234;
+for ( unsigned int i = 0; i < OCCLUSION_TEST_NUM_TRIANGLES; ++i )
+{
+	PLVector3 v[ 3 ];
+	for ( unsigned int j = 0; j < 3; ++j )
+		v[ j ] = PLVector3( occlusion_random( &random ) * 400.0f - 200.0f,
+		                    occlusion_random( &random ) * 400.0f - 200.0f,
+		                    occlusion_random( &random ) * 300.0f - 20.0f );
+
+	Common_OcclusionBuffer_AddTriangle( &simd, &v[ 0 ], &v[ 1 ], &v[ 2 ] );
+	Common_OcclusionBuffer_AddTriangle( &scalar, &v[ 0 ], &v[ 1 ], &v[ 2 ] );
+}
+
+if ( simd.numTriangles == 0 || simd.numTriangles != scalar.numTriangles )
+{
+	printf( "Set up %u and %u triangles!\n", simd.numTriangles, scalar.numTriangles );
+	ret = TEST_RETURN_FAILURE;
+}
+
+unsigned int split = simd.height / 3;
+Common_OcclusionBuffer_DrawRows( &simd, 0, split );
+Common_OcclusionBuffer_DrawRows( &simd, split, simd.height ); /* runs off the bottom */
+Common_OcclusionBuffer_DrawRowsScalar( &scalar, 0, scalar.height );
+
+unsigned int numCovered = 0;
+for ( unsigned int i = 0; i < simd.width * simd.height; ++i )
+	numCovered += ( scalar.depth[ i ] > 0.0f );
+
+if ( numCovered == 0 || memcmp( simd.depth, scalar.depth, sizeof( float ) * simd.width * simd.height ) != 0 )
+{
+	printf( "Depths differ (%u pixels covered)!\n", numCovered );
+	ret = TEST_RETURN_FAILURE;
+}
+
+Common_OcclusionBuffer_Destroy( &scalar );
+Common_OcclusionBuffer_Destroy( &simd );
+
+if ( ret != TEST_RETURN_SUCCESS )
+	return ret;
+
+FUNC_TEST_END()
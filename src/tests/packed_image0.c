@@ -0,0 +1,255 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* Copyright © 2020-2023 Mark E Sowden <hogsy@oldtimes-software.com> */
+
+#include "common_format_gfx.h"
+
+#include "../pkgman/pkgman.h"
+
+#define PACKED_IMAGE_TEST_PATH "packed_image0.gfx"
+
+static uint32_t packed_image_checksum( const uint8_t *buf, size_t size )
+{
+	uint32_t hash = 2166136261u;
+	for ( size_t i = 0; i < size; ++i )
+	{
+		hash ^= buf[ i ];
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+static void packed_image_write_header( FILE *file, uint8_t format, uint8_t numLevels, uint16_t width, uint16_t height )
+{
+	fwrite( GFX_IDENTIFIER, sizeof( char ), 4, file );
+	fwrite( &format, sizeof( uint8_t ), 1, file );
+	fwrite( &numLevels, sizeof( uint8_t ), 1, file );
+	fwrite( &width, sizeof( uint16_t ), 1, file );
+	fwrite( &height, sizeof( uint16_t ), 1, file );
+}
+
+static PLImage *packed_image_load( void )
+{
+	PLFile *file = PlOpenFile( PACKED_IMAGE_TEST_PATH, false );
+	if ( file == NULL )
+	{
+		printf( "Failed to open \"%s\"!\nPL: %s\n", PACKED_IMAGE_TEST_PATH, PlGetError() );
+		return NULL;
+	}
+
+	PLImage *image = Common_Image_LoadPackedImage( file );
+	PlCloseFile( file );
+	remove( PACKED_IMAGE_TEST_PATH );
+
+	if ( image == NULL )
+		printf( "Failed to load packed image!\n" );
+
+	return image;
+}
+
+/**
+ * Checks the dimensions and contents of every level
+ * match what we originally wrote out.
+ */
+static uint8_t packed_image_check_levels( const PLImage *image, unsigned int numLevels, const uint8_t **levels )
+{
+	if ( image->levels != numLevels )
+	{
+		printf( "Unexpected number of levels (%u vs %u)!\n", image->levels, numLevels );
+		return TEST_RETURN_FAILURE;
+	}
+
+	for ( unsigned int i = 0; i < numLevels; ++i )
+	{
+		unsigned int w = ( image->width >> i ) > 0 ? ( image->width >> i ) : 1;
+		unsigned int h = ( image->height >> i ) > 0 ? ( image->height >> i ) : 1;
+
+		size_t size = PlGetImageSize( image->format, w, h );
+		if ( packed_image_checksum( image->data[ i ], size ) != packed_image_checksum( levels[ i ], size ) )
+		{
+			printf( "Checksum mismatch on level %u (%ux%u)!\n", i, w, h );
+			return TEST_RETURN_FAILURE;
+		}
+	}
+
+	return TEST_RETURN_SUCCESS;
+}
+
+static uint8_t packed_image_compressed_test( void )
+{
+	/* 8x8 dxt1, down to 1x1 - each level is at least one 8 byte block */
+	static const unsigned int levelSizes[] = { 32, 8, 8, 8 };
+	uint8_t                   levelData[ 4 ][ 32 ];
+	const uint8_t            *levels[ 4 ];
+
+	FILE *file = fopen( PACKED_IMAGE_TEST_PATH, "wb" );
+	if ( file == NULL )
+	{
+		printf( "Failed to open \"%s\" for writing!\n", PACKED_IMAGE_TEST_PATH );
+		return TEST_RETURN_FATAL;
+	}
+
+	packed_image_write_header( file, PGFX_FORMAT_DXT1, 4, 8, 8 );
+	for ( unsigned int i = 0; i < 4; ++i )
+	{
+		for ( unsigned int j = 0; j < levelSizes[ i ]; ++j )
+			levelData[ i ][ j ] = ( uint8_t ) ( ( i + 1 ) * 31 + j * 7 );
+
+		fwrite( levelData[ i ], sizeof( uint8_t ), levelSizes[ i ], file );
+		levels[ i ] = levelData[ i ];
+	}
+	fclose( file );
+
+	PLImage *image = packed_image_load();
+	if ( image == NULL )
+		return TEST_RETURN_FAILURE;
+
+	uint8_t ret = TEST_RETURN_SUCCESS;
+	if ( image->format != PL_IMAGEFORMAT_RGB_DXT1 || image->width != 8 || image->height != 8 )
+	{
+		printf( "Unexpected format or dimensions!\n" );
+		ret = TEST_RETURN_FAILURE;
+	}
+	else
+		ret = packed_image_check_levels( image, 4, levels );
+
+	PlDestroyImage( image );
+
+	return ret;
+}
+
+static uint8_t packed_image_cluster_test( void )
+{
+	/* 4x2 rgb, with the first level using blocks and the second plain data */
+	static const uint8_t level0[] = {
+	        255, 0, 0, 0, 0, 255, 255, 0, 0, 0, 0, 255,
+	        0, 0, 255, 0, 0, 255, 255, 0, 0, 0, 0, 255 };
+	static const uint8_t level1[] = { 128, 0, 128, 128, 0, 128 };
+	const uint8_t       *levels[] = { level0, level1 };
+
+	FILE *file = fopen( PACKED_IMAGE_TEST_PATH, "wb" );
+	if ( file == NULL )
+	{
+		printf( "Failed to open \"%s\" for writing!\n", PACKED_IMAGE_TEST_PATH );
+		return TEST_RETURN_FATAL;
+	}
+
+	packed_image_write_header( file, PGFX_FORMAT_CLUSTER, 2, 4, 2 );
+
+	uint16_t numBlocks = 2;
+	fputc( PGFX_CHANNEL_RED | PGFX_CHANNEL_BLUE, file );
+	fwrite( &numBlocks, sizeof( uint16_t ), 1, file );
+	{
+		static const uint8_t red[]  = { PGFX_CHANNEL_RED, 255, 3, 0, 0, 2, 6 };
+		static const uint8_t blue[] = { PGFX_CHANNEL_BLUE, 255, 5, 0, 1, 3, 4, 5, 7 };
+		fwrite( red, sizeof( uint8_t ), sizeof( red ), file );
+		fwrite( blue, sizeof( uint8_t ), sizeof( blue ), file );
+	}
+
+	numBlocks = 0;
+	fputc( PGFX_CHANNEL_RED | PGFX_CHANNEL_BLUE, file );
+	fwrite( &numBlocks, sizeof( uint16_t ), 1, file );
+	for ( unsigned int i = 0; i < 2; ++i )
+	{
+		fputc( 128, file );
+		fputc( 128, file );
+	}
+	fclose( file );
+
+	PLImage *image = packed_image_load();
+	if ( image == NULL )
+		return TEST_RETURN_FAILURE;
+
+	uint8_t ret;
+	if ( image->format != PL_IMAGEFORMAT_RGB8 || image->width != 4 || image->height != 2 )
+	{
+		printf( "Unexpected format or dimensions!\n" );
+		ret = TEST_RETURN_FAILURE;
+	}
+	else
+		ret = packed_image_check_levels( image, 2, levels );
+
+	PlDestroyImage( image );
+
+	return ret;
+}
+
+static uint8_t packed_image_check_texel( const char *description, const uint8_t *texel, const uint8_t *expected )
+{
+	for ( unsigned int i = 0; i < 4; ++i )
+	{
+		/* allow for rounding */
+		if ( abs( ( int ) texel[ i ] - ( int ) expected[ i ] ) > 1 )
+		{
+			printf( "Unexpected %s texel (%u %u %u %u vs %u %u %u %u)!\n", description,
+			        texel[ 0 ], texel[ 1 ], texel[ 2 ], texel[ 3 ],
+			        expected[ 0 ], expected[ 1 ], expected[ 2 ], expected[ 3 ] );
+			return TEST_RETURN_FAILURE;
+		}
+	}
+
+	return TEST_RETURN_SUCCESS;
+}
+
+static uint8_t packed_image_mip_test( void )
+{
+	/* 4x2 rgba, down to 2x1; the left half is black and white, and the
+	 * right half is a transparent red texel next to three opaque blue ones */
+	static const uint8_t pixels[] = {
+	        0, 0, 0, 255, 255, 255, 255, 255, 255, 0, 0, 0, 0, 0, 255, 255,
+	        255, 255, 255, 255, 0, 0, 0, 255, 0, 0, 255, 255, 0, 0, 255, 255 };
+
+	static const struct
+	{
+		const char *description;
+		bool        isLinear;
+		uint8_t     expected[ 2 ][ 4 ];
+	} cases[] = {
+	        /* averaged in linear space, so mid grey comes out brighter than 128,
+	         * and the transparent red doesn't bleed into the blue */
+	        {"colour", false, { { 188, 188, 188, 255 }, { 0, 0, 255, 191 } }},
+	        /* but non-colour data is averaged as-is */
+	        { "linear", true, { { 128, 128, 128, 255 }, { 64, 0, 191, 191 } }},
+	};
+
+	uint8_t ret = TEST_RETURN_SUCCESS;
+	for ( unsigned int i = 0; i < PL_ARRAY_ELEMENTS( cases ); ++i )
+	{
+		unsigned int w, h;
+		uint8_t     *mip = PackImage_GenerateMipLevel( pixels, 4, 2, 4, cases[ i ].isLinear, &w, &h );
+		if ( w != 2 || h != 1 )
+		{
+			printf( "Unexpected %s mip dimensions (%ux%u)!\n", cases[ i ].description, w, h );
+			ret = TEST_RETURN_FAILURE;
+		}
+		else if ( packed_image_check_texel( cases[ i ].description, &mip[ 0 ], cases[ i ].expected[ 0 ] ) != TEST_RETURN_SUCCESS ||
+		          packed_image_check_texel( cases[ i ].description, &mip[ 4 ], cases[ i ].expected[ 1 ] ) != TEST_RETURN_SUCCESS )
+			ret = TEST_RETURN_FAILURE;
+
+		free( mip );
+	}
+
+	return ret;
+}
+
+FUNC_TEST( packed_image0 )
+
+uint8_t ret;
+if ( ( ret = packed_image_compressed_test() ) != TEST_RETURN_SUCCESS )
+{
+	printf( "Failed on compressed image\n" );
+	return ret;
+}
+
+if ( ( ret = packed_image_cluster_test() ) != TEST_RETURN_SUCCESS )
+{
+	printf( "Failed on cluster image\n" );
+	return ret;
+}
+
+if ( ( ret = packed_image_mip_test() ) != TEST_RETURN_SUCCESS )
+{
+	printf( "Failed on mip generation\n" );
+	return ret;
+}
+
+FUNC_TEST_END()
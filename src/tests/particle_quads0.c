@@ -0,0 +1,110 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* Copyright © 2020-2023 Mark E Sowden <hogsy@oldtimes-software.com> */
+
+#include "common_particles.h"
+
+#define PARTICLE_QUADS_TEST_NUM_PARTICLES 257
+
+/* laid out differently from the renderer's vertex, to make sure the offsets are honoured */
+typedef struct ParticleQuadsTestVertex
+{
+	float   uv[ 2 ];
+	uint8_t pad[ 3 ];
+	uint8_t colour[ 4 ];
+	float   position[ 3 ];
+} ParticleQuadsTestVertex;
+
+static bool particle_quads_near( float a, float b )
+{
+	float d = a - b;
+	return ( d > -0.0001f && d < 0.0001f );
+}
+
+FUNC_TEST( particle_quads0 )
+
+CommonParticlePool pool;
+PL_ZERO_( pool );
+Common_ParticlePool_Seed( &pool, 42 );
+Common_ParticlePool_Reserve( &pool, PARTICLE_QUADS_TEST_NUM_PARTICLES );
+for ( unsigned int i = 0; i < PARTICLE_QUADS_TEST_NUM_PARTICLES; ++i )
+{
+	unsigned int p   = Common_ParticlePool_Spawn( &pool );
+	pool.x[ p ]      = Common_ParticlePool_Random( &pool ) * 100.0f - 50.0f;
+	pool.y[ p ]      = Common_ParticlePool_Random( &pool ) * 100.0f - 50.0f;
+	pool.z[ p ]      = Common_ParticlePool_Random( &pool ) * 100.0f - 50.0f;
+	pool.r[ p ]      = Common_ParticlePool_Random( &pool );
+	pool.g[ p ]      = 1.5f; /* out of range either way, should be clamped */
+	pool.b[ p ]      = -0.5f;
+	pool.a[ p ]      = 1.0f;
+	pool.scale[ p ]  = 1.0f + Common_ParticlePool_Random( &pool ) * 8.0f;
+}
+
+/* a camera looking down an arbitrary diagonal */
+PLVector3 right = PLVector3( 0.70710678f, 0.0f, -0.70710678f );
+PLVector3 up    = PLVector3( -0.40824829f, 0.81649658f, -0.40824829f );
+
+ParticleQuadsTestVertex *vertices = calloc( PARTICLE_QUADS_TEST_NUM_PARTICLES * CMN_PARTICLE_QUAD_VERTICES, sizeof( ParticleQuadsTestVertex ) );
+
+/* build it in two uneven halves, as it would be if split between workers */
+CommonParticleVertexLayout layout;
+layout.stride         = sizeof( ParticleQuadsTestVertex );
+layout.positionOffset = offsetof( ParticleQuadsTestVertex, position );
+layout.colourOffset   = offsetof( ParticleQuadsTestVertex, colour );
+layout.uvOffset       = offsetof( ParticleQuadsTestVertex, uv );
+
+unsigned int split     = PARTICLE_QUADS_TEST_NUM_PARTICLES / 3;
+layout.vertices        = vertices;
+unsigned int numFirst  = Common_ParticlePool_BuildQuads( &pool, 0, split, &right, &up, &layout );
+layout.vertices        = vertices + numFirst;
+unsigned int numSecond = Common_ParticlePool_BuildQuads( &pool, split, PARTICLE_QUADS_TEST_NUM_PARTICLES, &right, &up, &layout );
+
+uint8_t ret = TEST_RETURN_SUCCESS;
+if ( numFirst + numSecond != PARTICLE_QUADS_TEST_NUM_PARTICLES * CMN_PARTICLE_QUAD_VERTICES )
+{
+	printf( "Wrote %u vertices, expected %u!\n", numFirst + numSecond, PARTICLE_QUADS_TEST_NUM_PARTICLES * CMN_PARTICLE_QUAD_VERTICES );
+	ret = TEST_RETURN_FAILURE;
+}
+
+static const float cornerSigns[ CMN_PARTICLE_QUAD_VERTICES ][ 2 ] = {
+        {-1.0f, -1.0f},
+        {-1.0f, 1.0f },
+        {1.0f,  -1.0f},
+        {1.0f,  1.0f },
+};
+
+for ( unsigned int i = 0; i < PARTICLE_QUADS_TEST_NUM_PARTICLES && ret == TEST_RETURN_SUCCESS; ++i )
+{
+	uint8_t expectedColour[ 4 ] = { ( uint8_t ) ( pool.r[ i ] * 255.0f ), 255, 0, 255 };
+	for ( unsigned int j = 0; j < CMN_PARTICLE_QUAD_VERTICES; ++j )
+	{
+		const ParticleQuadsTestVertex *vertex = &vertices[ i * CMN_PARTICLE_QUAD_VERTICES + j ];
+
+		float sr = cornerSigns[ j ][ 0 ] * pool.scale[ i ];
+		float su = cornerSigns[ j ][ 1 ] * pool.scale[ i ];
+		float ex = pool.x[ i ] + right.x * sr + up.x * su;
+		float ey = pool.y[ i ] + right.y * sr + up.y * su;
+		float ez = pool.z[ i ] + right.z * sr + up.z * su;
+		if ( !particle_quads_near( vertex->position[ 0 ], ex ) || !particle_quads_near( vertex->position[ 1 ], ey ) || !particle_quads_near( vertex->position[ 2 ], ez ) )
+		{
+			printf( "Vertex %u of particle %u is in the wrong place!\n", j, i );
+			ret = TEST_RETURN_FAILURE;
+			break;
+		}
+
+		if ( vertex->uv[ 0 ] != ( cornerSigns[ j ][ 0 ] > 0.0f ? 1.0f : 0.0f ) || vertex->uv[ 1 ] != ( cornerSigns[ j ][ 1 ] > 0.0f ? 1.0f : 0.0f ) ||
+		     memcmp( vertex->colour, expectedColour, sizeof( expectedColour ) ) != 0 )
+		{
+			printf( "Vertex %u of particle %u has the wrong colour or uv!\n", j, i );
+			ret = TEST_RETURN_FAILURE;
+			break;
+		}
+	}
+}
+
+free( vertices );
+Common_ParticlePool_Destroy( &pool );
+
+if ( ret != TEST_RETURN_SUCCESS )
+	return ret;
+
+FUNC_TEST_END()
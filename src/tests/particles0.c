@@ -0,0 +1,91 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* Copyright © 2020-2023 Mark E Sowden <hogsy@oldtimes-software.com> */
+
+#include "common_particles.h"
+
+#define PARTICLES_TEST_NUM_PARTICLES 1003 /* deliberately not a multiple of four */
+#define PARTICLES_TEST_NUM_TICKS     64
+
+static void particles_fill( CommonParticlePool *pool )
+{
+	Common_ParticlePool_Seed( pool, 1234 );
+	Common_ParticlePool_Reserve( pool, PARTICLES_TEST_NUM_PARTICLES );
+	for ( unsigned int i = 0; i < PARTICLES_TEST_NUM_PARTICLES; ++i )
+	{
+		unsigned int p        = Common_ParticlePool_Spawn( pool );
+		pool->x[ p ]          = Common_ParticlePool_Random( pool ) * 100.0f;
+		pool->y[ p ]          = Common_ParticlePool_Random( pool ) * 100.0f;
+		pool->z[ p ]          = Common_ParticlePool_Random( pool ) * 100.0f;
+		pool->velocityX[ p ]  = Common_ParticlePool_Random( pool ) - 0.5f;
+		pool->r[ p ]          = 1.0f;
+		pool->deltaR[ p ]     = -0.01f;
+		pool->scale[ p ]      = 10.0f;
+		pool->deltaScale[ p ] = -0.1f;
+		pool->life[ p ]       = ( int32_t ) ( i % ( PARTICLES_TEST_NUM_TICKS + 8 ) );
+	}
+
+	/* and top it up with dead ones, which should go on the first tick */
+	while ( Common_ParticlePool_Spawn( pool ) != CMN_PARTICLE_POOL_FULL ) {}
+}
+
+FUNC_TEST( particles0 )
+
+CommonParticleForce force;
+force.force    = PLVector3( 0.0f, -0.5f, 0.0f );
+force.forceVar = PLVector3( 0.1f, 0.2f, 0.3f );
+
+CommonParticlePool simd, scalar;
+PL_ZERO_( simd );
+PL_ZERO_( scalar );
+particles_fill( &simd );
+particles_fill( &scalar );
+
+if ( simd.numParticles != simd.maxParticles || simd.numParticles < PARTICLES_TEST_NUM_PARTICLES )
+{
+	printf( "Pool took %u particles with room for %u!\n", simd.numParticles, simd.maxParticles );
+	return TEST_RETURN_FAILURE;
+}
+
+uint8_t ret = TEST_RETURN_SUCCESS;
+for ( unsigned int tick = 0; tick < PARTICLES_TEST_NUM_TICKS; ++tick )
+{
+	/* everything still alive should be exactly what was alive before, minus what ran out */
+	unsigned int expected = 0;
+	for ( unsigned int i = 0; i < scalar.numParticles; ++i )
+		expected += ( scalar.life[ i ] > 0 );
+
+	CommonBVHBounds simdBounds, scalarBounds;
+	unsigned int    numSimd   = Common_ParticlePool_Tick( &simd, &force, &simdBounds );
+	unsigned int    numScalar = Common_ParticlePool_TickScalar( &scalar, &force, &scalarBounds );
+	if ( numSimd != expected || numScalar != expected )
+	{
+		printf( "Expected %u particles on tick %u, got %u and %u!\n", expected, tick, numSimd, numScalar );
+		ret = TEST_RETURN_FAILURE;
+		break;
+	}
+
+	if ( numSimd > 0 && memcmp( &simdBounds, &scalarBounds, sizeof( CommonBVHBounds ) ) != 0 )
+	{
+		printf( "Bounds differ on tick %u!\n", tick );
+		ret = TEST_RETURN_FAILURE;
+		break;
+	}
+
+	size_t size = sizeof( float ) * numSimd;
+	if ( memcmp( simd.x, scalar.x, size ) != 0 || memcmp( simd.y, scalar.y, size ) != 0 || memcmp( simd.z, scalar.z, size ) != 0 ||
+	     memcmp( simd.r, scalar.r, size ) != 0 || memcmp( simd.scale, scalar.scale, size ) != 0 ||
+	     memcmp( simd.life, scalar.life, sizeof( int32_t ) * numSimd ) != 0 )
+	{
+		printf( "Particles differ on tick %u!\n", tick );
+		ret = TEST_RETURN_FAILURE;
+		break;
+	}
+}
+
+Common_ParticlePool_Destroy( &scalar );
+Common_ParticlePool_Destroy( &simd );
+
+if ( ret != TEST_RETURN_SUCCESS )
+	return ret;
+
+FUNC_TEST_END()
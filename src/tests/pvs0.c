@@ -0,0 +1,238 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* Copyright © 2020-2023 Mark E Sowden <hogsy@oldtimes-software.com> */
+
+#include "common_pvs.h"
+
+/* a block of box rooms, with doors knocked through some of the shared walls */
+#define PVS_TEST_ROOMS_X     4
+#define PVS_TEST_ROOMS_Y     4
+#define PVS_TEST_ROOMS_Z     2
+#define PVS_TEST_NUM_ROOMS   ( PVS_TEST_ROOMS_X * PVS_TEST_ROOMS_Y * PVS_TEST_ROOMS_Z )
+#define PVS_TEST_ROOM_SIZE   64.0f
+#define PVS_TEST_MAX_WALLS   ( PVS_TEST_NUM_ROOMS * 3 )
+#define PVS_TEST_NUM_SAMPLES 64
+
+static uint32_t pvsTestSeed;
+
+static float pvs_random( float min, float max )
+{
+	pvsTestSeed = pvsTestSeed * 1664525u + 1013904223u;
+	return min + ( ( float ) ( pvsTestSeed >> 8 ) / ( float ) ( 1u << 24 ) ) * ( max - min );
+}
+
+/* an axis-aligned rectangle that blocks sight */
+typedef struct PVSTestSolid
+{
+	unsigned int axis;
+	float        position;
+	float        mins[ 2 ];
+	float        maxs[ 2 ];
+} PVSTestSolid;
+
+typedef struct PVSTestWorld
+{
+	PVSTestSolid    solids[ PVS_TEST_MAX_WALLS * 4 ];
+	unsigned int    numSolids;
+	PLVector3       points[ PVS_TEST_MAX_WALLS ][ 4 ];
+	CommonPVSPortal portals[ PVS_TEST_MAX_WALLS * 2 ];
+	unsigned int    numPortals;
+} PVSTestWorld;
+
+static void pvs_add_solid( PVSTestWorld *world, unsigned int axis, float position, float u0, float v0, float u1, float v1 )
+{
+	if ( u1 <= u0 || v1 <= v0 )
+		return;
+
+	PVSTestSolid *solid = &world->solids[ world->numSolids++ ];
+	solid->axis         = axis;
+	solid->position     = position;
+	solid->mins[ 0 ]    = u0;
+	solid->mins[ 1 ]    = v0;
+	solid->maxs[ 0 ]    = u1;
+	solid->maxs[ 1 ]    = v1;
+}
+
+static PLVector3 pvs_make_point( unsigned int axis, float position, float u, float v )
+{
+	float p[ 3 ];
+	p[ axis ]             = position;
+	p[ ( axis + 1 ) % 3 ] = u;
+	p[ ( axis + 2 ) % 3 ] = v;
+	return PLVector3( p[ 0 ], p[ 1 ], p[ 2 ] );
+}
+
+static unsigned int pvs_room_index( unsigned int x, unsigned int y, unsigned int z )
+{
+	return x + y * PVS_TEST_ROOMS_X + z * PVS_TEST_ROOMS_X * PVS_TEST_ROOMS_Y;
+}
+
+/**
+ * Either walls up the side of the room in the given direction,
+ * or puts a door in it with a portal each way.
+ */
+static void pvs_build_wall( PVSTestWorld *world, const unsigned int *room, unsigned int axis )
+{
+	const unsigned int dimensions[ 3 ] = { PVS_TEST_ROOMS_X, PVS_TEST_ROOMS_Y, PVS_TEST_ROOMS_Z };
+	if ( room[ axis ] + 1 >= dimensions[ axis ] )
+		return;
+
+	unsigned int other[ 3 ] = { room[ 0 ], room[ 1 ], room[ 2 ] };
+	other[ axis ]++;
+
+	float position = other[ axis ] * PVS_TEST_ROOM_SIZE;
+	float u0       = room[ ( axis + 1 ) % 3 ] * PVS_TEST_ROOM_SIZE;
+	float v0       = room[ ( axis + 2 ) % 3 ] * PVS_TEST_ROOM_SIZE;
+	float u1       = u0 + PVS_TEST_ROOM_SIZE;
+	float v1       = v0 + PVS_TEST_ROOM_SIZE;
+
+	if ( pvs_random( 0.0f, 1.0f ) > 0.6f )
+	{
+		pvs_add_solid( world, axis, position, u0, v0, u1, v1 );
+		return;
+	}
+
+	float du0 = pvs_random( u0 + 2.0f, u1 - 10.0f );
+	float dv0 = pvs_random( v0 + 2.0f, v1 - 10.0f );
+	float du1 = pvs_random( du0 + 8.0f, u1 - 2.0f );
+	float dv1 = pvs_random( dv0 + 8.0f, v1 - 2.0f );
+
+	pvs_add_solid( world, axis, position, u0, v0, u1, dv0 );
+	pvs_add_solid( world, axis, position, u0, dv1, u1, v1 );
+	pvs_add_solid( world, axis, position, u0, dv0, du0, dv1 );
+	pvs_add_solid( world, axis, position, du1, dv0, u1, dv1 );
+
+	PLVector3 *points = world->points[ world->numPortals / 2 ];
+	points[ 0 ]       = pvs_make_point( axis, position, du0, dv0 );
+	points[ 1 ]       = pvs_make_point( axis, position, du1, dv0 );
+	points[ 2 ]       = pvs_make_point( axis, position, du1, dv1 );
+	points[ 3 ]       = pvs_make_point( axis, position, du0, dv1 );
+
+	PLVector3    normal = pvs_make_point( axis, 1.0f, 0.0f, 0.0f );
+	unsigned int a      = pvs_room_index( room[ 0 ], room[ 1 ], room[ 2 ] );
+	unsigned int b      = pvs_room_index( other[ 0 ], other[ 1 ], other[ 2 ] );
+
+	world->portals[ world->numPortals++ ] = ( CommonPVSPortal ){ points, 4, normal, a, b };
+	world->portals[ world->numPortals++ ] = ( CommonPVSPortal ){ points, 4, PLVector3( -normal.x, -normal.y, -normal.z ), b, a };
+}
+
+static bool pvs_is_segment_blocked( const PVSTestWorld *world, const PLVector3 *start, const PLVector3 *end )
+{
+	const float s[ 3 ] = { start->x, start->y, start->z };
+	const float e[ 3 ] = { end->x, end->y, end->z };
+	for ( unsigned int i = 0; i < world->numSolids; ++i )
+	{
+		const PVSTestSolid *solid = &world->solids[ i ];
+
+		float d = e[ solid->axis ] - s[ solid->axis ];
+		if ( d == 0.0f )
+			continue;
+
+		float t = ( solid->position - s[ solid->axis ] ) / d;
+		if ( t <= 0.0f || t >= 1.0f )
+			continue;
+
+		unsigned int uAxis = ( solid->axis + 1 ) % 3;
+		unsigned int vAxis = ( solid->axis + 2 ) % 3;
+		float        u     = s[ uAxis ] + ( e[ uAxis ] - s[ uAxis ] ) * t;
+		float        v     = s[ vAxis ] + ( e[ vAxis ] - s[ vAxis ] ) * t;
+
+		/* edges count as solid, so nothing slips through where two walls meet */
+		if ( u >=solid->mins[ 0 ] && u <= solid->maxs[ 0 ] && v >= solid->mins[ 1 ] && v <= solid->maxs[ 1 ] )
+			return true;
+	}
+
+	return false;
+}
+
+static PLVector3 pvs_random_point_in_room( unsigned int room )
+{
+	unsigned int x = room % PVS_TEST_ROOMS_X;
+	unsigned int y = ( room / PVS_TEST_ROOMS_X ) % PVS_TEST_ROOMS_Y;
+	unsigned int z = room / ( PVS_TEST_ROOMS_X * PVS_TEST_ROOMS_Y );
+	return PLVector3( pvs_random( x * PVS_TEST_ROOM_SIZE + 1.0f, ( x + 1 ) * PVS_TEST_ROOM_SIZE - 1.0f ),
+	                  pvs_random( y * PVS_TEST_ROOM_SIZE + 1.0f, ( y + 1 ) * PVS_TEST_ROOM_SIZE - 1.0f ),
+	                  pvs_random( z * PVS_TEST_ROOM_SIZE + 1.0f, ( z + 1 ) * PVS_TEST_ROOM_SIZE - 1.0f ) );
+}
+
+FUNC_TEST( pvs0 )
+
+pvsTestSeed = 54321;
+
+PVSTestWorld *world = calloc( 1, sizeof( PVSTestWorld ) );
+for ( unsigned int z = 0; z < PVS_TEST_ROOMS_Z; ++z )
+{
+	for ( unsigned int y = 0; y < PVS_TEST_ROOMS_Y; ++y )
+	{
+		for ( unsigned int x = 0; x < PVS_TEST_ROOMS_X; ++x )
+		{
+			const unsigned int room[ 3 ] = { x, y, z };
+			for ( unsigned int axis = 0; axis < 3; ++axis )
+				pvs_build_wall( world, room, axis );
+		}
+	}
+}
+
+CommonPVS pvs;
+if ( !Common_PVS_Compute( &pvs, world->portals, world->numPortals, PVS_TEST_NUM_ROOMS ) )
+{
+	printf( "Failed to compute pvs!\n" );
+	free( world );
+	return TEST_RETURN_FAILURE;
+}
+
+/* anything a ray can get to has to be in the set, and
+ * the set shouldn't just be everything either */
+uint8_t      ret        = TEST_RETURN_SUCCESS;
+unsigned int numVisible = 0;
+for ( unsigned int i = 0; i < PVS_TEST_NUM_ROOMS && ret == TEST_RETURN_SUCCESS; ++i )
+{
+	numVisible += Common_PVS_GetNumVisible( &pvs, i );
+	for ( unsigned int j = 0; j < PVS_TEST_NUM_ROOMS; ++j )
+	{
+		if ( i == j )
+			continue;
+
+		for ( unsigned int k = 0; k < PVS_TEST_NUM_SAMPLES; ++k )
+		{
+			PLVector3 start = pvs_random_point_in_room( i );
+			PLVector3 end   = pvs_random_point_in_room( j );
+			if ( pvs_is_segment_blocked( world, &start, &end ) )
+				continue;
+
+			if ( !Common_PVS_IsVisible( &pvs, i, j ) )
+			{
+				printf( "Room %u can see room %u, but it's not in the set!\n", i, j );
+				ret = TEST_RETURN_FAILURE;
+			}
+			break;
+		}
+	}
+}
+
+if ( ret == TEST_RETURN_SUCCESS && numVisible >= PVS_TEST_NUM_ROOMS * PVS_TEST_NUM_ROOMS )
+{
+	printf( "Every room is visible from every other room!\n" );
+	ret = TEST_RETURN_FAILURE;
+}
+
+/* and make sure it comes back the same */
+CommonPVS loaded;
+if ( ret == TEST_RETURN_SUCCESS )
+{
+	if ( !Common_PVS_Load( &loaded, pvs.bits, pvs.numClusters ) ||
+	     memcmp( loaded.bits, pvs.bits, sizeof( uint32_t ) * pvs.numWords * pvs.numClusters ) != 0 )
+	{
+		printf( "Loaded pvs doesn't match!\n" );
+		ret = TEST_RETURN_FAILURE;
+	}
+
+	Common_PVS_Destroy( &loaded );
+}
+
+Common_PVS_Destroy( &pvs );
+free( world );
+
+if ( ret != TEST_RETURN_SUCCESS )
+	return ret;
+
+FUNC_TEST_END()
@@ -0,0 +1,69 @@
+/* SPDX-License-Identifier: LGPL-3.0-or-later */
+/* Copyright © 2020-2023 Mark E Sowden <hogsy@oldtimes-software.com> */
+
+#include "common_sort.h"
+
+#define SORT_TEST_NUM_KEYS 100000
+
+static uint64_t sortTestSeed;
+
+static uint64_t sort_random( void )
+{
+	sortTestSeed = sortTestSeed * 6364136223846793005ull + 1442695040888963407ull;
+	return sortTestSeed;
+}
+
+FUNC_TEST( sort0 )
+
+sortTestSeed = 1234;
+
+uint64_t *keys          = calloc( SORT_TEST_NUM_KEYS, sizeof( uint64_t ) );
+uint64_t *original      = calloc( SORT_TEST_NUM_KEYS, sizeof( uint64_t ) );
+uint64_t *scratchKeys   = calloc( SORT_TEST_NUM_KEYS, sizeof( uint64_t ) );
+uint32_t *values        = calloc( SORT_TEST_NUM_KEYS, sizeof( uint32_t ) );
+uint32_t *scratchValues = calloc( SORT_TEST_NUM_KEYS, sizeof( uint32_t ) );
+uint8_t  *seen          = calloc( SORT_TEST_NUM_KEYS, sizeof( uint8_t ) );
+
+/* laid out much like draw keys; a few distinct values up top, a constant
+ * byte in the middle that can be skipped, and plenty of duplicates */
+for ( unsigned int i = 0; i < SORT_TEST_NUM_KEYS; ++i )
+{
+	uint64_t r    = sort_random();
+	keys[ i ]     = ( ( r >> 60 ) << 56 ) | ( 0x5Aull << 40 ) | ( ( ( r >> 20 ) & 0xFFFF ) << 16 ) | ( ( r >> 8 ) & 0x3 );
+	original[ i ] = keys[ i ];
+	values[ i ]   = i;
+}
+
+Common_RadixSort64( keys, values, scratchKeys, scratchValues, SORT_TEST_NUM_KEYS );
+
+uint8_t ret = TEST_RETURN_SUCCESS;
+for ( unsigned int i = 0; i < SORT_TEST_NUM_KEYS; ++i )
+{
+	if ( values[ i ] >= SORT_TEST_NUM_KEYS || seen[ values[ i ] ] || original[ values[ i ] ] != keys[ i ] )
+	{
+		printf( "Key %u doesn't match its value!\n", i );
+		ret = TEST_RETURN_FAILURE;
+		break;
+	}
+	seen[ values[ i ] ] = 1;
+
+	/* and equal keys should have stayed in the order they were given */
+	if ( i > 0 && ( keys[ i - 1 ] > keys[ i ] || ( keys[ i - 1 ] == keys[ i ] && values[ i - 1 ] > values[ i ] ) ) )
+	{
+		printf( "Keys %u and %u are out of order!\n", i - 1, i );
+		ret = TEST_RETURN_FAILURE;
+		break;
+	}
+}
+
+free( seen );
+free( scratchValues );
+free( values );
+free( scratchKeys );
+free( original );
+free( keys );
+
+if ( ret != TEST_RETURN_SUCCESS )
+	return ret;
+
+FUNC_TEST_END()
@@ -20,6 +20,16 @@ enum
 	}
 
 #include "node_parser0.c"
+#include "packed_image0.c"
+#include "bvh0.c"
+#include "pvs0.c"
+#include "lightmap0.c"
+#include "light_cull0.c"
+#include "sort0.c"
+#include "particles0.c"
+#include "particle_quads0.c"
+#include "occlusion0.c"
+#include "dxt_compress0.c"
 
 int main( int argc, char **argv )
 {
@@ -41,6 +51,16 @@ int main( int argc, char **argv )
 	}
 
 	CALL_FUNC_TEST( node_parser0 )
+	CALL_FUNC_TEST( packed_image0 )
+	CALL_FUNC_TEST( bvh0 )
+	CALL_FUNC_TEST( pvs0 )
+	CALL_FUNC_TEST( lightmap0 )
+	CALL_FUNC_TEST( light_cull0 )
+	CALL_FUNC_TEST( sort0 )
+	CALL_FUNC_TEST( particles0 )
+	CALL_FUNC_TEST( particle_quads0 )
+	CALL_FUNC_TEST( occlusion0 )
+	CALL_FUNC_TEST( dxt_compress0 )
 
 	printf( "All tests finished successfully!\n" );
 
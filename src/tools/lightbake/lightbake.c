@@ -0,0 +1,106 @@
+// SPDX-License-Identifier: LGPL-3.0-or-later
+// Copyright © 2020-2023 OldTimes Software, Mark E Sowden <hogsy@oldtimes-software.com>
+
+#include <SDL2/SDL.h>
+
+#include <plcore/pl.h>
+#include <plcore/pl_timer.h>
+
+#include <yin/node.h>
+
+#include "common.h"
+#include "common_lightmap.h"
+
+#define VERSION "1.0.0"
+
+int main( int argc, char **argv )
+{
+	if ( PlInitialize( argc, argv ) != PL_RESULT_SUCCESS )
+	{
+		fprintf( stderr, "Failed to initialize Hei library: %s\n", PlGetError() );
+		return EXIT_FAILURE;
+	}
+
+	PlInitializeSubSystems( PL_SUBSYSTEM_IO );
+
+	Common_Initialize();
+
+	printf( "lightbake v" VERSION " (" __DATE__ " " __TIME__ ")\n"
+	        "Lightmap baking for the Yin 3D Game Engine\n"
+	        "Copyright (C) 2020-2023 Mark E Sowden <hogsy@oldtimes-software.com>\n"
+	        "-------------------------------------------------------------------\n" );
+
+	const char *worldPath = PlGetCommandLineArgumentValue( "-world" );
+	if ( worldPath == NULL )
+	{
+		printf( "Usage: lightbake -world <world-path> [options]\n"
+		        "Options:\n"
+		        "   -world   = World to bake (required).\n"
+		        "   -out     = Output location, defaults to alongside the world.\n"
+		        "   -threads = Number of threads, defaults to one per core.\n"
+		        "   -luxel   = World units per luxel.\n" );
+		return EXIT_SUCCESS;
+	}
+
+	PLPath      outPath;
+	const char *arg = PlGetCommandLineArgumentValue( "-out" );
+	if ( arg != NULL )
+		snprintf( outPath, sizeof( outPath ), "%s", arg );
+	else if ( !Common_Lightmap_GetOutputPath( worldPath, outPath, sizeof( outPath ) ) )
+	{
+		fprintf( stderr, "Invalid world path: %s\n", worldPath );
+		return EXIT_FAILURE;
+	}
+
+	int numThreads = SDL_GetCPUCount();
+	if ( ( arg = PlGetCommandLineArgumentValue( "-threads" ) ) != NULL )
+		numThreads = atoi( arg );
+	if ( numThreads < 1 )
+		numThreads = 1;
+	else if ( numThreads > CMN_LIGHTMAP_MAX_THREADS )
+		numThreads = CMN_LIGHTMAP_MAX_THREADS;
+
+	float luxelSize = CMN_LIGHTMAP_DEFAULT_LUXEL_SIZE;
+	if ( ( arg = PlGetCommandLineArgumentValue( "-luxel" ) ) != NULL )
+		luxelSize = strtof( arg, NULL );
+
+	double timeStart = PlGetCurrentSeconds();
+
+	CommonLightmapBaker baker;
+	Common_Lightmap_Setup( &baker, luxelSize, CMN_LIGHTMAP_DEFAULT_ATLAS_SIZE );
+	if ( !Common_Lightmap_LoadWorld( &baker, worldPath ) || !Common_Lightmap_Prepare( &baker ) )
+	{
+		fprintf( stderr, "Failed to set up lightmaps for %s!\n", worldPath );
+		Common_Lightmap_Destroy( &baker );
+		return EXIT_FAILURE;
+	}
+
+	printf( "Baking %u charts into %u atlases, with %u lights, on %d threads...\n",
+	        baker.numCharts, baker.numAtlases, baker.numLights, numThreads );
+
+	double timeBake = PlGetCurrentSeconds();
+
+	uint64_t numRays = Common_LightmapBaker_BakeThreaded( &baker, ( unsigned int ) numThreads );
+
+	double timeEnd = PlGetCurrentSeconds();
+
+	YNNodeBranch *root   = Common_Lightmap_Serialise( &baker );
+	bool          status = YnNode_WriteFile( outPath, root, YN_NODE_FILE_BINARY );
+	YnNode_DestroyBranch( root );
+	Common_Lightmap_Destroy( &baker );
+
+	if ( !status )
+	{
+		fprintf( stderr, "Failed to write lightmaps: %s\n", outPath );
+		return EXIT_FAILURE;
+	}
+
+	double seconds = ( timeEnd > timeBake ) ? timeEnd - timeBake : 1e-6;
+	printf( "-------------------------------------------------------------------\n"
+	        "Traced %llu rays in %.2lfs (%.2lf Mrays/s)\n"
+	        "Finished baking successfully in %.2lfs to \"%s\"\n",
+	        ( unsigned long long ) numRays, seconds, ( ( double ) numRays / seconds ) / 1000000.0,
+	        PlGetCurrentSeconds() - timeStart, outPath );
+
+	return EXIT_SUCCESS;
+}